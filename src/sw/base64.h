@@ -24,37 +24,601 @@
 
 #include <string>
 
+// Vectorized kernels. x86 kernels are compiled with per-function target attributes and picked at
+// runtime, so the rest of the program doesn't need to be built with -mavx2. NEON is baseline on
+// aarch64 so it's picked at compile time.
+#if !defined(SW_BASE64_X86)
+#  if (SW_GCC_CXX || SW_CLANG_CXX) && (defined(__x86_64__) || defined(__i386__))
+#    define SW_BASE64_X86 1
+#  else
+#    define SW_BASE64_X86 0
+#  endif
+#endif
+
+#if !defined(SW_BASE64_NEON)
+#  if defined(__aarch64__) && defined(__ARM_NEON)
+#    define SW_BASE64_NEON 1
+#  else
+#    define SW_BASE64_NEON 0
+#  endif
+#endif
+
+#if SW_BASE64_X86
+#  include <immintrin.h>
+#  define SW_BASE64_TARGET(isa) __attribute__((target(isa)))
+#elif SW_BASE64_NEON
+#  include <arm_neon.h>
+#endif
+
 SW_NAMESPACE_BEGIN
 
-/// Base64 encoder that supports:
+/// Base64 encoder/decoder that supports:
 ///  * Standard encoding, or
 ///  * URL/Filename safe encoding per https://en.wikipedia.org/wiki/Base64#Variants_summary_table
 ///  * Optional '=' padding. URL/Filename version defaults to no padding, Standard defaults to padded
+///
+/// The bulk of the work is done by SSE4.1/AVX2 (x86) or NEON (aarch64) kernels when the CPU has
+/// them, with the scalar code handling the tail and anything else.
+///
+/// Decoding is strict: characters outside the alphabet (including whitespace), misplaced or
+/// excess padding, and non-zero trailing bits are all rejected. Padding is optional on input, but
+/// when present it must complete the final 4-char group.
+
+////////////////////////////////////////////////////////////////////////////////
+/// The available encode/decode implementations
+enum class Base64Kernel : u8 {
+  Scalar,
+  Sse41,
+  Avx2,
+  Neon,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Returned by the raw encoders/decoders when the input isn't valid or the output won't fit
+constexpr sizex kBase64Invalid = ~sizex(0);
+
+////////////////////////////////////////////////////////////////////////////////
+/// Encoded size of sourceLen bytes
+inline sizex base64EncodedSize(sizex sourceLen, bool pad) {
+  SW_ASSERT(((sourceLen << 2u) >> 2u) == sourceLen);  // Ensure 2-MSbits are zero so we don't overflow
+  const sizex baseMod = sourceLen % 3;
+  const sizex baseExtra = baseMod > 0 ? 3 - baseMod : 0;
+  const sizex baseLen = sourceLen + baseExtra;
+  return (baseLen / 3 * 4) - (pad ? 0 : baseExtra);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Upper bound on the decoded size of sourceLen chars. Exact for valid unpadded input
+inline sizex base64DecodedSizeBound(sizex sourceLen) {
+  const sizex tail = sourceLen % 4;
+  return sourceLen / 4 * 3 + (tail > 1 ? tail - 1 : 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Decoded size of the given text, accounting for padding. Exact for valid input
+inline sizex base64DecodedSize(const char source[], sizex sourceLen) {
+  sizex padCount = 0;
+  if (sourceLen > 0 && sourceLen % 4 == 0 && source[sourceLen - 1] == '=') {
+    padCount = source[sourceLen - 2] == '=' ? 2 : 1;
+  }
+  return base64DecodedSizeBound(sourceLen - padCount);
+}
 
 namespace detail {
 
+/// Decoder classification by high nibble, shared by both alphabets. A char is invalid when
+/// (lutLo[c & 0xf] & lutHi[c >> 4]) is non-zero. Bit 0x10 rejects control chars and anything
+/// >= 0x80; the other bits are one-per-row for the rows that hold alphabet chars.
+inline const u8* base64DecodeLutHi() {
+  static const u8 kLut[16] = {0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x20,
+                              0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10};
+  return kLut;
+}
+
 struct Base64Traits {
   static constexpr const char* kEncode = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  static constexpr char kChar62 = '+';
+  static constexpr char kChar63 = '/';
+  static constexpr bool kPadByDefault = true;
   static char encode(byte bits6) {
     SW_ASSERT((bits6 & ~0b111111_u8) == 0);
     return kEncode[bits6];
   }
+
+  /// Decoder classification by low nibble. Only '+' (0x2b) and '/' (0x2f) are valid in row 2
+  static const u8* decodeLutLo() {
+    static const u8 kLut[16] = {0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                0x11, 0x11, 0x13, 0x3a, 0x3b, 0x3b, 0x3b, 0x3a};
+    return kLut;
+  }
 };
 
 struct Base64UrlTraits {
   static constexpr const char* kEncode = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+  static constexpr char kChar62 = '-';
+  static constexpr char kChar63 = '_';
+  static constexpr bool kPadByDefault = false;
   static char encode(byte bits6) {
     SW_ASSERT((bits6 & ~0b111111_u8) == 0);
     return kEncode[bits6];
   }
+
+  /// Decoder classification by low nibble. '-' (0x2d) is the only valid row 2 char, and '_' (0x5f)
+  /// joins 'P'-'Z' in row 5
+  static const u8* decodeLutLo() {
+    static const u8 kLut[16] = {0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                0x11, 0x11, 0x13, 0x3b, 0x3b, 0x3a, 0x3b, 0x33};
+    return kLut;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Char to 6-bit value, or -1 for anything outside the alphabet
+template <typename Base64TraitsType>
+struct Base64DecodeTable {
+  Base64DecodeTable() {
+    for (auto& value : values) {
+      value = -1;
+    }
+    for (i8 i = 0; i < 64; ++i) {
+      values[u8(Base64TraitsType::kEncode[i])] = i;
+    }
+  }
+
+  static const i8* get() {
+    static const Base64DecodeTable kTable;
+    return kTable.values;
+  }
+
+  i8 values[256];
 };
 
+////////////////////////////////////////////////////////////////////////////////
+/// Scalar encoder, also used for the tail of the vectorized ones. Returns the new end of dest
+template <typename Base64TraitsType>
+inline char* base64EncodeScalar(const byte source[], sizex sourceLen, char* dest, bool pad) {
+  const auto encode = [](byte bits6) -> char { return Base64TraitsType::encode(bits6); };
+
+  // Work through the array in 3-byte groups, encode every 6-bits into a single char
+  const byte* pos = source;
+  const byte* const end = pos + sourceLen;
+  while ((pos + 2) < end) {
+    // Encode 3-bytes
+    const auto& b0 = *pos++;
+    const auto& b1 = *pos++;
+    const auto& b2 = *pos++;
+
+    // Note - shift operators promote byte's to ints, thus our cast-fest
+    *dest++ = encode(byte(b0 >> 2u));
+    *dest++ = encode(byte(byte(byte(b0 << 4u) & 0b110000_u8) | byte(b1 >> 4u)));
+    *dest++ = encode(byte(byte(byte(b1 << 2u) & 0b111100_u8) | byte(b2 >> 6u)));
+    *dest++ = encode(byte(b2 & 0b111111_u8));
+  }
+
+  // Groups of 3 complete. We're left with 0, 1, or 2 more bytes to encode.
+  constexpr char kPad = '=';
+  if ((pos + 2) == end) {  // 2 bytes left
+    const auto& b0 = *pos++;
+    const auto& b1 = *pos++;
+    *dest++ = encode(byte(b0 >> 2u));
+    *dest++ = encode(byte(byte(byte(b0 << 4u) & 0b110000_u8) | byte(b1 >> 4u)));
+    *dest++ = encode(byte(byte(b1 << 2u) & 0b111100_u8));
+    if (pad) {
+      *dest++ = kPad;
+    }
+  } else if ((pos + 1) == end) {  // 1 byte left
+    const auto& b0 = *pos++;
+    *dest++ = encode(byte(b0 >> 2u));
+    *dest++ = encode(byte(byte(b0 << 4u) & 0b110000_u8));
+    if (pad) {
+      *dest++ = kPad;
+      *dest++ = kPad;
+    }
+  }
+
+  return dest;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Strict scalar decoder. Returns the number of bytes written, or kBase64Invalid
+template <typename Base64TraitsType>
+inline sizex base64DecodeScalar(const char source[], sizex sourceLen, byte* dest) {
+  const i8* const table = Base64DecodeTable<Base64TraitsType>::get();
+  const auto value = [table](char c) -> i32 { return table[u8(c)]; };
+
+  // Padding, if present, must round the input out to a multiple of 4. Any other '=' will fail the
+  // alphabet check below
+  if (sourceLen > 0 && source[sourceLen - 1] == '=') {
+    if (sourceLen % 4 != 0) {
+      return kBase64Invalid;
+    }
+    sourceLen -= (source[sourceLen - 2] == '=') ? 2 : 1;
+  }
+
+  const sizex tail = sourceLen % 4;
+  if (tail == 1) {
+    return kBase64Invalid;
+  }
+
+  byte* out = dest;
+  const char* pos = source;
+  const char* const end = source + (sourceLen - tail);
+  for (; pos != end; pos += 4) {
+    const i32 a = value(pos[0]);
+    const i32 b = value(pos[1]);
+    const i32 c = value(pos[2]);
+    const i32 d = value(pos[3]);
+    if ((a | b | c | d) < 0) {
+      return kBase64Invalid;
+    }
+    const u32 bits = (u32(a) << 18u) | (u32(b) << 12u) | (u32(c) << 6u) | u32(d);
+    *out++ = byte(bits >> 16u);
+    *out++ = byte(bits >> 8u);
+    *out++ = byte(bits);
+  }
+
+  // The bits that don't make it into a whole byte must be zero, else the encoding isn't canonical
+  if (tail == 2) {
+    const i32 a = value(pos[0]);
+    const i32 b = value(pos[1]);
+    if ((a | b) < 0 || (b & 0b1111) != 0) {
+      return kBase64Invalid;
+    }
+    *out++ = byte((u32(a) << 2u) | (u32(b) >> 4u));
+  } else if (tail == 3) {
+    const i32 a = value(pos[0]);
+    const i32 b = value(pos[1]);
+    const i32 c = value(pos[2]);
+    if ((a | b | c) < 0 || (c & 0b11) != 0) {
+      return kBase64Invalid;
+    }
+    *out++ = byte((u32(a) << 2u) | (u32(b) >> 4u));
+    *out++ = byte((u32(b) << 4u) | (u32(c) >> 2u));
+  }
+
+  return sizex(out - dest);
+}
+
+#if SW_BASE64_X86
+
+////////////////////////////////////////////////////////////////////////////////
+/// The x86 kernels follow Wojciech Muła's and Daniel Lemire's "Faster Base64 Encoding and
+/// Decoding using AVX2 Instructions". Each one consumes whole blocks and returns how much input it
+/// used, advancing dest. Decoders stop at the first block that doesn't validate and leave it for
+/// the scalar code to diagnose, which also covers the padded final group.
+
+/// 6-bit values to ascii. Buckets the values into A-Z, a-z, 0-9, 62, 63 and adds the bucket offset
+template <typename Base64TraitsType>
+SW_BASE64_TARGET("sse4.1") inline __m128i base64LookupSse41(__m128i indices) {
+  const __m128i shiftLut = _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, i8(Base64TraitsType::kChar62 - 62), i8(Base64TraitsType::kChar63 - 63), 'A', 0, 0);
+  __m128i bucket = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  const __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+  bucket = _mm_or_si128(bucket, _mm_and_si128(upper, _mm_set1_epi8(13)));
+  return _mm_add_epi8(_mm_shuffle_epi8(shiftLut, bucket), indices);
+}
+
+template <typename Base64TraitsType>
+SW_BASE64_TARGET("avx2") inline __m256i base64LookupAvx2(__m256i indices) {
+  const __m256i shiftLut = _mm256_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, i8(Base64TraitsType::kChar62 - 62), i8(Base64TraitsType::kChar63 - 63), 'A', 0, 0,
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, i8(Base64TraitsType::kChar62 - 62), i8(Base64TraitsType::kChar63 - 63), 'A', 0, 0);
+  __m256i bucket = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+  const __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+  bucket = _mm256_or_si256(bucket, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+  return _mm256_add_epi8(_mm256_shuffle_epi8(shiftLut, bucket), indices);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// 12 bytes to 16 chars per block. Loads 16 bytes, so the last 4 input bytes are left for later
+template <typename Base64TraitsType>
+SW_BASE64_TARGET("sse4.1") inline sizex base64EncodeSse41(const byte source[], sizex sourceLen, char*& dest) {
+  sizex pos = 0;
+  for (; pos + 16 <= sourceLen; pos += 12) {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + pos));
+    // Spread each 3 bytes into a 32-bit lane as [b1, b0, b2, b1], then shift each 6-bit field
+    // into its own byte with a pair of multiplies
+    in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    const __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    const __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    const __m128i chars = base64LookupSse41<Base64TraitsType>(_mm_or_si128(t0, t1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), chars);
+    dest += 16;
+  }
+  return pos;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// 24 bytes to 32 chars per block. The two 128-bit lanes are loaded 12 bytes apart so each lane
+/// works just like the SSE version
+template <typename Base64TraitsType>
+SW_BASE64_TARGET("avx2") inline sizex base64EncodeAvx2(const byte source[], sizex sourceLen, char*& dest) {
+  sizex pos = 0;
+  for (; pos + 28 <= sourceLen; pos += 24) {
+    const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + pos));
+    const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + pos + 12));
+    __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    in = _mm256_shuffle_epi8(in, _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,  //
+                                                  1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    const __m256i t0 =
+        _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+    const __m256i t1 =
+        _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+    const __m256i chars = base64LookupAvx2<Base64TraitsType>(_mm256_or_si256(t0, t1));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), chars);
+    dest += 32;
+  }
+  return pos;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// 16 chars to 12 bytes per block. Stores 16 bytes, so stops while destEnd still has room
+template <typename Base64TraitsType>
+SW_BASE64_TARGET("sse4.1")
+inline sizex base64DecodeSse41(const char source[], sizex sourceLen, byte*& dest, const byte* destEnd) {
+  const __m128i lutLo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Base64TraitsType::decodeLutLo()));
+  const __m128i lutHi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(base64DecodeLutHi()));
+  // Offset by high nibble. Row 2 only has char 62, and char 63 is patched in separately
+  const __m128i lutRoll = _mm_setr_epi8(0, 0, i8(62 - Base64TraitsType::kChar62), 4, -65, -65, -71,
+                                        -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask0f = _mm_set1_epi8(0x0f);
+  const __m128i char63 = _mm_set1_epi8(Base64TraitsType::kChar63);
+  const __m128i roll63 = _mm_set1_epi8(i8(63 - Base64TraitsType::kChar63));
+
+  sizex pos = 0;
+  for (; pos + 16 <= sourceLen && dest + 16 <= destEnd; pos += 16) {
+    const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + pos));
+    const __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask0f);
+    const __m128i loNibbles = _mm_and_si128(in, mask0f);
+    const __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+    const __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+    if (!_mm_testz_si128(lo, hi)) {
+      break;
+    }
+
+    __m128i roll = _mm_shuffle_epi8(lutRoll, hiNibbles);
+    // Plain and/or select rather than blendv, which GCC folds to a (mask < 0) test that's never
+    // true under -funsigned-char
+    const __m128i is63 = _mm_cmpeq_epi8(in, char63);
+    roll = _mm_or_si128(_mm_andnot_si128(is63, roll), _mm_and_si128(is63, roll63));
+    const __m128i values = _mm_add_epi8(in, roll);
+
+    // Pack 4 x 6-bits into 3 bytes per 32-bit lane, then squeeze out the empty 4th bytes
+    const __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    __m128i out = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    out = _mm_shuffle_epi8(out, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), out);
+    dest += 12;
+  }
+  return pos;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// 32 chars to 24 bytes per block. Stores 32 bytes, so stops while destEnd still has room
+template <typename Base64TraitsType>
+SW_BASE64_TARGET("avx2")
+inline sizex base64DecodeAvx2(const char source[], sizex sourceLen, byte*& dest, const byte* destEnd) {
+  const __m256i lutLo = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(Base64TraitsType::decodeLutLo())));
+  const __m256i lutHi =
+      _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(base64DecodeLutHi())));
+  const __m256i lutRoll = _mm256_setr_epi8(0, 0, i8(62 - Base64TraitsType::kChar62), 4, -65, -65, -71, -71, 0, 0, 0,
+                                           0, 0, 0, 0, 0,  //
+                                           0, 0, i8(62 - Base64TraitsType::kChar62), 4, -65, -65, -71, -71, 0, 0, 0,
+                                           0, 0, 0, 0, 0);
+  const __m256i mask0f = _mm256_set1_epi8(0x0f);
+  const __m256i char63 = _mm256_set1_epi8(Base64TraitsType::kChar63);
+  const __m256i roll63 = _mm256_set1_epi8(i8(63 - Base64TraitsType::kChar63));
+
+  sizex pos = 0;
+  for (; pos + 32 <= sourceLen && dest + 32 <= destEnd; pos += 32) {
+    const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + pos));
+    const __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), mask0f);
+    const __m256i loNibbles = _mm256_and_si256(in, mask0f);
+    const __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+    const __m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+    if (!_mm256_testz_si256(lo, hi)) {
+      break;
+    }
+
+    __m256i roll = _mm256_shuffle_epi8(lutRoll, hiNibbles);
+    const __m256i is63 = _mm256_cmpeq_epi8(in, char63);
+    roll = _mm256_or_si256(_mm256_andnot_si256(is63, roll), _mm256_and_si256(is63, roll63));
+    const __m256i values = _mm256_add_epi8(in, roll);
+
+    const __m256i merged = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    __m256i out = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+    out = _mm256_shuffle_epi8(out, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,  //
+                                                    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    out = _mm256_permutevar8x32_epi32(out, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), out);
+    dest += 24;
+  }
+  return pos;
+}
+
+#endif  // SW_BASE64_X86
+
+#if SW_BASE64_NEON
+
+////////////////////////////////////////////////////////////////////////////////
+/// 48 bytes to 64 chars per block. The de-interleaving loads/stores do the heavy lifting and the
+/// alphabet lookup is a single 64-entry table lookup
+template <typename Base64TraitsType>
+inline sizex base64EncodeNeon(const byte source[], sizex sourceLen, char*& dest) {
+  const auto* alphabet = reinterpret_cast<const u8*>(Base64TraitsType::kEncode);
+  const uint8x16x4_t table = {
+      {vld1q_u8(alphabet), vld1q_u8(alphabet + 16), vld1q_u8(alphabet + 32), vld1q_u8(alphabet + 48)}};
+  const uint8x16_t mask3f = vdupq_n_u8(0x3f);
+
+  sizex pos = 0;
+  for (; pos + 48 <= sourceLen; pos += 48) {
+    const uint8x16x3_t in = vld3q_u8(source + pos);
+    uint8x16x4_t out;
+    out.val[0] = vshrq_n_u8(in.val[0], 2);
+    out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask3f);
+    out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask3f);
+    out.val[3] = vandq_u8(in.val[2], mask3f);
+    for (auto& v : out.val) {
+      v = vqtbl4q_u8(table, v);
+    }
+    vst4q_u8(reinterpret_cast<u8*>(dest), out);
+    dest += 64;
+  }
+  return pos;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// 64 chars to 48 bytes per block. The ascii half of the decode table is split across two
+/// 64-entry lookups; anything invalid or >= 0x80 sets the high bit of the result
+template <typename Base64TraitsType>
+inline sizex base64DecodeNeon(const char source[], sizex sourceLen, byte*& dest, const byte* destEnd) {
+  const auto* decode = reinterpret_cast<const u8*>(Base64DecodeTable<Base64TraitsType>::get());
+  const uint8x16x4_t tableLo = {{vld1q_u8(decode), vld1q_u8(decode + 16), vld1q_u8(decode + 32), vld1q_u8(decode + 48)}};
+  const uint8x16x4_t tableHi = {
+      {vld1q_u8(decode + 64), vld1q_u8(decode + 80), vld1q_u8(decode + 96), vld1q_u8(decode + 112)}};
+  const uint8x16_t offset = vdupq_n_u8(64);
+
+  sizex pos = 0;
+  for (; pos + 64 <= sourceLen && dest + 48 <= destEnd; pos += 64) {
+    uint8x16x4_t in = vld4q_u8(reinterpret_cast<const u8*>(source + pos));
+    uint8x16_t error = vdupq_n_u8(0);
+    for (auto& v : in.val) {
+      const uint8x16_t values = vqtbx4q_u8(vqtbl4q_u8(tableLo, v), tableHi, vsubq_u8(v, offset));
+      error = vorrq_u8(error, vorrq_u8(values, v));
+      v = values;
+    }
+    if (vmaxvq_u8(error) >= 0x80) {
+      break;
+    }
+
+    uint8x16x3_t out;
+    out.val[0] = vorrq_u8(vshlq_n_u8(in.val[0], 2), vshrq_n_u8(in.val[1], 4));
+    out.val[1] = vorrq_u8(vshlq_n_u8(in.val[1], 4), vshrq_n_u8(in.val[2], 2));
+    out.val[2] = vorrq_u8(vshlq_n_u8(in.val[2], 6), in.val[3]);
+    vst3q_u8(dest, out);
+    dest += 48;
+  }
+  return pos;
+}
+
+#endif  // SW_BASE64_NEON
+
+inline Base64Kernel detectBase64Kernel() {
+#if SW_BASE64_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return Base64Kernel::Avx2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return Base64Kernel::Sse41;
+  }
+#elif SW_BASE64_NEON
+  return Base64Kernel::Neon;
+#endif
+  return Base64Kernel::Scalar;
+}
+
+}  // namespace detail
+
+////////////////////////////////////////////////////////////////////////////////
+/// The fastest kernel this CPU supports. Detected once
+inline Base64Kernel base64Kernel() {
+  static const Base64Kernel kKernel = ::sw::detail::detectBase64Kernel();
+  return kKernel;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Whether the given kernel can run on this CPU
+inline bool base64KernelSupported(Base64Kernel kernel) {
+  switch (base64Kernel()) {
+    case Base64Kernel::Avx2:
+      return kernel == Base64Kernel::Avx2 || kernel == Base64Kernel::Sse41 || kernel == Base64Kernel::Scalar;
+    case Base64Kernel::Sse41:
+      return kernel == Base64Kernel::Sse41 || kernel == Base64Kernel::Scalar;
+    case Base64Kernel::Neon:
+      return kernel == Base64Kernel::Neon || kernel == Base64Kernel::Scalar;
+    case Base64Kernel::Scalar:
+      break;
+  }
+  return kernel == Base64Kernel::Scalar;
+}
+
+namespace detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// Raw encode into dest, which must have room for base64EncodedSize(). Returns the new end of dest
+template <typename Base64TraitsType>
+inline char* base64EncodeWith(Base64Kernel kernel, const byte source[], sizex sourceLen, char* dest, bool pad) {
+  SW_ASSERT(base64KernelSupported(kernel));
+  sizex pos = 0;
+#if SW_BASE64_X86
+  if (kernel == Base64Kernel::Avx2) {
+    pos += base64EncodeAvx2<Base64TraitsType>(source, sourceLen, dest);
+  }
+  if (kernel == Base64Kernel::Avx2 || kernel == Base64Kernel::Sse41) {
+    pos += base64EncodeSse41<Base64TraitsType>(source + pos, sourceLen - pos, dest);
+  }
+#elif SW_BASE64_NEON
+  if (kernel == Base64Kernel::Neon) {
+    pos += base64EncodeNeon<Base64TraitsType>(source, sourceLen, dest);
+  }
+#endif
+  unused(kernel);
+  return base64EncodeScalar<Base64TraitsType>(source + pos, sourceLen - pos, dest, pad);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Raw decode into dest. Returns the number of bytes written, or kBase64Invalid if the source
+/// isn't valid or its decoded size won't fit in destSize
+template <typename Base64TraitsType>
+inline sizex base64DecodeWith(Base64Kernel kernel, const char source[], sizex sourceLen, byte* dest,
+                              sizex destSize) {
+  SW_ASSERT(base64KernelSupported(kernel));
+  const sizex decodedSize = base64DecodedSize(source, sourceLen);
+  if (decodedSize > destSize) {
+    return kBase64Invalid;
+  }
+
+  // Vector stores are kept within the decoded size, so a dest that's exactly big enough is fine
+  byte* out = dest;
+  const byte* const outEnd = dest + decodedSize;
+  sizex pos = 0;
+#if SW_BASE64_X86
+  if (kernel == Base64Kernel::Avx2) {
+    pos += base64DecodeAvx2<Base64TraitsType>(source, sourceLen, out, outEnd);
+  }
+  if (kernel == Base64Kernel::Avx2 || kernel == Base64Kernel::Sse41) {
+    pos += base64DecodeSse41<Base64TraitsType>(source + pos, sourceLen - pos, out, outEnd);
+  }
+#elif SW_BASE64_NEON
+  if (kernel == Base64Kernel::Neon) {
+    pos += base64DecodeNeon<Base64TraitsType>(source, sourceLen, out, outEnd);
+  }
+#endif
+  unused(kernel);
+  unused(outEnd);
+  const sizex tailSize = base64DecodeScalar<Base64TraitsType>(source + pos, sourceLen - pos, out);
+  return tailSize == kBase64Invalid ? kBase64Invalid : sizex(out - dest) + tailSize;
+}
+
 }  // namespace detail
 
 ////////////////////////////////////////////////////////////////////////////////
 /// The main encoding function, defined later
 template <typename Base64Traits = ::sw::detail::Base64Traits>
-inline std::string base64Encoder(const byte source[], sizex sourceLen, bool pad);
+inline std::string base64Encoder(const byte source[], sizex sourceLen, bool pad,
+                                 Base64Kernel kernel = base64Kernel());
+
+////////////////////////////////////////////////////////////////////////////////
+/// The main decoding function, defined later. Returns false, leaving result empty, if the
+/// source isn't valid
+template <typename Base64Traits = ::sw::detail::Base64Traits>
+inline bool base64Decoder(const char source[], sizex sourceLen, std::string& result,
+                          Base64Kernel kernel = base64Kernel());
 
 ////////////////////////////////////////////////////////////////////////////////
 /// Do standard base64 encoding
@@ -89,63 +653,310 @@ inline std::string base64UrlEncode(const char* str, sizex len, bool pad = false)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-template <typename Base64TraitsType>
-inline std::string base64Encoder(const byte source[], sizex sourceLen, bool pad) {
-  SW_ASSERT(((sourceLen << 2u) >> 2u) == sourceLen);  // Ensure 2-MSbits are zero so we don't overflow
+/// Do standard base64 decoding
+inline bool base64Decode(const char* str, sizex len, std::string& result) {
+  return base64Decoder(str, len, result);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline bool base64Decode(const std::string& str, std::string& result) {
+  return base64Decode(str.data(), str.size(), result);
+}
 
+////////////////////////////////////////////////////////////////////////////////
+/// Do url & filename safe base64 decoding
+inline bool base64UrlDecode(const char* str, sizex len, std::string& result) {
+  return base64Decoder<::sw::detail::Base64UrlTraits>(str, len, result);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline bool base64UrlDecode(const std::string& str, std::string& result) {
+  return base64UrlDecode(str.data(), str.size(), result);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename Base64TraitsType>
+inline std::string base64Encoder(const byte source[], sizex sourceLen, bool pad, Base64Kernel kernel) {
   // Figure out resultant string size. It will be much more efficient to pre-size the
-  // string and use [] ops than to append to it, as the append func has to do various checks
-  // like figuring out if it needs to regrow the string. Also, we'll only incur one
+  // string and write through data() than to append to it, as the append func has to do various
+  // checks like figuring out if it needs to regrow the string. Also, we'll only incur one
   // allocation this way
-  const sizex baseMod = sourceLen % 3;
-  const sizex baseExtra = baseMod > 0 ? 3 - baseMod : 0;
-  const sizex baseLen = sourceLen + baseExtra;
-  const sizex resultSize = (baseLen / 3 * 4) - (pad ? 0 : baseExtra);
-  auto result = std::string(resultSize, '\0');
-  sizex resultPos = 0;
+  auto result = std::string(base64EncodedSize(sourceLen, pad), '\0');
+  char* const end = ::sw::detail::base64EncodeWith<Base64TraitsType>(kernel, source, sourceLen, &result[0], pad);
+  SW_ASSERT(sizex(end - result.data()) == result.size());
+  unused(end);
+  return result;
+}
 
-  const auto encode = [](byte bits6) -> char { return Base64TraitsType::encode(bits6); };
+////////////////////////////////////////////////////////////////////////////////
+template <typename Base64TraitsType>
+inline bool base64Decoder(const char source[], sizex sourceLen, std::string& result, Base64Kernel kernel) {
+  result.resize(base64DecodedSize(source, sourceLen));
+  const sizex size = ::sw::detail::base64DecodeWith<Base64TraitsType>(
+      kernel, source, sourceLen, sw::utils::saferAlias<byte*>(&result[0]), result.size());
+  if (size == kBase64Invalid) {
+    result.clear();
+    return false;
+  }
+  result.resize(size);
+  return true;
+}
 
-  // Work through the array in 3-byte groups, encode every 6-bits into a single char
-  const byte* pos = source;
-  const byte* const end = pos + sourceLen;
-  while ((pos + 2) < end) {
-    // Encode 3-bytes
-    const auto& b0 = *pos++;
-    const auto& b1 = *pos++;
-    const auto& b2 = *pos++;
+////////////////////////////////////////////////////////////////////////////////
+/// Encode into a caller supplied buffer, no allocation. Returns the number of chars written, or
+/// kBase64Invalid if destSize is less than base64EncodedSize()
+template <typename Base64TraitsType = ::sw::detail::Base64Traits>
+inline sizex base64EncoderInto(const byte source[], sizex sourceLen, char* dest, sizex destSize, bool pad,
+                               Base64Kernel kernel = base64Kernel()) {
+  const sizex size = base64EncodedSize(sourceLen, pad);
+  if (size > destSize) {
+    return kBase64Invalid;
+  }
+  ::sw::detail::base64EncodeWith<Base64TraitsType>(kernel, source, sourceLen, dest, pad);
+  return size;
+}
 
-    // Note - shift operators promote byte's to ints, thus our cast-fest
-    result[resultPos++] = encode(byte(b0 >> 2u));
-    result[resultPos++] = encode(byte(byte(byte(b0 << 4u) & 0b110000_u8) | byte(b1 >> 4u)));
-    result[resultPos++] = encode(byte(byte(byte(b1 << 2u) & 0b111100_u8) | byte(b2 >> 6u)));
-    result[resultPos++] = encode(byte(b2 & 0b111111_u8));
+////////////////////////////////////////////////////////////////////////////////
+/// Decode into a caller supplied buffer, no allocation. Returns the number of bytes written, or
+/// kBase64Invalid if the source isn't valid or destSize is less than base64DecodedSize()
+template <typename Base64TraitsType = ::sw::detail::Base64Traits>
+inline sizex base64DecoderInto(const char source[], sizex sourceLen, byte* dest, sizex destSize,
+                               Base64Kernel kernel = base64Kernel()) {
+  return ::sw::detail::base64DecodeWith<Base64TraitsType>(kernel, source, sourceLen, dest, destSize);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline sizex base64EncodeInto(const byte source[], sizex sourceLen, char* dest, sizex destSize, bool pad = true) {
+  return base64EncoderInto(source, sourceLen, dest, destSize, pad);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline sizex base64EncodeInto(const std::string& str, char* dest, sizex destSize, bool pad = true) {
+  return base64EncodeInto(sw::utils::saferAlias<const byte*>(str.data()), str.size(), dest, destSize, pad);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline sizex base64UrlEncodeInto(const byte source[], sizex sourceLen, char* dest, sizex destSize,
+                                 bool pad = false) {
+  return base64EncoderInto<::sw::detail::Base64UrlTraits>(source, sourceLen, dest, destSize, pad);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline sizex base64UrlEncodeInto(const std::string& str, char* dest, sizex destSize, bool pad = false) {
+  return base64UrlEncodeInto(sw::utils::saferAlias<const byte*>(str.data()), str.size(), dest, destSize, pad);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline sizex base64DecodeInto(const char* str, sizex len, byte* dest, sizex destSize) {
+  return base64DecoderInto(str, len, dest, destSize);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline sizex base64DecodeInto(const std::string& str, byte* dest, sizex destSize) {
+  return base64DecodeInto(str.data(), str.size(), dest, destSize);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline sizex base64UrlDecodeInto(const char* str, sizex len, byte* dest, sizex destSize) {
+  return base64DecoderInto<::sw::detail::Base64UrlTraits>(str, len, dest, destSize);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline sizex base64UrlDecodeInto(const std::string& str, byte* dest, sizex destSize) {
+  return base64UrlDecodeInto(str.data(), str.size(), dest, destSize);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Incremental encoder for input that arrives in pieces, e.g. the segments of a PagedBuffer.
+/// Carries the 0-2 bytes that don't make a whole group from one update() to the next, so the
+/// output is identical to encoding the concatenated input in one go.
+///
+/// Usage:
+///   Base64StreamEncoder<> encoder;
+///   for (...) { encoder.update(chunk, chunkSize, out); }
+///   encoder.finish(out);
+template <typename Base64TraitsType = ::sw::detail::Base64Traits>
+class Base64StreamEncoder {
+public:
+  /// Most chars finish() will write
+  static constexpr sizex kMaxFinishSize = 4;
+
+  explicit Base64StreamEncoder(bool pad = Base64TraitsType::kPadByDefault, Base64Kernel kernel = base64Kernel())
+      : pad_(pad), kernel_(kernel) {}
+
+  /// Most chars update() will write for the given input size
+  sizex maxUpdateSize(sizex sourceLen) const { return (pendingSize_ + sourceLen) / 3 * 4; }
+
+  /// Encode all the whole groups available. dest must have room for maxUpdateSize(sourceLen).
+  /// Returns the number of chars written
+  sizex update(const byte source[], sizex sourceLen, char* dest) {
+    char* out = dest;
+
+    // Top up the carried bytes first
+    if (pendingSize_ > 0) {
+      while (pendingSize_ < 3 && sourceLen > 0) {
+        pending_[pendingSize_++] = *source++;
+        --sourceLen;
+      }
+      if (pendingSize_ < 3) {
+        return 0;
+      }
+      out = ::sw::detail::base64EncodeScalar<Base64TraitsType>(pending_, 3, out, false);
+      pendingSize_ = 0;
+    }
+
+    const sizex wholeLen = sourceLen - sourceLen % 3;
+    out = ::sw::detail::base64EncodeWith<Base64TraitsType>(kernel_, source, wholeLen, out, false);
+    for (sizex i = wholeLen; i < sourceLen; ++i) {
+      pending_[pendingSize_++] = source[i];
+    }
+    return sizex(out - dest);
   }
 
-  // Groups of 3 complete. We're left with 0, 1, or 2 more bytes to encode.
-  constexpr char kPad = '=';
-  if ((pos + 2) == end) {  // 2 bytes left
-    const auto& b0 = *pos++;
-    const auto& b1 = *pos++;
-    result[resultPos++] = encode(byte(b0 >> 2u));
-    result[resultPos++] = encode(byte(byte(byte(b0 << 4u) & 0b110000_u8) | byte(b1 >> 4u)));
-    result[resultPos++] = encode(byte(byte(b1 << 2u) & 0b111100_u8));
-    if (pad) {
-      result[resultPos++] = kPad;
+  /// Appending version of update()
+  void update(const byte source[], sizex sourceLen, std::string& result) {
+    const sizex start = result.size();
+    result.resize(start + maxUpdateSize(sourceLen));
+    result.resize(start + update(source, sourceLen, &result[start]));
+  }
+
+  /// Encode the carried bytes and any padding, and reset for reuse. dest must have room for
+  /// kMaxFinishSize. Returns the number of chars written
+  sizex finish(char* dest) {
+    char* const end = ::sw::detail::base64EncodeScalar<Base64TraitsType>(pending_, pendingSize_, dest, pad_);
+    pendingSize_ = 0;
+    return sizex(end - dest);
+  }
+
+  /// Appending version of finish()
+  void finish(std::string& result) {
+    char buffer[kMaxFinishSize];
+    result.append(buffer, finish(buffer));
+  }
+
+private:
+  byte pending_[3] = {};
+  sizex pendingSize_ = 0;
+  bool pad_;
+  Base64Kernel kernel_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Incremental strict decoder, the counterpart to Base64StreamEncoder. Carries the 0-3 chars that
+/// don't make a whole group between updates. Padding ends the stream: any input after it is an
+/// error. Errors are sticky until reset().
+template <typename Base64TraitsType = ::sw::detail::Base64Traits>
+class Base64StreamDecoder {
+public:
+  /// Most bytes finish() will write
+  static constexpr sizex kMaxFinishSize = 2;
+
+  explicit Base64StreamDecoder(Base64Kernel kernel = base64Kernel()) : kernel_(kernel) {}
+
+  /// Most bytes update() will write for the given input size
+  sizex maxUpdateSize(sizex sourceLen) const { return (pendingSize_ + sourceLen) / 4 * 3; }
+
+  /// Whether an error has been seen
+  bool failed() const { return failed_; }
+
+  /// Decode all the whole groups available. dest must have room for maxUpdateSize(sourceLen).
+  /// Returns the number of bytes written, or kBase64Invalid
+  sizex update(const char source[], sizex sourceLen, byte* dest) {
+    if (failed_ || (padded_ && sourceLen > 0)) {
+      return fail();
     }
-  } else if ((pos + 1) == end) {  // 1 byte left
-    const auto& b0 = *pos++;
-    result[resultPos++] = encode(byte(b0 >> 2u));
-    result[resultPos++] = encode(byte(byte(b0 << 4u) & 0b110000_u8));
-    if (pad) {
-      result[resultPos++] = kPad;
-      result[resultPos++] = kPad;
+
+    byte* out = dest;
+    if (pendingSize_ > 0) {
+      while (pendingSize_ < 4 && sourceLen > 0) {
+        pending_[pendingSize_++] = *source++;
+        --sourceLen;
+      }
+      if (pendingSize_ < 4) {
+        return 0;
+      }
+      pendingSize_ = 0;
+      if (!decodeGroups(pending_, 4, out) || (padded_ && sourceLen > 0)) {
+        return fail();
+      }
+    }
+
+    const sizex wholeLen = sourceLen - sourceLen % 4;
+    if (!decodeGroups(source, wholeLen, out) || (padded_ && wholeLen < sourceLen)) {
+      return fail();
+    }
+    for (sizex i = wholeLen; i < sourceLen; ++i) {
+      pending_[pendingSize_++] = source[i];
     }
+    return sizex(out - dest);
   }
 
-  return result;
-}
+  /// Appending version of update(). Returns false on error
+  bool update(const char source[], sizex sourceLen, std::string& result) {
+    const sizex start = result.size();
+    result.resize(start + maxUpdateSize(sourceLen));
+    const sizex size = update(source, sourceLen, sw::utils::saferAlias<byte*>(&result[start]));
+    result.resize(start + (size == kBase64Invalid ? 0 : size));
+    return size != kBase64Invalid;
+  }
+
+  /// Decode the carried chars, which must form a valid unpadded final group, and reset for reuse.
+  /// dest must have room for kMaxFinishSize. Returns the number of bytes written, or
+  /// kBase64Invalid
+  sizex finish(byte* dest) {
+    const sizex size = failed_ ? kBase64Invalid
+                               : ::sw::detail::base64DecodeScalar<Base64TraitsType>(pending_, pendingSize_, dest);
+    reset();
+    return size;
+  }
+
+  /// Appending version of finish(). Returns false on error
+  bool finish(std::string& result) {
+    byte buffer[kMaxFinishSize];
+    const sizex size = finish(buffer);
+    if (size == kBase64Invalid) {
+      return false;
+    }
+    result.append(sw::utils::saferAlias<const char*>(static_cast<const byte*>(buffer)), size);
+    return true;
+  }
+
+  /// Clear any error and carried input
+  void reset() {
+    pendingSize_ = 0;
+    padded_ = false;
+    failed_ = false;
+  }
+
+private:
+  bool decodeGroups(const char source[], sizex sourceLen, byte*& out) {
+    if (sourceLen == 0) {
+      return true;
+    }
+    const sizex size = ::sw::detail::base64DecodeWith<Base64TraitsType>(
+        kernel_, source, sourceLen, out, base64DecodedSizeBound(sourceLen));
+    if (size == kBase64Invalid) {
+      return false;
+    }
+    out += size;
+    padded_ = source[sourceLen - 1] == '=';
+    return true;
+  }
+
+  sizex fail() {
+    failed_ = true;
+    return kBase64Invalid;
+  }
+
+private:
+  char pending_[4] = {};
+  sizex pendingSize_ = 0;
+  bool padded_ = false;
+  bool failed_ = false;
+  Base64Kernel kernel_;
+};
 
-/// TODO: write a decoder
+using Base64UrlStreamEncoder = Base64StreamEncoder<::sw::detail::Base64UrlTraits>;
+using Base64UrlStreamDecoder = Base64StreamDecoder<::sw::detail::Base64UrlTraits>;
 
 SW_NAMESPACE_END
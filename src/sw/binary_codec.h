@@ -0,0 +1,579 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "assert.h"
+#include "types.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+// Vectorized byte swap kernels, set up the same way as base64.h: x86 kernels are compiled with
+// per-function target attributes and picked at runtime, NEON is baseline on aarch64.
+#if !defined(SW_CODEC_X86)
+#  if (SW_GCC_CXX || SW_CLANG_CXX) && (defined(__x86_64__) || defined(__i386__))
+#    define SW_CODEC_X86 1
+#  else
+#    define SW_CODEC_X86 0
+#  endif
+#endif
+
+#if !defined(SW_CODEC_NEON)
+#  if defined(__aarch64__) && defined(__ARM_NEON)
+#    define SW_CODEC_NEON 1
+#  else
+#    define SW_CODEC_NEON 0
+#  endif
+#endif
+
+#if SW_CODEC_X86
+#  include <immintrin.h>
+#  define SW_CODEC_TARGET(isa) __attribute__((target(isa)))
+#elif SW_CODEC_NEON
+#  include <arm_neon.h>
+#endif
+
+SW_NAMESPACE_BEGIN
+
+/// Endian-aware binary encoding for wire and file formats:
+///  * Bulk fixed-width encode/decode of integer and floating point arrays in an explicit byte
+///    order. Native order is a memcpy, the other order runs through SSSE3/AVX2 (x86) or NEON
+///    (aarch64) byte swap kernels with a scalar tail.
+///  * LEB128 varints, with zigzag for signed values.
+///  * appendArray()/appendVarints() to encode straight onto the end of a growable byte container
+///    (Vector<byte>, std::vector, std::string) or a PagedBuffer. Fixed buffers like UniqueBuffer
+///    take the pointer based calls on their data().
+
+////////////////////////////////////////////////////////////////////////////////
+/// The byte order of encoded data
+enum class ByteOrder : u8 {
+  Little,
+  Big,
+};
+
+#if SW_LITTLE_ENDIAN
+constexpr ByteOrder kNativeByteOrder = ByteOrder::Little;
+#else
+constexpr ByteOrder kNativeByteOrder = ByteOrder::Big;
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// The available byte swap implementations
+enum class ByteSwapKernel : u8 {
+  Scalar,
+  Ssse3,
+  Avx2,
+  Neon,
+};
+
+/// The longest varint encoding of a 64-bit value
+constexpr sizex kMaxVarintSize = 10;
+
+////////////////////////////////////////////////////////////////////////////////
+inline u8 byteSwap(u8 value) noexcept {
+  return value;
+}
+
+inline u16 byteSwap(u16 value) noexcept {
+#if SW_GCC_CXX || SW_CLANG_CXX
+  return __builtin_bswap16(value);
+#else
+  return u16((value << 8u) | (value >> 8u));
+#endif
+}
+
+inline u32 byteSwap(u32 value) noexcept {
+#if SW_GCC_CXX || SW_CLANG_CXX
+  return __builtin_bswap32(value);
+#else
+  return (u32(byteSwap(u16(value))) << 16u) | byteSwap(u16(value >> 16u));
+#endif
+}
+
+inline u64 byteSwap(u64 value) noexcept {
+#if SW_GCC_CXX || SW_CLANG_CXX
+  return __builtin_bswap64(value);
+#else
+  return (u64(byteSwap(u32(value))) << 32u) | byteSwap(u32(value >> 32u));
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Zigzag maps signed values onto unsigned ones so small magnitudes stay small: 0, -1, 1, -2, ...
+/// become 0, 1, 2, 3, ...
+inline u64 zigzagEncode(i64 value) noexcept {
+  return (u64(value) << 1u) ^ (u64(0) - (u64(value) >> 63u));
+}
+
+inline i64 zigzagDecode(u64 value) noexcept {
+  return i64((value >> 1u) ^ (u64(0) - (value & 1u)));
+}
+
+namespace codec_detail {
+
+template <sizex kSize>
+struct UnsignedOfSize;
+template <>
+struct UnsignedOfSize<1> {
+  using type = u8;
+};
+template <>
+struct UnsignedOfSize<2> {
+  using type = u16;
+};
+template <>
+struct UnsignedOfSize<4> {
+  using type = u32;
+};
+template <>
+struct UnsignedOfSize<8> {
+  using type = u64;
+};
+
+template <typename T>
+using CodecBitsType = typename UnsignedOfSize<sizeof(T)>::type;
+
+template <typename T>
+struct IsCodecValue
+    : std::integral_constant<bool, (std::is_integral<T>::value || std::is_floating_point<T>::value ||
+                                    std::is_enum<T>::value) &&
+                                       (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)> {};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Copy count elements of width bytes from source to dest, reversing the bytes of each. Either
+/// both pointers are the same or the ranges don't overlap.
+template <typename Bits>
+inline void swapBytesScalar(const byte* source, byte* dest, sizex count) noexcept {
+  for (sizex i = 0; i < count; ++i) {
+    Bits value;
+    std::memcpy(&value, source + i * sizeof(Bits), sizeof(Bits));
+    value = byteSwap(value);
+    std::memcpy(dest + i * sizeof(Bits), &value, sizeof(Bits));
+  }
+}
+
+#if SW_CODEC_X86
+
+/// pshufb control that reverses each width byte lane of a 16 byte block
+inline __m128i swapMask128(sizex width) noexcept {
+  switch (width) {
+    case 2:
+      return _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    case 4:
+      return _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    default:
+      return _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  }
+}
+
+/// Returns the number of bytes swapped, always a multiple of 16
+SW_CODEC_TARGET("ssse3") inline sizex swapBytesSsse3(const byte* source, byte* dest, sizex size, sizex width) {
+  const __m128i mask = swapMask128(width);
+  sizex pos = 0;
+  for (; pos + 16 <= size; pos += 16) {
+    const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + pos));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + pos), _mm_shuffle_epi8(in, mask));
+  }
+  return pos;
+}
+
+/// Returns the number of bytes swapped, always a multiple of 32
+SW_CODEC_TARGET("avx2") inline sizex swapBytesAvx2(const byte* source, byte* dest, sizex size, sizex width) {
+  // vpshufb works within each 128-bit lane, so the same control goes in both halves
+  const __m256i mask = _mm256_broadcastsi128_si256(swapMask128(width));
+  sizex pos = 0;
+  for (; pos + 64 <= size; pos += 64) {
+    const __m256i in0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + pos));
+    const __m256i in1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + pos + 32));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + pos), _mm256_shuffle_epi8(in0, mask));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + pos + 32), _mm256_shuffle_epi8(in1, mask));
+  }
+  for (; pos + 32 <= size; pos += 32) {
+    const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + pos));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + pos), _mm256_shuffle_epi8(in, mask));
+  }
+  return pos;
+}
+
+#elif SW_CODEC_NEON
+
+/// Returns the number of bytes swapped, always a multiple of 16
+inline sizex swapBytesNeon(const byte* source, byte* dest, sizex size, sizex width) {
+  sizex pos = 0;
+  for (; pos + 16 <= size; pos += 16) {
+    const uint8x16_t in = vld1q_u8(source + pos);
+    vst1q_u8(dest + pos, width == 2 ? vrev16q_u8(in) : width == 4 ? vrev32q_u8(in) : vrev64q_u8(in));
+  }
+  return pos;
+}
+
+#endif  // SW_CODEC_NEON
+
+inline ByteSwapKernel detectByteSwapKernel() {
+#if SW_CODEC_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return ByteSwapKernel::Avx2;
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    return ByteSwapKernel::Ssse3;
+  }
+#elif SW_CODEC_NEON
+  return ByteSwapKernel::Neon;
+#endif
+  return ByteSwapKernel::Scalar;
+}
+
+}  // namespace codec_detail
+
+////////////////////////////////////////////////////////////////////////////////
+/// The fastest kernel this CPU supports. Detected once
+inline ByteSwapKernel byteSwapKernel() {
+  static const ByteSwapKernel kKernel = codec_detail::detectByteSwapKernel();
+  return kKernel;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Whether the given kernel can run on this CPU
+inline bool byteSwapKernelSupported(ByteSwapKernel kernel) {
+  switch (byteSwapKernel()) {
+    case ByteSwapKernel::Avx2:
+      return kernel == ByteSwapKernel::Avx2 || kernel == ByteSwapKernel::Ssse3 || kernel == ByteSwapKernel::Scalar;
+    case ByteSwapKernel::Ssse3:
+      return kernel == ByteSwapKernel::Ssse3 || kernel == ByteSwapKernel::Scalar;
+    case ByteSwapKernel::Neon:
+      return kernel == ByteSwapKernel::Neon || kernel == ByteSwapKernel::Scalar;
+    case ByteSwapKernel::Scalar:
+      break;
+  }
+  return kernel == ByteSwapKernel::Scalar;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Copy count elements of type T from source to dest, reversing the bytes of each. source and dest
+/// may be the same pointer for an in-place swap, but must not otherwise overlap. Neither needs to
+/// be aligned.
+template <typename T>
+inline void swapBytesWith(ByteSwapKernel kernel, const void* source, void* dest, sizex count) {
+  static_assert(codec_detail::IsCodecValue<T>::value, "Byte swapping needs a 1, 2, 4 or 8 byte arithmetic type");
+  SW_ASSERT(byteSwapKernelSupported(kernel));
+  using Bits = codec_detail::CodecBitsType<T>;
+  const byte* in = static_cast<const byte*>(source);
+  byte* out = static_cast<byte*>(dest);
+  if (sizeof(T) == 1) {
+    if (in != out) {
+      std::memcpy(out, in, count);
+    }
+    return;
+  }
+
+  const sizex size = count * sizeof(T);
+  sizex pos = 0;
+#if SW_CODEC_X86
+  if (kernel == ByteSwapKernel::Avx2) {
+    pos += codec_detail::swapBytesAvx2(in, out, size, sizeof(T));
+  }
+  if (kernel == ByteSwapKernel::Avx2 || kernel == ByteSwapKernel::Ssse3) {
+    pos += codec_detail::swapBytesSsse3(in + pos, out + pos, size - pos, sizeof(T));
+  }
+#elif SW_CODEC_NEON
+  if (kernel == ByteSwapKernel::Neon) {
+    pos += codec_detail::swapBytesNeon(in, out, size, sizeof(T));
+  }
+#endif
+  unused(kernel);
+  codec_detail::swapBytesScalar<Bits>(in + pos, out + pos, (size - pos) / sizeof(T));
+}
+
+template <typename T>
+inline void swapBytes(const void* source, void* dest, sizex count) {
+  swapBytesWith<T>(byteSwapKernel(), source, dest, count);
+}
+
+SW_NAMESPACE_END
+
+SW_NAMESPACE_BEGIN namespace utils {
+  ////////////////////////////////////////////////////////////////////////////////
+  /// extractFromBuffer() for data stored in the given byte order
+  template <typename Dest>
+  inline Dest extractFromBuffer(const byte* sourceBuffer, ByteOrder order) {
+    static_assert(codec_detail::IsCodecValue<Dest>::value, "Ordered extraction needs a 1, 2, 4 or 8 byte arithmetic type");
+    auto bits = extractFromBuffer<codec_detail::CodecBitsType<Dest>>(sourceBuffer);
+    if (order != kNativeByteOrder) {
+      bits = byteSwap(bits);
+    }
+    Dest dest;
+    std::memcpy(&dest, &bits, sizeof(Dest));
+    return dest;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// placeIntoBuffer() storing the value in the given byte order
+  template <typename Source>
+  inline void placeIntoBuffer(byte * destBuffer, Source value, ByteOrder order) {
+    static_assert(codec_detail::IsCodecValue<Source>::value, "Ordered placement needs a 1, 2, 4 or 8 byte arithmetic type");
+    auto bits = extractFromBuffer<codec_detail::CodecBitsType<Source>>(reinterpret_cast<const byte*>(&value));
+    if (order != kNativeByteOrder) {
+      bits = byteSwap(bits);
+    }
+    placeIntoBuffer(destBuffer, bits);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Bulk extractFromBuffer(): decode count values stored back to back in the given byte order.
+  /// Returns the end of the consumed source
+  template <typename Dest>
+  inline const byte* extractArrayFromBuffer(const byte* sourceBuffer, Dest* dest, sizex count, ByteOrder order) {
+    static_assert(codec_detail::IsCodecValue<Dest>::value, "Ordered extraction needs a 1, 2, 4 or 8 byte arithmetic type");
+    if (order == kNativeByteOrder) {
+      std::memcpy(dest, sourceBuffer, count * sizeof(Dest));
+    } else {
+      swapBytes<Dest>(sourceBuffer, dest, count);
+    }
+    return sourceBuffer + count * sizeof(Dest);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Bulk placeIntoBuffer(): encode count values back to back in the given byte order. destBuffer
+  /// must have room for count * sizeof(Source). Returns the new end of destBuffer
+  template <typename Source>
+  inline byte* placeArrayIntoBuffer(byte * destBuffer, const Source* source, sizex count, ByteOrder order) {
+    static_assert(codec_detail::IsCodecValue<Source>::value, "Ordered placement needs a 1, 2, 4 or 8 byte arithmetic type");
+    if (order == kNativeByteOrder) {
+      std::memcpy(destBuffer, source, count * sizeof(Source));
+    } else {
+      swapBytes<Source>(source, destBuffer, count);
+    }
+    return destBuffer + count * sizeof(Source);
+  }
+}  // namespace sw::utils
+SW_NAMESPACE_END
+
+SW_NAMESPACE_BEGIN
+
+namespace codec_detail {
+
+template <typename T>
+inline u64 varintBits(T value) noexcept {
+  return std::is_signed<T>::value ? zigzagEncode(i64(value)) : u64(value);
+}
+
+/// Convert decoded varint bits back to T. Returns false if the value doesn't fit
+template <typename T>
+inline bool varintValue(u64 bits, T& value) noexcept {
+  if (std::is_signed<T>::value) {
+    const i64 decoded = zigzagDecode(bits);
+    if (decoded < i64(std::numeric_limits<T>::min()) || decoded > i64(std::numeric_limits<T>::max())) {
+      return false;
+    }
+    value = T(decoded);
+  } else {
+    if (bits > u64(std::numeric_limits<T>::max())) {
+      return false;
+    }
+    value = T(bits);
+  }
+  return true;
+}
+
+}  // namespace codec_detail
+
+////////////////////////////////////////////////////////////////////////////////
+/// Write value as a LEB128 varint: 7 bits per byte, low bits first, high bit set on all but the
+/// last byte. dest needs room for kMaxVarintSize. Returns the new end of dest
+inline byte* varintEncode(u64 value, byte* dest) noexcept {
+  while (value >= 0x80u) {
+    *dest++ = byte(value | 0x80u);
+    value >>= 7u;
+  }
+  *dest++ = byte(value);
+  return dest;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Read a LEB128 varint from [source, end). Returns the end of the varint, or nullptr if it's
+/// truncated, longer than kMaxVarintSize, or doesn't fit in 64 bits
+inline const byte* varintDecode(const byte* source, const byte* end, u64& value) noexcept {
+  u64 result = 0;
+  u32 shift = 0;
+  for (sizex i = 0; i < kMaxVarintSize && source != end; ++i, shift += 7) {
+    const byte next = *source++;
+    // The 10th byte only has the top bit of a u64 left to give
+    if (i == kMaxVarintSize - 1 && next > 1) {
+      return nullptr;
+    }
+    result |= u64(next & 0x7fu) << shift;
+    if ((next & 0x80u) == 0) {
+      value = result;
+      return source;
+    }
+  }
+  return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// The encoded size of value
+inline sizex varintSize(u64 value) noexcept {
+  sizex size = 1;
+  for (; value >= 0x80u; value >>= 7u) {
+    ++size;
+  }
+  return size;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// The longest varint for a T. Zigzag keeps signed values to the same number of bits
+template <typename T>
+constexpr sizex maxVarintSize() noexcept {
+  return (sizeof(T) * 8 + 6) / 7;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// The total encoded size of count integers, as written by varintEncodeArray()
+template <typename T>
+inline sizex varintEncodedSize(const T* values, sizex count) noexcept {
+  static_assert(std::is_integral<T>::value, "Varints are for integers");
+  sizex size = 0;
+  for (sizex i = 0; i < count; ++i) {
+    size += varintSize(codec_detail::varintBits(values[i]));
+  }
+  return size;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Encode count integers as varints. Signed types are zigzag encoded first. dest needs room for
+/// varintEncodedSize(), which is at most count * maxVarintSize<T>(). Returns the new end of dest
+template <typename T>
+inline byte* varintEncodeArray(const T* values, sizex count, byte* dest) noexcept {
+  static_assert(std::is_integral<T>::value, "Varints are for integers");
+  for (sizex i = 0; i < count; ++i) {
+    dest = varintEncode(codec_detail::varintBits(values[i]), dest);
+  }
+  return dest;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Decode count varints from [source, end) into values, reversing varintEncodeArray(). Returns the
+/// end of the consumed source, or nullptr if the data runs out, is malformed, or a value doesn't
+/// fit in T
+template <typename T>
+inline const byte* varintDecodeArray(const byte* source, const byte* end, T* values, sizex count) noexcept {
+  static_assert(std::is_integral<T>::value, "Varints are for integers");
+  for (sizex i = 0; i < count; ++i) {
+    u64 bits;
+    source = varintDecode(source, end, bits);
+    if (source == nullptr || !codec_detail::varintValue(bits, values[i])) {
+      return nullptr;
+    }
+  }
+  return source;
+}
+
+namespace codec_detail {
+
+template <typename...>
+using VoidType = void;
+
+/// Sinks with data() and resize() are encoded into directly, anything else needs append()
+template <typename Sink, typename = void>
+struct IsContiguousSink : std::false_type {};
+template <typename Sink>
+struct IsContiguousSink<Sink, VoidType<decltype(std::declval<Sink&>().data()), decltype(std::declval<Sink&>().resize(0))>>
+    : std::true_type {};
+
+/// Bounded scratch space for sinks that have to be appended to
+constexpr sizex kSinkChunkSize = 512;
+
+////////////////////////////////////////////////////////////////////////////////
+/// Grow sink by exactly encodedSize() bytes and encode in place, so the sink never holds more
+/// than the output. encode(first, count, dest) writes elements [first, first + count) and
+/// returns the new dest.
+template <typename Sink, typename EncodedSize, typename Encode>
+inline void appendEncoded(std::true_type, Sink& sink, sizex count, sizex /*maxElementSize*/,
+                          EncodedSize&& encodedSize, Encode&& encode) {
+  static_assert(sizeof(*sink.data()) == 1, "Byte sinks need byte sized elements");
+  if (count == 0) {
+    return;
+  }
+  const sizex oldSize = sink.size();
+  const sizex size = encodedSize();
+  sink.resize(oldSize + size);
+  // &sink[0] over data() since std::string::data() is const until C++17
+  byte* const base = reinterpret_cast<byte*>(&sink[0]);
+  byte* const end = encode(sizex(0), count, base + oldSize);
+  SW_ASSERT(end == base + oldSize + size);
+  unused(end);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Encode through a stack buffer a chunk at a time, for sinks like PagedBuffer. Chunks are
+/// sized by the worst case per element, so there's no sizing pass
+template <typename Sink, typename EncodedSize, typename Encode>
+inline void appendEncoded(std::false_type, Sink& sink, sizex count, sizex maxElementSize,
+                          EncodedSize&& /*encodedSize*/, Encode&& encode) {
+  SW_ASSERT(maxElementSize <= kSinkChunkSize);
+  byte scratch[kSinkChunkSize];
+  const sizex perChunk = kSinkChunkSize / maxElementSize;
+  for (sizex first = 0; first < count; first += perChunk) {
+    const sizex chunk = std::min(perChunk, count - first);
+    byte* const end = encode(first, chunk, scratch);
+    sink.append(scratch, sizex(end - scratch));
+  }
+}
+
+}  // namespace codec_detail
+
+////////////////////////////////////////////////////////////////////////////////
+/// Append count values to the end of sink in the given byte order. Sink is a growable byte
+/// container (Vector<byte>, std::vector<byte>, std::string) or anything with
+/// append(const byte*, sizex), like PagedBuffer
+template <typename Sink, typename T>
+inline void appendArray(Sink& sink, const T* values, sizex count, ByteOrder order) {
+  codec_detail::appendEncoded(codec_detail::IsContiguousSink<Sink>{}, sink, count, sizeof(T),
+                              [count]() { return count * sizeof(T); },
+                              [values, order](sizex first, sizex chunk, byte* dest) {
+                                return utils::placeArrayIntoBuffer(dest, values + first, chunk, order);
+                              });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Append a single value to the end of sink in the given byte order
+template <typename Sink, typename T>
+inline void appendValue(Sink& sink, T value, ByteOrder order) {
+  appendArray(sink, &value, 1, order);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Append count integers to the end of sink as varints, zigzag encoding signed types. See
+/// appendArray() for the supported sinks. Contiguous sinks take a sizing pass first, so they
+/// grow by exactly the encoded size
+template <typename Sink, typename T>
+inline void appendVarints(Sink& sink, const T* values, sizex count) {
+  codec_detail::appendEncoded(codec_detail::IsContiguousSink<Sink>{}, sink, count, maxVarintSize<T>(),
+                              [values, count]() { return varintEncodedSize(values, count); },
+                              [values](sizex first, sizex chunk, byte* dest) {
+                                return varintEncodeArray(values + first, chunk, dest);
+                              });
+}
+
+SW_NAMESPACE_END
@@ -20,10 +20,21 @@
 
 #include "assert.h"
 #include "fixed_width_int_literals.h"
+#include "misc.h"
 #include "reallocator.h"
 #include "types.h"
 
 #include <memory>
+#include <string>
+
+#if SW_POSIX
+#  include <cerrno>
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <system_error>
+#  include <unistd.h>
+#endif
 
 SW_NAMESPACE_BEGIN
 
@@ -36,8 +47,9 @@ using UniqueBuffer = UniqueBufferType<>;
 
 ////////////////////////////////////////////////////////////////////////////////
 template <typename ReallocatorType = MallocReallocator<byte>>
-UniqueBufferType<ReallocatorType> makeUniqueBuffer(sizex size) {
-  return UniqueBufferType<ReallocatorType>(ReallocatorType().allocate(size), size);
+UniqueBufferType<ReallocatorType> makeUniqueBuffer(sizex size, ReallocatorType reallocator = ReallocatorType()) {
+  auto data = reallocator.allocate(size);
+  return UniqueBufferType<ReallocatorType>(data, size, std::move(reallocator));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -46,21 +58,27 @@ UniqueBufferType<ReallocatorType> makeUniqueBuffer(sizex size) {
 // if needed.
 //
 // Usage of this object is designed to have the same semantics as unique_ptr.
+// Stateful reallocators (eg. ArenaReallocator) are kept alongside, and move with the buffer.
 //
 template <typename ReallocatorType>
-class UniqueBufferType {
+class UniqueBufferType : private ReallocatorType {
 public:
   UniqueBufferType() noexcept {}
 
+  explicit UniqueBufferType(ReallocatorType reallocator) noexcept : ReallocatorType(std::move(reallocator)) {}
+
   /// The passed buffer must be from the same allocator or it's undefined.
-  UniqueBufferType(byte* buffer, sizex size) noexcept : data_(buffer), size_(size) {}
+  UniqueBufferType(byte* buffer, sizex size, ReallocatorType reallocator = ReallocatorType()) noexcept :
+      ReallocatorType(std::move(reallocator)), data_(buffer), size_(size) {}
 
   UniqueBufferType(UniqueBufferType& that) = delete;
   UniqueBufferType& operator=(UniqueBufferType& that) = delete;
 
   /// Proper noexcept move
   UniqueBufferType(UniqueBufferType&& that) noexcept :
-      data_(std::exchange(that.data_, nullptr)), size_(std::exchange(that.size_, 0)) {}
+      ReallocatorType(std::move(that.allocator())),
+      data_(std::exchange(that.data_, nullptr)),
+      size_(std::exchange(that.size_, 0)) {}
 
   /// Proper Noexcept move assign
   UniqueBufferType& operator=(UniqueBufferType&& that) noexcept {
@@ -69,6 +87,7 @@ public:
         allocator().deallocate(data_, size_);
       }
 
+      allocator() = std::move(that.allocator());
       data_ = std::exchange(that.data_, nullptr);
       size_ = std::exchange(that.size_, 0);
     }
@@ -107,7 +126,10 @@ public:
     }
   }
 
+  const ReallocatorType& reallocator() const noexcept { return *this; }
+
   void swap(UniqueBufferType& that) noexcept {
+    std::swap(allocator(), that.allocator());
     std::swap(data_, that.data_);
     std::swap(size_, that.size_);
   }
@@ -122,9 +144,7 @@ public:
 
 private:
   ////////////////////////////////////////////////////////////////////////////////
-  /// For now until we have an allocator member (via compressed pair)... this can
-  /// then change to return a reallocator&
-  ReallocatorType allocator() { return ReallocatorType(); }
+  ReallocatorType& allocator() noexcept { return *this; }
 
   byte* data_ = nullptr;
   sizex size_ = 0u;
@@ -227,7 +247,9 @@ public:
 
   ////////////////////////////////////////////////////////////////////////////////
   /// Creates a buffer-view of the given unique buffer
-  explicit ConstBufferView(const UniqueBuffer& ub) noexcept : ConstBufferView(ub.data(), ub.size()) {}
+  template <typename ReallocatorType = MallocReallocator<byte>>
+  explicit ConstBufferView(const UniqueBufferType<ReallocatorType>& ub) noexcept :
+      ConstBufferView(ub.data(), ub.size()) {}
 
   /// A valid buffer must be non-null and have >0 size
   bool isValid() const noexcept { return data_ != nullptr && size_ > 0; }
@@ -279,4 +301,105 @@ private:
   sizex size_ = 0_z;
 };
 
+#if SW_POSIX
+////////////////////////////////////////////////////////////////////////////////
+/// A UniqueBuffer over mmap'd memory, which unmaps on destruction. See `mapFile()`.
+using MappedBuffer = UniqueBufferType<MmapReallocator<byte>>;
+
+////////////////////////////////////////////////////////////////////////////////
+enum class FileMapMode : u8 {
+  ReadOnly,     ///< Writing to the buffer is a segfault, so stick to ConstBufferViews
+  CopyOnWrite,  ///< Writable, but changes stay private to the buffer
+  ReadWrite,    ///< Changes go back to the file
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// madvise hints for mapped buffers. They're only hints: any the system doesn't support
+/// are ignored.
+enum class FileMapAdvice : u8 {
+  None = 0,
+  Sequential = 1u << 0,  ///< Read ahead aggressively, and drop pages once read
+  Random = 1u << 1,      ///< Don't bother reading ahead
+  WillNeed = 1u << 2,    ///< Start reading everything in now
+  HugePages = 1u << 3,   ///< Back with transparent huge pages where possible (Linux)
+};
+SW_DEFINE_ENUM_BITFIELD_OPERATORS(FileMapAdvice);
+
+////////////////////////////////////////////////////////////////////////////////
+/// Give madvise hints for a range of mapped memory. `data` must be page aligned, as the
+/// start of a mapping is.
+inline void adviseMapping(const byte* data, sizex size, FileMapAdvice advice) noexcept {
+  if (data == nullptr || size == 0) {
+    return;
+  }
+
+  auto addr = const_cast<byte*>(data);
+  auto has = [advice](FileMapAdvice flag) { return (advice & flag) != FileMapAdvice::None; };
+  if (has(FileMapAdvice::Sequential)) {
+    ::madvise(addr, size, MADV_SEQUENTIAL);
+  }
+  if (has(FileMapAdvice::Random)) {
+    ::madvise(addr, size, MADV_RANDOM);
+  }
+  if (has(FileMapAdvice::WillNeed)) {
+    ::madvise(addr, size, MADV_WILLNEED);
+  }
+#  if defined(MADV_HUGEPAGE)
+  if (has(FileMapAdvice::HugePages)) {
+    ::madvise(addr, size, MADV_HUGEPAGE);
+  }
+#  endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Map a whole file into memory instead of reading and copying it, so loading costs no
+/// more than the pages actually touched, and those come from the page cache. An empty
+/// file gives an empty buffer. Throws std::system_error if the file can't be opened or
+/// mapped.
+inline MappedBuffer mapFile(const char* path, FileMapMode mode = FileMapMode::ReadOnly,
+                            FileMapAdvice advice = FileMapAdvice::None) {
+  auto fail = [path](const char* what) {
+    throw std::system_error(errno, std::generic_category(), std::string(what) + " " + path);
+  };
+
+  const auto fd = ::open(path, (mode == FileMapMode::ReadWrite ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+  if (fd < 0) {
+    fail("open");
+  }
+
+  struct stat info;
+  if (::fstat(fd, &info) != 0) {
+    const auto error = errno;
+    ::close(fd);
+    errno = error;
+    fail("fstat");
+  }
+
+  const auto size = static_cast<sizex>(info.st_size);
+  if (size == 0) {
+    ::close(fd);
+    return MappedBuffer();
+  }
+
+  const auto protection = mode == FileMapMode::ReadOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+  const auto flags = mode == FileMapMode::ReadWrite ? MAP_SHARED : MAP_PRIVATE;
+  const auto addr = ::mmap(nullptr, size, protection, flags, fd, 0);
+  const auto error = errno;
+  ::close(fd);  // The mapping keeps its own reference to the file
+  if (addr == MAP_FAILED) {
+    errno = error;
+    fail("mmap");
+  }
+
+  adviseMapping(static_cast<byte*>(addr), size, advice);
+  return MappedBuffer(static_cast<byte*>(addr), size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline MappedBuffer mapFile(const std::string& path, FileMapMode mode = FileMapMode::ReadOnly,
+                            FileMapAdvice advice = FileMapAdvice::None) {
+  return mapFile(path.c_str(), mode, advice);
+}
+#endif
+
 SW_NAMESPACE_END
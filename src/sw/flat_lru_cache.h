@@ -0,0 +1,805 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <sw/assert.h>
+#include <sw/fixed_width_int_literals.h>
+#include <sw/types.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+SW_NAMESPACE_BEGIN
+
+using namespace sw::intliterals;
+
+namespace lru_detail {
+
+template <typename Cache, bool kIsConst>
+class FlatLruIterator;
+
+/// void_t, done as a struct so that unused parameters still SFINAE on older compilers
+template <typename...>
+struct MakeVoid {
+  using type = void;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Does the given hash or equality functor have an `is_transparent` member type?
+template <typename Func, typename = void>
+struct IsTransparent : std::false_type {};
+
+template <typename Func>
+struct IsTransparent<Func, typename MakeVoid<typename Func::is_transparent>::type> : std::true_type {};
+
+}  // namespace lru_detail
+
+////////////////////////////////////////////////////////////////////////////////
+/// # Overview
+/// An LRU-cache with the same interface as `LruCache`, but with node-free storage.
+///
+/// Entries live in a contiguous slab of slots. The LRU ordering is a doubly-linked list
+/// threaded through the slots using 32-bit slot numbers, and lookup is an open-addressing
+/// (linear probing) index of slot numbers. So there are no per-entry allocations and the key
+/// is only stored once. Erased or purged slots go onto a free list and get reused, they
+/// aren't handed back to the allocator. The slab and index only grow, and only by doubling.
+///
+/// Differences from `LruCache`
+/// * There is only one iterator flavor, and it's ordered (most recent first). The
+///   `*Ordered()` functions are kept for compatibility.
+/// * Growing the slab move-constructs the live entries, so references and iterators are
+///   invalidated by any insert, not just by erasing the item.
+/// * When full and auto-purging, the oldest item is evicted *before* inserting the new one
+///   so the slab stays at `maxSize()` entries.
+/// * At most 2^32 - 2 entries.
+///
+/// When both `Hash` and `KeyEqual` are transparent (they have an `is_transparent` member
+/// type, eg. `TransparentStringHash`), the lookup functions also accept any key type they
+/// can take. So a cache keyed by `std::string` can be searched with a `StringView`.
+///
+/// @tparam kAutoPurge Same as for `LruCache`
+/// @tparam Hash Hash for keys
+/// @tparam KeyEqual Equality for keys
+////////////////////////////////////////////////////////////////////////////////
+template <typename Key, typename T, bool kAutoPurge = true, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class FlatLruCache {
+  using ThisType = FlatLruCache<Key, T, kAutoPurge, Hash, KeyEqual>;
+  using KeyValuePair = std::pair<Key, T>;
+
+  /// Marks the end of a slot list and empty index buckets
+  static constexpr u32 kNil = ~0_u32;
+
+  /// A slab cell. The entry is only constructed while the slot is on the LRU list.
+  struct Slot {
+    u32 prev;
+    u32 next;  // Also the free list link
+    u32 hash;
+    typename std::aligned_storage<sizeof(KeyValuePair), alignof(KeyValuePair)>::type storage;
+  };
+
+  /// An index cell. The hash is kept to skip key compares and to avoid rehashing on growth
+  struct Bucket {
+    u32 slot;
+    u32 hash;
+  };
+
+public:
+  using Iterator = lru_detail::FlatLruIterator<ThisType, false>;
+  using ConstIterator = lru_detail::FlatLruIterator<ThisType, true>;
+  using OrderedIterator = Iterator;
+  using ConstOrderedIterator = ConstIterator;
+
+  using KeyType = Key;
+  using ValueType = T;
+  using HasherType = Hash;
+  using KeyEqualType = KeyEqual;
+
+  /// True if lookups accept other key types. See the overview.
+  static constexpr bool kTransparentLookup =
+      lru_detail::IsTransparent<Hash>::value && lru_detail::IsTransparent<KeyEqual>::value;
+
+private:
+  /// Enables the heterogeneous lookups. KeyType itself always uses the plain versions
+  template <typename K>
+  using TransparentKey = typename std::enable_if<kTransparentLookup && !std::is_same<K, Key>::value>::type;
+
+public:
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Creates the cache and sets the maximum size before items get purged. No memory is
+  /// allocated until the first insert. Use `reserve()` to allocate up front.
+  explicit FlatLruCache(sizex maxSizeValue = 10) : maxSize_(std::max(maxSizeValue, 1_z)) {
+    SW_ASSERT(maxSize_ < kNil);
+  }
+
+  // Cached values will be destructed normally
+  ~FlatLruCache() { destroyEntries(); }
+
+  // Create a copy of the given cache
+  FlatLruCache(const FlatLruCache& that) :
+      maxSize_(that.maxSize_), hasher_(that.hasher_), keyEqual_(that.keyEqual_) {
+    doEmptyCopyFrom(that);
+  }
+
+  // Copies the given cache to this cache. All prior entires in this cache are discarded
+  FlatLruCache& operator=(const FlatLruCache& that) {
+    if (this != &that) {
+      clear();
+      maxSize_ = that.maxSize_;
+      doEmptyCopyFrom(that);
+    }
+    return *this;
+  }
+
+  // Moves the given cache to this. The given cache is left empty
+  FlatLruCache(FlatLruCache&& that) noexcept :
+      slots_(std::move(that.slots_)),
+      index_(std::move(that.index_)),
+      slotCapacity_(std::exchange(that.slotCapacity_, 0)),
+      slotsUsed_(std::exchange(that.slotsUsed_, 0)),
+      indexMask_(std::exchange(that.indexMask_, 0)),
+      size_(std::exchange(that.size_, 0)),
+      head_(std::exchange(that.head_, kNil)),
+      tail_(std::exchange(that.tail_, kNil)),
+      freeHead_(std::exchange(that.freeHead_, kNil)),
+      maxSize_(that.maxSize_),
+      hasher_(std::move(that.hasher_)),
+      keyEqual_(std::move(that.keyEqual_)) {}
+
+  // Moves the given cache to this. The given cache is left empty
+  FlatLruCache& operator=(FlatLruCache&& that) noexcept {
+    if (this != &that) {
+      destroyEntries();
+      slots_ = std::move(that.slots_);
+      index_ = std::move(that.index_);
+      slotCapacity_ = std::exchange(that.slotCapacity_, 0);
+      slotsUsed_ = std::exchange(that.slotsUsed_, 0);
+      indexMask_ = std::exchange(that.indexMask_, 0);
+      size_ = std::exchange(that.size_, 0);
+      head_ = std::exchange(that.head_, kNil);
+      tail_ = std::exchange(that.tail_, kNil);
+      freeHead_ = std::exchange(that.freeHead_, kNil);
+      maxSize_ = that.maxSize_;
+      hasher_ = std::move(that.hasher_);
+      keyEqual_ = std::move(that.keyEqual_);
+    }
+    return *this;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the number of items in the cache
+  sizex size() const noexcept { return size_; }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the number maximum number of items allowed in the cache. Soft-limit when
+  /// kAutoPurge is `false`, same as `LruCache`.
+  sizex maxSize() const noexcept { return maxSize_; }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Sets the maximum size of the cache. Will purge items when `kAutoPurge` is
+  /// true and the maximum size is reduced. Already allocated slots are kept.
+  void setMaxSize(sizex maxSizeValue) {
+    auto newMaxSize = std::max(maxSizeValue, 1_z);
+    SW_ASSERT(newMaxSize < kNil);
+    bool isSmaller = newMaxSize < maxSize_;
+    maxSize_ = newMaxSize;
+    if (isSmaller)
+      doAutoPurge();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Is the cache empty?
+  bool empty() const noexcept { return size_ == 0; }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Number of slots allocated in the slab
+  sizex capacity() const noexcept { return slotCapacity_; }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Allocate slots and index space for at least the given number of entries
+  void reserve(sizex count) {
+    SW_ASSERT(count < kNil);
+    if (count > slotCapacity_)
+      growSlots(count);
+    if (count > indexLimit())
+      growIndex(count);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Check if the given key is mapped to a value in the cache. Does *not* change
+  /// cache ordering. Use `refresh()` for that case.
+  bool contains(const KeyType& key) const { return findSlot(key, hashOf(key)) != kNil; }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Refreshes a cache item if it exists, causing it to move to the front
+  void refresh(const KeyType& key) {
+    const auto slot = findSlot(key, hashOf(key));
+    if (slot != kNil) {
+      onValueUsed(slot);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Refreshes the cache item at the given iterator, causing it to move to the front
+  void refresh(const ConstIterator& iter) {
+    if (iter != cend()) {
+      onValueUsed(iter.slot_);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Purge any entries such that the cache will be within it's max-size. Not necessary
+  /// when auto-purge is enabled
+  void purge() { doPurge(maxSize_); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Clear the cache completely. The slab and index memory is kept for reuse.
+  void clear() {
+    while (tail_ != kNil) {
+      eraseSlot(tail_);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Remove a cached value
+  sizex erase(const KeyType& key) {
+    const auto slot = findSlot(key, hashOf(key));
+    if (slot == kNil) {
+      return 0;
+    }
+
+    eraseSlot(slot);
+    return 1;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Remove a cached value using an iterator
+  /// @return Iterator to the next (older) item
+  Iterator erase(const ConstIterator& iter) {
+    if (iter == cend())
+      return end();
+
+    const auto next = slots_[iter.slot_].next;
+    eraseSlot(iter.slot_);
+    return Iterator(this, next);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Extract the cached value for the given key. If the value isn't in the cache, a
+  /// default constructed value will be created, placed in the cache, and returned.
+  T& operator[](const KeyType& key) {
+    const auto hash = hashOf(key);
+    auto slot = findSlot(key, hash);
+    if (slot == kNil) {
+      slot = insertSlot(hash, key, T{});
+    } else {
+      onValueUsed(slot);
+    }
+    return entryAt(slot).second;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Inserts or updates mapped value associated with the given key
+  void put(const KeyType& key, const T& value) {
+    const auto hash = hashOf(key);
+    const auto slot = findSlot(key, hash);
+    if (slot == kNil) {
+      insertSlot(hash, key, value);
+    } else {
+      entryAt(slot).second = value;
+      onValueUsed(slot);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Inserts or updates mapped value associated with the given key
+  void put(const KeyType& key, T&& value) {
+    const auto hash = hashOf(key);
+    const auto slot = findSlot(key, hash);
+    if (slot == kNil) {
+      insertSlot(hash, key, std::move(value));
+    } else {
+      entryAt(slot).second = std::move(value);
+      onValueUsed(slot);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// @value Will be a copy of the value if it exists, otherwise it is unchanged
+  /// @return true if the value was found
+  bool get(const KeyType& key, T& value) {
+    const auto slot = findSlot(key, hashOf(key));
+    if (slot == kNil) {
+      return false;
+    }
+
+    onValueUsed(slot);
+    value = entryAt(slot).second;
+    return true;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Find the cache element with the specified key. If it doesn't exist, end() is
+  /// returned. If it does exist, it will be refreshed to the front of the cache.
+  Iterator find(const KeyType& key) {
+    const auto slot = findSlot(key, hashOf(key));
+    if (slot != kNil) {
+      onValueUsed(slot);
+    }
+    return Iterator(this, slot);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Same as `find()` but returns a ConstIterator
+  ConstIterator cfind(const KeyType& key) { return find(key); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Find the cache element with the specified key *without* refreshing it.
+  ConstIterator peek(const KeyType& key) const { return ConstIterator(this, findSlot(key, hashOf(key))); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Iteration is always most-recent first
+  Iterator begin() noexcept { return Iterator(this, head_); }
+  Iterator end() noexcept { return Iterator(this, kNil); }
+  ConstIterator begin() const noexcept { return ConstIterator(this, head_); }
+  ConstIterator end() const noexcept { return ConstIterator(this, kNil); }
+  ConstIterator cbegin() const noexcept { return ConstIterator(this, head_); }
+  ConstIterator cend() const noexcept { return ConstIterator(this, kNil); }
+
+  OrderedIterator beginOrdered() noexcept { return begin(); }
+  OrderedIterator endOrdered() noexcept { return end(); }
+  ConstOrderedIterator beginOrdered() const noexcept { return cbegin(); }
+  ConstOrderedIterator endOrdered() const noexcept { return cend(); }
+  ConstOrderedIterator cbeginOrdered() const noexcept { return cbegin(); }
+  ConstOrderedIterator cendOrdered() const noexcept { return cend(); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Heterogeneous versions of the lookups. Only when `kTransparentLookup` is true.
+  template <typename K, typename = TransparentKey<K>>
+  bool contains(const K& key) const {
+    return findSlot(key, hashOf(key)) != kNil;
+  }
+
+  template <typename K, typename = TransparentKey<K>>
+  void refresh(const K& key) {
+    const auto slot = findSlot(key, hashOf(key));
+    if (slot != kNil) {
+      onValueUsed(slot);
+    }
+  }
+
+  template <typename K, typename = TransparentKey<K>>
+  sizex erase(const K& key) {
+    const auto slot = findSlot(key, hashOf(key));
+    if (slot == kNil) {
+      return 0;
+    }
+
+    eraseSlot(slot);
+    return 1;
+  }
+
+  template <typename K, typename = TransparentKey<K>>
+  bool get(const K& key, T& value) {
+    const auto slot = findSlot(key, hashOf(key));
+    if (slot == kNil) {
+      return false;
+    }
+
+    onValueUsed(slot);
+    value = entryAt(slot).second;
+    return true;
+  }
+
+  template <typename K, typename = TransparentKey<K>>
+  Iterator find(const K& key) {
+    const auto slot = findSlot(key, hashOf(key));
+    if (slot != kNil) {
+      onValueUsed(slot);
+    }
+    return Iterator(this, slot);
+  }
+
+  template <typename K, typename = TransparentKey<K>>
+  ConstIterator cfind(const K& key) {
+    return find(key);
+  }
+
+  template <typename K, typename = TransparentKey<K>>
+  ConstIterator peek(const K& key) const {
+    return ConstIterator(this, findSlot(key, hashOf(key)));
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Hint that the given key is about to be looked up, by prefetching its index bucket.
+  /// That lets a batch of lookups overlap their cache misses.
+  template <typename K>
+  void prefetch(const K& key) const noexcept {
+#if SW_GCC_CXX || SW_CLANG_CXX
+    if (index_) {
+      __builtin_prefetch(&index_[hashOf(key) & indexMask_]);
+    }
+#endif
+  }
+
+private:
+  KeyValuePair& entryAt(u32 slot) noexcept {
+    return *reinterpret_cast<KeyValuePair*>(&slots_[slot].storage);
+  }
+  const KeyValuePair& entryAt(u32 slot) const noexcept {
+    return *reinterpret_cast<const KeyValuePair*>(&slots_[slot].storage);
+  }
+
+  /// Fold the hash to 32-bits. The multiply spreads poor hashes (eg. identity for ints)
+  /// so that linear probing doesn't cluster.
+  template <typename K>
+  u32 hashOf(const K& key) const {
+    return static_cast<u32>((static_cast<u64>(hasher_(key)) * 0x9E3779B97F4A7C15_u64) >> 32);
+  }
+
+  /// Maximum entries before the index has to grow. Keeps the load factor at or under 3/4
+  sizex indexLimit() const noexcept { return index_ ? (sizex(indexMask_) + 1) / 4 * 3 : 0; }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// @return the slot for the given key, or kNil
+  template <typename K>
+  u32 findSlot(const K& key, u32 hash) const {
+    const auto bucket = findBucket(key, hash);
+    return bucket == kNil ? kNil : index_[bucket].slot;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// @return the index bucket for the given key, or kNil
+  template <typename K>
+  u32 findBucket(const K& key, u32 hash) const {
+    if (!index_)
+      return kNil;
+
+    for (auto bucket = hash & indexMask_;; bucket = (bucket + 1) & indexMask_) {
+      const auto& cell = index_[bucket];
+      if (cell.slot == kNil)
+        return kNil;
+      if (cell.hash == hash && keyEqual_(entryAt(cell.slot).first, key))
+        return bucket;
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Add a slot to the index. The key must not already be indexed, and there must be room
+  void indexSlot(u32 slot, u32 hash) noexcept {
+    auto bucket = hash & indexMask_;
+    while (index_[bucket].slot != kNil) {
+      bucket = (bucket + 1) & indexMask_;
+    }
+    index_[bucket] = Bucket{slot, hash};
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Remove the given bucket from the index. Uses backward-shift deletion, so there are
+  /// no tombstones and probe sequences never degrade.
+  void unindexBucket(u32 bucket) noexcept {
+    auto hole = bucket;
+    for (auto next = (bucket + 1) & indexMask_; index_[next].slot != kNil; next = (next + 1) & indexMask_) {
+      // The entry can move back to the hole if the hole is within [home, next)
+      const auto home = index_[next].hash & indexMask_;
+      if (((next - home) & indexMask_) >= ((next - hole) & indexMask_)) {
+        index_[hole] = index_[next];
+        hole = next;
+      }
+    }
+    index_[hole].slot = kNil;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Unlink a slot from the LRU list
+  void unlinkSlot(u32 slot) noexcept {
+    auto& cell = slots_[slot];
+    if (cell.prev != kNil)
+      slots_[cell.prev].next = cell.next;
+    else
+      head_ = cell.next;
+    if (cell.next != kNil)
+      slots_[cell.next].prev = cell.prev;
+    else
+      tail_ = cell.prev;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Link a slot to the front of the LRU list
+  void linkFront(u32 slot) noexcept {
+    auto& cell = slots_[slot];
+    cell.prev = kNil;
+    cell.next = head_;
+    if (head_ != kNil)
+      slots_[head_].prev = slot;
+    else
+      tail_ = slot;
+    head_ = slot;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Call this when a cached value is used, thus pushing it to the front of the list.
+  void onValueUsed(u32 slot) noexcept {
+    if (slot != head_) {
+      unlinkSlot(slot);
+      linkFront(slot);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Insert a new entry at the front. The key must not be in the cache.
+  /// @return the slot of the new entry
+  template <typename Value>
+  u32 insertSlot(u32 hash, const KeyType& key, Value&& value) {
+    // Make room first so a full cache recycles the oldest slot rather than growing
+    if (kAutoPurge && size_ >= maxSize_) {
+      doPurge(maxSize_ - 1);
+    }
+    if (size_ + 1 > indexLimit()) {
+      growIndex(size_ + 1);
+    }
+
+    const auto slot = allocateSlot();
+    try {
+      new (&slots_[slot].storage) KeyValuePair(key, std::forward<Value>(value));
+    } catch (...) {
+      freeSlot(slot);
+      throw;
+    }
+
+    slots_[slot].hash = hash;
+    linkFront(slot);
+    indexSlot(slot, hash);
+    ++size_;
+    return slot;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Remove a live entry completely. The slot goes to the free list
+  void eraseSlot(u32 slot) noexcept {
+    const auto bucket = findBucket(entryAt(slot).first, slots_[slot].hash);
+    SW_ASSERT(bucket != kNil);
+    unindexBucket(bucket);
+    unlinkSlot(slot);
+    entryAt(slot).~KeyValuePair();
+    freeSlot(slot);
+    --size_;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Take a slot from the free list, or from the unused end of the slab
+  u32 allocateSlot() {
+    if (freeHead_ != kNil) {
+      const auto slot = freeHead_;
+      freeHead_ = slots_[slot].next;
+      return slot;
+    }
+
+    if (slotsUsed_ == slotCapacity_) {
+      growSlots(std::max(sizex(slotCapacity_) * 2, 8_z));
+    }
+    return slotsUsed_++;
+  }
+
+  void freeSlot(u32 slot) noexcept {
+    slots_[slot].next = freeHead_;
+    freeHead_ = slot;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Move the slab to a larger one. Live entries keep their slot numbers, so the links
+  /// and index stay valid. The free list is carried over as is.
+  void growSlots(sizex minCapacity) {
+    const auto newCapacity = static_cast<u32>(std::min(minCapacity, sizex(kNil - 1)));
+    SW_ASSERT(newCapacity > slotCapacity_);
+    std::unique_ptr<Slot[]> newSlots(new Slot[newCapacity]);
+    for (u32 slot = 0; slot < slotsUsed_; ++slot) {
+      newSlots[slot].prev = slots_[slot].prev;
+      newSlots[slot].next = slots_[slot].next;
+      newSlots[slot].hash = slots_[slot].hash;
+    }
+
+    // The move is a construct and destroy, walking only the live entries
+    for (auto slot = head_; slot != kNil; slot = slots_[slot].next) {
+      auto& entry = entryAt(slot);
+      new (&newSlots[slot].storage) KeyValuePair(std::move_if_noexcept(entry));
+      entry.~KeyValuePair();
+    }
+
+    slots_ = std::move(newSlots);
+    slotCapacity_ = newCapacity;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Rebuild the index so it can hold at least the given number of entries
+  void growIndex(sizex minEntries) {
+    sizex buckets = 16;
+    while (buckets / 4 * 3 < minEntries) {
+      buckets *= 2;
+    }
+    SW_ASSERT(buckets <= (sizex(1) << 32));
+
+    index_.reset(new Bucket[buckets]);
+    indexMask_ = static_cast<u32>(buckets - 1);
+    for (sizex i = 0; i < buckets; ++i) {
+      index_[i].slot = kNil;
+    }
+    for (auto slot = head_; slot != kNil; slot = slots_[slot].next) {
+      indexSlot(slot, slots_[slot].hash);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Delete the last (aka oldest) items till the size is no more than the given amount
+  void doPurge(sizex targetSize) {
+    while (size_ > targetSize) {
+      eraseSlot(tail_);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Will auto purge the cache if configured. Should optimize to a NOP when auto
+  /// purge is disabled
+  void doAutoPurge() {
+    if (kAutoPurge) {
+      doPurge(maxSize_);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Run the destructors for all live entries.
+  void destroyEntries() noexcept {
+    for (auto slot = head_; slot != kNil; slot = slots_[slot].next) {
+      entryAt(slot).~KeyValuePair();
+    }
+    head_ = tail_ = kNil;
+    size_ = 0;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Copies the contents of the given cache into this cache, assumes this cache is empty
+  void doEmptyCopyFrom(const FlatLruCache& cache) {
+    SW_ASSERT(empty());
+    reserve(cache.size());
+    for (auto slot = cache.tail_; slot != kNil; slot = cache.slots_[slot].prev) {
+      const auto& entry = cache.entryAt(slot);
+      insertSlot(cache.slots_[slot].hash, entry.first, entry.second);
+    }
+  }
+
+private:
+  std::unique_ptr<Slot[]> slots_;
+  std::unique_ptr<Bucket[]> index_;
+
+  u32 slotCapacity_ = 0;
+  u32 slotsUsed_ = 0;  // Slots past here have never been used
+  u32 indexMask_ = 0;
+  u32 size_ = 0;
+  u32 head_ = kNil;  // Most recent
+  u32 tail_ = kNil;  // Oldest
+  u32 freeHead_ = kNil;
+
+  /// Maximum size for the cache (aka max num entries)
+  sizex maxSize_ = 10;
+
+  Hash hasher_;
+  KeyEqual keyEqual_;
+
+  // We let the cache and iterators access each other's privates
+  friend Iterator;
+  friend ConstIterator;
+};
+
+template <typename Key, typename T, bool kAutoPurge, typename Hash, typename KeyEqual>
+constexpr u32 FlatLruCache<Key, T, kAutoPurge, Hash, KeyEqual>::kNil;
+
+template <typename Key, typename T, bool kAutoPurge, typename Hash, typename KeyEqual>
+constexpr bool FlatLruCache<Key, T, kAutoPurge, Hash, KeyEqual>::kTransparentLookup;
+
+namespace lru_detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// Iterator for the FlatLruCache. Just the cache and a slot number.
+template <typename Cache, bool kIsConst>
+class FlatLruIterator {
+  using IterType = FlatLruIterator;
+  using CachePtr = typename std::conditional<kIsConst, const Cache*, Cache*>::type;
+
+public:
+  using Key = typename Cache::KeyType;
+  using Value = typename Cache::ValueType;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Default constructed iterators are singular, only good for assigning over
+  FlatLruIterator() noexcept = default;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Allow direct conversion from non-const to const iterator
+  template <bool kThatIsConst, typename = typename std::enable_if<kIsConst && !kThatIsConst>::type>
+  FlatLruIterator(const FlatLruIterator<Cache, kThatIsConst>& iter) noexcept :
+      cache_(iter.cache_), slot_(iter.slot_) {}
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Moves to the next older item
+  IterType& operator++() {
+    slot_ = cache_->slots_[slot_].next;
+    return *this;
+  }
+
+  IterType operator++(int) & {  // NOLINT const return
+    IterType tmp = *this;
+    operator++();
+    return tmp;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Moves to the next newer item. Decrementing end() gives the oldest item.
+  IterType& operator--() {
+    slot_ = slot_ == Cache::kNil ? cache_->tail_ : cache_->slots_[slot_].prev;
+    return *this;
+  }
+
+  IterType operator--(int) & {  // NOLINT const return
+    IterType tmp = *this;
+    operator--();
+    return tmp;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// All iterators can support const access to key/values
+  const Key& key() const { return cache_->entryAt(slot_).first; }
+  const Value& value() const { return cache_->entryAt(slot_).second; }
+  const Value& operator*() const { return cache_->entryAt(slot_).second; }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Allow value setting from non-const iterators only
+  template <bool kThisIsConst = kIsConst>
+  typename std::enable_if<!kThisIsConst, Value>::type& value() {
+    return cache_->entryAt(slot_).second;
+  }
+
+  template <bool kThisIsConst = kIsConst>
+  typename std::enable_if<!kThisIsConst, Value>::type& operator*() const {
+    return cache_->entryAt(slot_).second;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Allow iterator equality comparisons
+  friend bool operator==(const IterType& i1, const IterType& i2) { return i1.slot_ == i2.slot_; }
+  friend bool operator!=(const IterType& i1, const IterType& i2) { return i1.slot_ != i2.slot_; }
+
+private:
+  /// No public construction
+  FlatLruIterator(CachePtr cache, u32 slot) noexcept : cache_(cache), slot_(slot) {}
+
+  CachePtr cache_ = nullptr;
+  u32 slot_ = Cache::kNil;
+
+  // We let the cache and iterators access each other's privates
+  friend Cache;
+  friend class FlatLruIterator<Cache, !kIsConst>;
+};
+
+}  // namespace lru_detail
+
+SW_NAMESPACE_END
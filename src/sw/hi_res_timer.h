@@ -18,12 +18,175 @@
 ////////////////////////////////////////////////////////////////////////////////
 #pragma once
 
-#include "defines.h"
+#include "assert.h"
+#include "types.h"
 
 #include <chrono>
 
+// CPU tick counter backends for TscClock. Either can be forced off by defining it to 0, which
+// leaves TscClock on steady_clock.
+#if !defined(SW_HI_RES_TSC_X86)
+#  if (SW_GCC_CXX || SW_CLANG_CXX) && defined(__x86_64__)
+#    define SW_HI_RES_TSC_X86 1
+#  else
+#    define SW_HI_RES_TSC_X86 0
+#  endif
+#endif
+
+#if !defined(SW_HI_RES_TSC_ARM)
+#  if (SW_GCC_CXX || SW_CLANG_CXX) && defined(__aarch64__)
+#    define SW_HI_RES_TSC_ARM 1
+#  else
+#    define SW_HI_RES_TSC_ARM 0
+#  endif
+#endif
+
+#if SW_HI_RES_TSC_X86
+#  include <cpuid.h>
+#  include <x86intrin.h>
+#endif
+
 SW_NAMESPACE_BEGIN
 
+namespace hi_res_detail {
+
+/// How long to time the TSC against steady_clock when calibrating
+constexpr std::chrono::milliseconds kTickCalibrationTime{5};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Read the CPU tick counter. rdtscp waits for earlier instructions to finish, so the work
+/// being timed can't drift past the read.
+inline u64 readTicks() noexcept {
+#if SW_HI_RES_TSC_X86
+  unsigned aux;
+  return __rdtscp(&aux);
+#elif SW_HI_RES_TSC_ARM
+  u64 ticks;
+  asm volatile("isb; mrs %0, cntvct_el0" : "=r"(ticks) : : "memory");
+  return ticks;
+#else
+  return 0;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Whether the tick counter runs at a constant rate across cores and power states. On x86 that
+/// is the invariant TSC bit, and rdtscp is needed too. The ARM generic timer always is.
+inline bool invariantTicks() noexcept {
+#if SW_HI_RES_TSC_X86
+  unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) {
+    return false;
+  }
+  __get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx);
+  if ((edx & (1u << 27u)) == 0) {
+    return false;
+  }
+  __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+  return (edx & (1u << 8u)) != 0;
+#elif SW_HI_RES_TSC_ARM
+  return true;
+#else
+  return false;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Tick to nanosecond conversion, measured once
+struct TickCalibration {
+  bool useTicks = false;
+  u64 baseTicks = 0;
+  /// Nanoseconds per tick, as 32.32 fixed point
+  u64 nsPerTick = 0;
+};
+
+inline TickCalibration calibrateTicks() noexcept {
+  TickCalibration result;
+  if (!invariantTicks()) {
+    return result;
+  }
+
+#if SW_HI_RES_TSC_ARM
+  u64 frequency;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+  if (frequency == 0) {
+    return result;
+  }
+  result.nsPerTick = (u64(1000000000) << 32u) / frequency;
+#else
+  using Steady = std::chrono::steady_clock;
+  const auto startTime = Steady::now();
+  const u64 startTicks = readTicks();
+  auto endTime = startTime;
+  u64 endTicks = startTicks;
+  do {
+    endTime = Steady::now();
+    endTicks = readTicks();
+  } while (endTime - startTime < kTickCalibrationTime);
+
+  const u64 ticks = endTicks - startTicks;
+  if (ticks == 0) {
+    return result;
+  }
+  const double ns = std::chrono::duration<double, std::nano>(endTime - startTime).count();
+  result.nsPerTick = u64(ns / double(ticks) * 4294967296.0);
+#endif
+
+  result.baseTicks = readTicks();
+  result.useTicks = true;
+  return result;
+}
+
+inline const TickCalibration& tickCalibration() noexcept {
+  static const TickCalibration kCalibration = calibrateTicks();
+  return kCalibration;
+}
+
+inline u64 ticksToNs(u64 ticks, u64 nsPerTick) noexcept {
+#if SW_HI_RES_TSC_X86 || SW_HI_RES_TSC_ARM
+  __extension__ typedef unsigned __int128 u128;
+  return u64((u128(ticks) * nsPerTick) >> 32u);
+#else
+  return u64((double(ticks) * double(nsPerTick)) / 4294967296.0);
+#endif
+}
+
+}  // namespace hi_res_detail
+
+////////////////////////////////////////////////////////////////////////////////
+/// A steady chrono clock that reads the CPU tick counter (rdtscp on x86, cntvct on aarch64)
+/// instead of making a clock call, so `now()` is a few ns rather than tens. Ticks are
+/// calibrated to ns once, on first use or an explicit `calibrate()`, which spins for a few ms
+/// on x86.
+///
+/// When there's no invariant tick counter (some VMs hide it), `now()` falls back to
+/// steady_clock. Time points are ns since calibration, and only compare within a process.
+class TscClock {
+public:
+  using rep = i64;
+  using period = std::nano;
+  using duration = std::chrono::nanoseconds;
+  using time_point = std::chrono::time_point<TscClock>;
+  static constexpr bool is_steady = true;
+
+  static time_point now() noexcept {
+    const auto& calibration = hi_res_detail::tickCalibration();
+    if (calibration.useTicks) {
+      const u64 ticks = hi_res_detail::readTicks() - calibration.baseTicks;
+      return time_point(duration(rep(hi_res_detail::ticksToNs(ticks, calibration.nsPerTick))));
+    }
+    return time_point(std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch()));
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Calibrate now, eg. at startup, rather than on the first `now()`
+  static void calibrate() noexcept { unused(hi_res_detail::tickCalibration()); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// @return True when `now()` reads the tick counter, false if it fell back to steady_clock
+  static bool usesTicks() noexcept { return hi_res_detail::tickCalibration().useTicks; }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 /// Class for hi-resolution timing.
 ///
@@ -34,15 +197,18 @@ SW_NAMESPACE_BEGIN
 /// auto elapsedTime = hrt.elapsed();
 /// </code>
 ///
-class HiResTimer {
+/// @tparam ClockT The chrono clock to read. `HiResTimer` uses high_resolution_clock, and
+///   `TscTimer` uses TscClock for timing very short sections.
+template <typename ClockT>
+class HiResTimerType {
 public:
-  using Clock = std::chrono::high_resolution_clock;
-  using TimePoint = Clock::time_point;
-  using Duration = Clock::duration;
+  using Clock = ClockT;
+  using TimePoint = typename Clock::time_point;
+  using Duration = typename Clock::duration;
 
   ////////////////////////////////////////////////////////////////////////////////
   /// Creation of the timer starts it
-  HiResTimer() noexcept : start_(Clock::now()) {}
+  HiResTimerType() noexcept : start_(Clock::now()) {}
 
   ////////////////////////////////////////////////////////////////////////////////
   /// @return Returns the duration since the timer was started as a double in ms
@@ -54,6 +220,10 @@ public:
   // @return Returns the duration since the timer was started
   std::chrono::microseconds elapsed() const noexcept { return elapsedDuration<std::chrono::microseconds>(); }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /// @return Returns the duration since the timer was started
+  std::chrono::nanoseconds elapsedNs() const noexcept { return elapsedDuration<std::chrono::nanoseconds>(); }
+
   ////////////////////////////////////////////////////////////////////////////////
   /// @return Returns the duration since the timer was started
   std::chrono::milliseconds elapsedMs() const noexcept {
@@ -109,4 +279,7 @@ private:
   TimePoint start_;
 };
 
+using HiResTimer = HiResTimerType<std::chrono::high_resolution_clock>;
+using TscTimer = HiResTimerType<TscClock>;
+
 SW_NAMESPACE_END
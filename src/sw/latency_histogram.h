@@ -0,0 +1,390 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "fixed_width_int_literals.h"
+#include "hi_res_timer.h"
+#include "threading_utils.h"
+#include "types.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+SW_NAMESPACE_BEGIN
+
+namespace latency_detail {
+
+/// Each power of two range is split into 2^kSubBucketBits linear buckets, so a bucket is at most
+/// 1/32 (about 3%) of its values wide
+constexpr u32 kSubBucketBits = 5;
+constexpr u64 kSubBuckets = 1_u64 << kSubBucketBits;
+
+/// Values at or above 2^kMaxValueBits ns (about 18 minutes) go in the last bucket
+constexpr u32 kMaxValueBits = 40;
+constexpr u64 kMaxValue = (1_u64 << kMaxValueBits) - 1;
+constexpr sizex kBucketCount = sizex(kMaxValueBits - kSubBucketBits + 1) * kSubBuckets;
+
+inline u32 topBit(u64 value) noexcept {
+#if SW_GCC_CXX || SW_CLANG_CXX
+  return 63u - u32(__builtin_clzll(value | 1u));
+#else
+  u32 result = 0;
+  while ((value >>= 1u) != 0) {
+    ++result;
+  }
+  return result;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Values below 2*kSubBuckets get their own bucket. Above that, a value with its top bit at
+/// `m` is shifted down by `m - kSubBucketBits`, keeping its top kSubBucketBits+1 bits.
+inline sizex bucketIndex(u64 value) noexcept {
+  value = value < kMaxValue ? value : kMaxValue;
+  const u32 top = topBit(value);
+  const u32 shift = top > kSubBucketBits ? top - kSubBucketBits : 0;
+  return sizex(shift) * kSubBuckets + sizex(value >> shift);
+}
+
+inline u64 bucketLowest(sizex index) noexcept {
+  if (index < 2 * kSubBuckets) {
+    return u64(index);
+  }
+  const u64 shift = index / kSubBuckets - 1;
+  return u64(index - shift * kSubBuckets) << shift;
+}
+
+inline u64 bucketHighest(sizex index) noexcept {
+  if (index < 2 * kSubBuckets) {
+    return u64(index);
+  }
+  const u64 shift = index / kSubBuckets - 1;
+  return (u64(index - shift * kSubBuckets + 1) << shift) - 1;
+}
+
+inline double toMicros(u64 ns) noexcept {
+  return double(ns) / 1000.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// One thread's counts. Only the owning thread writes, so recording is a relaxed load and
+/// store per counter rather than an atomic add.
+struct Shard {
+  std::array<std::atomic<u64>, kBucketCount> counts = {};
+  std::atomic<u64> count = {0};
+  std::atomic<u64> sum = {0};
+
+  void record(u64 ns) noexcept {
+    bump(counts[bucketIndex(ns)], 1);
+    bump(count, 1);
+    bump(sum, ns);
+  }
+
+  static void bump(std::atomic<u64>& counter, u64 value) noexcept {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+};
+
+}  // namespace latency_detail
+
+////////////////////////////////////////////////////////////////////////////////
+/// The merged counts of a LatencyHistogram at some point, or over some interval. Percentiles
+/// are the highest value in their bucket, so they're within about 3% above the true value.
+struct LatencySnapshot {
+  u64 count = 0;
+  u64 sumNs = 0;
+  std::vector<u64> counts = std::vector<u64>(latency_detail::kBucketCount);
+
+  double meanNs() const noexcept { return count == 0 ? 0.0 : double(sumNs) / double(count); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// @param percent In [0, 100]
+  /// @return The value that `percent` of the recorded values are at or below, or 0 if empty
+  u64 percentileNs(double percent) const noexcept {
+    if (count == 0) {
+      return 0;
+    }
+    const double wanted = percent / 100.0 * double(count);
+    u64 target = wanted <= 1.0 ? 1 : u64(wanted);
+    target += (double(target) < wanted) ? 1 : 0;
+    target = target < count ? target : count;
+
+    u64 seen = 0;
+    for (sizex i = 0; i < counts.size(); ++i) {
+      seen += counts[i];
+      if (seen >= target) {
+        return latency_detail::bucketHighest(i);
+      }
+    }
+    return latency_detail::bucketHighest(counts.size() - 1);
+  }
+
+  u64 minNs() const noexcept {
+    for (sizex i = 0; i < counts.size(); ++i) {
+      if (counts[i] != 0) {
+        return latency_detail::bucketLowest(i);
+      }
+    }
+    return 0;
+  }
+
+  u64 maxNs() const noexcept { return percentileNs(100.0); }
+  u64 p50Ns() const noexcept { return percentileNs(50.0); }
+  u64 p99Ns() const noexcept { return percentileNs(99.0); }
+  u64 p999Ns() const noexcept { return percentileNs(99.9); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// One line summary, in microseconds. eg. "count=1000 mean=1.204us p50=1.087us ..."
+  std::string summary() const {
+    using latency_detail::toMicros;
+    char buffer[256];
+    std::snprintf(buffer, sizeof(buffer),
+                  "count=%llu mean=%.3fus p50=%.3fus p99=%.3fus p999=%.3fus max=%.3fus",
+                  static_cast<unsigned long long>(count), meanNs() / 1000.0, toMicros(p50Ns()),
+                  toMicros(p99Ns()), toMicros(p999Ns()), toMicros(maxNs()));
+    return buffer;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// The counts recorded between `earlier` and this snapshot
+  LatencySnapshot since(const LatencySnapshot& earlier) const {
+    LatencySnapshot result;
+    result.count = count - earlier.count;
+    result.sumNs = sumNs - earlier.sumNs;
+    for (sizex i = 0; i < counts.size(); ++i) {
+      result.counts[i] = counts[i] - earlier.counts[i];
+    }
+    return result;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// A log-linear (HDR style) histogram of latencies in ns, cheap enough to leave on in hot
+/// paths. Each thread records into its own shard, so `record()` is a thread local lookup and
+/// a few relaxed stores, with no atomic read-modify-writes or shared cache lines.
+///
+/// `snapshot()` merges every shard. Counts from threads that have exited are kept, since a
+/// shard is folded into the histogram when its thread exits. Each shard is about 9KB, which
+/// is the price of a thread recording into a histogram.
+///
+/// Thread safe.
+class LatencyHistogram {
+public:
+  LatencyHistogram() : _state(std::make_shared<State>()) {}
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  void record(u64 ns) { threadShard().record(ns); }
+
+  template <typename Rep, typename Period>
+  void record(std::chrono::duration<Rep, Period> elapsed) {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    record(ns > 0 ? u64(ns) : 0);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Everything recorded so far
+  LatencySnapshot snapshot() const {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    return _state->mergeLocked();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// What was recorded since the last call, eg. for periodic reporting
+  LatencySnapshot intervalSnapshot() {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    auto current = _state->mergeLocked();
+    auto result = current.since(_state->lastInterval);
+    _state->lastInterval = std::move(current);
+    return result;
+  }
+
+private:
+  using Shard = latency_detail::Shard;
+
+  struct State {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Shard>> shards;
+    /// Counts from threads that have exited
+    LatencySnapshot retired;
+    LatencySnapshot lastInterval;
+
+    LatencySnapshot mergeLocked() const {
+      LatencySnapshot result = retired;
+      for (const auto& shard : shards) {
+        add(*shard, result);
+      }
+      return result;
+    }
+
+    static void add(const Shard& shard, LatencySnapshot& out) {
+      out.count += shard.count.load(std::memory_order_relaxed);
+      out.sumNs += shard.sum.load(std::memory_order_relaxed);
+      for (sizex i = 0; i < shard.counts.size(); ++i) {
+        out.counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+      }
+    }
+  };
+
+  /// A thread's hold on its shard. Folds the shard into the histogram as the thread exits,
+  /// if the histogram is still around
+  struct Recorder {
+    std::shared_ptr<Shard> shard;
+    std::weak_ptr<State> state;
+
+    ~Recorder() {
+      if (auto owner = state.lock()) {
+        std::lock_guard<std::mutex> lock(owner->mutex);
+        State::add(*shard, owner->retired);
+        owner->shards.erase(std::find(owner->shards.begin(), owner->shards.end(), shard));
+      }
+    }
+  };
+
+  Shard& threadShard() {
+    return *_recorders
+                .get([this]() {
+                  auto recorder = std::make_unique<Recorder>();
+                  recorder->shard = std::make_shared<Shard>();
+                  recorder->state = _state;
+                  std::lock_guard<std::mutex> lock(_state->mutex);
+                  _state->shards.push_back(recorder->shard);
+                  return recorder;
+                })
+                .shard;
+  }
+
+  std::shared_ptr<State> _state;
+  ThreadLocalValue<Recorder> _recorders;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Records the time from construction to destruction into a histogram.
+///
+/// <code>
+/// void lookup() {
+///   ScopedTimer timer(lookupLatency);
+///   ... The timed section ...
+/// }
+/// </code>
+///
+/// @tparam Clock The chrono clock to time with. `ScopedTimer` uses TscClock.
+template <typename Clock>
+class ScopedTimerType {
+public:
+  explicit ScopedTimerType(LatencyHistogram& histogram) noexcept : _histogram(&histogram) {}
+  ScopedTimerType(const ScopedTimerType&) = delete;
+  ScopedTimerType& operator=(const ScopedTimerType&) = delete;
+
+  ~ScopedTimerType() {
+    if (_histogram != nullptr) {
+      _histogram->record(_timer.elapsedNs());
+    }
+  }
+
+  /// Don't record anything, eg. on an error path that shouldn't count
+  void cancel() noexcept { _histogram = nullptr; }
+
+private:
+  LatencyHistogram* _histogram;
+  HiResTimerType<Clock> _timer;
+};
+
+using ScopedTimer = ScopedTimerType<TscClock>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// Named histograms, for one place to report every instrumented section from.
+///
+/// Looking up a name takes a lock, so look it up once and keep the reference, which stays
+/// valid for the registry's lifetime. `SW_SCOPED_LATENCY` does that for you.
+class LatencyRegistry {
+public:
+  ////////////////////////////////////////////////////////////////////////////////
+  /// The histogram with this name, created on first use
+  LatencyHistogram& histogram(const std::string& name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto& histogram = _histograms[name];
+    if (!histogram) {
+      histogram = std::make_unique<LatencyHistogram>();
+    }
+    return *histogram;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Interval snapshots of every histogram, in name order
+  std::vector<std::pair<std::string, LatencySnapshot>> intervalSnapshots() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<std::pair<std::string, LatencySnapshot>> result;
+    result.reserve(_histograms.size());
+    for (auto& entry : _histograms) {
+      result.emplace_back(entry.first, entry.second->intervalSnapshot());
+    }
+    return result;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Log a line for each histogram that had anything recorded since the last call. Meant to be
+  /// called periodically, eg. from a housekeeping thread.
+  ///
+  /// @param logger A Logger, or anything else with a `log(category, msg)`
+  template <typename Logger>
+  void logIntervalSnapshots(Logger& logger, typename Logger::Category category = Logger::Category::Info) {
+    for (const auto& entry : intervalSnapshots()) {
+      if (entry.second.count != 0) {
+        logger.log(category, "latency " + entry.first + ": " + entry.second.summary());
+      }
+    }
+  }
+
+private:
+  std::mutex _mutex;
+  std::map<std::string, std::unique_ptr<LatencyHistogram>> _histograms;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// The process wide registry used by SW_SCOPED_LATENCY. Never destroyed, so histograms stay
+/// usable from static destructors and exiting threads.
+inline LatencyRegistry& latencyRegistry() {
+  static LatencyRegistry* registry = new LatencyRegistry;
+  return *registry;
+}
+
+#define SW_LATENCY_CONCAT_(a, b) a##b
+#define SW_LATENCY_CONCAT(a, b) SW_LATENCY_CONCAT_(a, b)
+
+////////////////////////////////////////////////////////////////////////////////
+/// Time the rest of the enclosing scope into the named histogram of `latencyRegistry()`. The
+/// name is looked up once per call site.
+///   eg. SW_SCOPED_LATENCY("cache.get");
+#define SW_SCOPED_LATENCY(name)                                                                              \
+  static ::sw::LatencyHistogram& SW_LATENCY_CONCAT(swLatencyHistogram_, __LINE__) =                          \
+      ::sw::latencyRegistry().histogram(name);                                                                \
+  ::sw::ScopedTimer SW_LATENCY_CONCAT(swLatencyTimer_, __LINE__)(SW_LATENCY_CONCAT(swLatencyHistogram_, __LINE__))
+
+SW_NAMESPACE_END
@@ -20,7 +20,12 @@
 
 #include "assert.h"
 
+#include <atomic>
 #include <functional>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 ////////////////////////////////////////////////////////////////////////////////
 /// Contains useful miscellaneous functions
@@ -135,5 +140,134 @@ template <typename T, typename Func>
 LazyLambdaValue<T, Func> makeLazyValue(Func&& f) {
   return LazyLambdaValue<T, Func>(std::forward<Func>(f));
 }
+
+////////////////////////////////////////////////////////////////////////////////
+/// A thread-safe LazyPodValue, for pointer and integer payloads. The value is a single
+/// atomic, so `get()` is one acquire load once it's set, and never locks.
+///
+/// If several threads find it unset at once, each calls initFunc() and the first to store
+/// wins. The others return the winner's value, so initFunc() must be safe to call more than
+/// once, and should be cheap relative to a lock (or use ConcurrentLazyLambdaValue).
+template <typename T, T kInvalidValue>
+class AtomicLazyPodValue {
+  static_assert(std::is_trivially_copyable<T>::value, "AtomicLazyPodValue needs a trivially copyable T");
+
+public:
+  explicit AtomicLazyPodValue(T const& value = kInvalidValue) noexcept : value_(value) {}
+
+  AtomicLazyPodValue(AtomicLazyPodValue const&) = delete;
+  AtomicLazyPodValue& operator=(AtomicLazyPodValue const&) = delete;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// If the value is kInvalidValue, sets it to the return value of initFunc(). Returns the
+  /// value either way.
+  template <typename InitFunc>
+  inline T get(InitFunc const& initFunc) const {
+    T value = value_.load(std::memory_order_acquire);
+    if (value != kInvalidValue) {
+      return value;
+    }
+
+    T expected = kInvalidValue;
+    value = initFunc();
+    SW_ASSERT(value != kInvalidValue);  // Don't ever set the value to invalid value
+    if (value_.compare_exchange_strong(expected, value, std::memory_order_acq_rel, std::memory_order_acquire)) {
+      return value;
+    }
+    return expected;
+  }
+
+private:
+  // Allow const semantics
+  mutable std::atomic<T> value_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// A thread-safe LazyLambdaValue. The value is evaluated exactly once, under a lock, and
+/// after that `get()` is a single acquire load with no lock. Like std::call_once, if the
+/// evaluation throws, the exception goes to that caller and the next `get()` tries again.
+///
+/// Like LazyLambdaValue, this doesn't use std::function. The value is constructed in place
+/// from the evaluation's result, so T doesn't need a default constructor.
+///
+/// Moves are *not* thread-safe, and are only for setting it up.
+template <typename T, typename EvalFunc>
+class ConcurrentLazyLambdaValue {
+public:
+  explicit ConcurrentLazyLambdaValue(EvalFunc f) noexcept : evalFunc_(std::move(f)) {}
+
+  ConcurrentLazyLambdaValue(ConcurrentLazyLambdaValue&& that) : evalFunc_(std::move(that.evalFunc_)) {
+    if (that.isSet_.load(std::memory_order_acquire)) {
+      new (&storage_) T(std::move(that.value()));
+      isSet_.store(true, std::memory_order_relaxed);
+    }
+  }
+
+  ConcurrentLazyLambdaValue(ConcurrentLazyLambdaValue const&) = delete;
+  ConcurrentLazyLambdaValue& operator=(ConcurrentLazyLambdaValue const&) = delete;
+  ConcurrentLazyLambdaValue& operator=(ConcurrentLazyLambdaValue&&) = delete;
+
+  ~ConcurrentLazyLambdaValue() {
+    if (isSet_.load(std::memory_order_acquire)) {
+      value().~T();
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Gets the value. Lazy evaluates if needed
+  T& get() { return doGet(); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Gets the value. Lazy evaluates if needed
+  T const& get() const { return doGet(); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// @return True if the value has been evaluated
+  bool isSet() const noexcept { return isSet_.load(std::memory_order_acquire); }
+
+private:
+  ////////////////////////////////////////////////////////////////////////////////
+  T& doGet() const {
+    if (!isSet_.load(std::memory_order_acquire)) {
+      evaluate();
+    }
+    return value();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// The slow path, kept separate so the fast path inlines to a load and a branch
+  void evaluate() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!isSet_.load(std::memory_order_relaxed)) {
+      new (&storage_) T(evalFunc_());
+      isSet_.store(true, std::memory_order_release);
+    }
+  }
+
+  T& value() const noexcept { return *reinterpret_cast<T*>(&storage_); }
+
+  // Allow const semantics
+  mutable typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+  mutable std::atomic<bool> isSet_ = {false};
+  mutable std::mutex mutex_;
+  EvalFunc evalFunc_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// The std::function version of ConcurrentLazyLambdaValue, with easier syntax
+template <typename T>
+class ConcurrentLazyValue : public ConcurrentLazyLambdaValue<T, std::function<T()>> {
+  using BaseClass = ConcurrentLazyLambdaValue<T, std::function<T()>>;
+
+public:
+  explicit ConcurrentLazyValue(std::function<T()> f) noexcept : BaseClass(std::move(f)) {}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Make a ConcurrentLazyLambdaValue, deducing the lambda type
+template <typename T, typename Func>
+ConcurrentLazyLambdaValue<T, typename std::decay<Func>::type> makeConcurrentLazyValue(Func&& f) {
+  return ConcurrentLazyLambdaValue<T, typename std::decay<Func>::type>(std::forward<Func>(f));
+}
 }
 ;  // namespace sw
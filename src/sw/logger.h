@@ -20,19 +20,25 @@
 
 #include "strings.h"
 #include "system_traits.h"
+#include "threading_utils.h"
 #include "utils.h"
 
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <functional>
 #include <iomanip>
 #include <iostream>
 #include <mutex>
-#include <queue>
+#include <iterator>
 #include <sstream>
+#include <thread>
+#include <tuple>
+#include <utility>
 
 SW_NAMESPACE_BEGIN
 
@@ -41,10 +47,6 @@ SW_NAMESPACE_BEGIN
 /// logger, but after looking at the options, decided to just keep using this. The
 /// front end is nice, the backend could use some love for real applications.
 ////////////////////////////////////////////////////////////////////////////////
-template <typename SystemTraits = system::ThisSystemTraits>
-class LoggerType;
-using Logger = LoggerType<>;
-
 ////////////////////////////////////////////////////////////////////////////////
 enum class LoggerTimeStyle : uint8 { None, Delta, Absolute };
 
@@ -88,6 +90,194 @@ enum class LoggerCategory : uint8 {
 };
 SW_DEFINE_ENUM_BITFIELD_OPERATORS(LoggerCategory);
 
+////////////////////////////////////////////////////////////////////////////////
+/// The categories compiled into loggers by default. Logging calls for any other category
+/// compile to nothing. eg. Define as `(::sw::LoggerCategory::Error | ::sw::LoggerCategory::Warn)`
+/// to strip everything else from a build.
+#ifndef SW_LOGGER_COMPILED_CATEGORIES
+#  define SW_LOGGER_COMPILED_CATEGORIES ::sw::LoggerCategory::All
+#endif
+
+template <typename SystemTraits = system::ThisSystemTraits,
+          LoggerCategory kCompiledCategories = SW_LOGGER_COMPILED_CATEGORIES>
+class LoggerType;
+using Logger = LoggerType<>;
+
+namespace log_detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// How a deferred log argument is captured. Values are copied as raw bytes, so they must
+/// be trivially copyable. Pointers are rejected since what they point to may be gone by the
+/// time the message is formatted. Strings are specialized below to copy their contents.
+template <typename T, typename Enable = void>
+struct DeferredArg {
+  static_assert(std::is_trivially_copyable<T>::value && !std::is_pointer<T>::value,
+                "Deferred log arguments must be trivially copyable values or strings");
+
+  static const T& view(const T& value) noexcept { return value; }
+
+  static void encode(const T& value, std::string& out) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  static T decode(const char*& in) noexcept {
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    std::memcpy(&storage, in, sizeof(T));
+    in += sizeof(T);
+    return *reinterpret_cast<const T*>(&storage);
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Strings are copied as a length and the characters, and decode as views of the copy
+struct DeferredStringArg {
+  static void encodeChars(const char* data, sizex size, std::string& out) {
+    const auto len = static_cast<u32>(size);
+    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    out.append(data, len);
+  }
+
+  static fmt::string_view decode(const char*& in) noexcept {
+    u32 len = 0;
+    std::memcpy(&len, in, sizeof(len));
+    const auto data = in + sizeof(len);
+    in = data + len;
+    return fmt::string_view(data, len);
+  }
+};
+
+template <>
+struct DeferredArg<const char*> : DeferredStringArg {
+  static fmt::string_view view(const char* value) noexcept { return fmt::string_view(value, std::strlen(value)); }
+  static void encode(const char* value, std::string& out) { encodeChars(value, std::strlen(value), out); }
+};
+
+template <>
+struct DeferredArg<char*> : DeferredArg<const char*> {};
+
+/// String literals
+template <sizex N>
+struct DeferredArg<char[N]> : DeferredArg<const char*> {};
+
+template <>
+struct DeferredArg<std::string> : DeferredStringArg {
+  static fmt::string_view view(const std::string& value) noexcept { return fmt::string_view(value.data(), value.size()); }
+  static void encode(const std::string& value, std::string& out) { encodeChars(value.data(), value.size(), out); }
+};
+
+template <>
+struct DeferredArg<StringView> : DeferredStringArg {
+  static fmt::string_view view(const StringView& value) noexcept { return fmt::string_view(value.data(), value.size()); }
+  static void encode(const StringView& value, std::string& out) { encodeChars(value.data(), value.size(), out); }
+};
+
+template <>
+struct DeferredArg<StringWrapper> : DeferredStringArg {
+  static fmt::string_view view(const StringWrapper& value) { return fmt::string_view(value.data(), value.size()); }
+  static void encode(const StringWrapper& value, std::string& out) { encodeChars(value.data(), value.size(), out); }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// The type-erased operations for a deferred message with the given argument types. The
+/// arguments are held as a tuple of references while the message is live.
+template <typename... Ts>
+struct DeferredFormatter {
+  using Args = std::tuple<const Ts&...>;
+
+  static void encode(const void* args, std::string& out) {
+    encode(*static_cast<const Args*>(args), out, std::index_sequence_for<Ts...>{});
+  }
+
+  static void formatArgs(const char* format, const void* args, fmt::memory_buffer& out) {
+    formatArgs(format, *static_cast<const Args*>(args), out, std::index_sequence_for<Ts...>{});
+  }
+
+  static void formatEncoded(const char* format, const char* encoded, fmt::memory_buffer& out) {
+    // Braced initialization guarantees the decodes happen in order
+    unused(encoded);
+    const std::tuple<decltype(DeferredArg<Ts>::decode(encoded))...> values{DeferredArg<Ts>::decode(encoded)...};
+    formatValues(format, values, out, std::index_sequence_for<Ts...>{});
+  }
+
+private:
+  template <sizex... Is>
+  static void encode(const Args& args, std::string& out, std::index_sequence<Is...>) {
+    unused(args);
+    unused(out);
+    const int expand[] = {0, (DeferredArg<Ts>::encode(std::get<Is>(args), out), 0)...};
+    unused(expand);
+  }
+
+  template <sizex... Is>
+  static void formatArgs(const char* format, const Args& args, fmt::memory_buffer& out, std::index_sequence<Is...>) {
+    unused(args);
+    fmt::format_to(std::back_inserter(out), format, DeferredArg<Ts>::view(std::get<Is>(args))...);
+  }
+
+  template <typename Values, sizex... Is>
+  static void formatValues(const char* format, const Values& values, fmt::memory_buffer& out,
+                           std::index_sequence<Is...>) {
+    unused(values);
+    fmt::format_to(std::back_inserter(out), format, std::get<Is>(values)...);
+  }
+};
+
+}  // namespace log_detail
+
+////////////////////////////////////////////////////////////////////////////////
+/// A log message where the formatting hasn't been done yet. See `LoggerType::logDeferred()`.
+///
+/// It refers to the caller's arguments, so it's only valid for the duration of the
+/// `LogHandler::onLogDeferred()` call. A handler that wants to format it later, eg. on
+/// another thread, must `encode()` the arguments and keep the `encodedFormatter()`.
+class DeferredLogMessage {
+public:
+  using EncodedFormatter = void (*)(const char* format, const char* encoded, fmt::memory_buffer& out);
+
+  template <typename... Ts>
+  DeferredLogMessage(const char* format, const std::tuple<const Ts&...>& args) noexcept :
+      _format(format),
+      _args(&args),
+      _encode(&log_detail::DeferredFormatter<Ts...>::encode),
+      _formatArgs(&log_detail::DeferredFormatter<Ts...>::formatArgs),
+      _formatEncoded(&log_detail::DeferredFormatter<Ts...>::formatEncoded) {}
+
+  /// The format string. Must have static storage duration
+  const char* formatString() const noexcept { return _format; }
+
+  /// Format the message now
+  void formatTo(fmt::memory_buffer& out) const { _formatArgs(_format, _args, out); }
+
+  /// Format the message now
+  std::string format() const {
+    fmt::memory_buffer out;
+    formatTo(out);
+    return std::string(out.data(), out.size());
+  }
+
+  /// Append a copy of the arguments to `out`, for formatting later with `encodedFormatter()`
+  void encode(std::string& out) const { _encode(_args, out); }
+
+  /// Formats from the `encode()` bytes rather than the live arguments
+  EncodedFormatter encodedFormatter() const noexcept { return _formatEncoded; }
+
+private:
+  const char* _format;
+  const void* _args;
+  void (*_encode)(const void* args, std::string& out);
+  void (*_formatArgs)(const char* format, const void* args, fmt::memory_buffer& out);
+  EncodedFormatter _formatEncoded;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// One message of a batch given to `LogHandler::onLogBatch()`
+struct LogRecord {
+  SystemTimepoint logTime;
+  LoggerCategory cat;
+  StringWrapper msg;
+  bool force;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 /// This is the "backend" for the logger. Implement to do as needed.
 ///
@@ -95,6 +285,22 @@ SW_DEFINE_ENUM_BITFIELD_OPERATORS(LoggerCategory);
 struct LogHandler {
   virtual ~LogHandler() = default;
   virtual void onLog(SystemTimepoint logTime, LoggerCategory cat, const StringWrapper& msg, bool force) = 0;
+
+  /// Deferred messages are formatted right away and logged normally unless overridden
+  virtual void onLogDeferred(SystemTimepoint logTime, LoggerCategory cat, const DeferredLogMessage& msg, bool force) {
+    onLog(logTime, cat, msg.format(), force);
+  }
+
+  /// Log several messages at once, in order. Handlers that lock or write per message
+  /// should override this to do it once for the batch.
+  virtual void onLogBatch(const LogRecord* records, sizex count) {
+    for (sizex i = 0; i < count; ++i) {
+      onLog(records[i].logTime, records[i].cat, records[i].msg, records[i].force);
+    }
+  }
+
+  /// Write out anything that's buffered
+  virtual void flush() {}
 };
 using LogHandlerRef = std::shared_ptr<LogHandler>;
 
@@ -104,7 +310,13 @@ using LogHandlerRef = std::shared_ptr<LogHandler>;
 /// The general design is a front-end/back-end approach. This class is the front
 /// end, where the back end is whatever instance of LogHandler that gets attached.
 /// A few backends are included at the end of this file.
-template <typename SystemTraits>
+///
+/// There are two category masks in front of the log handler. Categories not in
+/// `kCompiledCategories` are removed at compile time. The runtime mask, via
+/// `setCategoryMask()`, is checked inline before any formatting. Forced messages skip the
+/// runtime mask but not the compiled one. The `SW_LOG_*` macros do the check before
+/// evaluating the arguments.
+template <typename SystemTraits, LoggerCategory kCompiledCategories>
 class LoggerType {
 public:
   using Category = LoggerCategory;
@@ -141,6 +353,10 @@ public:
     return "????";
   }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Is the category compiled into this logger type?
+  static constexpr bool isCompiledIn(Category cat) { return (kCompiledCategories & cat) == cat; }
+
   ////////////////////////////////////////////////////////////////////////////////
   /// Creates an unusable logger
   LoggerType() = default;
@@ -151,11 +367,39 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
   ~LoggerType() = default;
 
-  // No move/copy
+  // No copy
   LoggerType(LoggerType const&) = delete;
   LoggerType& operator=(LoggerType const&) = delete;
-  LoggerType(LoggerType&&) = default;
-  LoggerType& operator=(LoggerType&&) = default;
+
+  // Movable, though not while being logged to
+  LoggerType(LoggerType&& that) noexcept :
+      _startTime(that._startTime),
+      _logHandler(std::move(that._logHandler)),
+      _categoryMask(that._categoryMask.load(std::memory_order_relaxed)) {}
+
+  // Movable, though not while being logged to
+  LoggerType& operator=(LoggerType&& that) noexcept {
+    _startTime = that._startTime;
+    _logHandler = std::move(that._logHandler);
+    _categoryMask.store(that._categoryMask.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return *this;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the runtime category mask. Defaults to all categories.
+  Category categoryMask() const noexcept {
+    return static_cast<Category>(_categoryMask.load(std::memory_order_relaxed));
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Sets the runtime category mask. Safe to call while other threads are logging.
+  void setCategoryMask(Category mask) noexcept { _categoryMask.store(asPod(mask), std::memory_order_relaxed); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Would a message in the given category be logged? Handlers may still filter it out.
+  bool isEnabled(Category cat) const noexcept {
+    return isCompiledIn(cat) && (asPod(cat) & _categoryMask.load(std::memory_order_relaxed)) == asPod(cat);
+  }
 
   ////////////////////////////////////////////////////////////////////////////////
   /// Get the starting timepoint
@@ -164,30 +408,54 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
   /// Log a message at the specified category
   void log(SystemTimepoint logTime, Category category, StringWrapper const& msg, bool force = false) {
-    _logHandler->onLog(logTime, category, msg, force);
+    if (canLog(category, force)) {
+      _logHandler->onLog(logTime, category, msg, force);
+    }
   }
 
   ////////////////////////////////////////////////////////////////////////////////
   /// Log a message at the specified category
   void log(Category category, StringWrapper const& msg, bool force = false) {
-    _logHandler->onLog(SystemClock::now(), category, msg, force);
+    if (canLog(category, force)) {
+      _logHandler->onLog(SystemClock::now(), category, msg, force);
+    }
   }
 
   ////////////////////////////////////////////////////////////////////////////////
   /// Force a log entry using {fmt} style formatted message at the specified category
   /// This overrides any category mask disables.
   template <typename... Ts>
-  void logForcef(Category cat, StringWrapper const& format, Ts... ts) {
-    std::string logString = fmt::format(format.c_str(), std::forward<Ts>(ts)...);
-    log(cat, logString, true);
+  void logForcef(Category cat, StringWrapper const& format, Ts&&... ts) {
+    if (canLog(cat, true)) {
+      std::string logString = fmt::format(format.c_str(), std::forward<Ts>(ts)...);
+      _logHandler->onLog(SystemClock::now(), cat, logString, true);
+    }
   }
 
   ////////////////////////////////////////////////////////////////////////////////
   /// Log an {fmt} style formatted message at the specified category
   template <typename... Ts>
-  void logf(Category cat, StringWrapper const& format, Ts... ts) {
-    std::string logString = fmt::format(format.c_str(), std::forward<Ts>(ts)...);
-    log(cat, logString);
+  void logf(Category cat, StringWrapper const& format, Ts&&... ts) {
+    if (canLog(cat, false)) {
+      std::string logString = fmt::format(format.c_str(), std::forward<Ts>(ts)...);
+      _logHandler->onLog(SystemClock::now(), cat, logString, false);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Log an {fmt} style message where the formatting may be deferred to the log handler.
+  /// With an AsyncLogHandler the arguments are copied to its queue and formatted on the
+  /// logging thread, so the caller only pays for the copy.
+  ///
+  /// The format string must be a literal (or otherwise outlive the logger). The arguments
+  /// must be trivially copyable values or strings. String contents are copied.
+  template <typename... Ts>
+  void logDeferred(Category cat, const char* format, const Ts&... ts) {
+    if (!canLog(cat, false))
+      return;
+
+    const std::tuple<const Ts&...> args{ts...};
+    _logHandler->onLogDeferred(SystemClock::now(), cat, DeferredLogMessage(format, args), false);
   }
 
   ////////////////////////////////////////////////////////////////////////////////
@@ -197,7 +465,7 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
   /// Log an sprintf style formatted message with the Trace category
   template <typename... Ts>
-  void verbosef(StringWrapper const& format, Ts... ts) {
+  void verbosef(StringWrapper const& format, Ts&&... ts) {
     logf(Category::Verbose, format, std::forward<Ts>(ts)...);
   }
 
@@ -208,7 +476,7 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
   /// Log an sprintf style formatted message with the Debug category
   template <typename... Ts>
-  void debugf(StringWrapper const& format, Ts... ts) {
+  void debugf(StringWrapper const& format, Ts&&... ts) {
     logf(Category::Debug, format, std::forward<Ts>(ts)...);
   }
 
@@ -219,7 +487,7 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
   /// Log an sprintf style formatted message with the Info category
   template <typename... Ts>
-  void infof(StringWrapper const& format, Ts... ts) {
+  void infof(StringWrapper const& format, Ts&&... ts) {
     logf(Category::Info, format, std::forward<Ts>(ts)...);
   }
 
@@ -234,7 +502,7 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
   /// Log an sprintf style formatted message with the WARN category
   template <typename... Ts>
-  void warnf(StringWrapper const& format, Ts... ts) {
+  void warnf(StringWrapper const& format, Ts&&... ts) {
     logf(Category::Warn, format, std::forward<Ts>(ts)...);
   }
 
@@ -249,7 +517,7 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
   /// Log an sprintf style formatted message with the Error category
   template <typename... Ts>
-  void errorf(StringWrapper const& format, Ts... ts) {
+  void errorf(StringWrapper const& format, Ts&&... ts) {
     logf(Category::Error, format, std::forward<Ts>(ts)...);
   }
 
@@ -258,13 +526,36 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
 
 private:
+  ////////////////////////////////////////////////////////////////////////////////
+  bool canLog(Category cat, bool force) const noexcept { return force ? isCompiledIn(cat) : isEnabled(cat); }
+
   /// Note - Using 'system' clock so that it's convertable to time_t and capable of date formatting.
   /// TODO: C++20 solves this and allows use of steady and hi-res clocks
   SystemTimepoint _startTime;
 
   LogHandlerRef _logHandler;
+
+  /// Runtime category mask. Atomic so it can be changed while logging
+  std::atomic<uint8> _categoryMask{asPod(Category::All)};
 };
 
+////////////////////////////////////////////////////////////////////////////////
+/// Log macros that check the category before evaluating any of the arguments. Calls for
+/// categories that aren't compiled in are removed entirely.
+///   eg. SW_LOG_DEBUG(logger, "value={}", expensiveToCompute());
+#define SW_LOG(logger, cat, ...)         \
+  do {                                   \
+    if ((logger).isEnabled(cat)) {       \
+      (logger).logf((cat), __VA_ARGS__); \
+    }                                    \
+  } while (false)
+
+#define SW_LOG_ERROR(logger, ...) SW_LOG(logger, ::sw::LoggerCategory::Error, __VA_ARGS__)
+#define SW_LOG_WARN(logger, ...) SW_LOG(logger, ::sw::LoggerCategory::Warn, __VA_ARGS__)
+#define SW_LOG_INFO(logger, ...) SW_LOG(logger, ::sw::LoggerCategory::Info, __VA_ARGS__)
+#define SW_LOG_VERBOSE(logger, ...) SW_LOG(logger, ::sw::LoggerCategory::Verbose, __VA_ARGS__)
+#define SW_LOG_DEBUG(logger, ...) SW_LOG(logger, ::sw::LoggerCategory::Debug, __VA_ARGS__)
+
 ////////////////////////////////////////////////////////////////////////////////
 /// Simple empty logger
 struct NullLogHandler : public LogHandler {
@@ -308,8 +599,47 @@ private:
   std::mutex _lock;
 };
 
+namespace log_detail {
+
+////////////////////////////////////////////////////////////////////////////////
+struct AbsTime {
+  std::string timeString;
+  double msFraction;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+static AbsTime getAbsTime(const SystemClock::time_point& now) {
+  auto const nowTimet = SystemClock::to_time_t(now);
+
+  // time_t is in seconds, and we want ms resolution. Convert back and extract the ms.
+  auto const nowFromTimet = SystemClock::from_time_t(nowTimet);
+  auto const msDelta = std::chrono::duration_cast<std::chrono::milliseconds>(now - nowFromTimet);
+  auto const msFraction = double(msDelta.count()) / 1000.0;
+
+  std::stringstream timeStr;
+
+  // Note - intentionally omitting timezone since it doesn't change. The app will always log
+  // an initial entry that includes a reference time with the timezone.
+  // SCW: Also note, using %Z on Windows is emitting "Pacific Standard Time" rather than "PST"
+  const auto lt = sw::localtime(&nowTimet);
+  timeStr << std::put_time(&lt, "%c");
+
+  return AbsTime{timeStr.str(), msFraction};
+}
+
+}  // namespace log_detail
+
 ////////////////////////////////////////////////////////////////////////////////
 /// Beefier log-handler that can log to console, file, and/or callback
+///
+/// File output can be buffered by setting `fileBufferSize`. Lines then collect in memory
+/// and are written when the buffer fills, for any category in `fileFlushCategoryMask`, or on
+/// `flush()`. A batch from `onLogBatch()` is written at most once.
+///
+/// `fileFlushInterval` is only checked when something is logged: a line logged once the
+/// interval has passed since the last write flushes the buffer. There's no timer, so on its own
+/// a quiet process can keep lines buffered until the next log call or `flush()`. Behind an
+/// AsyncLogHandler that doesn't happen, since its thread calls `flush()` whenever it goes idle.
 struct ConsoleFileLogHandler : public LogHandler {
   using Category = Logger::Category;
   using ConsoleDestination = LoggerConsoleDestination;
@@ -320,48 +650,100 @@ struct ConsoleFileLogHandler : public LogHandler {
     LoggerTimeStyle fileTimeStyle = LoggerTimeStyle::Absolute;
     Category fileCategoryMask = Category::All;
 
+    // Buffered file output. A zero size writes every line through
+    sizex fileBufferSize = 0;
+    std::chrono::milliseconds fileFlushInterval{1000};  ///> Checked on log calls only
+    Category fileFlushCategoryMask = Category::Error;
+
     // Log to console support
     Category consoleCategoryMask = Category::All;
     LoggerTimeStyle consoleTimeStyle = LoggerTimeStyle::Delta;
     ConsoleDestination console_destination = ConsoleDestination::Stdout;
   };
 
-  ConsoleFileLogHandler(Config config) : _config(config) {}
+  ConsoleFileLogHandler(Config config) : _config(config) {
+    if (!_config.logFile.empty()) {
+      _fout.open(_config.logFile, std::ios::out | std::ios::app);
+    }
+    _fileBuffer.reserve(_config.fileBufferSize);
+  }
+
+  ~ConsoleFileLogHandler() override {
+    MutexLock lock(_lock);
+    flushFile();
+  }
 
   void onLog(SystemTimepoint logTime, Logger::Category cat, const StringWrapper& msg, bool force) override;
+  void onLogBatch(const LogRecord* records, sizex count) override;
+  void flush() override;
 
 private:
+  /// Append the message to the console and file outputs. Returns true if the file needs
+  /// flushing. Must hold the lock.
+  bool logLocked(SystemTimepoint logTime, Logger::Category cat, const StringWrapper& msg, bool force);
+
+  /// Format a full log line, without the newline, onto `out`. Must hold the lock.
+  void appendLogLine(fmt::memory_buffer& out, LoggerTimeStyle timeStyle, SystemTimepoint logTime,
+                     Logger::Category category, const StringWrapper& msg);
+
+  /// Flush the outputs as needed after logging. Must hold the lock.
+  void finishLocked(bool flushFileNow);
+
+  /// Write out the file buffer. Must hold the lock.
+  void flushFile();
+
   SystemTimepoint _startTime = SystemClock::now();
   Config _config;
   std::ofstream _fout;  ///> File to log to. Will be unused when file logging is disabled
+  std::string _fileBuffer;
+  fmt::memory_buffer _lineBuffer;  ///> Reused for each line, so there are no per-line allocations
+  log_detail::AbsTime _absTime;    ///> Cached absolute time text for `_absTimet`
+  std::time_t _absTimet = 0;
+  SteadyClock::time_point _lastFileFlush = SteadyClock::now();
+  bool _consolePending = false;
   std::mutex _lock;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
-/// Asynchronous log handler
+/// What AsyncLogHandler does with a message when its queue is full
+/// * Block: The logging thread waits for room. Nothing is lost.
+/// * Drop: The message is silently discarded.
+/// * DropAndCount: The message is discarded and counted. The count is logged as a warning
+///   once there's room again, and is available via `droppedCount()`.
+enum class AsyncLogOverflow : uint8 { Block, Drop, DropAndCount };
+
+////////////////////////////////////////////////////////////////////////////////
+/// Asynchronous log handler. Messages go through a bounded lock-free queue and are
+/// forwarded to the target handler on a single background thread.
+///
+/// Logging never takes a lock or signals the thread per message. The thread wakes up every
+/// `flushInterval`, or early when the queue crosses `wakeWatermark`. The queue slots are
+/// reused, so once warmed up there are no per-message allocations either.
 struct AsyncLogHandler : public LogHandler {
   struct LogEntry {
-    LogEntry() = default;
-    LogEntry(SystemTimepoint time, Logger::Category catx, std::string&& msgx, bool forcex) :
-        logTime(time),
-        cat(catx),
-        msg(std::move(msgx)),
-        force(forcex) {}
     SystemTimepoint logTime;
-    Logger::Category cat;
-    std::string msg;
-    bool force;
+    Logger::Category cat = Logger::Category::None;
+    std::string msg;  ///> The message, or the encoded arguments for a deferred message
+    bool force = false;
+
+    /// Only for deferred messages
+    const char* format = nullptr;
+    DeferredLogMessage::EncodedFormatter formatter = nullptr;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  struct Config {
+    sizex capacity = 8192;      ///> Queue slots. Rounded up to a power of two
+    sizex wakeWatermark = 512;  ///> Queue size that wakes the thread before the interval
+    std::chrono::milliseconds flushInterval{50};
+    AsyncLogOverflow overflow = AsyncLogOverflow::Block;
   };
 
   ////////////////////////////////////////////////////////////////////////////////
   ~AsyncLogHandler() {
     // Let our thread know it's exit time
-    {
-      std::lock_guard<decltype(_queueLock)> lockGuard(_queueLock);
-      _exit = true;
-      _drain = false;
-    }
-    _queueCondition.notify_all();
+    _drain = false;
+    requestExit();
 
     // Wait for the thread to exit
     try {
@@ -374,37 +756,58 @@ struct AsyncLogHandler : public LogHandler {
   }
 
   ////////////////////////////////////////////////////////////////////////////////
-  AsyncLogHandler(LogHandlerRef forwardLogger) :
+  AsyncLogHandler(LogHandlerRef forwardLogger) : AsyncLogHandler(std::move(forwardLogger), Config()) {}
+
+  ////////////////////////////////////////////////////////////////////////////////
+  AsyncLogHandler(LogHandlerRef forwardLogger, Config config) :
       _targetLogger(std::move(forwardLogger)),
+      _config(config),
+      _queue(config.capacity),
       _thread([this]() { this->threadExec(); }) {}
 
   ////////////////////////////////////////////////////////////////////////////////
-  void onLog(SystemTimepoint logTime, Logger::Category cat, const StringWrapper& msg, bool force) {
-    // Put log entry on queue
-    {
-      std::lock_guard<decltype(_queueLock)> lockGuard(_queueLock);
+  void onLog(SystemTimepoint logTime, Logger::Category cat, const StringWrapper& msg, bool force) override {
+    // Don't add new log items once we've exited
+    if (_exit.load(std::memory_order_relaxed)) {
+      // Somebody logged after the logger shutdown
+      SW_ASSERT(false);
+      return;
+    }
 
-      // Don't add new log items once we've exited
-      if (_exit) {
-        // Somebody logged after the logger shutdown
-        SW_ASSERT(false);
-      } else {
-        _queue.emplace(logTime, cat, std::string(msg.data(), msg.size()), force);
-      }
+    push([&](LogEntry& entry) {
+      entry.logTime = logTime;
+      entry.cat = cat;
+      entry.msg.assign(msg.data(), msg.size());
+      entry.force = force;
+      entry.formatter = nullptr;
+    });
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Queues a copy of the arguments. The formatting happens on the logging thread.
+  void onLogDeferred(SystemTimepoint logTime, Logger::Category cat, const DeferredLogMessage& msg,
+                     bool force) override {
+    if (_exit.load(std::memory_order_relaxed)) {
+      SW_ASSERT(false);
+      return;
     }
 
-    _queueCondition.notify_one();
+    push([&](LogEntry& entry) {
+      entry.logTime = logTime;
+      entry.cat = cat;
+      entry.msg.clear();
+      msg.encode(entry.msg);
+      entry.force = force;
+      entry.format = msg.formatString();
+      entry.formatter = msg.encodedFormatter();
+    });
   }
 
   ////////////////////////////////////////////////////////////////////////////////
   /// Safe shutdown that drains the queue before exiting
   void shutdown() {
-    {
-      std::lock_guard<decltype(_queueLock)> lockGuard(_queueLock);
-      _drain = true;  // Order matters here
-      _exit = true;
-    }
-    _queueCondition.notify_all();
+    _drain = true;  // Order matters here
+    requestExit();
 
     // Wait for the thread to exit
     if (_thread.joinable()) {
@@ -412,124 +815,286 @@ struct AsyncLogHandler : public LogHandler {
     }
   }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the number of messages dropped with `AsyncLogOverflow::DropAndCount`
+  u64 droppedCount() const noexcept { return _droppedTotal.load(std::memory_order_relaxed); }
+
 private:
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Queue an entry, applying the overflow policy if the queue is full
+  template <typename Fill>
+  void push(Fill&& fill) {
+    while (!_queue.tryPush(fill)) {
+      switch (_config.overflow) {
+      case AsyncLogOverflow::Drop:
+        return;
+      case AsyncLogOverflow::DropAndCount:
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      case AsyncLogOverflow::Block:
+        if (_exit.load(std::memory_order_relaxed))
+          return;
+        wake();
+        std::this_thread::yield();
+        break;
+      }
+    }
+
+    // Only signal on crossing the watermark. The timer picks up everything else
+    if (_queue.size() >= _config.wakeWatermark) {
+      wake();
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  void requestExit() {
+    {
+      MutexLock lock(_wakeLock);
+      _exit = true;
+    }
+    _wakeCondition.notify_all();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Wake the thread if it's sleeping
+  void wake() {
+    if (_sleeping.load(std::memory_order_acquire)) {
+      MutexLock lock(_wakeLock);
+      _wakeCondition.notify_one();
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Entries are handed to the target in batches of up to this many
+  static constexpr sizex kBatchSize = 256;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Forward everything that's queued, in batches
+  /// @return true if anything was forwarded
+  bool drainQueue() {
+    bool forwarded = false;
+    const auto& addRecord = [&](LogEntry& entry) {
+      // Deferred messages are formatted back into the entry so they stay put for the batch
+      if (entry.formatter != nullptr) {
+        _formatBuffer.clear();
+        try {
+          entry.formatter(entry.format, entry.msg.data(), _formatBuffer);
+          entry.msg.assign(_formatBuffer.data(), _formatBuffer.size());
+        } catch (const std::exception& ex) {
+          // A bad format is the caller's bug, but it mustn't take down the logging thread
+          entry.msg = fmt::format("Invalid deferred log format \"{}\": {}", entry.format, ex.what());
+        }
+        entry.formatter = nullptr;
+      }
+      _batch.push_back(LogRecord{entry.logTime, entry.cat, StringWrapper(entry.msg), entry.force});
+    };
+    const auto& forwardBatch = [&]() {
+      try {
+        _targetLogger->onLogBatch(_batch.data(), _batch.size());
+      } catch (const std::exception& ex) {
+        unused(ex);
+        SW_ASSERT(false);
+      }
+      _batch.clear();
+    };
+    while (_queue.popBatch(kBatchSize, addRecord, forwardBatch) != 0) {
+      forwarded = true;
+    }
+
+    const auto dropped = _dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped != 0) {
+      _droppedTotal.fetch_add(dropped, std::memory_order_relaxed);
+      forward(SystemClock::now(), Logger::Category::Warn,
+              fmt::format("AsyncLogHandler queue overflowed, dropped {} messages", dropped), false);
+      forwarded = true;
+    }
+    return forwarded;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  void flushTarget() {
+    try {
+      _targetLogger->flush();
+    } catch (const std::exception& ex) {
+      unused(ex);
+      SW_ASSERT(false);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  void forward(SystemTimepoint logTime, Logger::Category cat, const StringWrapper& msg, bool force) {
+    // Forward the log entry, do it unlocked!
+    try {
+      _targetLogger->onLog(logTime, cat, msg, force);
+    } catch (const std::exception& ex) {
+      unused(ex);
+      SW_ASSERT(false);
+    }
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
   /// Thread execution function for the async logger. This delivers all log messages
   /// to our forwarding thread, and thus they all come in on the same thread to the
   /// target logger.
   void threadExec() {
-    LogEntry logEntry;
+    bool unflushed = false;
     while (true) {
-      {
-        std::unique_lock<decltype(_queueLock)> lock(_queueLock);
-        _queueCondition.wait(lock, [&]() { return _exit || !_queue.empty(); });
-        if (_exit && (!_drain || _queue.empty())) {
-          return;
-        }
+      unflushed = drainQueue() || unflushed;
 
-        // Process the next log item
-        SW_ASSERT(!_queue.empty());
-        logEntry = std::move(_queue.front());
-        _queue.pop();
+      // Going idle, so let the target write out what it's buffered
+      if (unflushed && _queue.empty()) {
+        flushTarget();
+        unflushed = false;
       }
 
-      // Forward the log entry, do it unlocked!
-      try {
-        _targetLogger->onLog(logEntry.logTime, logEntry.cat, logEntry.msg, logEntry.force);
-      } catch (const std::exception& ex) {
-        SW_ASSERT(false);
+      {
+        std::unique_lock<decltype(_wakeLock)> lock(_wakeLock);
+        if (!_exit && _queue.size() < _config.wakeWatermark) {
+          _sleeping.store(true, std::memory_order_release);
+          _wakeCondition.wait_for(lock, _config.flushInterval,
+                                  [&]() { return _exit || _queue.size() >= _config.wakeWatermark; });
+          _sleeping.store(false, std::memory_order_relaxed);
+        }
+        if (_exit) {
+          break;
+        }
       }
     }
+
+    if (_drain) {
+      drainQueue();
+    }
+    flushTarget();
   }
 
   LogHandlerRef _targetLogger;
+  Config _config;
+  BoundedMpscQueue<LogEntry> _queue;
 
-  std::thread _thread;
-  std::queue<LogEntry> _queue;
-  std::mutex _queueLock;
-  std::condition_variable _queueCondition;
-  bool _exit = false;   ///> Does not need to be atomic since it's guarded by a mutex
-  bool _drain = false;  ///> Does not need to be atomic since it's guarded by a mutex
-};
+  fmt::memory_buffer _formatBuffer;  ///> Reused for deferred messages. Only used by the thread
+  std::vector<LogRecord> _batch;     ///> Reused for batches. Only used by the thread
 
-namespace log_detail {
+  std::atomic<u64> _dropped{0};       ///> Drops not reported yet
+  std::atomic<u64> _droppedTotal{0};  ///> All reported drops
 
-////////////////////////////////////////////////////////////////////////////////
-struct AbsTime {
-  std::string timeString;
-  double msFraction;
+  std::mutex _wakeLock;  ///> Only for sleeping/waking the thread. Never held while logging
+  std::condition_variable _wakeCondition;
+  std::atomic<bool> _sleeping{false};
+  std::atomic<bool> _exit{false};
+  std::atomic<bool> _drain{false};
+
+  std::thread _thread;  ///> Last, so everything it uses is constructed first
 };
 
 ////////////////////////////////////////////////////////////////////////////////
-static AbsTime getAbsTime(const SystemClock::time_point& now) {
-  auto const nowTimet = SystemClock::to_time_t(now);
-
-  // time_t is in seconds, and we want ms resolution. Convert back and extract the ms.
-  auto const nowFromTimet = SystemClock::from_time_t(nowTimet);
-  auto const msDelta = std::chrono::duration_cast<std::chrono::milliseconds>(now - nowFromTimet);
-  auto const msFraction = double(msDelta.count()) / 1000.0;
-
-  std::stringstream timeStr;
-
-  // Note - intentionally omitting timezone since it doesn't change. The app will always log
-  // an initial entry that includes a reference time with the timezone.
-  // SCW: Also note, using %Z on Windows is emitting "Pacific Standard Time" rather than "PST"
-  const auto lt = sw::localtime(&nowTimet);
-  timeStr << std::put_time(&lt, "%c");
+inline void ConsoleFileLogHandler::onLog(SystemTimepoint logTime, Logger::Category category,
+                                         const StringWrapper& msg, bool force) {
+  MutexLock lock(_lock);
+  finishLocked(logLocked(logTime, category, msg, force));
+}
 
-  return AbsTime{timeStr.str(), msFraction};
+////////////////////////////////////////////////////////////////////////////////
+inline void ConsoleFileLogHandler::onLogBatch(const LogRecord* records, sizex count) {
+  MutexLock lock(_lock);
+  bool flushFileNow = false;
+  for (sizex i = 0; i < count; ++i) {
+    flushFileNow = logLocked(records[i].logTime, records[i].cat, records[i].msg, records[i].force) || flushFileNow;
+  }
+  finishLocked(flushFileNow);
 }
 
-}  // namespace log_detail
+////////////////////////////////////////////////////////////////////////////////
+inline void ConsoleFileLogHandler::flush() {
+  MutexLock lock(_lock);
+  flushFile();
+}
 
 ////////////////////////////////////////////////////////////////////////////////
-inline void ConsoleFileLogHandler::onLog(SystemTimepoint logTime, Logger::Category category,
-                                         const StringWrapper& msg, bool force) {
+inline bool ConsoleFileLogHandler::logLocked(SystemTimepoint logTime, Logger::Category category,
+                                             const StringWrapper& msg, bool force) {
   // Determine what we'll log and exit early if nothing to do.
   bool const logToConsole = (_config.console_destination != ConsoleDestination::None) &&
                             Logger::canLogCategory(category, _config.consoleCategoryMask, force);
   bool const logToFile = _fout.is_open() && Logger::canLogCategory(category, _config.fileCategoryMask, force);
   if (!logToConsole && !logToFile) {
-    return;
+    return false;
   }
 
-  // Pre-compute abs time string if needed
-  const auto& absTime = (logToConsole && _config.consoleTimeStyle == LoggerTimeStyle::Absolute) ||
-                                (logToFile && _config.fileTimeStyle == LoggerTimeStyle::Absolute) ?
-                            log_detail::getAbsTime(logTime) :
-                            log_detail::AbsTime{std::string{}, 0};
+  if (logToConsole) {
+    _lineBuffer.clear();
+    appendLogLine(_lineBuffer, _config.consoleTimeStyle, logTime, category, msg);
+    _lineBuffer.push_back('\n');
+    auto& dest = (_config.console_destination == ConsoleDestination::Stderr) ? std::cerr : std::cout;
+    dest.write(_lineBuffer.data(), static_cast<std::streamsize>(_lineBuffer.size()));
+    _consolePending = true;
+  }
+  if (!logToFile) {
+    return false;
+  }
 
-  // Handle different log styles
-  const auto& makeLogString = [&](LoggerTimeStyle timeStyle) -> std::string {
-    switch (timeStyle) {
-    case LoggerTimeStyle::Delta: {
-      auto const& elapsed = logTime - _startTime;
-      auto const& elapsedSecs = std::chrono::duration_cast<std::chrono::duration<double>>(elapsed);
-      return fmt::format("{:.3f}:{:4}: {}", elapsedSecs.count(), Logger::categoryCode(category), msg.c_str());
-    }
-    case LoggerTimeStyle::Absolute: {
-      return fmt::format("{}.{:.3f}:{:4}: {}", absTime.timeString, absTime.msFraction,
-                         Logger::categoryCode(category), msg.c_str());
-    }
-    case LoggerTimeStyle::None:
-    default: {
-      return fmt::format("{:4}: {}", Logger::categoryCode(category), msg.c_str());
-    }
-    }
-  };
+  _lineBuffer.clear();
+  appendLogLine(_lineBuffer, _config.fileTimeStyle, logTime, category, msg);
+  _fileBuffer.append(_lineBuffer.data(), _lineBuffer.size());
+  _fileBuffer += system::ThisSystemTraits::newline();
+  return _fileBuffer.size() >= _config.fileBufferSize || (category & _config.fileFlushCategoryMask) == category;
+}
 
-  const auto& consoleStr = logToConsole ? makeLogString(_config.consoleTimeStyle) : std::string{};
-  const auto& fileStr = logToFile ? makeLogString(_config.fileTimeStyle) : std::string{};
+////////////////////////////////////////////////////////////////////////////////
+inline void ConsoleFileLogHandler::appendLogLine(fmt::memory_buffer& out, LoggerTimeStyle timeStyle,
+                                                 SystemTimepoint logTime, Logger::Category category,
+                                                 const StringWrapper& msg) {
+  const fmt::string_view msgView(msg.data(), msg.size());
+  switch (timeStyle) {
+  case LoggerTimeStyle::Delta: {
+    auto const& elapsed = logTime - _startTime;
+    auto const& elapsedSecs = std::chrono::duration_cast<std::chrono::duration<double>>(elapsed);
+    fmt::format_to(std::back_inserter(out), "{:.3f}:{:4}: {}", elapsedSecs.count(), Logger::categoryCode(category),
+                   msgView);
+    break;
+  }
+  case LoggerTimeStyle::Absolute: {
+    // The date/time text only changes once a second, so it's cached
+    auto const logTimet = SystemClock::to_time_t(logTime);
+    if (_absTime.timeString.empty() || logTimet != _absTimet) {
+      _absTime = log_detail::getAbsTime(logTime);
+      _absTimet = logTimet;
+    }
+    auto const msDelta = std::chrono::duration_cast<std::chrono::milliseconds>(logTime - SystemClock::from_time_t(logTimet));
+    auto const msFraction = double(msDelta.count()) / 1000.0;
+    fmt::format_to(std::back_inserter(out), "{}.{:.3f}:{:4}: {}", _absTime.timeString, msFraction,
+                   Logger::categoryCode(category), msgView);
+    break;
+  }
+  case LoggerTimeStyle::None:
+  default: {
+    fmt::format_to(std::back_inserter(out), "{:4}: {}", Logger::categoryCode(category), msgView);
+    break;
+  }
+  }
+}
 
-  // Locking just around the actual output means messages can print out-of-order
-  MutexLock lock(_lock);
-  if (logToConsole) {
+////////////////////////////////////////////////////////////////////////////////
+inline void ConsoleFileLogHandler::finishLocked(bool flushFileNow) {
+  if (_consolePending) {
     auto& dest = (_config.console_destination == ConsoleDestination::Stderr) ? std::cerr : std::cout;
-    dest << consoleStr << std::endl;
+    dest.flush();
+    _consolePending = false;
   }
-  if (logToFile) {
-    _fout << fileStr << system::ThisSystemTraits::newline() << std::flush;
+
+  if (flushFileNow || (!_fileBuffer.empty() && SteadyClock::now() - _lastFileFlush >= _config.fileFlushInterval)) {
+    flushFile();
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+inline void ConsoleFileLogHandler::flushFile() {
+  _lastFileFlush = SteadyClock::now();
+  if (_fileBuffer.empty())
+    return;
+
+  _fout.write(_fileBuffer.data(), static_cast<std::streamsize>(_fileBuffer.size()));
+  _fout.flush();
+  _fileBuffer.clear();
+}
+
 SW_NAMESPACE_END
@@ -30,9 +30,13 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
+#include <iterator>
 #include <list>
 #include <memory>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 SW_NAMESPACE_BEGIN
 
@@ -50,13 +54,466 @@ template <class Key, class T, class Hash = std::hash<Key>, class KeyEqual = std:
 using SysHashMap = std::unordered_map<Key, T, Hash, KeyEqual, Allocator>;
 #endif
 
+////////////////////////////////////////////////////////////////////////////////
+/// A snapshot of cache statistics. See LruCache's `kStats` parameter.
+struct LruCacheStats {
+  u64 hits = 0;         // Lookups that found the item
+  u64 misses = 0;       // Lookups that didn't (including operator[] creating the item)
+  u64 inserts = 0;      // New items added
+  u64 evictions = 0;    // Items purged to meet the bounds. Not explicit erases
+  u64 evictedCost = 0;  // Total cost of the evicted items. Same as evictions if unweighted
+  u64 rejections = 0;   // Puts not cached by the admission policy or for being over budget
+
+  /// @return hits / lookups, or 0 with no lookups
+  double hitRatio() const noexcept {
+    const auto lookups = hits + misses;
+    return lookups == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+  }
+
+  LruCacheStats& operator+=(const LruCacheStats& that) noexcept {
+    hits += that.hits;
+    misses += that.misses;
+    inserts += that.inserts;
+    evictions += that.evictions;
+    evictedCost += that.evictedCost;
+    rejections += that.rejections;
+    return *this;
+  }
+};
+
 namespace lru_detail {
 
 template <typename Cache, typename MemberIter, typename NonConstMemberIter, typename ConstMemberIter>
 class LruIterator;
 
+////////////////////////////////////////////////////////////////////////////////
+/// Statistics counters. The disabled version is empty and every call is a no-op.
+template <bool kStats>
+class LruStatsCounters {
+public:
+  void countHit() const noexcept {}
+  void countMiss() const noexcept {}
+  void countInsert() noexcept {}
+  void countEviction(sizex) noexcept {}
+  void countRejection() noexcept {}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Relaxed atomic counters. They're atomic because shared-locked readers (eg. a deferred
+/// promotion shard) count hits concurrently, but they never order anything.
+template <>
+class LruStatsCounters<true> {
+public:
+  LruStatsCounters() = default;
+  LruStatsCounters(const LruStatsCounters& that) noexcept { assign(that.snapshot()); }
+  LruStatsCounters& operator=(const LruStatsCounters& that) noexcept {
+    assign(that.snapshot());
+    return *this;
+  }
+
+  void countHit() const noexcept { hits_.fetch_add(1, std::memory_order_relaxed); }
+  void countMiss() const noexcept { misses_.fetch_add(1, std::memory_order_relaxed); }
+  void countInsert() noexcept { inserts_.fetch_add(1, std::memory_order_relaxed); }
+  void countEviction(sizex costValue) noexcept {
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+    evictedCost_.fetch_add(costValue, std::memory_order_relaxed);
+  }
+  void countRejection() noexcept { rejections_.fetch_add(1, std::memory_order_relaxed); }
+
+  LruCacheStats snapshot() const noexcept {
+    LruCacheStats result;
+    result.hits = hits_.load(std::memory_order_relaxed);
+    result.misses = misses_.load(std::memory_order_relaxed);
+    result.inserts = inserts_.load(std::memory_order_relaxed);
+    result.evictions = evictions_.load(std::memory_order_relaxed);
+    result.evictedCost = evictedCost_.load(std::memory_order_relaxed);
+    result.rejections = rejections_.load(std::memory_order_relaxed);
+    return result;
+  }
+
+  void assign(const LruCacheStats& stats) noexcept {
+    hits_.store(stats.hits, std::memory_order_relaxed);
+    misses_.store(stats.misses, std::memory_order_relaxed);
+    inserts_.store(stats.inserts, std::memory_order_relaxed);
+    evictions_.store(stats.evictions, std::memory_order_relaxed);
+    evictedCost_.store(stats.evictedCost, std::memory_order_relaxed);
+    rejections_.store(stats.rejections, std::memory_order_relaxed);
+  }
+
+private:
+  mutable std::atomic<u64> hits_{0};
+  mutable std::atomic<u64> misses_{0};
+  std::atomic<u64> inserts_{0};
+  std::atomic<u64> evictions_{0};
+  std::atomic<u64> evictedCost_{0};
+  std::atomic<u64> rejections_{0};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Per-entry cost storage. Only weighted caches pay for it.
+template <bool kWeighted>
+struct LruEntryCost {
+  static constexpr sizex cost() noexcept { return 1; }
+  void setCost(sizex) noexcept {}
+};
+
+template <>
+struct LruEntryCost<true> {
+  sizex cost() const noexcept { return cost_; }
+  void setCost(sizex costValue) noexcept { cost_ = costValue; }
+
+  sizex cost_ = 1;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Per-entry segment flag. Only segmented policies pay for it. Unsegmented caches treat
+/// everything as a single (protected) segment.
+template <bool kSegmented>
+struct LruEntrySegment {
+  static constexpr bool isProtected() noexcept { return true; }
+  void setProtected(bool) noexcept {}
+};
+
+template <>
+struct LruEntrySegment<true> {
+  bool isProtected() const noexcept { return isProtected_; }
+  void setProtected(bool value) noexcept { isProtected_ = value; }
+
+  bool isProtected_ = false;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// The list element. Named like std::pair so it reads the same as before. The metadata
+/// is in (often empty) bases so it costs nothing when unused.
+template <typename Key, typename T, bool kWeighted, bool kSegmented>
+struct LruEntry : LruEntryCost<kWeighted>, LruEntrySegment<kSegmented> {
+  template <typename K, typename V>
+  LruEntry(K&& key, V&& value) : first(std::forward<K>(key)), second(std::forward<V>(value)) {}
+
+  Key first;
+  T second;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Total cost tracking for weighted caches. The unweighted version is never over budget,
+/// so the checks optimize away.
+template <bool kWeighted>
+class LruCostBudget {
+public:
+  explicit LruCostBudget(sizex) noexcept {}
+  static constexpr sizex totalCost() noexcept { return 0; }
+  static constexpr sizex maxCost() noexcept { return ~sizex(0); }
+  static constexpr bool isOverBudget() noexcept { return false; }
+  void setMaxCost(sizex) noexcept {}
+  void addCost(sizex) noexcept {}
+  void removeCost(sizex) noexcept {}
+  void resetCost() noexcept {}
+};
+
+template <>
+class LruCostBudget<true> {
+public:
+  explicit LruCostBudget(sizex maxCostValue) noexcept : maxCost_(maxCostValue) {}
+  LruCostBudget(const LruCostBudget&) = default;
+  LruCostBudget& operator=(const LruCostBudget&) = default;
+
+  // The moved-from cache is empty, so the moved-from total must be too
+  LruCostBudget(LruCostBudget&& that) noexcept :
+      totalCost_(std::exchange(that.totalCost_, 0)), maxCost_(that.maxCost_) {}
+  LruCostBudget& operator=(LruCostBudget&& that) noexcept {
+    totalCost_ = std::exchange(that.totalCost_, 0);
+    maxCost_ = that.maxCost_;
+    return *this;
+  }
+
+  sizex totalCost() const noexcept { return totalCost_; }
+  sizex maxCost() const noexcept { return maxCost_; }
+  bool isOverBudget() const noexcept { return totalCost_ > maxCost_; }
+  void setMaxCost(sizex maxCostValue) noexcept { maxCost_ = maxCostValue; }
+  void addCost(sizex costValue) noexcept { totalCost_ += costValue; }
+  void removeCost(sizex costValue) noexcept {
+    SW_ASSERT(costValue <= totalCost_);
+    totalCost_ -= costValue;
+  }
+  void resetCost() noexcept { totalCost_ = 0; }
+
+private:
+  sizex totalCost_ = 0;
+  sizex maxCost_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// List management for the eviction policy. The plain version is the classic LRU: new
+/// and used items go to the front, the back is the oldest.
+template <typename ListType, bool kSegmented, u32 kProtectedPercent>
+class LruSegments {
+  using ListIter = typename ListType::iterator;
+
+public:
+  static ListIter insertPosition(ListType& list) noexcept { return list.begin(); }
+  void onInserted(const ListIter&) noexcept {}
+  void onErase(const ListIter&) noexcept {}
+  void onClear() noexcept {}
+  void onCopied(ListType&) noexcept {}
+  void promote(ListType& list, const ListIter& iter, sizex) noexcept { list.splice(list.begin(), list, iter); }
+  void rebalance(ListType&, sizex) noexcept {}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Segmented LRU. The list is split into a protected segment at the front and a probation
+/// segment at the back:
+///   [protected MRU ... protected LRU][probation MRU ... probation LRU]
+/// New items go to the head of probation, and only a hit moves an item to protected. So a
+/// one-off scan churns through probation without touching items that have been used more
+/// than once. Protected is kept to `kProtectedPercent` of the capacity by demoting its oldest
+/// items to the head of probation. Eviction still just takes the back of the list.
+template <typename ListType, u32 kProtectedPercent>
+class LruSegments<ListType, true, kProtectedPercent> {
+  static_assert(kProtectedPercent > 0 && kProtectedPercent < 100, "Protected percent must be in (0, 100)");
+  using ListIter = typename ListType::iterator;
+
+public:
+  LruSegments() = default;
+  LruSegments(const LruSegments&) = delete;
+  LruSegments& operator=(const LruSegments&) = delete;
+
+  // Note that list iterators stay valid across a list move
+  LruSegments(LruSegments&& that) noexcept :
+      probationHead_(that.probationHead_), probationCount_(std::exchange(that.probationCount_, 0)) {}
+  LruSegments& operator=(LruSegments&& that) noexcept {
+    probationHead_ = that.probationHead_;
+    probationCount_ = std::exchange(that.probationCount_, 0);
+    return *this;
+  }
+
+  ListIter insertPosition(ListType& list) noexcept { return probationCount_ ? probationHead_ : list.end(); }
+
+  void onInserted(const ListIter& iter) noexcept {
+    iter->setProtected(false);
+    probationHead_ = iter;
+    ++probationCount_;
+  }
+
+  /// Must be called before the item is removed from the list
+  void onErase(const ListIter& iter) noexcept {
+    if (!iter->isProtected()) {
+      leaveProbation(iter);
+    }
+  }
+
+  void onClear() noexcept { probationCount_ = 0; }
+
+  /// Rebuild the segment state for a list that was copied with its flags
+  void onCopied(ListType& list) noexcept {
+    probationCount_ = 0;
+    for (auto iter = list.begin(); iter != list.end(); ++iter) {
+      if (!iter->isProtected() && probationCount_++ == 0) {
+        probationHead_ = iter;
+      }
+    }
+  }
+
+  void promote(ListType& list, const ListIter& iter, sizex capacity) noexcept {
+    if (!iter->isProtected()) {
+      leaveProbation(iter);
+      iter->setProtected(true);
+    }
+    list.splice(list.begin(), list, iter);
+    rebalance(list, capacity);
+  }
+
+  /// Demote the oldest protected items until protected is within its share of the capacity
+  void rebalance(ListType& list, sizex capacity) noexcept {
+    const auto size = list.size();
+    const auto limit = std::max(capacity / 100 * kProtectedPercent + capacity % 100 * kProtectedPercent / 100, 1_z);
+    while (size - probationCount_ > limit) {
+      auto last = std::prev(probationCount_ ? probationHead_ : list.end());
+      last->setProtected(false);
+      probationHead_ = last;
+      ++probationCount_;
+    }
+  }
+
+private:
+  void leaveProbation(const ListIter& iter) noexcept {
+    SW_ASSERT(probationCount_ > 0);
+    if (iter == probationHead_) {
+      ++probationHead_;
+    }
+    --probationCount_;
+  }
+
+private:
+  /// Only valid when the probation count is non-zero
+  ListIter probationHead_;
+  sizex probationCount_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// A count-min sketch of 4-bit counters, for estimating how often keys were seen. Each
+/// 64-bit word holds 16 counters and each key maps to 4 counters. All counters are halved
+/// once the number of increments reaches 10x the table width, so the estimates favor
+/// recent history. This is the TinyLFU sketch.
+class LruFrequencySketch {
+public:
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Grow the table to suit the given number of entries. Growing resets the counts.
+  void ensureCapacity(sizex entries) {
+    if (entries <= table_.size())
+      return;
+
+    sizex words = 16;
+    while (words < entries) {
+      words *= 2;
+    }
+    table_.assign(words, 0);
+    mask_ = words - 1;
+    sampleSize_ = 10 * words;
+    additions_ = 0;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// @return the estimated frequency (0 to 15) of the given hash
+  u32 frequency(u64 hash) const noexcept {
+    if (table_.empty())
+      return 0;
+
+    u32 result = 15;
+    for (u32 i = 0; i < 4; ++i) {
+      const auto h = rehash(hash, i);
+      result = std::min(result, static_cast<u32>((table_[h & mask_] >> counterShift(h)) & 15));
+    }
+    return result;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Count an occurrence of the given hash
+  void increment(u64 hash) noexcept {
+    if (table_.empty())
+      return;
+
+    bool isAdded = false;
+    for (u32 i = 0; i < 4; ++i) {
+      const auto h = rehash(hash, i);
+      auto& word = table_[h & mask_];
+      const auto shift = counterShift(h);
+      if (((word >> shift) & 15) < 15) {
+        word += u64(1) << shift;
+        isAdded = true;
+      }
+    }
+
+    if (isAdded && ++additions_ >= sampleSize_) {
+      reset();
+    }
+  }
+
+private:
+  static u64 rehash(u64 hash, u32 index) noexcept {
+    static const u64 kSeeds[] = {0xc3a5c85c97cb3127_u64, 0xb492b66fbe98f273_u64, 0x9ae16a3b2f90404f_u64,
+                                 0xcbf29ce484222325_u64};
+    auto h = (hash + kSeeds[index]) * kSeeds[index];
+    return h ^ (h >> 32);
+  }
+
+  /// The high bits pick the counter within the word, the low bits pick the word
+  static u32 counterShift(u64 h) noexcept { return static_cast<u32>(h >> 60) * 4; }
+
+  /// Halve every counter. The mask drops the bit shifted in from the neighboring counter
+  void reset() noexcept {
+    for (auto& word : table_) {
+      word = (word >> 1) & 0x7777777777777777_u64;
+    }
+    additions_ /= 2;
+  }
+
+private:
+  std::vector<u64> table_;
+  sizex mask_ = 0;
+  sizex sampleSize_ = 0;
+  sizex additions_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Admission filter. The default admits everything and never hashes anything.
+template <typename Hasher, bool kAdmission>
+class LruAdmission {
+public:
+  template <typename Key>
+  void recordAccess(const Key&) noexcept {}
+
+  template <typename Key>
+  static constexpr bool admit(const Key&, const Key&) noexcept {
+    return true;
+  }
+
+  void onSizeChanged(sizex) noexcept {}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// TinyLFU admission. A newcomer that would cause an eviction is only admitted if it has
+/// been seen at least as often as the item it would evict.
+template <typename Hasher>
+class LruAdmission<Hasher, true> {
+public:
+  template <typename Key>
+  void recordAccess(const Key& key) {
+    sketch_.increment(static_cast<u64>(Hasher{}(key)));
+  }
+
+  template <typename Key>
+  bool admit(const Key& candidate, const Key& victim) const {
+    return sketch_.frequency(static_cast<u64>(Hasher{}(candidate))) >=
+           sketch_.frequency(static_cast<u64>(Hasher{}(victim)));
+  }
+
+  void onSizeChanged(sizex size) { sketch_.ensureCapacity(size); }
+
+private:
+  LruFrequencySketch sketch_;
+};
+
 }  // namespace lru_detail
 
+////////////////////////////////////////////////////////////////////////////////
+/// The default eviction policy. Plain LRU.
+struct LruPolicy {
+  static constexpr bool kSegmented = false;
+  static constexpr u32 kProtectedPercent = 0;
+  static constexpr bool kAdmission = false;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Segmented LRU eviction. Items must be hit once after insertion to get into the protected
+/// segment, which is `kProtected` percent of the entries.
+template <u32 kProtected = 80>
+struct SlruPolicy {
+  static constexpr bool kSegmented = true;
+  static constexpr u32 kProtectedPercent = kProtected;
+  static constexpr bool kAdmission = false;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// TinyLFU admission on top of the given eviction policy. Newcomers with a lower estimated
+/// frequency than the eviction victim are rejected, ie. `put()` won't cache them.
+/// Items created by `operator[]` are always admitted since a reference is returned.
+template <typename EvictionPolicy = SlruPolicy<>>
+struct TinyLfuPolicy {
+  static constexpr bool kSegmented = EvictionPolicy::kSegmented;
+  static constexpr u32 kProtectedPercent = EvictionPolicy::kProtectedPercent;
+  static constexpr bool kAdmission = true;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// The default cost functor. Every entry costs 1, so the cache is bounded by entry
+/// count only and no cost is tracked.
+struct LruUnitCost {
+  template <typename Key, typename T>
+  constexpr sizex operator()(const Key&, const T&) const noexcept {
+    return 1;
+  }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 /// # Overview
 /// This will implement an LRU-cache.
@@ -71,6 +528,29 @@ class LruIterator;
 /// approach was chosen rather than a constructor argument simply for performance. ie. the
 /// optimizer should remove any checks to auto-purge when it's is disabled.
 ///
+/// # Cost
+/// By default the cache is bounded by entry count (`maxSize()`). Give a `Cost` functor,
+/// called as `sizex(const Key&, const T&)`, to also bound it by total cost (`maxCost()`),
+/// eg. the bytes held by each value. The cost is taken when an item is inserted or `put()`,
+/// or can be given directly with `put(key, value, cost)`. Changing a value in place through
+/// `operator[]` or an iterator doesn't re-cost it, so use `put()` for values that change
+/// size. Purging evicts from the tail until both bounds are met, except that the most
+/// recent item is never evicted just for cost. A `put()` of a single item costing more than
+/// `maxCost()` isn't cached at all when auto-purging.
+///
+/// # Policy
+/// The eviction/admission policy is also a template parameter. `LruPolicy` is the plain LRU
+/// described above. `SlruPolicy` segments the list so one-off scans can't flush items
+/// that are used repeatedly. `TinyLfuPolicy` adds a frequency sketch that rejects newcomers
+/// seen less often than the item they'd evict. Lookups through `peek()` and `contains()`
+/// don't count as accesses for any of them.
+///
+/// # Statistics
+/// Set `kStats` to count hits, misses, inserts, evictions (and their cost), and rejections,
+/// readable via `stats()`. Lookups are `find()`, `get()`, `operator[]`, and `peek()`. When
+/// `kStats` is `false`, which is the default, the counters are an empty base and all the
+/// counting compiles away.
+///
 /// # Insertion
 /// * Use `operator[]` with similar semantics to std::unordered_map:
 ///     cache[1] = "foo";
@@ -115,11 +595,24 @@ class LruIterator;
 ///
 /// SCW: Basically just writing this for fun... haven't done one before.
 ////////////////////////////////////////////////////////////////////////////////
-template <typename Key, typename T, bool kAutoPurge = true>
-class LruCache {
-  using ThisType = LruCache<Key, T, kAutoPurge>;
-  using KeyValuePair = std::pair<Key, T>;
-  using ListType = std::list<KeyValuePair>;
+template <typename Key, typename T, bool kAutoPurge = true, typename Cost = LruUnitCost, typename Policy = LruPolicy,
+          bool kStats = false>
+class LruCache :
+    private lru_detail::LruCostBudget<!std::is_same<Cost, LruUnitCost>::value>,
+    private lru_detail::LruSegments<std::list<lru_detail::LruEntry<Key, T, !std::is_same<Cost, LruUnitCost>::value,
+                                                                   Policy::kSegmented>>,
+                                    Policy::kSegmented, Policy::kProtectedPercent>,
+    private lru_detail::LruAdmission<typename SysHashMap<Key, int>::hasher, Policy::kAdmission>,
+    private lru_detail::LruStatsCounters<kStats> {
+  static constexpr bool kWeighted = !std::is_same<Cost, LruUnitCost>::value;
+
+  using ThisType = LruCache<Key, T, kAutoPurge, Cost, Policy, kStats>;
+  using Stats = lru_detail::LruStatsCounters<kStats>;
+  using CostBudget = lru_detail::LruCostBudget<kWeighted>;
+  using Entry = lru_detail::LruEntry<Key, T, kWeighted, Policy::kSegmented>;
+  using ListType = std::list<Entry>;
+  using Segments = lru_detail::LruSegments<ListType, Policy::kSegmented, Policy::kProtectedPercent>;
+  using Admission = lru_detail::LruAdmission<typename SysHashMap<Key, int>::hasher, Policy::kAdmission>;
   using ListIter = typename ListType::iterator;
   using MapType = SysHashMap<Key, ListIter>;
   using ConstListIter = typename ListType::const_iterator;
@@ -137,22 +630,37 @@ public:
   using ConstIterator = ConstUnorderedIterator;
   using KeyType = Key;
   using ValueType = T;
+  using HasherType = typename MapType::hasher;
+  using CostType = Cost;
+  using PolicyType = Policy;
+
+  /// Use for the max-cost when only the entry count should bound the cache
+  static constexpr sizex kUnlimitedCost = ~sizex(0);
 
   ////////////////////////////////////////////////////////////////////////////////
-  /// Creates the cache and sets the maximum size before items get purged.
-  explicit LruCache(sizex maxSizeValue = 10) : maxSize_(std::max(maxSizeValue, 1_z)) {}
+  /// Creates the cache and sets the maximum size before items get purged. The max-cost
+  /// only applies when there is a `Cost` functor.
+  explicit LruCache(sizex maxSizeValue = 10, sizex maxCostValue = kUnlimitedCost) :
+      CostBudget(maxCostValue), maxSize_(std::max(maxSizeValue, 1_z)) {
+    SW_ASSERT(kWeighted || maxCostValue == kUnlimitedCost);
+  }
 
   // Cached values will be destructed normally
   ~LruCache() = default;
 
   // Create a copy of the given cache
-  LruCache(const LruCache& that) : maxSize_(that.maxSize_) { doEmptyCopyFrom(that); }
+  LruCache(const LruCache& that) :
+      CostBudget(that.maxCost()), Segments(), Admission(), Stats(that), maxSize_(that.maxSize_) {
+    doEmptyCopyFrom(that);
+  }
 
   // Copies the given cache to this cache. All prior entires in this cache are discarded
   LruCache& operator=(const LruCache& that) {
     if (this != &that) {
       clear();
       maxSize_ = that.maxSize_;
+      CostBudget::setMaxCost(that.maxCost());
+      Stats::operator=(that);
       doEmptyCopyFrom(that);
     }
     return *this;
@@ -181,10 +689,46 @@ public:
     auto newMaxSize = std::max(maxSizeValue, 1_z);
     bool isSmaller = newMaxSize < maxSize_;
     maxSize_ = newMaxSize;
+    if (isSmaller) {
+      Segments::rebalance(list_, segmentCapacity());
+      doAutoPurge();
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the total cost of the cached items. Always 0 for an unweighted cache.
+  sizex totalCost() const noexcept { return CostBudget::totalCost(); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the maximum total cost allowed in the cache. It's a soft-limit when kAutoPurge
+  /// is `false`, same as `maxSize()`.
+  sizex maxCost() const noexcept { return CostBudget::maxCost(); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Sets the maximum total cost of the cache. Will purge items when `kAutoPurge` is
+  /// true and the maximum cost is reduced.
+  void setMaxCost(sizex maxCostValue) {
+    static_assert(kWeighted, "Only caches with a Cost functor have a max-cost");
+    bool isSmaller = maxCostValue < maxCost();
+    CostBudget::setMaxCost(maxCostValue);
     if (isSmaller)
       doAutoPurge();
   }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return a snapshot of the statistics. Only available when `kStats` is true.
+  LruCacheStats stats() const noexcept {
+    static_assert(kStats, "Statistics are disabled for this cache");
+    return Stats::snapshot();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Zero the statistics
+  void resetStats() noexcept {
+    static_assert(kStats, "Statistics are disabled for this cache");
+    Stats::assign(LruCacheStats{});
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
   /// Is the map empty?
   bool empty() const noexcept { return map_.empty(); }
@@ -203,6 +747,15 @@ public:
     }
   }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Refreshes the cache item at the given iterator, causing it to move to the front.
+  /// Pairs with `peek()` to split a lookup from its recency update.
+  void refresh(const ConstIterator& iter) {
+    if (iter != cend()) {
+      onValueUsed(iter.iter_);
+    }
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
   /// Purge any entries such that the cache will be within it's max-size. Not necessary
   /// when auto-purge is enabled
@@ -213,6 +766,8 @@ public:
   void clear() {
     list_.clear();
     map_.clear();
+    CostBudget::resetCost();
+    Segments::onClear();
   }
 
   ////////////////////////////////////////////////////////////////////////////////
@@ -224,6 +779,8 @@ public:
     }
 
     // Remove the node from the list and the map
+    CostBudget::removeCost(iter->second->cost());
+    Segments::onErase(iter->second);
     list_.erase(iter->second);
     map_.erase(iter);
     return 1;
@@ -237,6 +794,8 @@ public:
 
     auto mapIter = iter.iter_;
     auto listIter = mapIter->second;
+    CostBudget::removeCost(listIter->cost());
+    Segments::onErase(listIter);
     list_.erase(listIter);
     return Iterator(map_.erase(mapIter));
   }
@@ -249,48 +808,40 @@ public:
     if (iter == map_.end()) {
       // No item. We needs to create a default value in that case
       // First insert a default value to the front of the list, then add it to the map
-      list_.emplace_front(key, T{});
-      auto listIter = list_.begin();
+      Stats::countMiss();
+      Admission::recordAccess(key);
+      auto listIter = emplaceEntry(key, T{});
       map_.emplace(key, listIter);
+      Stats::countInsert();
+      onEntryAdded(listIter, Cost{}(key, valueFromIter(listIter)));
       doAutoPurge();
       return valueFromIter(listIter);
     }
 
     // The item already exists - bring it to the front of the list since it's been "used"
+    Stats::countHit();
     onValueUsed(iter);
     return valueFromIter(iter);
   }
 
   ////////////////////////////////////////////////////////////////////////////////
   /// Inserts or updates mapped value associated with the given key
-  void put(const KeyType& key, const T& value) {
-    auto iter = map_.find(key);
-    if (iter == map_.end()) {
-      // New item
-      list_.emplace_front(key, value);
-      map_.emplace(key, list_.begin());
-      doAutoPurge();
-    } else {
-      // Item already exists. Update the mapped value and push it to the front
-      valueFromIter(iter) = value;
-      onValueUsed(iter);
-    }
-  }
+  void put(const KeyType& key, const T& value) { doPut(key, value, Cost{}(key, value)); }
 
   ////////////////////////////////////////////////////////////////////////////////
   /// Inserts or updates mapped value associated with the given key
   void put(const KeyType& key, T&& value) {
-    auto iter = map_.find(key);
-    if (iter == map_.end()) {
-      // New item
-      list_.emplace_front(key, std::move(value));
-      map_.emplace(key, list_.begin());
-      doAutoPurge();
-    } else {
-      // Item already exists. Update the mapped value and push it to the front
-      valueFromIter(iter) = std::move(value);
-      onValueUsed(iter);
-    }
+    const auto costValue = Cost{}(key, value);
+    doPut(key, std::move(value), costValue);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Inserts or updates mapped value associated with the given key, using the given cost
+  /// rather than the `Cost` functor.
+  template <typename Value>
+  void put(const KeyType& key, Value&& value, sizex costValue) {
+    static_assert(kWeighted, "Only caches with a Cost functor take a cost");
+    doPut(key, std::forward<Value>(value), costValue);
   }
 
   ////////////////////////////////////////////////////////////////////////////////
@@ -299,9 +850,12 @@ public:
   bool get(const KeyType& key, T& value) {
     MapIter iter = map_.find(key);
     if (iter == map_.end()) {
+      Stats::countMiss();
+      Admission::recordAccess(key);
       return false;
     }
 
+    Stats::countHit();
     onValueUsed(iter);
     value = valueFromIter(iter);
     return true;
@@ -314,7 +868,11 @@ public:
   Iterator find(const KeyType& key) {
     MapIter iter = map_.find(key);
     if (iter != map_.end()) {
+      Stats::countHit();
       onValueUsed(iter);
+    } else {
+      Stats::countMiss();
+      Admission::recordAccess(key);
     }
 
     return Iterator(iter);
@@ -328,6 +886,20 @@ public:
   /// value. Thus to get one with a const iterator there is `cfind`
   ConstIterator cfind(const KeyType& key) { return find(key); }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Find the cache element with the specified key *without* refreshing it, so this is
+  /// a read-only lookup. It will be `cend()` if the item isn't cached. Use
+  /// `refresh(iter)` if the recency update is wanted later.
+  ConstIterator peek(const KeyType& key) const {
+    auto iter = map_.find(key);
+    if (iter != map_.end()) {
+      Stats::countHit();
+    } else {
+      Stats::countMiss();
+    }
+    return ConstIterator(iter);
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
   Iterator begin() noexcept { return Iterator(map_.begin()); }
   Iterator end() noexcept { return Iterator(map_.end()); }
@@ -354,15 +926,95 @@ private:
 
   ////////////////////////////////////////////////////////////////////////////////
   /// Call this when a cached value is used, thus pushing it to the front of the list.
-  void onValueUsed(const ConstMapIter& iter) { list_.splice(list_.begin(), list_, iter->second); }
+  void onValueUsed(const ConstMapIter& iter) {
+    Admission::recordAccess(iter->first);
+    Segments::promote(list_, iter->second, segmentCapacity());
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// The entry count used for sizing segments. Weighted caches have no real bound on the
+  /// entry count, so their segments are sized from the current entries.
+  sizex segmentCapacity() const noexcept { return kWeighted ? size() : maxSize_; }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Create a new list entry wherever the policy puts new items. Not yet in the map.
+  template <typename Value>
+  ListIter emplaceEntry(const KeyType& key, Value&& value) {
+    auto listIter = list_.emplace(Segments::insertPosition(list_), key, std::forward<Value>(value));
+    Segments::onInserted(listIter);
+    Admission::onSizeChanged(list_.size());
+    return listIter;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Would adding an item of the given cost push the cache over its bounds?
+  bool isFullFor(sizex costValue) const noexcept {
+    return size() + 1 > maxSize_ || (kWeighted && CostBudget::totalCost() + costValue > maxCost());
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Account for a newly linked entry
+  void onEntryAdded(const ListIter& listIter, sizex costValue) {
+    listIter->setCost(costValue);
+    CostBudget::addCost(listIter->cost());
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  template <typename Value>
+  void doPut(const KeyType& key, Value&& value, sizex costValue) {
+    auto iter = map_.find(key);
+
+    // Something bigger than the whole budget can never fit. Drop any stale value too
+    if (kWeighted && kAutoPurge && costValue > maxCost()) {
+      if (iter != map_.end()) {
+        erase(key);
+      }
+      Stats::countRejection();
+      return;
+    }
+
+    if (iter == map_.end()) {
+      // New item. The admission policy may turn it away rather than evict for it
+      Admission::recordAccess(key);
+      if (Policy::kAdmission && kAutoPurge && !empty() && isFullFor(costValue) &&
+          !Admission::admit(key, keyFromIter(ConstListIter(std::prev(list_.end()))))) {
+        Stats::countRejection();
+        return;
+      }
+
+      auto listIter = emplaceEntry(key, std::forward<Value>(value));
+      map_.emplace(key, listIter);
+      Stats::countInsert();
+      onEntryAdded(listIter, costValue);
+      doAutoPurge();
+    } else {
+      // Item already exists. Update the mapped value and push it to the front
+      auto listIter = iter->second;
+      valueFromIter(listIter) = std::forward<Value>(value);
+      CostBudget::removeCost(listIter->cost());
+      onEntryAdded(listIter, costValue);
+      onValueUsed(iter);
+      if (kWeighted) {
+        doAutoPurge();
+      }
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Is the cache over its size or cost bounds? The most recent item is never purged for
+  /// cost alone.
+  bool isOverBounds() const noexcept { return size() > maxSize_ || (CostBudget::isOverBudget() && size() > 1); }
 
   ////////////////////////////////////////////////////////////////////////////////
   void doPurge() {
     // Delete the last (aka oldest) item till our size is ok
-    while (size() > maxSize_) {
+    while (isOverBounds()) {
       auto listIter = --list_.end();
       auto mapIter = map_.find(LruCache::keyFromIter(listIter));
       SW_ASSERT(mapIter != map_.end());
+      CostBudget::removeCost(listIter->cost());
+      Stats::countEviction(listIter->cost());
+      Segments::onErase(listIter);
       map_.erase(mapIter);
       list_.erase(listIter);
     }
@@ -384,14 +1036,15 @@ private:
     if (cache.empty())
       return;
 
-    auto iter = cache.cendOrdered();
+    auto iter = cache.list_.cend();
     do {
       --iter;
-      const auto& key = iter.key();
-      const auto& value = iter.value();
-      list_.emplace_front(key, value);
-      map_.emplace(key, list_.begin());
-    } while (iter != cache.cbeginOrdered());
+      list_.emplace_front(*iter);
+      map_.emplace(iter->first, list_.begin());
+      CostBudget::addCost(iter->cost());
+    } while (iter != cache.list_.cbegin());
+    Segments::onCopied(list_);
+    Admission::onSizeChanged(list_.size());
   }
 
 private:
@@ -412,6 +1065,9 @@ private:
   friend ConstOrderedIterator;
 };
 
+template <typename Key, typename T, bool kAutoPurge, typename Cost, typename Policy, bool kStats>
+constexpr sizex LruCache<Key, T, kAutoPurge, Cost, Policy, kStats>::kUnlimitedCost;
+
 namespace lru_detail {
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -433,6 +1089,10 @@ public:
   using Key = typename CacheType::KeyType;
   using Value = typename CacheType::ValueType;
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Default constructed iterators are singular, only good for assigning over
+  LruIterator() noexcept = default;
+
   ////////////////////////////////////////////////////////////////////////////////
   /// Allow direct conversion from non-const to const iterator
   template <typename T = MemberIter>
@@ -23,6 +23,7 @@
 #include "types.h"
 
 #include <cstring>
+#include <memory>
 #include <new>
 #include <type_traits>
 
@@ -55,6 +56,28 @@ struct IsMemCopyable :
 
 using namespace ::sw::detail;
 
+////////////////////////////////////////////////////////////////////////////////
+/// Types that can be moved to a new address with a plain memcpy, leaving the old bytes
+/// behind without destroying them. That's every trivially copyable type, plus any type
+/// that opts in, which is most that don't point into themselves. Containers can then
+/// relocate them with realloc/memcpy instead of a move and destroy per item.
+///
+/// Opt in with `SW_DECLARE_TRIVIALLY_RELOCATABLE(MyType)`, or by specializing.
+template <typename T>
+struct IsTriviallyRelocatable : std::is_trivially_copyable<T> {};
+
+template <typename T>
+struct IsTriviallyRelocatable<std::unique_ptr<T>> : std::true_type {};
+template <typename T>
+struct IsTriviallyRelocatable<std::shared_ptr<T>> : std::true_type {};
+template <typename T>
+struct IsTriviallyRelocatable<std::weak_ptr<T>> : std::true_type {};
+
+/// Use at namespace scope within (or enclosing) the sw namespace
+#define SW_DECLARE_TRIVIALLY_RELOCATABLE(T) \
+  template <>                                \
+  struct IsTriviallyRelocatable<T> : std::true_type {}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// This class contains move/copy/construct/destruction functions that are useful for
 /// a container class like vector. For the purpose of performance, most of the functions here have
@@ -185,7 +208,7 @@ public:
   /// Move (or copy) 'count' non-trivial items from 'source' to 'dest'
   template <typename U = T,
             typename std::enable_if_t<!IsMemCopyable<U>::value, NotMemCopyable> = NotMemCopyable::Unused>
-  inline static void moveConstructItems(T* dest, const T* source, sizex count) {
+  inline static void moveConstructItems(T* dest, T* source, sizex count) {
     for (sizex i = 0; i < count; ++i) {
       new (&dest[i]) T(std::move(source[i]));  // Move-ctor
     }
@@ -194,7 +217,7 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
   template <typename U = T,
             typename std::enable_if_t<IsMemCopyable<U>::value, MemCopyable> = MemCopyable::Unused>
-  inline static void moveConstructItems(T* dest, const T* source, sizex count) {
+  inline static void moveConstructItems(T* dest, T* source, sizex count) {
     /// These types of items can safely use memcpy for moving
     std::memcpy(dest, source, count * sizeof(T));
   }
@@ -203,8 +226,8 @@ public:
   /// Move (or copy) 'count' non-trivial items from 'source' to 'dest', and delete
   /// each item from 'source'
   template <typename U = T,
-            typename std::enable_if_t<!IsMemCopyable<U>::value, NotMemCopyable> = NotMemCopyable::Unused>
-  inline static void moveConstructAndDeleteItems(T* dest, const T* source, sizex count) {
+            typename std::enable_if_t<!IsTriviallyRelocatable<U>::value, NotMemCopyable> = NotMemCopyable::Unused>
+  inline static void moveConstructAndDeleteItems(T* dest, T* source, sizex count) {
     for (sizex i = 0; i < count; ++i) {
       // Move it from source to dest
       new (&dest[i]) T(std::move(source[i]));  // Move-ctor
@@ -215,11 +238,12 @@ public:
   }
 
   ////////////////////////////////////////////////////////////////////////////////
+  /// Trivially relocatable items just get their bytes copied. The source items are
+  /// then dead without running their destructors.
   template <typename U = T,
-            typename std::enable_if_t<IsMemCopyable<U>::value, MemCopyable> = MemCopyable::Unused>
-  inline static void moveConstructAndDeleteItems(T* dest, const T* source, sizex count) {
-    /// These types of items can safely use memcpy for moving
-    std::memcpy(dest, source, count * sizeof(T));
+            typename std::enable_if_t<IsTriviallyRelocatable<U>::value, MemCopyable> = MemCopyable::Unused>
+  inline static void moveConstructAndDeleteItems(T* dest, T* source, sizex count) {
+    std::memcpy(static_cast<void*>(dest), static_cast<const void*>(source), count * sizeof(T));
   }
 };
 
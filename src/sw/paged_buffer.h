@@ -19,25 +19,535 @@
 #pragma once
 
 #include "assert.h"
+#include "reallocator.h"
+#include "threading_utils.h"
 #include "types.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstring>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
 #include <vector>
 
+#if SW_POSIX
+#  include <cerrno>
+#  include <sys/uio.h>
+#endif
+
 SW_NAMESPACE_BEGIN
 
+////////////////////////////////////////////////////////////////////////////////
+/// A contiguous piece of a buffer, laid out like a POSIX `iovec` so that arrays of them
+/// can be handed to scatter/gather I/O.
+struct IoSegment {
+  void* data;
+  sizex size;
+};
+
+#if SW_POSIX
+static_assert(sizeof(IoSegment) == sizeof(iovec) && offsetof(IoSegment, data) == offsetof(iovec, iov_base) &&
+                  offsetof(IoSegment, size) == offsetof(iovec, iov_len),
+              "IoSegment must match iovec");
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// Page allocator that goes straight to the heap. Pages are not initialized.
+template <sizex kPageSize>
+struct HeapPageAllocator {
+  byte* allocatePage() { return new byte[kPageSize]; }
+  void deallocatePage(byte* page) noexcept { delete[] page; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Page allocator taking its pages from a byte reallocator, eg. `ArenaReallocator<byte>`
+/// for buffers that live and die with an arena.
+template <sizex kPageSize, typename Reallocator = MallocReallocator<byte>>
+class ReallocatorPageAllocator : private Reallocator {
+public:
+  explicit ReallocatorPageAllocator(Reallocator reallocator = Reallocator()) : Reallocator(std::move(reallocator)) {}
+
+  byte* allocatePage() { return Reallocator::allocate(kPageSize); }
+  void deallocatePage(byte* page) noexcept { Reallocator::deallocate(page, kPageSize); }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// # Overview
+/// A pool of recycled pages to share between PagedBuffers (or anything else needing
+/// fixed-size pages). Freed pages are kept rather than handed back to the heap, so buffers
+/// that are constantly created and dropped stop hitting malloc.
+///
+/// Each thread has its own small cache of pages so the common allocate/free pairs take no
+/// locks. When a thread cache runs dry it takes a batch from the shared free list, and when
+/// it overfills it gives half back. The shared list is capped at `maxPooledPages`, with any
+/// pages past it returned to the heap (the high-water trim). `trim()` does it on demand.
+///
+/// Create with `std::make_shared` and hand `allocator()` to the buffers. Pages (and
+/// allocators) may outlive the pool, in which case they go back to the heap.
+///
+/// @tparam kPageSize The size of every page in the pool
+////////////////////////////////////////////////////////////////////////////////
+template <sizex kPageSize>
+class PagePool : public std::enable_shared_from_this<PagePool<kPageSize>> {
+  struct Shared;
+
+public:
+  static constexpr sizex kUnlimited = ~0_z;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  struct Config {
+    sizex threadCachePages = 32;       ///> Pages each thread keeps to itself
+    sizex maxPooledPages = kUnlimited;  ///> Shared free pages kept before returning them to the heap
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// The allocator handle for PagedBuffer. Keeps the pool alive.
+  class Allocator {
+  public:
+    explicit Allocator(std::shared_ptr<PagePool> pool) noexcept : _pool(std::move(pool)) {}
+
+    byte* allocatePage() { return _pool->allocatePage(); }
+    void deallocatePage(byte* page) { _pool->deallocatePage(page); }
+
+    PagePool& pool() const noexcept { return *_pool; }
+
+  private:
+    std::shared_ptr<PagePool> _pool;
+  };
+
+  PagePool() : PagePool(Config()) {}
+  explicit PagePool(Config config) : _config(config), _shared(std::make_shared<Shared>(config.maxPooledPages)) {}
+
+  PagePool(const PagePool&) = delete;
+  PagePool& operator=(const PagePool&) = delete;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Must be owned by a shared_ptr
+  Allocator allocator() { return Allocator(this->shared_from_this()); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Get a page. Not initialized.
+  byte* allocatePage() {
+    auto& cache = threadCache();
+    if (cache.pages.empty()) {
+      _shared->take(cache.pages, std::max(_config.threadCachePages / 2, 1_z));
+      if (cache.pages.empty()) {
+        return new byte[kPageSize];
+      }
+    }
+
+    auto page = cache.pages.back();
+    cache.pages.pop_back();
+    return page;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Give back a page from `allocatePage()`. Any thread may free any page.
+  void deallocatePage(byte* page) {
+    auto& cache = threadCache();
+    cache.pages.push_back(page);
+    if (cache.pages.size() > _config.threadCachePages) {
+      _shared->give(cache.pages, cache.pages.size() / 2);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return shared free pages to the heap until there are at most `keepPages`. Thread
+  /// caches aren't touched.
+  void trim(sizex keepPages = 0) { _shared->trim(keepPages); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the number of free pages in the shared list. Thread caches aren't included.
+  sizex pooledPageCount() const { return _shared->size(); }
+
+  const Config& config() const noexcept { return _config; }
+
+private:
+  ////////////////////////////////////////////////////////////////////////////////
+  /// The shared free list. Thread caches refer to it weakly, so a thread exiting after the
+  /// pool is gone frees its pages instead.
+  struct Shared {
+    explicit Shared(sizex maxPagesValue) : maxPages(maxPagesValue) {}
+    ~Shared() { trim(0); }
+
+    void take(std::vector<byte*>& dest, sizex count) {
+      MutexLock lock(mutex);
+      const auto n = std::min(count, pages.size());
+      dest.insert(dest.end(), pages.end() - static_cast<ptrdiffx>(n), pages.end());
+      pages.resize(pages.size() - n);
+    }
+
+    void give(std::vector<byte*>& source, sizex count) {
+      const auto begin = source.end() - static_cast<ptrdiffx>(count);
+      {
+        MutexLock lock(mutex);
+        auto iter = begin;
+        for (; iter != source.end() && pages.size() < maxPages; ++iter) {
+          pages.push_back(*iter);
+        }
+        for (; iter != source.end(); ++iter) {
+          delete[] *iter;
+        }
+      }
+      source.erase(begin, source.end());
+    }
+
+    void trim(sizex keepPages) {
+      MutexLock lock(mutex);
+      while (pages.size() > keepPages) {
+        delete[] pages.back();
+        pages.pop_back();
+      }
+    }
+
+    sizex size() const {
+      MutexLock lock(mutex);
+      return pages.size();
+    }
+
+    mutable std::mutex mutex;
+    std::vector<byte*> pages;
+    const sizex maxPages;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  struct ThreadCache {
+    explicit ThreadCache(std::weak_ptr<Shared> sharedValue) : shared(std::move(sharedValue)) {}
+    ~ThreadCache() {
+      if (auto sharedPtr = shared.lock()) {
+        sharedPtr->give(pages, pages.size());
+      } else {
+        for (auto page : pages) {
+          delete[] page;
+        }
+      }
+    }
+
+    std::weak_ptr<Shared> shared;
+    std::vector<byte*> pages;
+  };
+
+  ThreadCache& threadCache() {
+    return _threadCaches.get([&]() { return std::make_unique<ThreadCache>(_shared); });
+  }
+
+  const Config _config;
+  std::shared_ptr<Shared> _shared;
+  ThreadLocalValue<ThreadCache> _threadCaches;
+};
+
+template <sizex kPageSize>
+constexpr sizex PagePool<kPageSize>::kUnlimited;
+
+namespace paged_detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// The reference count for a page held by more than one buffer or slice. Only created
+/// when a page is first shared, so pages that never get sliced don't pay for it.
+struct SharedPage {
+  explicit SharedPage(byte* pageData) noexcept : data(pageData) {}
+
+  std::atomic<u32> refs{1};
+  byte* const data;
+};
+
+inline void addRef(SharedPage* page) noexcept { page->refs.fetch_add(1, std::memory_order_relaxed); }
+
+////////////////////////////////////////////////////////////////////////////////
+/// Drop a reference, handing the page to `allocator` with the last one
+template <typename PageAllocator>
+void release(SharedPage* page, PageAllocator& allocator) {
+  if (page->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    allocator.deallocatePage(page->data);
+    delete page;
+  }
+}
+
+#if SW_POSIX
+/// Segments per writev/readv call. Well under any system's IOV_MAX
+constexpr sizex kMaxIoSegments = 64;
+
+////////////////////////////////////////////////////////////////////////////////
+/// Write `count` bytes with `writev()`. `fill(offset, segments, maxSegments)` gathers the
+/// segments from `offset` on, returning the bytes covered. Keeps going after partial
+/// writes, and retries on EINTR.
+/// @return the number of bytes written, or -1 with errno set if nothing could be written
+template <typename Fill>
+ptrdiffx writeSegments(int fd, sizex count, Fill fill) {
+  IoSegment segments[kMaxIoSegments];
+  sizex written = 0;
+  while (written < count) {
+    const auto covered = fill(written, segments, kMaxIoSegments);
+    int segmentCount = 0;
+    for (sizex bytes = 0; bytes < covered; bytes += segments[segmentCount++].size) {
+    }
+
+    const auto result = ::writev(fd, reinterpret_cast<const iovec*>(segments), segmentCount);
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      return written == 0 ? -1 : static_cast<ptrdiffx>(written);
+    }
+    if (result == 0)
+      break;
+    written += static_cast<sizex>(result);
+  }
+  return static_cast<ptrdiffx>(written);
+}
+#endif
+
+}  // namespace paged_detail
+
+template <sizex kPageSize, bool kZeroizeNewPages, typename PageAllocator>
+class PagedBuffer;
+
+////////////////////////////////////////////////////////////////////////////////
+/// # Overview
+/// An immutable view of bytes from PagedBuffers, sharing their pages by reference count
+/// instead of copying them (much like a folly IOBuf chain). Slices are cheap to copy,
+/// sub-slice and chain together, so fan-out, framing and retransmit queues can hold pieces
+/// of a buffer without copying a byte. Shared pages never change: a buffer writing to a
+/// page it shares copies the page first.
+///
+/// Slices can outlive the buffers they came from and be released on any thread. A single
+/// slice isn't synchronized, but separate copies can be used concurrently.
+///
+/// @tparam PageAllocator Frees the pages after the last reference goes. Must be able to
+///   free pages from the buffers' allocators, which is true of the allocators here.
+////////////////////////////////////////////////////////////////////////////////
+template <sizex kPageSize, typename PageAllocator>
+class PagedBufferSlice : private PageAllocator {
+public:
+  explicit PagedBufferSlice(PageAllocator pageAllocator = PageAllocator()) : PageAllocator(std::move(pageAllocator)) {}
+
+  ~PagedBufferSlice() { clear(); }
+
+  PagedBufferSlice(const PagedBufferSlice& that) :
+      PageAllocator(static_cast<const PageAllocator&>(that)), segments_(that.segments_), size_(that.size_) {
+    for (const auto& segment : segments_) {
+      paged_detail::addRef(segment.page);
+    }
+  }
+
+  PagedBufferSlice(PagedBufferSlice&& that) noexcept :
+      PageAllocator(static_cast<PageAllocator&>(that)),
+      segments_(std::move(that.segments_)),
+      size_(std::exchange(that.size_, 0)) {
+    that.segments_.clear();
+  }
+
+  PagedBufferSlice& operator=(const PagedBufferSlice& that) {
+    if (this != &that) {
+      *this = PagedBufferSlice(that);
+    }
+    return *this;
+  }
+
+  PagedBufferSlice& operator=(PagedBufferSlice&& that) noexcept {
+    if (this != &that) {
+      clear();
+      static_cast<PageAllocator&>(*this) = static_cast<PageAllocator&>(that);
+      segments_ = std::move(that.segments_);
+      that.segments_.clear();
+      size_ = std::exchange(that.size_, 0);
+    }
+    return *this;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  sizex size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the number of contiguous pieces. At least one per page.
+  sizex segmentCount() const { return segments_.size(); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Access single byte. Walks the segments, so prefer `copyFrom()` or `ioSegments()` for
+  /// anything more than the odd byte.
+  const byte& operator[](sizex i) const {
+    auto segment = segments_.begin();
+    while (i >= segment->size) {
+      i -= segment->size;
+      ++segment;
+    }
+    return segment->page->data[segment->offset + i];
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Drop all the references
+  void clear() {
+    for (const auto& segment : segments_) {
+      paged_detail::release(segment.page, static_cast<PageAllocator&>(*this));
+    }
+    segments_.clear();
+    size_ = 0;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return a slice of `count` bytes from `position`, sharing the same pages
+  PagedBufferSlice slice(sizex position, sizex count) const {
+    SW_ASSERT(position + count <= size_);
+    PagedBufferSlice result(static_cast<const PageAllocator&>(*this));
+    forEachSegment(position, count, [&](const Segment& segment, sizex offset, sizex bytes) {
+      result.addSegment(segment.page, segment.offset + offset, bytes);
+    });
+    return result;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Chain the bytes of another slice onto the end of this one, by reference
+  void append(const PagedBufferSlice& that) {
+    segments_.reserve(segments_.size() + that.segments_.size());
+    for (const auto& segment : that.segments_) {
+      addSegment(segment.page, segment.offset, segment.size);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  void copyFrom(sizex position, byte* dest, sizex count) const {
+    SW_ASSERT(position + count <= size_);
+    forEachSegment(position, count, [&](const Segment& segment, sizex offset, sizex bytes) {
+      std::memcpy(dest, segment.page->data + segment.offset + offset, bytes);
+      dest += bytes;
+    });
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Fill `segments` with the pieces covering `count` bytes from `position`, for reading
+  /// or `writev()`. The bytes must not be written. At most `maxSegments` are filled.
+  /// @return the number of bytes covered by the filled segments
+  sizex ioSegments(sizex position, sizex count, IoSegment* segments, sizex maxSegments) const {
+    SW_ASSERT(position + count <= size_);
+    sizex filled = 0;
+    sizex covered = 0;
+    forEachSegment(position, count, [&](const Segment& segment, sizex offset, sizex bytes) {
+      if (filled < maxSegments) {
+        segments[filled++] = IoSegment{segment.page->data + segment.offset + offset, bytes};
+        covered += bytes;
+      }
+    });
+    return covered;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the pieces covering the whole slice
+  std::vector<IoSegment> ioSegments() const {
+    std::vector<IoSegment> segments(segments_.size());
+    ioSegments(0, size_, segments.data(), segments.size());
+    return segments;
+  }
+
+#if SW_POSIX
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Write the slice to the file descriptor with `writev()`. Keeps going after partial
+  /// writes, and retries on EINTR.
+  /// @return the number of bytes written, or -1 with errno set if nothing could be written
+  ptrdiffx writeTo(int fd) const {
+    return paged_detail::writeSegments(fd, size_, [&](sizex offset, IoSegment* segments, sizex maxSegments) {
+      return ioSegments(offset, size_ - offset, segments, maxSegments);
+    });
+  }
+#endif
+
+private:
+  template <sizex, bool, typename>
+  friend class PagedBuffer;
+
+  struct Segment {
+    paged_detail::SharedPage* page;
+    sizex offset;  ///< Where the bytes start in the page
+    sizex size;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Add a reference to a piece of a page, merging it into the last segment when it
+  /// carries straight on from there
+  void addSegment(paged_detail::SharedPage* page, sizex offset, sizex size) {
+    if (!segments_.empty()) {
+      auto& last = segments_.back();
+      if (last.page == page && last.offset + last.size == offset) {
+        last.size += size;
+        size_ += size;
+        return;
+      }
+    }
+    segments_.push_back(Segment{page, offset, size});
+    paged_detail::addRef(page);
+    size_ += size;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Call `func(segment, offset, bytes)` for the part of each segment within the range
+  template <typename Func>
+  void forEachSegment(sizex position, sizex count, Func&& func) const {
+    for (const auto& segment : segments_) {
+      if (count == 0)
+        break;
+      if (position >= segment.size) {
+        position -= segment.size;
+        continue;
+      }
+      const auto bytes = std::min(count, segment.size - position);
+      func(segment, position, bytes);
+      count -= bytes;
+      position = 0;
+    }
+  }
+
+private:
+  std::vector<Segment> segments_;
+  sizex size_ = 0;  ///< size in bytes
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 /// Buffer that can grow without reallocating by using memory pages
 /// Only basic functions for now
-template <sizex kPageSize = 1024, bool kZeroizeNewPages = false>
-class PagedBuffer {
+///
+/// `slice()` hands out PagedBufferSlices that share pages rather than copy them, and
+/// appending a slice adopts its pages where they line up. Shared pages are copied before
+/// this buffer writes to them.
+///
+/// @tparam kZeroizeNewPages Zero pages as they're added. Otherwise new bytes are undefined
+/// @tparam PageAllocator Where pages come from. eg. `PagePool<kPageSize>::Allocator`
+template <sizex kPageSize = 1024, bool kZeroizeNewPages = false, typename PageAllocator = HeapPageAllocator<kPageSize>>
+class PagedBuffer : private PageAllocator {
 public:
-  explicit PagedBuffer(sizex capacity = 0) {
+  using Slice = PagedBufferSlice<kPageSize, PageAllocator>;
+
+  explicit PagedBuffer(sizex capacity = 0, PageAllocator pageAllocator = PageAllocator()) :
+      PageAllocator(std::move(pageAllocator)) {
     ensureCapacity(capacity);
     validateInvariants();
   }
 
+  // Pages go back to the allocator
+  ~PagedBuffer() { releasePages(); }
+
+  PagedBuffer(const PagedBuffer&) = delete;
+  PagedBuffer& operator=(const PagedBuffer&) = delete;
+
+  PagedBuffer(PagedBuffer&& that) noexcept :
+      PageAllocator(static_cast<PageAllocator&>(that)),
+      pages_(std::move(that.pages_)),
+      size_(std::exchange(that.size_, 0)) {
+    that.pages_.clear();
+  }
+
+  PagedBuffer& operator=(PagedBuffer&& that) noexcept {
+    if (this != &that) {
+      releasePages();
+      static_cast<PageAllocator&>(*this) = static_cast<PageAllocator&>(that);
+      pages_ = std::move(that.pages_);
+      that.pages_.clear();
+      size_ = std::exchange(that.size_, 0);
+    }
+    return *this;
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
   sizex capacity() const { return pages_.size() * kPageSize; }
 
@@ -52,7 +562,7 @@ public:
   sizex size() const { return size_; }
 
   ////////////////////////////////////////////////////////////////////////////////
-  sizex resize(sizex newSize) {
+  void resize(sizex newSize) {
     ensureCapacity(newSize);
     size_ = newSize;
 
@@ -64,7 +574,7 @@ public:
   byte& operator[](sizex i) {
     const auto page = i / kPageSize;
     const auto pageByte = i % kPageSize;
-    return pages_[page][pageByte];
+    return writablePage(page)[pageByte];
   }
 
   ////////////////////////////////////////////////////////////////////////////////
@@ -72,7 +582,7 @@ public:
   const byte& operator[](sizex i) const {
     const auto page = i / kPageSize;
     const auto pageByte = i % kPageSize;
-    return pages_[page][pageByte];
+    return pages_[page].data[pageByte];
   }
 
   ////////////////////////////////////////////////////////////////////////////////
@@ -85,6 +595,7 @@ public:
   /// 'position'. This buffer will expand if needed.
   void copyInto(sizex position, const byte* source, sizex count) {
     ensureCapacity(position + count);
+    makeWritable(position, count);
     const byte* end = source + count;
 
     // Copy into the first page
@@ -92,7 +603,7 @@ public:
     {
       const auto pageByte = position % kPageSize;
       const auto bytesLeftInPage = kPageSize - pageByte;
-      auto& page = pages_[pageNum];
+      auto page = pages_[pageNum].data;
       const auto bytesToCopy = std::min(count, bytesLeftInPage);
       std::memcpy(&page[pageByte], source, bytesToCopy);
       source += bytesToCopy;
@@ -100,7 +611,7 @@ public:
 
     // Now copy into the remaining pages
     while (source < end) {
-      auto& page = pages_[++pageNum];
+      auto page = pages_[++pageNum].data;
       const auto bytesLeft = static_cast<sizex>(end - source);
       const auto bytesToCopy = std::min(bytesLeft, kPageSize);
       std::memcpy(&page[0], source, bytesToCopy);
@@ -123,7 +634,7 @@ public:
     {
       const auto pageByte = position % kPageSize;
       const auto bytesLeftInPage = kPageSize - pageByte;
-      const auto& page = pages_[pageNum];
+      const auto page = pages_[pageNum].data;
       const auto bytesToCopy = std::min(count, bytesLeftInPage);
       std::memcpy(dest, &page[pageByte], bytesToCopy);
       dest += bytesToCopy;
@@ -131,7 +642,7 @@ public:
 
     // Now read into the remaining pages
     while (dest < end) {
-      auto& page = pages_[++pageNum];
+      const auto page = pages_[++pageNum].data;
       const auto bytesLeft = static_cast<sizex>(end - dest);
       const auto bytesToCopy = std::min(bytesLeft, kPageSize);
       std::memcpy(dest, &page[0], bytesToCopy);
@@ -139,6 +650,124 @@ public:
     }
   }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return a slice sharing `count` bytes from `position`. Nothing is copied: the pages
+  /// become shared, and get copied if this buffer writes to them later.
+  Slice slice(sizex position, sizex count) {
+    SW_ASSERT(position + count <= size_);
+    Slice result(static_cast<const PageAllocator&>(*this));
+    result.segments_.reserve(ioSegmentCount(position, count));
+    const auto end = position + count;
+    while (position < end) {
+      const auto pageByte = position % kPageSize;
+      const auto bytes = std::min(end - position, kPageSize - pageByte);
+      result.addSegment(sharePage(position / kPageSize), pageByte, bytes);
+      position += bytes;
+    }
+    return result;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return a slice sharing the whole buffer
+  Slice slice() { return slice(0, size_); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Append the bytes of a slice. Its pages are adopted by reference wherever they line
+  /// up with this buffer's pages, which is whenever the buffer ends on a page boundary and
+  /// the slice segment is a whole page (or a page start at the end of the slice). Anything
+  /// else is copied.
+  void append(const Slice& slice) {
+    for (const auto& segment : slice.segments_) {
+      const auto adopt = size_ % kPageSize == 0 && segment.offset == 0 &&
+                         (segment.size == kPageSize || &segment == &slice.segments_.back());
+      if (adopt) {
+        // Any spare capacity pages move down past the adopted one
+        pages_.insert(pages_.begin() + static_cast<ptrdiffx>(size_ / kPageSize), Page{segment.page->data, segment.page});
+        paged_detail::addRef(segment.page);
+        size_ += segment.size;
+      } else {
+        copyInto(size_, segment.page->data + segment.offset, segment.size);
+      }
+    }
+    validateInvariants();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the number of page segments covering `count` bytes from `position`
+  sizex ioSegmentCount(sizex position, sizex count) const {
+    return count == 0 ? 0 : (position + count - 1) / kPageSize - position / kPageSize + 1;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Fill `segments` with the pages covering `count` bytes from `position`, without
+  /// copying anything. The range must be within the capacity. Only for reading the
+  /// bytes, or `writev()`, since the pages may be shared with slices. At most `maxSegments` are
+  /// filled, so check the returned byte count for a partial range.
+  /// @return the number of bytes covered by the filled segments
+  sizex ioSegments(sizex position, sizex count, IoSegment* segments, sizex maxSegments) const {
+    SW_ASSERT(position + count <= capacity());
+    sizex covered = 0;
+    for (sizex i = 0; i < maxSegments && covered < count; ++i) {
+      const auto offset = position + covered;
+      const auto pageByte = offset % kPageSize;
+      const auto bytes = std::min(count - covered, kPageSize - pageByte);
+      segments[i] = IoSegment{pages_[offset / kPageSize].data + pageByte, bytes};
+      covered += bytes;
+    }
+    return covered;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the page segments covering `count` bytes from `position`
+  std::vector<IoSegment> ioSegments(sizex position, sizex count) const {
+    std::vector<IoSegment> segments(ioSegmentCount(position, count));
+    ioSegments(position, count, segments.data(), segments.size());
+    return segments;
+  }
+
+#if SW_POSIX
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Write `count` bytes from `position` to the file descriptor with `writev()`, straight
+  /// from the pages. Keeps going after partial writes, and retries on EINTR.
+  /// @return the number of bytes written, or -1 with errno set if nothing could be written
+  ptrdiffx writeTo(int fd, sizex position, sizex count) const {
+    SW_ASSERT(position + count <= size_);
+    return paged_detail::writeSegments(fd, count, [&](sizex offset, IoSegment* segments, sizex maxSegments) {
+      return ioSegments(position + offset, count - offset, segments, maxSegments);
+    });
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Write the whole buffer to the file descriptor. See `writeTo()` above.
+  ptrdiffx writeTo(int fd) const { return writeTo(fd, 0, size_); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Append up to `maxCount` bytes read from the file descriptor with a single `readv()`,
+  /// directly into the tail pages. Pages are added as needed. One `readv()` covers at most
+  /// `kMaxIoSegments` pages, so larger counts read less and only grow the buffer that far. Retries
+  /// on EINTR.
+  /// @return the number of bytes appended, 0 at end of file, or -1 with errno set
+  ptrdiffx appendFrom(int fd, sizex maxCount) {
+    const sizex maxCovered = (kPageSize - size_ % kPageSize) + (paged_detail::kMaxIoSegments - 1) * kPageSize;
+    maxCount = std::min(maxCount, maxCovered);
+    ensureCapacity(size_ + maxCount);
+    makeWritable(size_, maxCount);
+    IoSegment segments[paged_detail::kMaxIoSegments];
+    const auto covered = ioSegments(size_, maxCount, segments, paged_detail::kMaxIoSegments);
+    const auto segmentCount = static_cast<int>(ioSegmentCount(size_, covered));
+    ptrdiffx result = 0;
+    do {
+      result = ::readv(fd, reinterpret_cast<const iovec*>(segments), segmentCount);
+    } while (result < 0 && errno == EINTR);
+
+    if (result > 0) {
+      size_ += static_cast<sizex>(result);
+    }
+    validateInvariants();
+    return result;
+  }
+#endif
+
 private:
   ////////////////////////////////////////////////////////////////////////////////
   void ensureCapacity(sizex newCapacity) {
@@ -149,21 +778,78 @@ private:
     const auto newPageCount = newCapacity / kPageSize + (((newCapacity % kPageSize) == 0) ? 0 : 1);
     const auto oldPageCount = pages_.size();
     SW_ASSERT(newPageCount >= oldPageCount);
+    pages_.reserve(newPageCount);
     for (sizex i = oldPageCount; i < newPageCount; ++i) {
-      pages_.emplace_back(std::make_unique<byte[]>(kPageSize));
+      pages_.push_back(Page{PageAllocator::allocatePage(), nullptr});
       if (kZeroizeNewPages) {
-        std::memset(pages_.back().get(), 0, kPageSize);
+        std::memset(pages_.back().data, 0, kPageSize);
       }
     }
 
     validateInvariants();
   }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  void releasePages() {
+    for (const auto& page : pages_) {
+      if (page.shared != nullptr) {
+        paged_detail::release(page.shared, static_cast<PageAllocator&>(*this));
+      } else {
+        PageAllocator::deallocatePage(page.data);
+      }
+    }
+    pages_.clear();
+    size_ = 0;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Get the page's reference count, creating it the first time the page is shared
+  paged_detail::SharedPage* sharePage(sizex pageIndex) {
+    auto& page = pages_[pageIndex];
+    if (page.shared == nullptr) {
+      page.shared = new paged_detail::SharedPage(page.data);
+    }
+    return page.shared;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Get a page to write to, first taking a private copy if it's shared
+  byte* writablePage(sizex pageIndex) {
+    auto& page = pages_[pageIndex];
+    if (page.shared != nullptr) {
+      if (page.shared->refs.load(std::memory_order_acquire) == 1) {
+        // Every other reference is gone, so it's ours again
+        delete page.shared;
+      } else {
+        auto data = PageAllocator::allocatePage();
+        std::memcpy(data, page.data, kPageSize);
+        paged_detail::release(page.shared, static_cast<PageAllocator&>(*this));
+        page.data = data;
+      }
+      page.shared = nullptr;
+    }
+    return page.data;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Make sure none of the pages covering the range are shared
+  void makeWritable(sizex position, sizex count) {
+    if (count == 0)
+      return;
+    const auto lastPage = (position + count - 1) / kPageSize;
+    for (auto i = position / kPageSize; i <= lastPage; ++i) {
+      writablePage(i);
+    }
+  }
+
 private:
   void validateInvariants() { SW_ASSERT(pages_.size() * kPageSize >= size_); }
 
 private:
-  using Page = std::unique_ptr<byte[]>;
+  struct Page {
+    byte* data;
+    paged_detail::SharedPage* shared;  ///< Only set once the page has been shared
+  };
   std::vector<Page> pages_;
   sizex size_ = 0;  ///< size in bytes
 };
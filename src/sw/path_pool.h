@@ -0,0 +1,344 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "assert.h"
+#include "posix_path.h"
+#include "reallocator.h"
+#include "strings.h"
+#include "types.h"
+
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <new>
+#include <string>
+#include <vector>
+
+SW_NAMESPACE_BEGIN
+
+class PathPool;
+
+namespace path_pool_detail {
+
+using path_detail::PathSection;
+
+////////////////////////////////////////////////////////////////////////////////
+/// One segment of an interned path, linked to the path it was appended to. Nodes live in
+/// the pool's arena and never move or change once created.
+struct PathNode {
+  const PathNode* parent;
+  const char* name;
+  sizex hash;
+  u32 nameSize;
+  u32 size;   ///< Length of the whole path string
+  u32 depth;  ///< Segments in the whole path, including this one
+  PathSection section;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// A '/' goes between two named segments. Roots and the final separator carry their own.
+inline bool needsSep(const PathNode* parent, PathSection section) noexcept {
+  const auto named = [](PathSection s) {
+    return s == PathSection::Filename || s == PathSection::Dot || s == PathSection::DotDot;
+  };
+  return parent != nullptr && named(parent->section) && named(section);
+}
+
+inline PathSection sectionFor(const StringView& name) noexcept {
+  if (name.size() == 1 && name[0] == '.') {
+    return PathSection::Dot;
+  }
+  if (name.size() == 2 && name[0] == '.' && name[1] == '.') {
+    return PathSection::DotDot;
+  }
+  return PathSection::Filename;
+}
+
+}  // namespace path_pool_detail
+
+////////////////////////////////////////////////////////////////////////////////
+/// A handle to a path interned in a PathPool. It's a single pointer, so copies are free,
+/// equality is a pointer compare, and the hash is computed once when the path is interned.
+/// Handles from different pools never compare equal (other than the empty path).
+///
+/// The handle is only valid while its pool is alive.
+////////////////////////////////////////////////////////////////////////////////
+class InternedPath {
+  using PathNode = path_pool_detail::PathNode;
+
+public:
+  /// The empty path
+  InternedPath() = default;
+
+  bool empty() const noexcept { return _node == nullptr; }
+
+  /// The path without its last segment. The parent of "/foo/" is "/foo", same as PosixPath.
+  InternedPath parent_path() const noexcept { return InternedPath(_node ? _node->parent : nullptr); }
+
+  /// The last segment, eg. "bar.txt", "/" for a root directory or final separator, or the
+  /// root name for "//host"
+  StringView segment() const noexcept { return _node ? StringView(_node->name, _node->nameSize) : StringView("", 0); }
+
+  /// The number of segments
+  sizex depth() const noexcept { return _node ? _node->depth : 0; }
+
+  /// The length of the path string
+  sizex size() const noexcept { return _node ? _node->size : 0; }
+
+  /// Not the same value as hash_value(PosixPath), which would need the whole string
+  sizex hash() const noexcept { return _node ? _node->hash : 0; }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Determine if this is `ancestor` or somewhere below it. Costs the difference in depth.
+  bool isWithin(const InternedPath& ancestor) const noexcept {
+    if (depth() < ancestor.depth()) {
+      return false;
+    }
+    auto node = _node;
+    for (auto steps = depth() - ancestor.depth(); steps > 0; --steps) {
+      node = node->parent;
+    }
+    return node == ancestor._node;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Write the path string onto the end of `out`. One resize, then filled in leaf first.
+  void appendTo(std::string& out) const {
+    const auto offset = out.size();
+    out.resize(offset + size());
+    auto end = &out[0] + offset + size();
+    for (auto node = _node; node != nullptr; node = node->parent) {
+      end -= node->nameSize;
+      std::memcpy(end, node->name, node->nameSize);
+      if (path_pool_detail::needsSep(node->parent, node->section)) {
+        *--end = PosixPath::kSep;
+      }
+    }
+    SW_ASSERT(end == &out[0] + offset);
+  }
+
+  std::string str() const {
+    std::string result;
+    appendTo(result);
+    return result;
+  }
+
+  PosixPath path() const { return PosixPath(str()); }
+
+  friend bool operator==(const InternedPath& lhs, const InternedPath& rhs) noexcept { return lhs._node == rhs._node; }
+  friend bool operator!=(const InternedPath& lhs, const InternedPath& rhs) noexcept { return lhs._node != rhs._node; }
+
+private:
+  explicit InternedPath(const PathNode* node) noexcept : _node(node) {}
+
+  const PathNode* _node = nullptr;
+
+  friend class PathPool;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// # Overview
+/// Interns paths as a prefix tree, so paths sharing directories share their storage. Each
+/// segment is stored once per distinct parent and segment names are stored once overall, all
+/// in an arena. A path costs one 40 byte node per segment not already in the pool plus one
+/// pointer of table space, so a large file listing takes a fraction of what the equivalent
+/// PosixPaths (each owning a copy of its whole string) would take.
+///
+/// Paths are split the same way PosixPath iterates them, so repeated separators are
+/// dropped ("a//b" interns as "a/b") and nothing else is normalized. Dot segments are kept.
+///
+/// Interning isn't thread safe. The nodes never change though, so handles may be used from
+/// any thread (including while another thread interns) once they've been safely handed over.
+////////////////////////////////////////////////////////////////////////////////
+class PathPool {
+  using PathNode = path_pool_detail::PathNode;
+  using PathSection = path_detail::PathSection;
+
+public:
+  PathPool() = default;
+  ~PathPool() = default;
+
+  PathPool(const PathPool&) = delete;
+  PathPool& operator=(const PathPool&) = delete;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  InternedPath intern(const PosixPath& path) { return join(InternedPath(), path.u8()); }
+  InternedPath intern(const StringView& path) { return join(InternedPath(), path); }
+  InternedPath intern(const std::string& path) { return join(InternedPath(), path); }
+  InternedPath intern(const char* path) { return join(InternedPath(), path); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Append a single segment (no separators) to `parent`. This is the cheap way to walk down
+  /// a tree, costing one table probe when the child already exists.
+  InternedPath child(const InternedPath& parent, const StringView& name) {
+    SW_ASSERT(!name.empty() && std::memchr(name.data(), PosixPath::kSep, name.size()) == nullptr);
+    return InternedPath(findOrAdd(namedParent(parent._node), name, path_pool_detail::sectionFor(name)));
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Same as `PosixPath::operator/`. An absolute `relative` replaces `base` entirely.
+  InternedPath join(const InternedPath& base, const StringView& relative) {
+    path_detail::PathSegmentIterator it{std::string(relative.data(), relative.size())};
+    auto node = base._node;
+    for (auto segment = it.begin(); segment != it.end(); segment = it.next()) {
+      switch (segment.section) {
+      case PathSection::RootName:
+        node = findOrAdd(nullptr, segment.str, segment.section);
+        break;
+      case PathSection::RootDir:
+        node = findOrAdd(rootNameOf(node), segment.str, segment.section);
+        break;
+      default:
+        node = findOrAdd(namedParent(node), segment.str, segment.section);
+        break;
+      }
+    }
+    return InternedPath(node);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// The number of distinct segments (ie. nodes) in the pool
+  sizex nodeCount() const noexcept { return _nodeCount; }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// The number of distinct segment names
+  sizex nameCount() const noexcept { return _nameCount; }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Approximate bytes held by the pool
+  sizex memoryUsage() const noexcept {
+    return _arena.capacity() + _nodes.capacity() * sizeof(_nodes[0]) + _names.capacity() * sizeof(_names[0]);
+  }
+
+private:
+  static constexpr sizex kInitialTableSize = 64;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// A final separator is dropped when appending more segments, "foo/" + "bar" is "foo/bar"
+  static const PathNode* namedParent(const PathNode* node) noexcept {
+    return (node != nullptr && node->section == PathSection::FinalSep) ? node->parent : node;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// A root directory keeps the root name of the base, eg. "//c:/foo" / "/bar" is "//c:/bar"
+  static const PathNode* rootNameOf(const PathNode* node) noexcept {
+    while (node != nullptr && node->section != PathSection::RootName) {
+      node = node->parent;
+    }
+    return node;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  const PathNode* findOrAdd(const PathNode* parent, const StringView& name, PathSection section) {
+    const u64 seed = (parent ? parent->hash : 0) ^ static_cast<u64>(section);
+    const sizex hash = hashBytes(name.data(), name.size(), seed);
+    if ((_nodeCount + 1) * 2 > _nodes.size()) {
+      rehash(_nodes, _nodes.empty() ? kInitialTableSize : _nodes.size() * 2,
+             [](const PathNode* node) { return node->hash; });
+    }
+
+    const auto mask = _nodes.size() - 1;
+    auto index = hash & mask;
+    for (auto node = _nodes[index]; node != nullptr; node = _nodes[index]) {
+      if (node->hash == hash && node->parent == parent && node->section == section &&
+          StringView(node->name, node->nameSize) == name) {
+        return node;
+      }
+      index = (index + 1) & mask;
+    }
+
+    const auto parentSize = parent ? sizex(parent->size) : 0_z;
+    const auto size = parentSize + (path_pool_detail::needsSep(parent, section) ? 1 : 0) + name.size();
+    SW_ASSERT(size <= std::numeric_limits<u32>::max());
+
+    auto node = new (_arena.allocate(sizeof(PathNode), alignof(PathNode))) PathNode;
+    node->parent = parent;
+    node->name = internName(name);
+    node->hash = hash;
+    node->nameSize = static_cast<u32>(name.size());
+    node->size = static_cast<u32>(size);
+    node->depth = (parent ? parent->depth : 0) + 1;
+    node->section = section;
+
+    _nodes[index] = node;
+    ++_nodeCount;
+    return node;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// The pool's copy of `name`, shared by every node with that name
+  const char* internName(const StringView& name) {
+    if ((_nameCount + 1) * 2 > _names.size()) {
+      rehash(_names, _names.empty() ? kInitialTableSize : _names.size() * 2,
+             [](const StringView& str) { return hashBytes(str.data(), str.size()); });
+    }
+
+    const auto mask = _names.size() - 1;
+    auto index = hashBytes(name.data(), name.size()) & mask;
+    for (; !_names[index].empty(); index = (index + 1) & mask) {
+      if (_names[index] == name) {
+        return _names[index].data();
+      }
+    }
+
+    auto copy = static_cast<char*>(_arena.allocate(name.size(), 1));
+    std::memcpy(copy, name.data(), name.size());
+    _names[index] = StringView(copy, name.size());
+    ++_nameCount;
+    return copy;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Grow an open addressed table, where a default constructed entry is an empty slot
+  template <typename Entry, typename HashFunc>
+  static void rehash(std::vector<Entry>& table, sizex newSize, HashFunc&& hashFunc) {
+    std::vector<Entry> grown(newSize);
+    const auto mask = newSize - 1;
+    for (const auto& entry : table) {
+      if (entry != Entry()) {
+        auto index = hashFunc(entry) & mask;
+        while (grown[index] != Entry()) {
+          index = (index + 1) & mask;
+        }
+        grown[index] = entry;
+      }
+    }
+    table.swap(grown);
+  }
+
+private:
+  Arena _arena;
+  std::vector<const PathNode*> _nodes;
+  std::vector<StringView> _names;
+  sizex _nodeCount = 0;
+  sizex _nameCount = 0;
+};
+
+SW_NAMESPACE_END
+
+namespace std {
+
+////////////////////////////////////////////////////////////////////////////////
+template <>
+struct hash<::sw::InternedPath> {
+  size_t operator()(const ::sw::InternedPath& p) const noexcept { return p.hash(); }
+};
+
+}  // namespace std
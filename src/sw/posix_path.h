@@ -23,8 +23,10 @@
 #include "strings.h"
 #include "types.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cctype>
-#include <numeric>
+#include <memory>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -52,6 +54,15 @@ static constexpr bool kPosixPathUseFullNormalization = true;
 static constexpr bool kPosixPathUseFullNormalization = false;
 #endif
 
+/// PosixPath caches the offsets of its filename, root directory, and extension the first
+/// time they're needed, so repeated component queries don't rescan the string. It costs 16
+/// bytes per path. Define SW_POSIX_PATH_NO_OFFSET_CACHE to go without.
+#if SW_POSIX_PATH_NO_OFFSET_CACHE
+static constexpr bool kPosixPathCacheOffsets = false;
+#else
+static constexpr bool kPosixPathCacheOffsets = true;
+#endif
+
 /// Private helpers
 namespace path_detail {
 
@@ -93,6 +104,86 @@ sizex findNetworkRootSep(const char* str, sizex endPos);
 bool isRootSeparator(const char* str, sizex endPos, sizex pos);
 sizex findRootDirPos(const char* str, sizex endPos);
 std::tuple<sizex, sizex> findFilenamePos(const char* str, sizex endPos);
+void normalizeInPlace(std::string& str, bool full);
+
+////////////////////////////////////////////////////////////////////////////////
+/// Where the parts of a path are, or kNoPos for the ones it doesn't have
+struct PathOffsets {
+  sizex filenamePos;   ///< As from findFilenamePos
+  sizex rootSepPos;    ///< As from findFilenamePos
+  sizex rootDirPos;    ///< As from findRootDirPos
+  sizex extensionPos;  ///< As from findExtensionPos
+};
+
+PathOffsets findPathOffsets(const char* str, sizex endPos);
+
+////////////////////////////////////////////////////////////////////////////////
+/// Holds a path's PathOffsets from the first time they're needed until `reset()`, which the
+/// path calls whenever it changes. The cache is filled from const accessors, so it's kept in
+/// relaxed atomics. Threads racing to fill it all store the same values, so a const path can
+/// still be shared between threads. Each word packs two offsets as (offset + 1), with 0
+/// meaning kNoPos and all bits set meaning not computed yet.
+template <bool kEnabled = true>
+class PathOffsetCache {
+public:
+  PathOffsetCache() noexcept = default;
+  PathOffsetCache(const PathOffsetCache& that) noexcept :
+      _filename(that._filename.load(std::memory_order_relaxed)),
+      _rootDir(that._rootDir.load(std::memory_order_relaxed)) {}
+  PathOffsetCache& operator=(const PathOffsetCache& that) noexcept {
+    _filename.store(that._filename.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    _rootDir.store(that._rootDir.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return *this;
+  }
+
+  void reset() noexcept {
+    _filename.store(kUnset, std::memory_order_relaxed);
+    _rootDir.store(kUnset, std::memory_order_relaxed);
+  }
+
+  bool cached() const noexcept {
+    return _filename.load(std::memory_order_relaxed) != kUnset && _rootDir.load(std::memory_order_relaxed) != kUnset;
+  }
+
+  PathOffsets get(const char* str, sizex size) const noexcept {
+    const auto filename = _filename.load(std::memory_order_relaxed);
+    const auto rootDir = _rootDir.load(std::memory_order_relaxed);
+    if (filename != kUnset && rootDir != kUnset) {
+      return PathOffsets{decode(filename >> 32u), decode(filename & 0xffffffffu), decode(rootDir >> 32u),
+                         decode(rootDir & 0xffffffffu)};
+    }
+
+    const auto offsets = findPathOffsets(str, size);
+    // Huge paths would need more bits, so they just go without
+    if (size < kMaxCachedSize) {
+      _filename.store(pack(offsets.filenamePos, offsets.rootSepPos), std::memory_order_relaxed);
+      _rootDir.store(pack(offsets.rootDirPos, offsets.extensionPos), std::memory_order_relaxed);
+    }
+    return offsets;
+  }
+
+private:
+  static constexpr u64 kUnset = ~0_u64;
+  static constexpr sizex kMaxCachedSize = 0xfffffffe;
+
+  static u64 encode(sizex pos) noexcept { return pos == kNoPos ? 0 : u64(pos + 1); }
+  static sizex decode(u64 value) noexcept { return value == 0 ? kNoPos : sizex(value - 1); }
+  static u64 pack(sizex hi, sizex lo) noexcept { return (encode(hi) << 32u) | encode(lo); }
+
+  mutable std::atomic<u64> _filename{kUnset};
+  mutable std::atomic<u64> _rootDir{kUnset};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// No caching. Every query does the scan.
+template <>
+class PathOffsetCache<false> {
+public:
+  void reset() noexcept {}
+  bool cached() const noexcept { return false; }
+  PathOffsets get(const char* str, sizex size) const noexcept { return findPathOffsets(str, size); }
+};
+
 }  // namespace path_detail
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -162,11 +253,16 @@ public:
   PosixPath(PosixPath&& that) :
       _pstr(std::move(that._pstr)),
       _normalized(std::exchange(that._normalized, false)),
-      _absolute(std::exchange(that._absolute, false)) {}
+      _absolute(std::exchange(that._absolute, false)),
+      _offsets(that._offsets) {
+    that._offsets.reset();
+  }
   PosixPath& operator=(PosixPath&& that) {
     _pstr = std::move(that._pstr);
     _normalized = std::exchange(that._normalized, false);
     _absolute = std::exchange(that._absolute, false);
+    _offsets = that._offsets;
+    that._offsets.reset();
     return *this;
   }
 
@@ -178,7 +274,7 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
   PosixPath& absolutize(const PosixPath& cwd) {
     if (!is_absolute()) {
-      *this = doMakeAbsolute(*this, cwd);
+      doPrependCwd(cwd);
     }
     return *this;
   }
@@ -190,10 +286,10 @@ public:
   }
 
   ////////////////////////////////////////////////////////////////////////////////
+  /// Normalizes in place, reusing the string. Does nothing if the path is known to be normalized.
   PosixPath& normalize() {
     if (!is_normalized()) {
-      auto normed = normalized();
-      *this = std::move(normed);
+      doNormalize(kPosixPathUseFullNormalization);
     }
     return *this;
   }
@@ -201,19 +297,18 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
   /// Returns the normalized version of the given path. Normalized has no fluff
   PosixPath normalized() const {
-    if (is_normalized()) {
-      return *this;
-    }
-
-    return doMakeNormalized(*this);
+    auto result = *this;
+    result.normalize();
+    return result;
   }
 
   ////////////////////////////////////////////////////////////////////////////////
-  /// Make this path weakly-canonical aka absonorm.
+  /// Make this path weakly-canonical aka absonorm, in place.
   PosixPath& absonormize(const PosixPath& cwd) {
     if (!is_absonorm()) {
-      auto cpathd = absonormed(cwd);
-      *this = std::move(cpathd);
+      absolutize(cwd);
+      normalize();
+      _absolute = true;
     }
     return *this;
   }
@@ -221,11 +316,9 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
   /// Returns the weakly-canonical aka absonormed version of the given path.
   PosixPath absonormed(const PosixPath& cwd) const {
-    if (is_absonorm()) {
-      return *this;
-    }
-
-    return doMakeCanonical(*this, cwd);
+    auto result = *this;
+    result.absonormize(cwd);
+    return result;
   }
 
   ////////////////////////////////////////////////////////////////////////////////
@@ -236,11 +329,13 @@ public:
   PosixPath& operator+=(const value_type* ptr) {
     _pstr += ptr;
     _normalized = false;
+    _offsets.reset();
     return *this;
   }
   PosixPath& operator+=(value_type x) {
     _pstr += x;
     _normalized = false;
+    _offsets.reset();
     return *this;
   }
 
@@ -248,12 +343,14 @@ public:
   PosixPath& operator+=(const Source& source) {
     _pstr += source;
     _normalized = false;
+    _offsets.reset();
     return *this;
   }
   template <class CharT>
   PosixPath& operator+=(CharT x) {
     _pstr += x;
     _normalized = false;
+    _offsets.reset();
     return *this;
   }
 
@@ -268,6 +365,7 @@ public:
     } else {
       _pstr.resize(0);
     }
+    _offsets.reset();
 
     // Unfortunately we can't be sure of absolute because of root-names. Not without checking anyway.
     // This shouldn't affect normalized state
@@ -285,6 +383,7 @@ public:
   PosixPath& concat(const Source& source) {
     _pstr.append(source);
     _normalized = false;
+    _offsets.reset();
     return *this;
   }
 
@@ -295,6 +394,7 @@ public:
   PosixPath& concat(InputIt first, InputIt last) {
     _pstr.append(first, last);
     _normalized = false;
+    _offsets.reset();
     return *this;
   }
 
@@ -352,6 +452,7 @@ public:
     _pstr.clear();
     _normalized = false;
     _absolute = false;
+    _offsets.reset();
   }
 
   ////////////////////////////////////////////////////////////////////////////////
@@ -423,6 +524,8 @@ public:
     _pstr.swap(that._pstr);
     std::swap(_absolute, that._absolute);
     std::swap(_normalized, that._normalized);
+    _offsets.reset();
+    that._offsets.reset();
   }
 
   ////////////////////////////////////////////////////////////////////////////////
@@ -443,11 +546,12 @@ public:
 
   ////////////////////////////////////////////////////////////////////////////////
   PosixPath& remove_filename() {
-    const auto fpos = std::get<0>(path_detail::findFilenamePos(_pstr.data(), _pstr.size()));
+    const auto fpos = offsets().filenamePos;
 
     // If there's no filename, we do nothing. If there is a filename, then just chop it off
     if (_pstr.data()[fpos] != kSep) {
       _pstr.resize(fpos);
+      _offsets.reset();
     }
 
     return *this;
@@ -461,10 +565,8 @@ public:
 
   ////////////////////////////////////////////////////////////////////////////////
   PosixPath& replace_extension(const PosixPath& replacement = PosixPath()) {
-    const auto* str = _pstr.data();
-    const auto size = _pstr.size();
     const bool replaceHasDot = !replacement.empty() && (replacement._pstr[0] == kDot);
-    const auto extPos = path_detail::findExtensionPos(str, size);
+    const auto extPos = offsets().extensionPos;
     if (extPos != kNoPos) {
       // We have an extension to replace.
       if (replaceHasDot || replacement.empty()) {
@@ -472,6 +574,7 @@ public:
       } else {
         _pstr.resize(extPos + 1);  // Use our dot
       }
+      _offsets.reset();
     }
 
     // And concatenate the replacement
@@ -479,14 +582,6 @@ public:
   }
 
 private:
-  PosixPath doDefaultLexicalNormalization() const {
-    if (kPosixPathUseFullNormalization) {
-      return lexically_full_normal();
-    } else {
-      return lexically_normal();
-    }
-  }
-
   PosixPath(const StringView& sv, bool norm, bool abs) :
       _pstr(sv.data(), sv.size()),
       _normalized(norm),
@@ -501,9 +596,14 @@ private:
       _normalized(norm),
       _absolute(abs) {}
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /// The component offsets, from the cache when we have them
+  path_detail::PathOffsets offsets() const noexcept { return _offsets.get(_pstr.data(), _pstr.size()); }
+
   PosixPath& doConcat(const char* str, sizex size) {
     _pstr.append(str, size);
     _normalized = false;
+    _offsets.reset();
     return *this;
   }
 
@@ -511,8 +611,7 @@ private:
   /// Determine if this path is absolute
   bool doIsAbsolute() const {
     // We're absolute if we have a root dir
-    const auto& rootDirPos = path_detail::findRootDirPos(_pstr.data(), _pstr.size());
-    const auto isAbs = rootDirPos != kNoPos;
+    const auto isAbs = offsets().rootDirPos != kNoPos;
     return isAbs;
   }
 
@@ -523,11 +622,31 @@ private:
   /// Returns the absolute version of the given path.
   static inline PosixPath doMakeAbsolute(const PosixPath& p, const PosixPath& cwd);
 
-  /// Returns the canonical version of the given path. Canonical is absolute and normalized
-  static inline PosixPath doMakeCanonical(const PosixPath& p, const PosixPath& cwd);
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Normalize in place, with the lexically_full_normal rules if `full`. The path is only flagged
+  /// normalized when those are the rules `normalize()` uses
+  void doNormalize(bool full) {
+    path_detail::normalizeInPlace(_pstr, full);
+    _normalized = (full == kPosixPathUseFullNormalization);
+    _offsets.reset();
+  }
 
-  /// Returns the normalized version of the given path. Normalized has no fluff
-  static inline PosixPath doMakeNormalized(const PosixPath& p);
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Same as `*this = cwd / *this`, but reusing our string
+  void doPrependCwd(const PosixPath& cwd) {
+    SW_ASSERT(cwd.is_absolute());
+    if (empty()) {
+      _pstr.assign(cwd._pstr);
+      _pstr += kSep;
+    } else if (_pstr[0] != kSep) {
+      const bool addSep = !cwd.empty() && !endsWith(cwd._pstr, kSep);
+      _pstr.insert(0, addSep ? 1 : 0, kSep);
+      _pstr.insert(0, cwd._pstr);
+    }
+    _normalized = false;
+    _absolute = true;
+    _offsets.reset();
+  }
 
   ////////////////////////////////////////////////////////////////////////////////
   /// Append the given path onto the end of our path using a separator
@@ -538,6 +657,7 @@ private:
     // Quick out for empty path
     if (that.empty()) {
       _pstr += kSep;
+      _offsets.reset();
       if (kPosixPathUseFullNormalization) {
         // For posix full norm, trailing sep means we're not normalized anymore
         _normalized = false;
@@ -561,6 +681,7 @@ private:
 
     // We can no longer ensure normalization. Absolute stays though
     _normalized = false;
+    _offsets.reset();
 
     return *this;
   }
@@ -574,6 +695,9 @@ private:
   // When true, indicates the path is definitely absolute. False means not sure
   bool _absolute = {false};
 
+  // Component offsets, found on first use
+  path_detail::PathOffsetCache<kPosixPathCacheOffsets> _offsets;
+
   friend PosixPath operator/(const PosixPath& lhs, const PosixPath& rhs) {
     auto lhsCopy = lhs;
     lhsCopy /= rhs;
@@ -623,7 +747,7 @@ inline bool operator>=(const PosixPath& lhs, const PosixPath& rhs) {
 ////////////////////////////////////////////////////////////////////////////////
 /// calculates the hash value for a path
 inline sizex hash_value(const PosixPath& p) {
-  return std::hash<PosixPath::string_type>()(p.u8());
+  return hashBytes(p.u8().data(), p.u8().size());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -713,28 +837,6 @@ inline PosixPath PosixPath::doMakeAbsolute(const PosixPath& p, const PosixPath&
   return abs;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-/// Returns the canonical version of the given path. Canonical is absolute and normalized. Note that
-/// this is "weakly canonical" since it's only lexically analyzed.
-/// @param cwd The current-working-dir which must be absolute. Used for absoluting a relative path.
-inline PosixPath PosixPath::doMakeCanonical(const PosixPath& p, const PosixPath& cwd) {
-  SW_ASSERT(cwd.is_absolute() == true);
-
-  const auto abs = p.is_absolute() ? p : cwd / p;
-  auto canon = abs.normalized();
-  canon._absolute = true;
-  return canon;
-}
-
-////////////////////////////////////////////////////////////////////////////////
-/// Returns the normalized version of the given path. Normalized has no fluff
-inline PosixPath PosixPath::doMakeNormalized(const PosixPath& p) {
-  auto norm = p.doDefaultLexicalNormalization();
-  norm._normalized = true;
-  norm._absolute = p._absolute;
-  return norm;
-}
-
 ////////////////////////////////////////////////////////////////////////////////
 /// Returns the filename. If the path end with a "/", then the filename
 /// is considered to be ".".
@@ -746,15 +848,15 @@ StringClass PosixPath::doFilename() const {
   }
 
   const auto* str = _pstr.data();
-  const auto& fileAndRootPos = path_detail::findFilenamePos(str, size);
-  const auto& fpos = std::get<0>(fileAndRootPos);
+  const auto fileAndRootPos = offsets();
+  const auto& fpos = fileAndRootPos.filenamePos;
   if (fpos == kNoPos) {
     // No filename available
     return StringClass(path_detail::kEmptyString, 0);
   }
 
   // If the result is the root separator, then we return a '/'
-  const auto& rootSepPos = std::get<1>(fileAndRootPos);
+  const auto& rootSepPos = fileAndRootPos.rootSepPos;
   if (rootSepPos == fpos) {
     SW_ASSERT(fpos == (size - 1));
     return StringClass(path_detail::kSepString, 1);
@@ -796,9 +898,9 @@ StringClass PosixPath::doParentPath() const {
   // thus be either a filename or a root-name.
 
   // Use the filename position and adjust appropriately
-  const auto& fileAndRootPos = path_detail::findFilenamePos(str, size);
-  const auto& fpos = std::get<0>(fileAndRootPos);
-  const auto& rootSepPos = std::get<1>(fileAndRootPos);
+  const auto fileAndRootPos = offsets();
+  const auto& fpos = fileAndRootPos.filenamePos;
+  const auto& rootSepPos = fileAndRootPos.rootSepPos;
   // If it's a file with no parent, return ""
   if (fpos == 0) {
     return StringClass(path_detail::kEmptyString, 0);  // NOLINT Yes creating an empty
@@ -860,11 +962,8 @@ StringClass PosixPath::doRootName() const {
 /// Returns either '/' if the path has a root dir, or '' if not.
 template <typename StringClass>
 StringClass PosixPath::doRootDir() const {
-  const auto size = _pstr.size();
-  const auto* str = _pstr.data();
-
   // Look for the root dir position. If we have one, we can return the slash
-  const auto& rootDirPos = path_detail::findRootDirPos(str, size);
+  const auto rootDirPos = offsets().rootDirPos;
   const auto& result = rootDirPos == kNoPos ? StringClass(path_detail::kEmptyString, 0) :
                                               StringClass(path_detail::kSepString, 1);
   return result;
@@ -939,8 +1038,7 @@ StringClass PosixPath::doRelativePath() const {
 template <typename StringClass>
 StringClass PosixPath::doExtension() const {
   const auto* str = _pstr.data();
-  const auto size = _pstr.size();
-  const auto extPos = path_detail::findExtensionPos(str, size);
+  const auto extPos = offsets().extensionPos;
   const auto& result = (extPos == kNoPos) ? StringClass(path_detail::kEmptyString, 0) :
                                             StringClass(str + extPos, _pstr.size() - extPos);
   return result;
@@ -1254,7 +1352,7 @@ private:
   PathSegment onSectionFilename() {
     auto str = _pstr.data() + _pos;
     auto endPos = _pstr.size() - _pos;
-    const auto nextSepPos = findNextSep(str, endPos, 3);
+    const auto nextSepPos = findNextSep(str, endPos, 1);
     const auto fnameLen = nextSepPos == kNoPos ? endPos : nextSepPos;
 
     _pos += fnameLen;
@@ -1461,6 +1559,106 @@ inline std::tuple<sizex, sizex> findFilenamePos(const char* str, sizex endPos) {
   return result;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// Lexically normalizes `str` in place, following the std::filesystem::path::lexically_normal
+/// algorithm (see PosixPath::lexically_normal). The normal form is never longer than the
+/// input, so it's written over the input as it's read and nothing is allocated. Kept segments
+/// are always ".." segments followed by named ones, which means the output itself works as the
+/// segment stack.
+///
+/// @param full Use the lexically_full_normal rules: no trailing separator, and "" instead of "."
+inline void normalizeInPlace(std::string& str, bool full) {
+  const auto size = str.size();
+  if (size == 0) {
+    return;
+  }
+
+  // The root name and root dir stay where they are
+  auto data = &str[0];
+  sizex base = 0;
+  if (isDriveRoot(data, size)) {
+    base = kDriveRootPos;
+  } else if (isNetworkRoot(data, size)) {
+    const auto netSepPos = findNetworkRootSep(data, size);
+    base = netSepPos == kNoPos ? size : netSepPos;
+  }
+  const bool hasRootDir = base < size && data[base] == kSep;
+  if (hasRootDir) {
+    ++base;
+  }
+
+  sizex read = base;
+  sizex write = base;
+  sizex named = 0;          // Kept segments other than ".."
+  bool endsAsDir = false;   // The input ends with a separator, "." or "x/.."
+  while (read < size) {
+    if (data[read] == kSep) {
+      ++read;
+      endsAsDir = true;
+      continue;
+    }
+
+    const auto start = read;
+    while (read < size && data[read] != kSep) {
+      ++read;
+    }
+    const auto len = read - start;
+
+    // Drop dots, and dot-dots along with the named segment before them or right after a root dir
+    if (len == 1 && data[start] == kDot) {
+      endsAsDir = true;
+      continue;
+    }
+    if (len == 2 && data[start] == kDot && data[start + 1] == kDot) {
+      if (named > 0) {
+        while (write > base && data[write - 1] != kSep) {
+          --write;
+        }
+        if (write > base) {
+          --write;
+        }
+        --named;
+        endsAsDir = true;
+        continue;
+      }
+      if (hasRootDir) {
+        endsAsDir = true;
+        continue;
+      }
+    } else {
+      ++named;
+    }
+
+    // Keep the segment. There's always room for the separator since we consumed at least one
+    if (write > base) {
+      data[write++] = kSep;
+    }
+    std::memmove(data + write, data + start, len);
+    write += len;
+    endsAsDir = false;
+  }
+
+  if (write == base) {
+    // A relative path with nothing left is ".". A root is left as is.
+    if (base == 0 && !full) {
+      data[write++] = kDot;
+    }
+  } else if (endsAsDir && named > 0 && !full) {
+    data[write++] = kSep;
+  }
+  str.resize(write);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Does all the scans for PathOffsets
+inline PathOffsets findPathOffsets(const char* str, sizex endPos) {
+  PathOffsets offsets;
+  std::tie(offsets.filenamePos, offsets.rootSepPos) = findFilenamePos(str, endPos);
+  offsets.rootDirPos = findRootDirPos(str, endPos);
+  offsets.extensionPos = findExtensionPos(str, endPos);
+  return offsets;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// This will be the public facing iterator
 ///
@@ -1476,7 +1674,7 @@ class PathIterator {
   static constexpr sizex kNoPos = ~0_z;
   using PathType = std::conditional_t<kIsConst, const PosixPath, PosixPath>;
   using NonConstPathType = PosixPath;
-  using PathVec = std::vector<PathType>;
+  using PathVec = std::vector<PosixPath>;
 
 public:
   using iterator_category = std::forward_iterator_tag;
@@ -1488,8 +1686,9 @@ public:
   ~PathIterator() = default;
   PathIterator(const PosixPath& path, sizex pos) : _path(&path), _current(pos) {}
 
-  PathIterator(const PathIterator& that) : _path(that._path), _current(that._current) {}
+  PathIterator(const PathIterator& that) : _segments(that._segments), _path(that._path), _current(that._current) {}
   PathIterator operator=(const PathIterator& that) {
+    _segments = that._segments;
     _path = that._path;
     _current = that._current;
     return *this;
@@ -1499,14 +1698,16 @@ public:
   //  PathIterator(PathIterator&& that) = default;
   //  PathIterator& operator=(PathIterator&& that) = default;
 
-  /// Gets the path segments. Will create if needed
-  PathVec& segments() {
+  /// Gets the path segments. Will create if needed. Copies of the iterator share them, so
+  /// the path is only split once however many copies get made.
+  const PathVec& segments() {
     if (!_segments) {
       auto iter = PathSegmentIterator(_path->u8());
-      _segments = std::make_unique<PathVec>();
+      auto segments = std::make_shared<PathVec>();
       for (auto segment = iter.begin(); segment != iter.end(); segment = iter.next()) {
-        _segments->emplace_back(segment.str);
+        segments->emplace_back(segment.str);
       }
+      _segments = std::move(segments);
     }
     return *_segments;
   }
@@ -1566,7 +1767,7 @@ public:
 private:
   // Going to use an SP to a vector so that default construction avoids
   // any allocation. Think 'end()' call. Cheaper copies, etc.
-  std::unique_ptr<std::vector<NonConstPathType>> _segments;
+  std::shared_ptr<const PathVec> _segments;
   const PosixPath* _path = nullptr;
   sizex _current = ~0_z;
 };
@@ -1588,120 +1789,8 @@ private:
 /// 7 If the last filename is dot-dot, remove any trailing directory-separator.
 /// 8 If the path is empty, add a dot (normal form of ./ is .)
 inline PosixPath PosixPath::lexically_normal() const {
-  namespace pd = path_detail;
-
-  // Handle #1
-  if (empty()) {
-    return *this;
-  }
-
-  // This will essentially be a stack form of the path. We'll use the iterator to build it
-  std::vector<pd::PathSegment> segments;
-  segments.reserve(32);
-
-  /// #2 and #3 happens automatically from iterator
-  /// Gets the previous segment. Returns End if there is no previous segment
-  const auto& prevSegment = [&]() {
-    const auto& result = segments.empty() ? pd::PathSegmentIterator::endSegment() :
-                                            (segments.size() > 1 ? segments[segments.size() - 2] :
-                                                                   pd::PathSegmentIterator::endSegment());
-    return result;
-  };
-
-  /// Iterate and process
-  pd::PathSegmentIterator iter(*this);
-  pd::PathSection lastSection = pd::PathSection::None;
-  bool concatFinalSep = false;
-  for (auto segment = iter.begin(); segment != iter.end(); segment = iter.next()) {
-    switch (segment.section) {
-    case pd::PathSection::Dot:
-      break;  // #4. Just ignore any dot we find
-
-    // Dotdot has a various implications.
-    case pd::PathSection::DotDot: {
-      // #5. If we have a preceeding filename, we can get rid of it. Otherwise we must add the ".."
-      // #6 If there is root-directory, remove all dot-dots ... immediately following them.
-      switch (prevSegment().section) {
-      case pd::PathSection::Filename:
-        segments.pop_back();
-        break;
-      case pd::PathSection::RootDir:
-        break;  // Don't add the ".." if it's preceeded by the root dir
-      default:
-        segments.push_back(segment);
-      }
-      break;
-    }
-
-    case pd::PathSection::RootDir:
-    case pd::PathSection::RootName:
-    case pd::PathSection::Filename: {
-      segments.push_back(segment);
-      break;
-    }
-
-    case pd::PathSection::FinalSep: {
-      // #7 If the last filename is dot-dot, remove any trailing directory-separator.
-      // Also, #8, "./" should be "."
-      // Instead of adding the final-sep segment, we just flag it. The reason here is so we can
-      // reconstruct the final path entirely using "/=". If it we added the "/", it would be
-      // treated as absolute and mess it all up
-      if (prevSegment().section != pd::PathSection::DotDot && lastSection != pd::PathSection::Dot) {
-        concatFinalSep = true;
-      }
-      break;
-    }
-
-    // None of these should occur
-    case pd::PathSection::Sep:
-    case pd::PathSection::None:
-    case pd::PathSection::End: {
-      SW_ASSERT(false);
-      break;
-    }
-    }
-
-    lastSection = segment.section;
-  }
-
-  // #8 If the path is empty, add a dot (normal form of ./ is .)
-  if (segments.empty()) {
-    return pd::kDotString;
-  }
-
-  // If the last thing we saw in the path was '.', then we need to check for the form
-  // of "/x/." which should norm to "/x/". Without this check we get "/x".
-  if (lastSection == pd::PathSection::Dot && segments.back().section != pd::PathSection::RootDir) {
-    concatFinalSep = true;
-  }
-
-  // Guess the size to limit the result allocations. Should always be >= actual. Include space
-  // for separators by adding segments.size()
-  const auto sizeGuess =
-      segments.size() + (concatFinalSep ? 1 : 0) +
-      std::accumulate(segments.begin(), segments.end(), 0_z,
-                      [](sizex total, const auto& segment) { return total + segment.str.size(); });
-
-  // Now construct the result via the final stack
-  PosixPath result;
-  result._pstr.reserve(sizeGuess);
-  for (const auto& segment : segments) {
-    if (segment.section == pd::PathSection::RootDir) {
-      // Can't use /= for root-dir separator - it will wipe out a dir-name if we had one since it's abs
-      result += segment.str;
-    } else {
-      result /= segment.str;
-    }
-  }
-
-  // And the final sep as needed
-  if (concatFinalSep) {
-    result += kSep;
-  }
-
-  // This is not a critical issue - just adjust the sizeGuess if this is ever triggered
-  SW_ASSERT(sizeGuess >= result._pstr.size());
-
+  auto result = *this;
+  result.doNormalize(false);
   return result;
 }
 
@@ -1722,102 +1811,65 @@ inline PosixPath PosixPath::lexically_normal() const {
 ///    './///' -> ''
 /// @return
 inline PosixPath PosixPath::lexically_full_normal() const {
-  namespace pd = path_detail;
+  auto result = *this;
+  result.doNormalize(true);
+  return result;
+}
 
-  // Handle #1
-  if (empty()) {
-    return *this;
+////////////////////////////////////////////////////////////////////////////////
+/// Normalize each of the paths in place. The ones already known to be normalized are skipped.
+inline void normalizeAll(PosixPath* paths, sizex count) {
+  for (sizex i = 0; i < count; ++i) {
+    paths[i].normalize();
   }
+}
 
-  // This will essentially be a stack form of the path. We'll use the iterator to build it
-  std::vector<pd::PathSegment> segments;
-  segments.reserve(32);
-
-  /// #2 and #3 happens automatically from iterator
-  /// Gets the previous segment. Returns End if there is no previous segment
-  const auto& prevSegment = [&]() {
-    const auto& result = segments.empty() ? pd::PathSegmentIterator::endSegment() :
-                                            (segments.size() > 1 ? segments[segments.size() - 2] :
-                                                                   pd::PathSegmentIterator::endSegment());
-    return result;
-  };
-
-  /// Iterate and process
-  pd::PathSegmentIterator iter(*this);
-  pd::PathSection lastSection = pd::PathSection::None;
-  for (auto segment = iter.begin(); segment != iter.end(); segment = iter.next()) {
-    switch (segment.section) {
-    case pd::PathSection::Dot:
-      break;  // #4. Just ignore any dot we find
-
-      // Dotdot has a various implications.
-    case pd::PathSection::DotDot: {
-      // #5. If we have a preceeding filename, we can get rid of it. Otherwise we must add the ".."
-      // #6 If there is root-directory, remove all dot-dots ... immediately following them.
-      switch (prevSegment().section) {
-      case pd::PathSection::Filename:
-        segments.pop_back();
-        break;
-      case pd::PathSection::RootDir:
-        break;  // Don't add the ".." if it's preceeded by the root dir
-      default:
-        segments.push_back(segment);
-      }
-      break;
-    }
-
-    case pd::PathSection::RootDir:
-    case pd::PathSection::RootName:
-    case pd::PathSection::Filename: {
-      segments.push_back(segment);
-      break;
-    }
-
-    case pd::PathSection::FinalSep: {
-      break;
-    }
-
-      // None of these should occur
-    case pd::PathSection::Sep:
-    case pd::PathSection::None:
-    case pd::PathSection::End: {
-      SW_ASSERT(false);
-      break;
-    }
-    }
-
-    lastSection = segment.section;
+////////////////////////////////////////////////////////////////////////////////
+/// Make each of the paths absolute against `cwd` and normalize them, in place
+inline void absonormizeAll(PosixPath* paths, sizex count, const PosixPath& cwd) {
+  for (sizex i = 0; i < count; ++i) {
+    paths[i].absonormize(cwd);
   }
+}
 
-  // Don't turn "" into a dot
-  if (segments.empty()) {
-    return PosixPath{};
-  };
+namespace path_detail {
 
-  // Guess the size to limit the result allocations. Should always be >= actual. Include space
-  // for separators by adding segments.size()
-  const auto sizeGuess = segments.size() + std::accumulate(segments.begin(), segments.end(), 0_z,
-                                                           [](sizex total, const auto& segment) {
-                                                             return total + segment.str.size();
-                                                           });
+static constexpr sizex kBatchChunkSize = 1024;
 
-  // Now construct the result via the final stack
-  PosixPath result;
-  result._pstr.reserve(sizeGuess);
-  for (const auto& segment : segments) {
-    if (segment.section == pd::PathSection::RootDir) {
-      // Can't use /= for root-dir separator - it will wipe out a dir-name if we had one since it's abs
-      result += segment.str;
-    } else {
-      result /= segment.str;
-    }
-  }
+template <typename ParallelFor, typename Func>
+void forEachChunk(sizex count, sizex chunkSize, ParallelFor&& parallelFor, const Func& func) {
+  SW_ASSERT(chunkSize > 0);
+  const sizex chunks = (count + chunkSize - 1) / chunkSize;
+  parallelFor(chunks, [&](sizex chunk) {
+    const auto first = chunk * chunkSize;
+    func(first, std::min(count, first + chunkSize));
+  });
+}
 
-  // This is not a critical issue - just adjust the sizeGuess if this is ever triggered
-  SW_ASSERT(sizeGuess >= result._pstr.size());
+}  // namespace path_detail
 
-  return result;
+////////////////////////////////////////////////////////////////////////////////
+/// Parallel normalizeAll. The paths are split into chunks of `chunkSize`, which are handed to
+/// `parallelFor(chunkCount, task)`. It must call `task(i)` once for every i in [0, chunkCount),
+/// from any threads, and return once they've all finished.
+template <typename ParallelFor>
+void normalizeAll(PosixPath* paths, sizex count, ParallelFor&& parallelFor,
+                  sizex chunkSize = path_detail::kBatchChunkSize) {
+  path_detail::forEachChunk(count, chunkSize, parallelFor, [&](sizex first, sizex last) {
+    normalizeAll(paths + first, last - first);
+  });
 }
+
+////////////////////////////////////////////////////////////////////////////////
+/// Parallel absonormizeAll. See the parallel normalizeAll for the `parallelFor` contract.
+template <typename ParallelFor>
+void absonormizeAll(PosixPath* paths, sizex count, const PosixPath& cwd, ParallelFor&& parallelFor,
+                    sizex chunkSize = path_detail::kBatchChunkSize) {
+  path_detail::forEachChunk(count, chunkSize, parallelFor, [&](sizex first, sizex last) {
+    absonormizeAll(paths + first, last - first, cwd);
+  });
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 inline PosixPath::iterator PosixPath::begin() {
   return iterator(*this, empty() ? kNoPos : 0);
@@ -1844,3 +1896,13 @@ inline PosixPath::native_string_type PosixPath::native() const {
 }
 
 SW_NAMESPACE_END
+
+namespace std {
+
+////////////////////////////////////////////////////////////////////////////////
+template <>
+struct hash<::sw::PosixPath> {
+  size_t operator()(const ::sw::PosixPath& p) const noexcept { return ::sw::hash_value(p); }
+};
+
+}  // namespace std
@@ -23,8 +23,16 @@
 #include "move_copy_ops.h"
 #include "types.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <new>
 #include <type_traits>
+#include <vector>
+
+#if SW_POSIX
+#  include <sys/mman.h>
+#endif
 
 SW_NAMESPACE_BEGIN
 
@@ -59,15 +67,13 @@ public:
 ///
 /// Intended to map (loosely) to the std::allocator specs. Especially the newer versions
 /// that don't include construct/destroy.
+///
+/// Since realloc moves items by copying their bytes, this is only for trivially
+/// relocatable types (see IsTriviallyRelocatable). Containers construct and destroy them.
 template <typename T>
 class MallocReallocator {
 public:
-  static_assert(std::is_trivially_copyable<T>::value,
-                "MallocReallocator only works with trivially copyable types");
-  static_assert(std::is_trivially_constructible<T>::value,
-                "MallocReallocator only works with trivially constructable types");
-  static_assert(std::is_trivially_destructible<T>::value,
-                "MallocReallocator only works with trivially destructable types");
+  static_assert(IsTriviallyRelocatable<T>::value, "MallocReallocator only works with trivially relocatable types");
 
   using move_copy_ops = MoveCopyOps<T>;
   using value_type = T;
@@ -96,7 +102,11 @@ public:
   T* reallocate(T* oldAddr, sizex existingCount, sizex /*oldCount*/, sizex newCount) {
     (void)existingCount;
 
-    auto newBuffer = static_cast<T*>(std::realloc(oldAddr, newCount * sizeof(T)));
+    // Ensure no overflow
+    if (newCount > (~0_z / sizeof(T))) {
+      throw std::bad_alloc();
+    }
+    auto newBuffer = static_cast<T*>(std::realloc(static_cast<void*>(oldAddr), newCount * sizeof(T)));
     if (newBuffer == nullptr) {
       throw std::bad_alloc();
     }
@@ -145,4 +155,494 @@ public:
 template <typename T>
 using StdReallocator = ReallocatorAdapter<T>;
 
+////////////////////////////////////////////////////////////////////////////////
+/// # Overview
+/// A monotonic (bump-pointer) memory region. Allocating just moves a pointer along the
+/// current block and nothing is given back until `reset()` rewinds the whole region, which
+/// keeps the blocks for next time. So request-scoped scratch memory costs no mallocs once
+/// the arena has warmed up. Freeing or growing the most recent allocation works in place.
+///
+/// It can start in caller-provided memory (eg. a stack buffer), only going to the heap
+/// once that runs out. Not thread safe. Use through `ArenaReallocator`.
+////////////////////////////////////////////////////////////////////////////////
+class Arena {
+public:
+  static constexpr sizex kDefaultBlockSize = 64 * 1024;
+
+  explicit Arena(sizex blockSize = kDefaultBlockSize) noexcept : blockSize_(blockSize) {}
+
+  /// Start in `initialBuffer`, which must outlive the arena
+  Arena(void* initialBuffer, sizex initialSize, sizex blockSize = kDefaultBlockSize) : blockSize_(blockSize) {
+    blocks_.push_back(Block{static_cast<byte*>(initialBuffer), initialSize, false});
+    useBlock(0);
+  }
+
+  ~Arena() noexcept { release(); }
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Allocate uninitialized bytes. Zero bytes gives nullptr. Throws if there's a problem
+  void* allocate(sizex bytes, sizex alignment = alignof(std::max_align_t)) {
+    if (bytes == 0) {
+      return nullptr;
+    }
+
+    auto addr = alignUp(cursor_, alignment);
+    if (cursor_ == nullptr || addr > limit_ || bytes > static_cast<sizex>(limit_ - addr)) {
+      addr = allocateSlow(bytes, alignment);
+    }
+    last_ = addr;
+    cursor_ = addr + bytes;
+    return addr;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Resize an allocation without moving it. Only the most recent allocation can grow,
+  /// and only while there's room left in its block.
+  /// @return true if the allocation now has `newBytes`
+  bool tryResize(void* addr, sizex oldBytes, sizex newBytes) noexcept {
+    if (addr != nullptr && addr == last_ && last_ + oldBytes == cursor_) {
+      if (newBytes > static_cast<sizex>(limit_ - last_)) {
+        return false;
+      }
+      cursor_ = last_ + newBytes;
+      return true;
+    }
+    return newBytes <= oldBytes;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Only the most recent allocation is actually given back. Anything else waits for
+  /// `reset()`.
+  void deallocate(void* addr, sizex bytes) noexcept {
+    if (addr != nullptr && addr == last_ && last_ + bytes == cursor_) {
+      cursor_ = last_;
+      last_ = nullptr;
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Throw away every allocation, keeping the blocks for reuse
+  void reset() noexcept {
+    last_ = nullptr;
+    if (blocks_.empty()) {
+      cursor_ = limit_ = nullptr;
+    } else {
+      useBlock(0);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Throw away every allocation, and give the heap blocks back
+  void release() noexcept {
+    blocks_.erase(std::remove_if(blocks_.begin(), blocks_.end(),
+                                 [](const Block& block) {
+                                   if (block.owned) {
+                                     std::free(block.data);
+                                   }
+                                   return block.owned;
+                                 }),
+                  blocks_.end());
+    reset();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the total size of the blocks, used or not
+  sizex capacity() const noexcept {
+    sizex total = 0;
+    for (const auto& block : blocks_) {
+      total += block.size;
+    }
+    return total;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  sizex blockCount() const noexcept { return blocks_.size(); }
+
+private:
+  struct Block {
+    byte* data;
+    sizex size;
+    bool owned;  ///< false for the caller's initial buffer
+  };
+
+  static byte* alignUp(byte* addr, sizex alignment) noexcept {
+    const auto value = reinterpret_cast<std::uintptr_t>(addr);
+    return reinterpret_cast<byte*>((value + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1));
+  }
+
+  void useBlock(sizex index) noexcept {
+    current_ = index;
+    cursor_ = blocks_[index].data;
+    limit_ = cursor_ + blocks_[index].size;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Move on to the next kept block with room, or get a new one
+  byte* allocateSlow(sizex bytes, sizex alignment) {
+    const auto fits = [&](const Block& block) {
+      auto addr = alignUp(block.data, alignment);
+      return addr <= block.data + block.size && bytes <= static_cast<sizex>(block.data + block.size - addr);
+    };
+
+    const auto first = cursor_ == nullptr ? 0 : current_ + 1;
+    for (auto i = first; i < blocks_.size(); ++i) {
+      if (fits(blocks_[i])) {
+        useBlock(i);
+        return alignUp(cursor_, alignment);
+      }
+    }
+
+    // Big allocations get a block to themselves
+    const auto size = std::max(blockSize_, bytes + alignment);
+    if (size < bytes) {
+      throw std::bad_alloc();
+    }
+    blocks_.reserve(blocks_.size() + 1);
+    auto data = static_cast<byte*>(std::malloc(size));
+    if (data == nullptr) {
+      throw std::bad_alloc();
+    }
+    blocks_.push_back(Block{data, size, true});
+    useBlock(blocks_.size() - 1);
+    return alignUp(cursor_, alignment);
+  }
+
+private:
+  std::vector<Block> blocks_;
+  sizex blockSize_;
+  sizex current_ = 0;
+  byte* cursor_ = nullptr;
+  byte* limit_ = nullptr;
+  byte* last_ = nullptr;  ///< The most recent allocation
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// A stateful reallocator handing out memory from an Arena, which must outlive it (and
+/// anything using it). Growing the most recent allocation is done in place, which makes a
+/// vector being filled from an arena nearly free. Works for any type, moving items when
+/// an allocation can't grow in place.
+template <typename T>
+class ArenaReallocator {
+public:
+  using move_copy_ops = MoveCopyOps<T>;
+  using value_type = T;
+
+  explicit ArenaReallocator(Arena& arena) noexcept : arena_(&arena) {}
+
+  /// Rebind from a reallocator for another type on the same arena
+  template <typename U>
+  explicit ArenaReallocator(const ArenaReallocator<U>& that) noexcept : arena_(&that.arena()) {}
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// See std:allocator::allocate. Throws if there's a problem
+  T* allocate(sizex count) { return static_cast<T*>(arena_->allocate(byteCount(count), alignof(T))); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  void deallocate(T* addr, sizex count) noexcept { arena_->deallocate(addr, count * sizeof(T)); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// This will return an array with space for newCount items, holding the 'existingCount'
+  /// items from oldAddr. That's oldAddr itself whenever the arena can grow it in place.
+  T* reallocate(T* oldAddr, sizex existingCount, sizex oldCount, sizex newCount) {
+    if (oldAddr != nullptr && arena_->tryResize(oldAddr, oldCount * sizeof(T), byteCount(newCount))) {
+      return oldAddr;
+    }
+
+    auto newAddr = allocate(newCount);
+    if (oldAddr != nullptr) {
+      move_copy_ops::moveConstructAndDeleteItems(newAddr, oldAddr, existingCount);
+      deallocate(oldAddr, oldCount);
+    }
+    return newAddr;
+  }
+
+  Arena& arena() const noexcept { return *arena_; }
+
+  friend bool operator==(const ArenaReallocator& lhs, const ArenaReallocator& rhs) noexcept {
+    return lhs.arena_ == rhs.arena_;
+  }
+  friend bool operator!=(const ArenaReallocator& lhs, const ArenaReallocator& rhs) noexcept { return !(lhs == rhs); }
+
+private:
+  static sizex byteCount(sizex count) {
+    // Ensure no overflow
+    if (count > (~0_z / sizeof(T))) {
+      throw std::bad_alloc();
+    }
+    return count * sizeof(T);
+  }
+
+  Arena* arena_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Reallocator with room for `N` items inside itself, only going to the `Fallback`
+/// reallocator for anything bigger. Since the storage lives wherever the reallocator
+/// does, it's meant to be embedded in a container (see SmallVector), which has to move
+/// inline items itself. Copies of it never share the inline storage.
+template <typename T, sizex N, typename Fallback>
+class InlineReallocator : private Fallback {
+public:
+  using move_copy_ops = MoveCopyOps<T>;
+  using value_type = T;
+  using fallback_type = Fallback;
+
+  explicit InlineReallocator(const Fallback& fallback = Fallback()) noexcept : Fallback(fallback) {}
+  InlineReallocator(const InlineReallocator& that) noexcept : Fallback(that.fallback()) {}
+
+  InlineReallocator& operator=(const InlineReallocator& that) noexcept {
+    static_cast<Fallback&>(*this) = that.fallback();
+    return *this;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Allocate inline if it fits and isn't taken already
+  T* allocate(sizex count) {
+    if (count <= N && !inUse_) {
+      inUse_ = true;
+      return inlineData();
+    }
+    return Fallback::allocate(count);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  void deallocate(T* addr, sizex count) noexcept {
+    if (addr == inlineData()) {
+      inUse_ = false;
+    } else {
+      Fallback::deallocate(addr, count);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Stays inline while it fits. Growing past it moves the items to the fallback.
+  T* reallocate(T* oldAddr, sizex existingCount, sizex oldCount, sizex newCount) {
+    if (oldAddr == nullptr) {
+      return allocate(newCount);
+    }
+    if (oldAddr != inlineData()) {
+      return Fallback::reallocate(oldAddr, existingCount, oldCount, newCount);
+    }
+    if (newCount <= N) {
+      return oldAddr;
+    }
+
+    auto newAddr = Fallback::allocate(newCount);
+    move_copy_ops::moveConstructAndDeleteItems(newAddr, oldAddr, existingCount);
+    inUse_ = false;
+    return newAddr;
+  }
+
+  bool isInline(const T* addr) const noexcept { return addr == inlineData(); }
+  const Fallback& fallback() const noexcept { return *this; }
+
+private:
+  T* inlineData() noexcept { return reinterpret_cast<T*>(&storage_); }
+  const T* inlineData() const noexcept { return reinterpret_cast<const T*>(&storage_); }
+
+  typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type storage_;
+  bool inUse_ = false;
+};
+
+#if SW_POSIX
+namespace reallocator_detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// mmap won't take empty mappings
+constexpr sizex mappedLength(sizex bytes) noexcept { return bytes == 0 ? 1 : bytes; }
+
+inline void adviseHugePages(void* addr, sizex bytes) noexcept {
+#  if defined(MADV_HUGEPAGE)
+  ::madvise(addr, mappedLength(bytes), MADV_HUGEPAGE);
+#  else
+  (void)addr;
+  (void)bytes;
+#  endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Map zeroed anonymous pages. Throws if there's a problem
+inline void* mapPages(sizex bytes, bool hugePages) {
+  auto addr = ::mmap(nullptr, mappedLength(bytes), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  if (hugePages) {
+    adviseHugePages(addr, bytes);
+  }
+  return addr;
+}
+
+inline void unmapPages(void* addr, sizex bytes) noexcept { ::munmap(addr, mappedLength(bytes)); }
+
+////////////////////////////////////////////////////////////////////////////////
+/// Resize a mapping from `mapPages()`, keeping the first `existingBytes`. Linux moves the
+/// pages with mremap so nothing is copied.
+inline void* remapPages(void* addr, sizex existingBytes, sizex oldBytes, sizex newBytes, bool hugePages) {
+#  if SW_LINUX
+  (void)existingBytes;
+  auto newAddr = ::mremap(addr, mappedLength(oldBytes), mappedLength(newBytes), MREMAP_MAYMOVE);
+  if (newAddr == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  if (hugePages) {
+    adviseHugePages(newAddr, newBytes);
+  }
+  return newAddr;
+#  else
+  auto newAddr = mapPages(newBytes, hugePages);
+  std::memcpy(newAddr, addr, std::min(existingBytes, newBytes));
+  unmapPages(addr, oldBytes);
+  return newAddr;
+#  endif
+}
+
+}  // namespace reallocator_detail
+
+////////////////////////////////////////////////////////////////////////////////
+/// Reallocator that takes pages straight from the kernel with mmap. Suits big buffers:
+/// untouched pages cost nothing, and freeing gives the memory back right away. Since
+/// `deallocate()` is just an munmap, it also owns the file mappings from `mapFile()`.
+/// Linux grows buffers with mremap instead of copying.
+///
+/// @tparam kHugePages Ask for transparent huge pages, cutting TLB misses on big buffers
+template <typename T, bool kHugePages = false>
+class MmapReallocator {
+public:
+  static_assert(IsTriviallyRelocatable<T>::value, "MmapReallocator only works with trivially relocatable types");
+
+  using move_copy_ops = MoveCopyOps<T>;
+  using value_type = T;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  void deallocate(T* addr, sizex count) noexcept { reallocator_detail::unmapPages(addr, count * sizeof(T)); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Allocate zeroed pages. Throws if there's a problem
+  T* allocate(sizex count) { return static_cast<T*>(reallocator_detail::mapPages(byteCount(count), kHugePages)); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// This will return a new array that has 'existingCount' count items copied from
+  /// the given oldAddr. The new buffer will have space for newCount items
+  T* reallocate(T* oldAddr, sizex existingCount, sizex oldCount, sizex newCount) {
+    if (oldAddr == nullptr) {
+      return allocate(newCount);
+    }
+    return static_cast<T*>(reallocator_detail::remapPages(oldAddr, existingCount * sizeof(T), oldCount * sizeof(T),
+                                                          byteCount(newCount), kHugePages));
+  }
+
+private:
+  static sizex byteCount(sizex count) {
+    // Ensure no overflow
+    if (count > (~0_z / sizeof(T))) {
+      throw std::bad_alloc();
+    }
+    return count * sizeof(T);
+  }
+};
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// Reallocator for buffers that can get big. Below `kMapThreshold` bytes it's just
+/// malloc/realloc, but from there up it maps pages directly and grows them with mremap,
+/// so growing a huge vector moves page table entries instead of copying every byte. The
+/// mmap side needs POSIX, and everything stays on malloc elsewhere.
+///
+/// Whether an allocation is mapped follows from its size, so the counts given back to
+/// `deallocate()` and `reallocate()` must be the ones allocated, just as Vector does.
+///
+/// @tparam kMapThreshold Allocations of at least this many bytes get mapped
+/// @tparam kHugePages Ask for transparent huge pages for the mapped allocations
+template <typename T, sizex kMapThreshold = 4 * 1024 * 1024, bool kHugePages = false>
+class LargeReallocator {
+public:
+  static_assert(IsTriviallyRelocatable<T>::value, "LargeReallocator only works with trivially relocatable types");
+
+  using move_copy_ops = MoveCopyOps<T>;
+  using value_type = T;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  void deallocate(T* addr, sizex count) noexcept {
+#if SW_POSIX
+    if (isMapped(count)) {
+      reallocator_detail::unmapPages(addr, count * sizeof(T));
+      return;
+    }
+#endif
+    std::free(addr);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Allocate the buffer. Throws if there's a problem
+  T* allocate(sizex count) {
+    const auto bytes = byteCount(count);
+#if SW_POSIX
+    if (isMapped(count)) {
+      return static_cast<T*>(reallocator_detail::mapPages(bytes, kHugePages));
+    }
+#endif
+    auto addr = static_cast<T*>(std::malloc(bytes));
+    if (addr == nullptr) {
+      throw std::bad_alloc();
+    }
+    return addr;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// This will return a new array that has 'existingCount' count items copied from
+  /// the given oldAddr. The new buffer will have space for newCount items
+  T* reallocate(T* oldAddr, sizex existingCount, sizex oldCount, sizex newCount) {
+    if (oldAddr == nullptr) {
+      return allocate(newCount);
+    }
+
+    const auto newBytes = byteCount(newCount);
+    const auto wasMapped = isMapped(oldCount);
+    const auto mapped = isMapped(newCount);
+    if (!wasMapped && !mapped) {
+      auto newAddr = static_cast<T*>(std::realloc(oldAddr, newBytes));
+      if (newAddr == nullptr) {
+        throw std::bad_alloc();
+      }
+      return newAddr;
+    }
+#if SW_POSIX
+    if (wasMapped && mapped) {
+      return static_cast<T*>(reallocator_detail::remapPages(oldAddr, existingCount * sizeof(T), oldCount * sizeof(T),
+                                                            newBytes, kHugePages));
+    }
+#endif
+
+    // Crossing the threshold: this is the only copy a growing buffer sees
+    auto newAddr = allocate(newCount);
+    std::memcpy(newAddr, oldAddr, std::min(existingCount, newCount) * sizeof(T));
+    deallocate(oldAddr, oldCount);
+    return newAddr;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return true if an allocation of `count` items is mapped rather than malloc'd
+  static constexpr bool isMapped(sizex count) noexcept {
+#if SW_POSIX
+    return count >= (kMapThreshold + sizeof(T) - 1) / sizeof(T);
+#else
+    (void)count;
+    return false;
+#endif
+  }
+
+private:
+  static sizex byteCount(sizex count) {
+    // Ensure no overflow
+    if (count > (~0_z / sizeof(T))) {
+      throw std::bad_alloc();
+    }
+    return count * sizeof(T);
+  }
+};
+
 SW_NAMESPACE_END
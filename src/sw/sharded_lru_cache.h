@@ -0,0 +1,641 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <sw/assert.h>
+#include <sw/fixed_width_int_literals.h>
+#include <sw/lru_cache.h>
+#include <sw/types.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <vector>
+
+SW_NAMESPACE_BEGIN
+
+using namespace sw::intliterals;
+
+////////////////////////////////////////////////////////////////////////////////
+/// How a sharded cache applies recency updates for lookup hits.
+/// * Immediate: A hit takes the shard lock exclusively and moves the item to the front,
+///   exactly like `LruCache::get()`.
+/// * Deferred: A hit takes the shard lock shared, does a read-only lookup, and only records
+///   the access in a small per-shard read buffer. The recorded promotions are applied in
+///   a batch under the exclusive lock: before any write to the shard, during `purge()`, or
+///   when the buffer fills and the lock happens to be free. The buffer is lossy, so with
+///   heavy read traffic some promotions are dropped. That's fine for recency, and it keeps
+///   hits from writing to the shared list.
+enum class LruPromotion : u8 { Immediate, Deferred };
+
+namespace lru_detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// Number of bits needed to index the given power-of-two shard count
+constexpr sizex shardBits(sizex shards) {
+  return shards <= 1 ? 0 : 1 + shardBits(shards >> 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Does the cache have a `kTransparentLookup` that's true? See `FlatLruCache`.
+template <typename Cache, typename = void>
+struct HasTransparentLookup : std::false_type {};
+
+template <typename Cache>
+struct HasTransparentLookup<Cache, typename std::enable_if<Cache::kTransparentLookup>::type> : std::true_type {};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Calls `cache.prefetch(key)` for caches that have it, otherwise does nothing
+template <typename Cache, typename K>
+auto prefetchKey(const Cache& cache, const K& key, int) -> decltype(cache.prefetch(key), void()) {
+  cache.prefetch(key);
+}
+
+template <typename Cache, typename K>
+void prefetchKey(const Cache&, const K&, long) {}
+
+template <typename Cache, LruPromotion kPromotion>
+class LruShard;
+
+////////////////////////////////////////////////////////////////////////////////
+/// Shard that promotes immediately. Everything goes through a single mutex.
+template <typename Cache>
+class LruShard<Cache, LruPromotion::Immediate> {
+public:
+  using KeyType = typename Cache::KeyType;
+  using ValueType = typename Cache::ValueType;
+
+  /// Calls `func(Cache&)` under the exclusive lock
+  template <typename Func>
+  auto write(Func&& func) -> decltype(func(std::declval<Cache&>())) {
+    MutexLock lock(lock_);
+    return func(cache_);
+  }
+
+  /// Calls `func(const Cache&)` under the lock. Must not change recency.
+  template <typename Func>
+  auto read(Func&& func) const -> decltype(func(std::declval<const Cache&>())) {
+    MutexLock lock(lock_);
+    return func(cache_);
+  }
+
+  template <typename K>
+  bool get(const K& key, ValueType& value) {
+    MutexLock lock(lock_);
+    return cache_.get(key, value);
+  }
+
+  /// Looks up `keys[indexes[i]]` for each `i < count` under a single lock. Calls
+  /// `onHit(index, value)` for each key that's found.
+  template <typename K, typename OnHit>
+  void getMany(const K* keys, const u32* indexes, sizex count, OnHit&& onHit) {
+    MutexLock lock(lock_);
+    for (sizex i = 0; i < count; ++i) {
+      prefetchKey(cache_, keys[indexes[i]], 0);
+    }
+    for (sizex i = 0; i < count; ++i) {
+      auto iter = cache_.find(keys[indexes[i]]);
+      if (iter != cache_.end()) {
+        onHit(indexes[i], iter.value());
+      }
+    }
+  }
+
+private:
+  mutable std::mutex lock_;
+  Cache cache_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Shard that defers promotion on hits. See `LruPromotion::Deferred`.
+///
+/// The read buffer holds cache iterators, which is only safe because every exclusive
+/// access drains the buffer *before* touching the cache. So nothing can be erased (or the
+/// map rehashed) while there are recorded iterators.
+template <typename Cache>
+class LruShard<Cache, LruPromotion::Deferred> {
+  using ConstIterator = typename Cache::ConstIterator;
+  using WriteLock = std::lock_guard<std::shared_timed_mutex>;
+  using ReadLock = std::shared_lock<std::shared_timed_mutex>;
+
+public:
+  using KeyType = typename Cache::KeyType;
+  using ValueType = typename Cache::ValueType;
+
+  /// Sized to cover a burst of hits without making the drain too long
+  static constexpr sizex kReadBufferSize = 32;
+
+  /// Calls `func(Cache&)` under the exclusive lock, after applying any recorded reads
+  template <typename Func>
+  auto write(Func&& func) -> decltype(func(std::declval<Cache&>())) {
+    WriteLock lock(lock_);
+    drainReads();
+    return func(cache_);
+  }
+
+  /// Calls `func(const Cache&)` under the shared lock. Must not change recency.
+  template <typename Func>
+  auto read(Func&& func) const -> decltype(func(std::declval<const Cache&>())) {
+    ReadLock lock(lock_);
+    return func(cache_);
+  }
+
+  template <typename K>
+  bool get(const K& key, ValueType& value) {
+    bool isFull = false;
+    {
+      ReadLock lock(lock_);
+      const auto iter = cache_.peek(key);
+      if (iter == cache_.cend())
+        return false;
+
+      value = iter.value();
+      isFull = !recordRead(iter);
+    }
+
+    if (isFull) {
+      tryDrainReads();
+    }
+    return true;
+  }
+
+  /// Same as the immediate shard's `getMany()`, but under the shared lock
+  template <typename K, typename OnHit>
+  void getMany(const K* keys, const u32* indexes, sizex count, OnHit&& onHit) {
+    bool isFull = false;
+    {
+      ReadLock lock(lock_);
+      for (sizex i = 0; i < count; ++i) {
+        prefetchKey(cache_, keys[indexes[i]], 0);
+      }
+      for (sizex i = 0; i < count; ++i) {
+        const auto iter = cache_.peek(keys[indexes[i]]);
+        if (iter != cache_.cend()) {
+          onHit(indexes[i], iter.value());
+          isFull = !recordRead(iter) || isFull;
+        }
+      }
+    }
+
+    if (isFull) {
+      tryDrainReads();
+    }
+  }
+
+private:
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Opportunistic drain. Never wait on writers or other readers for this
+  void tryDrainReads() {
+    if (lock_.try_lock()) {
+      drainReads();
+      lock_.unlock();
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Record a hit. Must hold the shared lock. Readers claim distinct slots, so the
+  /// writes don't race, and the exclusive lock in `drainReads()` makes them visible.
+  /// @return false if the buffer is now full and should be drained
+  bool recordRead(const ConstIterator& iter) {
+    const auto slot = readCount_.fetch_add(1, std::memory_order_relaxed);
+    if (slot >= kReadBufferSize)
+      return false;
+
+    reads_[slot] = iter;
+    return slot + 1 < kReadBufferSize;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Apply recorded hits, oldest first. Must hold the exclusive lock.
+  void drainReads() {
+    const auto count = std::min(readCount_.load(std::memory_order_relaxed), kReadBufferSize);
+    for (sizex i = 0; i < count; ++i) {
+      cache_.refresh(reads_[i]);
+    }
+    readCount_.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  mutable std::shared_timed_mutex lock_;
+  Cache cache_;
+  std::atomic<sizex> readCount_{0};
+  std::array<ConstIterator, kReadBufferSize> reads_;
+};
+
+template <typename Cache>
+constexpr sizex LruShard<Cache, LruPromotion::Deferred>::kReadBufferSize;
+
+}  // namespace lru_detail
+
+////////////////////////////////////////////////////////////////////////////////
+/// # Overview
+/// A thread-safe cache built from a fixed number of independent single-threaded caches
+/// (shards). Each shard has its own lock and its own slice of the maximum size, so threads
+/// working on keys in different shards never contend with each other.
+///
+/// Keys are routed to a shard by re-mixing the hash from the cache's own hasher type. The
+/// shard's map consumes the low bits of that same hash, so the top bits of a fibonacci hash
+/// are used for the shard index to keep the two from correlating.
+///
+/// Recency and eviction are per-shard. ie. the least recently used item in the shard is
+/// purged, which is not necessarily the least recently used item in the whole cache. For
+/// reasonably distributed keys that's close enough, and it's what removes the global lock.
+///
+/// There are no iterators or `operator[]` since a reference can't safely outlive the shard
+/// lock. Use `get()` to copy out, or `visit()` to operate on the value under the lock.
+///
+/// For read-mostly workloads use `LruPromotion::Deferred` so that hits only take a shared
+/// lock. The per-shard cache must then support `peek()` and `refresh(ConstIterator)`.
+///
+/// @tparam Cache The per-shard cache type (eg. `LruCache<Key, T>`)
+/// @tparam kShards Number of shards. Must be a power of two.
+/// @tparam kPromotion How recency updates are applied for hits
+////////////////////////////////////////////////////////////////////////////////
+template <typename Cache, sizex kShards = 16, LruPromotion kPromotion = LruPromotion::Immediate>
+class ShardedLruCacheType {
+  static_assert(kShards > 0 && (kShards & (kShards - 1)) == 0, "kShards must be a power of two");
+
+  using Shard = lru_detail::LruShard<Cache, kPromotion>;
+
+  /// Enables the heterogeneous lookups when the shard cache supports them
+  template <typename K>
+  using TransparentKey = typename std::enable_if<lru_detail::HasTransparentLookup<Cache>::value &&
+                                                 !std::is_same<K, typename Cache::KeyType>::value>::type;
+
+  /// Any key type a lookup accepts
+  template <typename K>
+  using LookupKey = typename std::enable_if<lru_detail::HasTransparentLookup<Cache>::value ||
+                                            std::is_same<K, typename Cache::KeyType>::value>::type;
+
+  /// Shift to take the top bits of the 64-bit mixed hash. Unused for a single shard
+  static constexpr u32 kShardShift = kShards == 1 ? 0 : 64 - lru_detail::shardBits(kShards);
+
+public:
+  using CacheType = Cache;
+  using KeyType = typename Cache::KeyType;
+  using ValueType = typename Cache::ValueType;
+  using HasherType = typename Cache::HasherType;
+
+  static constexpr sizex kShardCount = kShards;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Creates the cache and sets the maximum size before items get purged. The size is
+  /// split evenly across the shards (rounded up), with each shard holding at least 1 item.
+  explicit ShardedLruCacheType(sizex maxSizeValue = 10 * kShards) { setMaxSize(maxSizeValue); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Creates a cost-weighted cache. Both bounds are split evenly across the shards.
+  ShardedLruCacheType(sizex maxSizeValue, sizex maxCostValue) {
+    setMaxSize(maxSizeValue);
+    setMaxCost(maxCostValue);
+  }
+
+  // Shards hold locks, so no copies or moves
+  ShardedLruCacheType(const ShardedLruCacheType&) = delete;
+  ShardedLruCacheType& operator=(const ShardedLruCacheType&) = delete;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the number of items in the cache. Each shard is locked in turn, so with
+  /// concurrent writers the value is only a snapshot.
+  sizex size() const {
+    sizex total = 0;
+    for (auto& shard : shards_) {
+      total += shard.read([](const Cache& cache) { return cache.size(); });
+    }
+    return total;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Is the cache empty? Same snapshot caveat as `size()`
+  bool empty() const { return size() == 0; }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the maximum number of items allowed in the cache, as given to `setMaxSize()`
+  sizex maxSize() const noexcept { return maxSize_.load(std::memory_order_relaxed); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Sets the maximum size of the cache. Each shard gets an even share of the size.
+  void setMaxSize(sizex maxSizeValue) {
+    const auto newMaxSize = std::max(maxSizeValue, 1_z);
+    maxSize_.store(newMaxSize, std::memory_order_relaxed);
+    const auto shardMaxSize = (newMaxSize + kShards - 1) / kShards;
+    for (auto& shard : shards_) {
+      shard.write([&](Cache& cache) { cache.setMaxSize(shardMaxSize); });
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the total cost of the cached items. Same snapshot caveat as `size()`
+  sizex totalCost() const {
+    sizex total = 0;
+    for (auto& shard : shards_) {
+      total += shard.read([](const Cache& cache) { return cache.totalCost(); });
+    }
+    return total;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the maximum total cost allowed, as given to `setMaxCost()`
+  sizex maxCost() const noexcept { return maxCost_.load(std::memory_order_relaxed); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Sets the maximum total cost of the cache. Each shard gets an even share of the cost.
+  /// Only for caches with a cost functor.
+  void setMaxCost(sizex maxCostValue) {
+    maxCost_.store(maxCostValue, std::memory_order_relaxed);
+    const auto shardMaxCost = maxCostValue == Cache::kUnlimitedCost ?
+                                  maxCostValue :
+                                  maxCostValue / kShards + (maxCostValue % kShards != 0 ? 1 : 0);
+    for (auto& shard : shards_) {
+      shard.write([&](Cache& cache) { cache.setMaxCost(shardMaxCost); });
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Check if the given key is mapped to a value in the cache. Does *not* change
+  /// cache ordering.
+  bool contains(const KeyType& key) const {
+    return shardFor(key).read([&](const Cache& cache) { return cache.contains(key); });
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Refreshes a cache item if it exists, causing it to move to the front of its shard
+  void refresh(const KeyType& key) {
+    shardFor(key).write([&](Cache& cache) { cache.refresh(key); });
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Purge entries from all shards such that each is within it's max-size. This also
+  /// applies any deferred promotions.
+  void purge() {
+    for (auto& shard : shards_) {
+      shard.write([](Cache& cache) { cache.purge(); });
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Clear the cache completely
+  void clear() {
+    for (auto& shard : shards_) {
+      shard.write([](Cache& cache) { cache.clear(); });
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Remove a cached value
+  sizex erase(const KeyType& key) {
+    return shardFor(key).write([&](Cache& cache) { return cache.erase(key); });
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Inserts or updates mapped value associated with the given key
+  void put(const KeyType& key, const ValueType& value) {
+    shardFor(key).write([&](Cache& cache) { cache.put(key, value); });
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Inserts or updates mapped value associated with the given key
+  void put(const KeyType& key, ValueType&& value) {
+    shardFor(key).write([&](Cache& cache) { cache.put(key, std::move(value)); });
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Inserts or updates mapped value associated with the given key, using the given cost.
+  /// Only for caches with a cost functor.
+  template <typename Value>
+  void put(const KeyType& key, Value&& value, sizex costValue) {
+    shardFor(key).write([&](Cache& cache) { cache.put(key, std::forward<Value>(value), costValue); });
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// @value Will be a copy of the value if it exists, otherwise it is unchanged
+  /// @return true if the value was found
+  bool get(const KeyType& key, ValueType& value) { return shardFor(key).get(key, value); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Calls `func(ValueType&)` with the cached value while the shard lock is held, which
+  /// avoids the copy that `get()` requires. The item is refreshed like `find()`, and the
+  /// lock is always exclusive. The function must not call back into this cache.
+  /// @return true if the value was found and `func` was called
+  template <typename Func>
+  bool visit(const KeyType& key, Func&& func) {
+    return shardFor(key).write([&](Cache& cache) {
+      auto iter = cache.find(key);
+      if (iter == cache.end())
+        return false;
+
+      func(iter.value());
+      return true;
+    });
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Heterogeneous versions of the lookups. Only when the shard cache supports them, see
+  /// `FlatLruCache`. The cache's hasher must hash equal keys the same regardless of type,
+  /// since it also picks the shard.
+  template <typename K, typename = TransparentKey<K>>
+  bool contains(const K& key) const {
+    return shardFor(key).read([&](const Cache& cache) { return cache.contains(key); });
+  }
+
+  template <typename K, typename = TransparentKey<K>>
+  sizex erase(const K& key) {
+    return shardFor(key).write([&](Cache& cache) { return cache.erase(key); });
+  }
+
+  template <typename K, typename = TransparentKey<K>>
+  bool get(const K& key, ValueType& value) {
+    return shardFor(key).get(key, value);
+  }
+
+  template <typename K, typename Func, typename = TransparentKey<K>>
+  bool visit(const K& key, Func&& func) {
+    return shardFor(key).write([&](Cache& cache) {
+      auto iter = cache.find(key);
+      if (iter == cache.end())
+        return false;
+
+      func(iter.value());
+      return true;
+    });
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Batch version of `get()`. The keys are grouped by shard so that each shard is locked
+  /// just once, and each shard's lookups are prefetched before any of them are done (if
+  /// the shard cache supports `prefetch()`). Hits refresh the same as `get()`.
+  /// @values Must hold `count` values. Found values are copied in, others are unchanged
+  /// @found Optional. If given, must hold `count` flags which are set to whether each key
+  ///        was found.
+  /// @return the number of keys found
+  template <typename K, typename = LookupKey<K>>
+  sizex getMany(const K* keys, sizex count, ValueType* values, bool* found = nullptr) {
+    if (found != nullptr) {
+      std::fill(found, found + count, false);
+    }
+
+    std::vector<u32> order;
+    std::array<u32, kShards + 1> offsets;
+    groupByShard(keys, count, order, offsets);
+
+    sizex hits = 0;
+    for (sizex shard = 0; shard < kShards; ++shard) {
+      const auto begin = offsets[shard];
+      const auto shardCount = offsets[shard + 1] - begin;
+      if (shardCount == 0)
+        continue;
+
+      shards_[shard].getMany(keys, &order[begin], shardCount, [&](u32 index, const ValueType& value) {
+        values[index] = value;
+        if (found != nullptr) {
+          found[index] = true;
+        }
+        ++hits;
+      });
+    }
+    return hits;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Batch version of `put()`, locking each shard just once. Within a shard the puts are
+  /// done in the given order, so for duplicate keys the last value wins.
+  void putMany(const KeyType* keys, const ValueType* values, sizex count) {
+    std::vector<u32> order;
+    std::array<u32, kShards + 1> offsets;
+    groupByShard(keys, count, order, offsets);
+
+    for (sizex shard = 0; shard < kShards; ++shard) {
+      const auto begin = offsets[shard];
+      const auto end = offsets[shard + 1];
+      if (begin == end)
+        continue;
+
+      shards_[shard].write([&](Cache& cache) {
+        for (auto i = begin; i < end; ++i) {
+          cache.put(keys[order[i]], values[order[i]]);
+        }
+      });
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the statistics summed over all shards. Only for shard caches with statistics
+  /// enabled. Same snapshot caveat as `size()`.
+  LruCacheStats stats() const {
+    LruCacheStats total;
+    for (auto& shard : shards_) {
+      total += shard.read([](const Cache& cache) { return cache.stats(); });
+    }
+    return total;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Zero the statistics of all shards
+  void resetStats() {
+    for (auto& shard : shards_) {
+      shard.write([](Cache& cache) { cache.resetStats(); });
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the shard index that the given key maps to. Mostly for testing.
+  sizex shardIndex(const KeyType& key) const { return shardIndexOf(key); }
+
+  template <typename K, typename = TransparentKey<K>>
+  sizex shardIndex(const K& key) const {
+    return shardIndexOf(key);
+  }
+
+private:
+  template <typename K>
+  sizex shardIndexOf(const K& key) const {
+    if (kShards == 1)
+      return 0;
+
+    const auto hash = static_cast<u64>(hasher_(key)) * 0x9E3779B97F4A7C15_u64;
+    return static_cast<sizex>(hash >> kShardShift);
+  }
+
+  template <typename K>
+  Shard& shardFor(const K& key) {
+    return shards_[shardIndexOf(key)];
+  }
+
+  template <typename K>
+  const Shard& shardFor(const K& key) const {
+    return shards_[shardIndexOf(key)];
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Orders a batch by shard with a counting sort. The batch indexes for shard `s` are
+  /// `order[offsets[s]]` up to (not including) `order[offsets[s + 1]]`.
+  template <typename K>
+  void groupByShard(const K* keys, sizex count, std::vector<u32>& order,
+                    std::array<u32, kShards + 1>& offsets) const {
+    SW_ASSERT(count < ~0_u32);
+    std::vector<u32> shardOf(count);
+    offsets.fill(0);
+    for (sizex i = 0; i < count; ++i) {
+      shardOf[i] = static_cast<u32>(shardIndexOf(keys[i]));
+      ++offsets[shardOf[i] + 1];
+    }
+    for (sizex shard = 0; shard < kShards; ++shard) {
+      offsets[shard + 1] += offsets[shard];
+    }
+
+    auto next = offsets;
+    order.resize(count);
+    for (sizex i = 0; i < count; ++i) {
+      order[next[shardOf[i]]++] = static_cast<u32>(i);
+    }
+  }
+
+private:
+  std::array<Shard, kShards> shards_;
+
+  /// Total maximum size across all shards. Only changed via setMaxSize
+  std::atomic<sizex> maxSize_{10 * kShards};
+
+  /// Total maximum cost across all shards. Only changed via setMaxCost
+  std::atomic<sizex> maxCost_{~sizex(0)};
+
+  HasherType hasher_;
+};
+
+template <typename Cache, sizex kShards, LruPromotion kPromotion>
+constexpr sizex ShardedLruCacheType<Cache, kShards, kPromotion>::kShardCount;
+
+template <typename Cache, sizex kShards, LruPromotion kPromotion>
+constexpr u32 ShardedLruCacheType<Cache, kShards, kPromotion>::kShardShift;
+
+////////////////////////////////////////////////////////////////////////////////
+/// The typical sharded cache, using `LruCache` for each shard
+template <typename Key, typename T, sizex kShards = 16, bool kAutoPurge = true, typename Cost = LruUnitCost>
+using ShardedLruCache = ShardedLruCacheType<LruCache<Key, T, kAutoPurge, Cost>, kShards>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// Sharded cache for read-mostly workloads. Hits defer their promotion.
+template <typename Key, typename T, sizex kShards = 16, bool kAutoPurge = true, typename Cost = LruUnitCost>
+using ReadMostlyLruCache =
+    ShardedLruCacheType<LruCache<Key, T, kAutoPurge, Cost>, kShards, LruPromotion::Deferred>;
+
+SW_NAMESPACE_END
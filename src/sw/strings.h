@@ -27,10 +27,15 @@
 
 #include <codecvt>
 #include <cstring>
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <string>
 
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 SW_NAMESPACE_BEGIN
 
 using namespace sw::intliterals;
@@ -76,47 +81,109 @@ inline bool isalnum(char ch) {
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-/// If the final character of the given string matches the provided 'trimChar',
-/// that character will be removed and the string will be shorter by one character.
-/// Otherwise, the string will be the same.
-inline void trimEndingChar(std::string& str, char trimChar) {
-  auto const len = str.length();
-  if (len > 0 && str[len - 1] == trimChar) {
-    str.resize(len - 1);
-  }
+namespace strings_detail {
+
+/// Little endian loads, so hashBytes() gives the same values on big endian hosts
+inline u64 load64(const u8* p) noexcept {
+  u64 v;
+  std::memcpy(&v, p, sizeof(v));
+#if SW_BIG_ENDIAN
+#  if SW_GCC_CXX || SW_CLANG_CXX
+  v = __builtin_bswap64(v);
+#  else
+  v = ((v & 0x00000000ffffffff_u64) << 32u) | (v >> 32u);
+  v = ((v & 0x0000ffff0000ffff_u64) << 16u) | ((v >> 16u) & 0x0000ffff0000ffff_u64);
+  v = ((v & 0x00ff00ff00ff00ff_u64) << 8u) | ((v >> 8u) & 0x00ff00ff00ff00ff_u64);
+#  endif
+#endif
+  return v;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-/// Determines if 'str' ends with 'suffix'. This is for pre-c++ 20
-template <typename StringClass>
-inline bool endsWith(const StringClass& str, const std::string& suffix) {
-  auto const strLen = str.length();
-  auto const suffixLen = suffix.length();
-  bool result =
-      (strLen >= suffixLen) && (std::memcmp(&str[strLen - suffixLen], suffix.data(), suffixLen) == 0);
-  return result;
+inline u32 load32(const u8* p) noexcept {
+  u32 v;
+  std::memcpy(&v, p, sizeof(v));
+#if SW_BIG_ENDIAN
+#  if SW_GCC_CXX || SW_CLANG_CXX
+  v = __builtin_bswap32(v);
+#  else
+  v = (v << 24u) | ((v & 0xff00u) << 8u) | ((v >> 8u) & 0xff00u) | (v >> 24u);
+#  endif
+#endif
+  return v;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-/// Determines if 'str' ends with the given char
-inline bool endsWith(const std::string& str, char ch) {
-  return !str.empty() && str.back() == ch;
+/// Byte equality tuned for the short strings typical of keys and path segments. Up to 16 bytes
+/// is two overlapping word compares, up to 64 is an inline SSE2 loop, and anything longer goes to
+/// memcmp, which the C library already vectorizes.
+inline bool bytesEqual(const void* lhs, const void* rhs, sizex size) noexcept {
+  const auto a = static_cast<const u8*>(lhs);
+  const auto b = static_cast<const u8*>(rhs);
+  if (size <= 16) {
+    if (size >= 8) {
+      return ((load64(a) ^ load64(b)) | (load64(a + size - 8) ^ load64(b + size - 8))) == 0;
+    }
+    if (size >= 4) {
+      return ((load32(a) ^ load32(b)) | (load32(a + size - 4) ^ load32(b + size - 4))) == 0;
+    }
+    if (size == 0) {
+      return true;
+    }
+    return a[0] == b[0] && a[size >> 1u] == b[size >> 1u] && a[size - 1] == b[size - 1];
+  }
+#if defined(__SSE2__)
+  if (size <= 64) {
+    // 16-byte blocks, with the last one overlapping the one before if need be
+    const auto blockEqual = [](const u8* x, const u8* y) {
+      const __m128i vx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x));
+      const __m128i vy = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y));
+      return _mm_movemask_epi8(_mm_cmpeq_epi8(vx, vy)) == 0xffff;
+    };
+    for (sizex pos = 0; pos + 16 < size; pos += 16) {
+      if (!blockEqual(a + pos, b + pos)) {
+        return false;
+      }
+    }
+    return blockEqual(a + size - 16, b + size - 16);
+  }
+#endif
+  return std::memcmp(a, b, size) == 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-/// Determines if 'str' starts with 'prefix'. This is for pre-c++ 20
-template <typename StringClass>
-inline bool startsWith(const StringClass& str, const std::string& prefix) {
-  auto const strLen = str.length();
-  auto const prefixLen = prefix.length();
-  bool result = (strLen >= prefixLen) && (std::memcmp(str.data(), prefix.data(), prefixLen) == 0);
-  return result;
+/// 64x64 -> 128 multiply, returning the low and high halves in a and b
+inline void multiply128(u64& a, u64& b) noexcept {
+#if defined(__SIZEOF_INT128__)
+  __extension__ typedef unsigned __int128 u128;
+  const u128 product = static_cast<u128>(a) * b;
+  a = static_cast<u64>(product);
+  b = static_cast<u64>(product >> 64u);
+#else
+  const u64 aLo = a & 0xffffffffu, aHi = a >> 32u;
+  const u64 bLo = b & 0xffffffffu, bHi = b >> 32u;
+  const u64 loLo = aLo * bLo, hiLo = aHi * bLo, loHi = aLo * bHi, hiHi = aHi * bHi;
+  const u64 cross = (loLo >> 32u) + (hiLo & 0xffffffffu) + loHi;
+  a = (cross << 32u) | (loLo & 0xffffffffu);
+  b = hiHi + (hiLo >> 32u) + (cross >> 32u);
+#endif
+}
+
+inline u64 mix(u64 a, u64 b) noexcept {
+  multiply128(a, b);
+  return a ^ b;
 }
 
+}  // namespace strings_detail
+
 ////////////////////////////////////////////////////////////////////////////////
-/// Determines if 'str' ends with the given char
-inline bool startsWith(const std::string& str, char ch) {
-  return !str.empty() && str.front() == ch;
+/// If the final character of the given string matches the provided 'trimChar',
+/// that character will be removed and the string will be shorter by one character.
+/// Otherwise, the string will be the same.
+inline void trimEndingChar(std::string& str, char trimChar) {
+  auto const len = str.length();
+  if (len > 0 && str[len - 1] == trimChar) {
+    str.resize(len - 1);
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -242,6 +309,9 @@ public:
   /// Non-explicit intentionally
   StringView(char const* str) noexcept : _data(str), _size(std::strlen(str)) { SW_ASSERT(str != nullptr); }
 
+  /// Wrap a std::string. Non-explicit intentionally, same as std::string_view
+  StringView(const std::string& str) noexcept : _data(str.data()), _size(str.size()) {}
+
   /// Wrap a const char* based string with a known size
   constexpr StringView(char const* str, size_t len) noexcept : _data(str), _size(len) {
     SW_ASSERT(str != nullptr);
@@ -283,7 +353,7 @@ public:
 private:
   /// Comare if two non-null terminated string are equal
   static bool isEqual(const char* s1, sizex s1s, const char* s2, sizex s2s) {
-    bool result = (s1s == s2s) ? std::memcmp(s1, s2, s1s) == 0 : false;
+    bool result = (s1s == s2s) ? strings_detail::bytesEqual(s1, s2, s1s) : false;
     return result;
   }
 
@@ -292,10 +362,146 @@ private:
   sizex _size = 0;
 };
 
+////////////////////////////////////////////////////////////////////////////////
+/// Determines if 'str' ends with 'suffix'. This is for pre-c++ 20
+template <typename StringClass>
+inline bool endsWith(const StringClass& str, const StringView& suffix) {
+  auto const strLen = str.length();
+  auto const suffixLen = suffix.length();
+  bool result = (strLen >= suffixLen) &&
+                strings_detail::bytesEqual(str.data() + (strLen - suffixLen), suffix.data(), suffixLen);
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Determines if 'str' ends with the given char
+inline bool endsWith(const std::string& str, char ch) {
+  return !str.empty() && str.back() == ch;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Determines if 'str' starts with 'prefix'. This is for pre-c++ 20
+template <typename StringClass>
+inline bool startsWith(const StringClass& str, const StringView& prefix) {
+  auto const strLen = str.length();
+  auto const prefixLen = prefix.length();
+  bool result = (strLen >= prefixLen) && strings_detail::bytesEqual(str.data(), prefix.data(), prefixLen);
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Determines if 'str' ends with the given char
+inline bool startsWith(const std::string& str, char ch) {
+  return !str.empty() && str.front() == ch;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// Create a string from a string view
 inline std::string toString(const StringView& sv) {
   return std::string(sv.data(), sv.size());
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// Hash the given bytes. Follows wyhash: a couple of 64x64->128 multiplies for short input and
+/// three independent lanes of 16 bytes for long input, so it runs at several bytes per cycle.
+/// Values are stable across runs and platforms for a given seed, but aren't meant to be stored.
+inline sizex hashBytes(const void* data, sizex size, u64 seed = 0) noexcept {
+  using strings_detail::load32;
+  using strings_detail::load64;
+  using strings_detail::mix;
+  constexpr u64 kSecret0 = 0x2d358dccaa6c78a5_u64;
+  constexpr u64 kSecret1 = 0x8bb84b93962eacc9_u64;
+  constexpr u64 kSecret2 = 0x4b33a62ed433d4a3_u64;
+  constexpr u64 kSecret3 = 0x4d5a2da51de1aa47_u64;
+
+  auto p = static_cast<const u8*>(data);
+  seed ^= mix(seed ^ kSecret0, kSecret1);
+  u64 a;
+  u64 b;
+  if (size <= 16) {
+    if (size >= 4) {
+      const sizex quarter = (size >> 3u) << 2u;
+      a = (u64(load32(p)) << 32u) | load32(p + quarter);
+      b = (u64(load32(p + size - 4)) << 32u) | load32(p + size - 4 - quarter);
+    } else if (size > 0) {
+      a = (u64(p[0]) << 16u) | (u64(p[size >> 1u]) << 8u) | p[size - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    sizex remaining = size;
+    if (remaining >= 48) {
+      u64 seed1 = seed;
+      u64 seed2 = seed;
+      do {
+        seed = mix(load64(p) ^ kSecret1, load64(p + 8) ^ seed);
+        seed1 = mix(load64(p + 16) ^ kSecret2, load64(p + 24) ^ seed1);
+        seed2 = mix(load64(p + 32) ^ kSecret3, load64(p + 40) ^ seed2);
+        p += 48;
+        remaining -= 48;
+      } while (remaining >= 48);
+      seed ^= seed1 ^ seed2;
+    }
+    while (remaining > 16) {
+      seed = mix(load64(p) ^ kSecret1, load64(p + 8) ^ seed);
+      p += 16;
+      remaining -= 16;
+    }
+    a = load64(p + remaining - 16);
+    b = load64(p + remaining - 8);
+  }
+
+  a ^= kSecret1;
+  b ^= seed;
+  strings_detail::multiply128(a, b);
+  return static_cast<sizex>(mix(a ^ kSecret0 ^ size, b ^ kSecret1));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Hash for any of the string types where equal strings hash the same, regardless of type.
+/// Marked transparent, so containers supporting heterogeneous lookup can be keyed by
+/// std::string and searched by StringView without building a temporary string.
+struct TransparentStringHash {
+  using is_transparent = void;
+
+  sizex operator()(const StringView& str) const noexcept { return hashBytes(str.data(), str.size()); }
+  sizex operator()(const StringWrapper& str) const noexcept { return hashBytes(str.data(), str.size()); }
+  sizex operator()(const std::string& str) const noexcept { return hashBytes(str.data(), str.size()); }
+  sizex operator()(const char* str) const noexcept { return hashBytes(str, std::strlen(str)); }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Equality to go with TransparentStringHash
+struct TransparentStringEqual {
+  using is_transparent = void;
+
+  template <typename Lhs, typename Rhs>
+  bool operator()(const Lhs& lhs, const Rhs& rhs) const noexcept {
+    return viewOf(lhs) == viewOf(rhs);
+  }
+
+private:
+  static StringView viewOf(const StringView& str) noexcept { return str; }
+  static StringView viewOf(const StringWrapper& str) noexcept { return StringView(str.data(), str.size()); }
+  static StringView viewOf(const std::string& str) noexcept { return StringView(str.data(), str.size()); }
+  static StringView viewOf(const char* str) noexcept { return StringView(str); }
+};
+
 SW_NAMESPACE_END
+
+namespace std {
+
+////////////////////////////////////////////////////////////////////////////////
+/// Same values as TransparentStringHash, so either can be used for keys
+template <>
+struct hash<::sw::StringView> {
+  size_t operator()(const ::sw::StringView& str) const noexcept { return ::sw::hashBytes(str.data(), str.size()); }
+};
+
+template <>
+struct hash<::sw::StringWrapper> {
+  size_t operator()(const ::sw::StringWrapper& str) const noexcept { return ::sw::hashBytes(str.data(), str.size()); }
+};
+
+}  // namespace std
@@ -22,12 +22,100 @@
 #include "fixed_width_int_literals.h"
 #include "types.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#if SW_LINUX
+#  include <pthread.h>
+#  include <sched.h>
+#endif
+
 SW_NAMESPACE_BEGIN
 
 using namespace sw::intliterals;
 
+////////////////////////////////////////////////////////////////////////////////
+/// A value that has a separate instance per thread, for each ThreadLocalValue object.
+/// Unlike a `thread_local` variable, it can be a member of an object. eg. A per-thread
+/// cache for a pool.
+///
+/// Each thread's instance is created on its first `get()`, and destroyed when the thread
+/// exits. If the ThreadLocalValue is destroyed first, the other threads' instances live on
+/// until those threads exit or next call `get()` on any ThreadLocalValue<T>. So T's
+/// destructor must not depend on the owner still being alive, eg. by holding a weak_ptr.
+///
+/// @tparam T The per-thread value type
+template <typename T>
+class ThreadLocalValue {
+public:
+  ThreadLocalValue() : _token(std::make_shared<char>()) {}
+  ThreadLocalValue(const ThreadLocalValue&) = delete;
+  ThreadLocalValue& operator=(const ThreadLocalValue&) = delete;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return this thread's instance, calling `make()` to create it if this is the first
+  /// use on this thread. `make()` must return a `std::unique_ptr<T>`.
+  template <typename Make>
+  T& get(Make&& make) {
+    auto& slots = threadSlots();
+    for (auto iter = slots.begin(); iter != slots.end();) {
+      // An expired token means that owner is gone. Its key might have been reused too.
+      if (iter->token.expired()) {
+        iter = slots.erase(iter);
+      } else if (iter->key == _token.get()) {
+        return *iter->value;
+      } else {
+        ++iter;
+      }
+    }
+
+    slots.push_back(Slot{_token, _token.get(), make()});
+    return *slots.back().value;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return this thread's instance, default constructing it if needed
+  T& get() {
+    return get([]() { return std::make_unique<T>(); });
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return this thread's instance, or nullptr if it hasn't made one. Never creates one
+  T* find() const noexcept {
+    for (const auto& slot : threadSlots()) {
+      if (slot.key == _token.get() && !slot.token.expired()) {
+        return slot.value.get();
+      }
+    }
+    return nullptr;
+  }
+
+private:
+  struct Slot {
+    std::weak_ptr<void> token;
+    const void* key;
+    std::unique_ptr<T> value;
+  };
+
+  /// Every ThreadLocalValue<T> shares one list per thread. There are rarely more than a few
+  static std::vector<Slot>& threadSlots() {
+    static thread_local std::vector<Slot> slots;
+    return slots;
+  }
+
+  /// Identifies this object. Threads hold weak references so they can tell it's gone
+  std::shared_ptr<void> _token;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 /// This class manages versioned copies of a specific value in a thread safe way.
 /// Once a copy has been made of the source value, it will be cached with this
@@ -48,6 +136,12 @@ using namespace sw::intliterals;
 ///
 /// See the unit test for example usage.
 ///
+/// With `VersionedCopies::PerThread`, each thread also keeps the last copy it checked in. A
+/// checkout that finds its thread's copy still at the current version takes it without the
+/// lock, and checking it back in puts it back the same way. So a thread keeps reusing its
+/// own (cache warm) copy, and only goes to the lock and the shared copies after the value
+/// changes. The per-thread copies aren't included in `copyCount()`.
+///
 /// @tparam T The value type. Must be copyable and movable, and moves should be cheap.
 template <typename T, typename Mutex, typename LockGuard>
 class VersionedValueCache {
@@ -55,6 +149,12 @@ public:
   static constexpr u32 kInvalidVersion = ~0_u32;
   using ValueType = T;
 
+  /// Where checked in copies are kept
+  enum class VersionedCopies : u8 {
+    Shared,     ///< Only in the shared list, under the lock
+    PerThread,  ///< In a per-thread slot first, then the shared list
+  };
+
   /// The Value class is handled out
   class Value {
   public:
@@ -72,14 +172,15 @@ public:
       _value = std::move(that._value);
       _library = that._library;
       _version = std::exchange(that._version, kInvalidVersion);
+      return *this;
     }
 
     ////////////////////////////////////////////////////////////////////////////////
-    /// The item will auto-checkin upon destruction if needed. This will acquire the lock.
+    /// The item will auto-checkin upon destruction if needed. This will acquire the lock,
+    /// unless it can go back to this thread's slot.
     ~Value() {
       if (_library && _version != kInvalidVersion) {
-        LockGuard lock(*(_library->_mutex));
-        _library->checkin(Value(std::move(_value), _library, _version), lock);
+        _library->checkin(std::move(*this));
       }
     }
 
@@ -107,7 +208,9 @@ public:
 
   ////////////////////////////////////////////////////////////////////////////////
   /// Create a versioned value cache, giving it the mutex to use with accessing value copies
-  VersionedValueCache(Mutex& mutex) : _mutex(&mutex) {}
+  VersionedValueCache(Mutex& mutex, VersionedCopies copies = VersionedCopies::Shared) :
+      _mutex(&mutex),
+      _perThread(copies == VersionedCopies::PerThread) {}
 
   ////////////////////////////////////////////////////////////////////////////////
   /// Sets the new main item. This will signify a new version and clear any cached copies
@@ -134,6 +237,15 @@ public:
 
   ////////////////////////////////////////////////////////////////////////////////
   Value checkout() {
+    if (_perThread) {
+      // The thread's copy is only ours to take while it's the current version
+      auto& slot = threadSlot();
+      if (slot.version != kInvalidVersion && slot.version == _version.load(std::memory_order_acquire)) {
+        const auto version = std::exchange(slot.version, kInvalidVersion);
+        return Value(std::move(*slot.value), this, version);
+      }
+    }
+
     LockGuard lock(*_mutex);
     return checkout(lock);
   }
@@ -153,15 +265,32 @@ public:
 
   ////////////////////////////////////////////////////////////////////////////////
   void checkin(Value&& item) {
+    if (_perThread && item._version != kInvalidVersion) {
+      // Fill this thread's slot if it's empty. No lock needed, since only we use it
+      auto& slot = threadSlot();
+      if (slot.version == kInvalidVersion && item._version == _version.load(std::memory_order_acquire)) {
+        if (slot.value) {
+          *slot.value = std::move(item._value);
+        } else {
+          slot.value = std::make_unique<T>(std::move(item._value));
+        }
+        slot.version = std::exchange(item._version, kInvalidVersion);
+        return;
+      }
+    }
+
     LockGuard lock(*_mutex);
     return checkin(std::move(item), lock);
   }
 
   ////////////////////////////////////////////////////////////////////////////////
   void checkin(Value&& item, const LockGuard&) {
-    // Cache the item if it's version is still good. Otherwise let it die
+    // Cache the item if it's version is still good. Otherwise let it die, without it trying
+    // to check itself in again
     if (item._version == _version) {
       _copies.push_back(std::move(item));
+    } else {
+      item.invalidate();
     }
   }
 
@@ -173,6 +302,16 @@ public:
   }
 
 private:
+  ////////////////////////////////////////////////////////////////////////////////
+  /// A thread's own copy. Once allocated the unique_ptr sticks around, so refilling the slot
+  /// move-assigns into it rather than allocating a new T. The T's own buffers aren't reused
+  struct ThreadSlot {
+    std::unique_ptr<T> value;
+    u32 version = kInvalidVersion;
+  };
+
+  ThreadSlot& threadSlot() { return _threadSlots.get(); }
+
   ////////////////////////////////////////////////////////////////////////////////
   /// Clear any copies but don't trigger the auto check-in
   void clearCopies() {
@@ -194,6 +333,10 @@ private:
   /// The current version
   std::atomic_uint32_t _version = {0};
 
+  /// Per-thread copies, for VersionedCopies::PerThread
+  const bool _perThread;
+  ThreadLocalValue<ThreadSlot> _threadSlots;
+
   friend class Value;
 };
 
@@ -271,4 +414,848 @@ private:
   ConstValueRef _value;
 };
 
+////////////////////////////////////////////////////////////////////////////////
+/// # Overview
+/// A read-mostly version of AtomicSharedValue where reading takes no lock and touches no
+/// shared reference count. It's an RCU style scheme: each reading thread has its own slot,
+/// and a read marks the slot with the current epoch for as long as its `ReadGuard` lives.
+/// `set()` swaps in the new value, bumps the epoch, then waits for any reader still marked
+/// with an older epoch before freeing the old value.
+///
+/// Once a thread has read once (which registers its slot) `read()` is lock-free: a scan of the
+/// thread's own ThreadLocalValue slots, then a store to the thread's reader slot and a load. `set()` is the slow path.
+/// It's serialized on an internal mutex and waits out the readers.
+///
+/// Guards are meant to be short lived since `set()` waits for them. Use `snapshot()` to keep
+/// the value longer, at the cost of a shared_ptr copy. Calling `set()` while the same thread
+/// holds a guard would never finish, and asserts.
+///
+/// @tparam T The value type
+template <typename T>
+class ReadMostlySharedValue {
+  struct Node;
+  struct Slot;
+  struct Registry;
+  struct Reader;
+
+public:
+  using ConstValueRef = std::shared_ptr<const T>;
+  using ValuePtr = std::unique_ptr<T>;
+  static constexpr sizex kCacheLineSize = 64;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Keeps the value it was created with alive until it's destroyed. Not thread safe, and
+  /// must be destroyed on the thread that created it.
+  class ReadGuard {
+  public:
+    ReadGuard(ReadGuard&& that) noexcept :
+        _reader(std::exchange(that._reader, nullptr)),
+        _value(std::exchange(that._value, nullptr)) {}
+    ReadGuard& operator=(ReadGuard&&) = delete;
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+
+    ~ReadGuard() {
+      if (_reader != nullptr && --_reader->depth == 0) {
+        _reader->slot->epoch.store(0, std::memory_order_release);
+      }
+    }
+
+    /// The value, or nullptr if it's never been set
+    const T* get() const noexcept { return _value; }
+    const T& operator*() const noexcept { return *_value; }
+    const T* operator->() const noexcept { return _value; }
+    explicit operator bool() const noexcept { return _value != nullptr; }
+
+  private:
+    ReadGuard(Reader* reader, const T* value) noexcept : _reader(reader), _value(value) {}
+
+    Reader* _reader;
+    const T* _value;
+
+    friend class ReadMostlySharedValue;
+  };
+
+  ReadMostlySharedValue() : _registry(std::make_shared<Registry>()) {}
+  explicit ReadMostlySharedValue(ValuePtr value) : ReadMostlySharedValue() { set(std::move(value)); }
+  ReadMostlySharedValue(const ReadMostlySharedValue&) = delete;
+  ReadMostlySharedValue& operator=(const ReadMostlySharedValue&) = delete;
+
+  /// There must be no readers left
+  ~ReadMostlySharedValue() { delete _current.load(std::memory_order_acquire); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Read the current value. It stays alive, and unchanged, until the guard is destroyed.
+  /// Nested reads on one thread are fine.
+  ReadGuard read() {
+    auto& reader = threadReader();
+    if (reader.depth++ == 0) {
+      // Sequentially consistent with set(): either it sees our epoch, or we see its value
+      reader.slot->epoch.store(_epoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+    }
+    const auto node = _current.load(std::memory_order_seq_cst);
+    return ReadGuard(&reader, node ? node->value.get() : nullptr);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// A shared reference to the current value, to hold on to for a while
+  ConstValueRef snapshot() {
+    const auto guard = read();
+    const auto node = _current.load(std::memory_order_acquire);
+    return node ? node->value : ConstValueRef();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Replace the value. Waits until no reader can still be using the old one, then frees it
+  /// (or leaves it to the last snapshot).
+  void set(ValuePtr value) {
+    auto node = std::make_unique<Node>();
+    node->value = std::move(value);
+
+    std::lock_guard<std::mutex> lock(_writeMutex);
+    SW_ASSERT(!threadIsReading());
+    std::unique_ptr<Node> old(_current.exchange(node.release(), std::memory_order_seq_cst));
+    const auto retireEpoch = _epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+    if (!old) {
+      return;
+    }
+
+    // Threads registering from here on see the new value, so only the current slots matter
+    std::vector<Slot*> slots;
+    {
+      std::lock_guard<std::mutex> registryLock(_registry->mutex);
+      slots.reserve(_registry->slots.size());
+      for (const auto& slot : _registry->slots) {
+        slots.push_back(slot.get());
+      }
+    }
+    for (const auto slot : slots) {
+      while (true) {
+        const auto epoch = slot->epoch.load(std::memory_order_seq_cst);
+        if (epoch == 0 || epoch >= retireEpoch) {
+          break;
+        }
+        std::this_thread::yield();
+      }
+    }
+  }
+
+private:
+  struct Node {
+    ConstValueRef value;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// One reading thread's epoch, or 0 when it's not reading. Padded onto its own cache line
+  struct Slot {
+    char pad0[kCacheLineSize];
+    std::atomic<u64> epoch{0};
+    std::atomic<bool> owned{true};
+    char pad1[kCacheLineSize];
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// The slots of every thread that has read. Shared with the readers so a thread exiting
+  /// after the value is gone can still hand its slot back.
+  struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Slot>> slots;
+
+    Slot* acquire() {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (const auto& slot : slots) {
+        bool expected = false;
+        if (slot->owned.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+          return slot.get();
+        }
+      }
+      slots.push_back(std::make_unique<Slot>());
+      return slots.back().get();
+    }
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// The per-thread state. Gives the slot back when the thread exits.
+  struct Reader {
+    std::shared_ptr<Registry> registry;
+    Slot* slot;
+    sizex depth = 0;
+
+    Reader(std::shared_ptr<Registry> registryValue, Slot* slotValue) :
+        registry(std::move(registryValue)),
+        slot(slotValue) {}
+    ~Reader() {
+      SW_ASSERT(depth == 0);
+      slot->epoch.store(0, std::memory_order_relaxed);
+      slot->owned.store(false, std::memory_order_release);
+    }
+  };
+
+  Reader& threadReader() {
+    return _readers.get([this] { return std::make_unique<Reader>(_registry, _registry->acquire()); });
+  }
+
+  /// Whether this thread holds a guard. Doesn't register a reader, so writers don't add slots
+  bool threadIsReading() const noexcept {
+    const auto reader = _readers.find();
+    return reader != nullptr && reader->depth != 0;
+  }
+
+private:
+  std::atomic<Node*> _current{nullptr};
+  std::atomic<u64> _epoch{1};
+  std::shared_ptr<Registry> _registry;
+  ThreadLocalValue<Reader> _readers;
+  std::mutex _writeMutex;
+};
+
+template <typename T>
+constexpr sizex ReadMostlySharedValue<T>::kCacheLineSize;
+
+////////////////////////////////////////////////////////////////////////////////
+/// Bounded lock-free queue for many producers and a single consumer. This is Dmitry
+/// Vyukov's bounded queue: a ring of cells where each cell has a sequence number that says
+/// whose turn it is. Producers claim a cell with a CAS on the enqueue position, then
+/// publish it by bumping the cell's sequence. There are no locks, and no allocations after
+/// construction.
+///
+/// The cells are fixed. Values are filled in and consumed *in place* by the given
+/// functions, so a cell's value is reused for the life of the queue. eg. For a
+/// `std::string` value, assigning into it reuses the cell's capacity.
+///
+/// @tparam T The cell value. Must be default constructible.
+template <typename T>
+class BoundedMpscQueue {
+public:
+  static constexpr sizex kCacheLineSize = 64;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Create the queue. The capacity is rounded up to a power of two.
+  explicit BoundedMpscQueue(sizex capacityValue) :
+      _mask(roundUpPow2(std::max(capacityValue, 2_z)) - 1),
+      _cells(new Cell[_mask + 1]) {
+    for (sizex i = 0; i <= _mask; ++i) {
+      _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  BoundedMpscQueue(const BoundedMpscQueue&) = delete;
+  BoundedMpscQueue& operator=(const BoundedMpscQueue&) = delete;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Claims a cell and calls `fill(T&)` to set its value. Safe from any thread.
+  /// @return false if the queue is full, and `fill` isn't called.
+  template <typename Fill>
+  bool tryPush(Fill&& fill) {
+    auto pos = _enqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+      auto& cell = _cells[pos & _mask];
+      const auto sequence = cell.sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<ptrdiffx>(sequence) - static_cast<ptrdiffx>(pos);
+      if (diff == 0) {
+        if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          fill(cell.value);
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = _enqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Calls `consume(T&)` with the oldest value, if there is one. Only safe from the
+  /// single consumer thread.
+  /// @return false if the queue is empty, and `consume` isn't called.
+  template <typename Consume>
+  bool tryPop(Consume&& consume) {
+    const auto pos = _dequeuePos.load(std::memory_order_relaxed);
+    auto& cell = _cells[pos & _mask];
+    const auto sequence = cell.sequence.load(std::memory_order_acquire);
+    if (sequence != pos + 1)
+      return false;
+
+    consume(cell.value);
+    cell.sequence.store(pos + _mask + 1, std::memory_order_release);
+    _dequeuePos.store(pos + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Calls `consume(T&)` for each of up to `maxCount` of the oldest values, then calls
+  /// `done()`. The cells are only freed after `done()`, so the values stay put until then.
+  /// Only safe from the single consumer thread.
+  /// @return the number of values consumed. `done` isn't called if the queue is empty.
+  template <typename Consume, typename Done>
+  sizex popBatch(sizex maxCount, Consume&& consume, Done&& done) {
+    const auto pos = _dequeuePos.load(std::memory_order_relaxed);
+    sizex count = 0;
+    while (count < maxCount) {
+      auto& cell = _cells[(pos + count) & _mask];
+      if (cell.sequence.load(std::memory_order_acquire) != pos + count + 1)
+        break;
+
+      consume(cell.value);
+      ++count;
+    }
+    if (count == 0)
+      return 0;
+
+    done();
+    for (sizex i = 0; i < count; ++i) {
+      _cells[(pos + i) & _mask].sequence.store(pos + i + _mask + 1, std::memory_order_release);
+    }
+    _dequeuePos.store(pos + count, std::memory_order_relaxed);
+    return count;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return the number of queued values. Only a snapshot with concurrent producers.
+  sizex size() const noexcept {
+    const auto dequeuePos = _dequeuePos.load(std::memory_order_relaxed);
+    const auto enqueuePos = _enqueuePos.load(std::memory_order_relaxed);
+    return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+  }
+
+  bool empty() const noexcept { return size() == 0; }
+  sizex capacity() const noexcept { return _mask + 1; }
+
+private:
+  struct Cell {
+    std::atomic<sizex> sequence;
+    T value;
+  };
+
+  static sizex roundUpPow2(sizex value) noexcept {
+    sizex result = 1;
+    while (result < value) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  const sizex _mask;
+  std::unique_ptr<Cell[]> _cells;
+
+  /// The positions are padded onto their own cache lines so producers and the consumer
+  /// don't false-share. Padding rather than alignas, since C++14 `new` ignores over-alignment
+  char _pad0[kCacheLineSize];
+  std::atomic<sizex> _enqueuePos{0};
+  char _pad1[kCacheLineSize];
+  std::atomic<sizex> _dequeuePos{0};
+};
+
+template <typename T>
+constexpr sizex BoundedMpscQueue<T>::kCacheLineSize;
+
+namespace pool_detail {
+
+constexpr sizex kNoWorker = ~0_z;
+constexpr sizex kCacheLineSize = 64;
+
+////////////////////////////////////////////////////////////////////////////////
+/// A move-only `void()` callable stored inline rather than on the heap, so queueing one never
+/// allocates. Callables must fit in kCapacity bytes, which is enough for a lambda capturing
+/// about five pointers or references.
+class InlineTask {
+public:
+  static constexpr sizex kCapacity = 48;
+
+  InlineTask() noexcept = default;
+  InlineTask(InlineTask&& that) noexcept { moveFrom(that); }
+  InlineTask& operator=(InlineTask&& that) noexcept {
+    if (this != &that) {
+      reset();
+      moveFrom(that);
+    }
+    return *this;
+  }
+  InlineTask(const InlineTask&) = delete;
+  InlineTask& operator=(const InlineTask&) = delete;
+  ~InlineTask() { reset(); }
+
+  template <typename Func>
+  void assign(Func&& func) {
+    using F = typename std::decay<Func>::type;
+    static_assert(sizeof(F) <= kCapacity, "Task is too big to store inline. Capture by reference instead");
+    static_assert(alignof(F) <= alignof(Storage), "Task is over-aligned");
+    static_assert(std::is_nothrow_move_constructible<F>::value, "Task must be nothrow movable");
+    reset();
+    new (&_storage) F(std::forward<Func>(func));
+    _ops = &opsFor<F>();
+  }
+
+  void operator()() { _ops->invoke(&_storage); }
+  explicit operator bool() const noexcept { return _ops != nullptr; }
+
+  void reset() noexcept {
+    if (_ops != nullptr) {
+      _ops->destroy(&_storage);
+      _ops = nullptr;
+    }
+  }
+
+private:
+  using Storage = std::aligned_storage<kCapacity, alignof(std::max_align_t)>::type;
+
+  struct Ops {
+    void (*invoke)(void*);
+    void (*relocate)(void* dest, void* source);
+    void (*destroy)(void*);
+  };
+
+  template <typename F>
+  static void invokeImpl(void* p) {
+    (*static_cast<F*>(p))();
+  }
+
+  template <typename F>
+  static void relocateImpl(void* dest, void* source) {
+    new (dest) F(std::move(*static_cast<F*>(source)));
+    static_cast<F*>(source)->~F();
+  }
+
+  template <typename F>
+  static void destroyImpl(void* p) {
+    static_cast<F*>(p)->~F();
+  }
+
+  template <typename F>
+  static const Ops& opsFor() noexcept {
+    static const Ops kOps = {&invokeImpl<F>, &relocateImpl<F>, &destroyImpl<F>};
+    return kOps;
+  }
+
+  void moveFrom(InlineTask& that) noexcept {
+    if (that._ops != nullptr) {
+      that._ops->relocate(&_storage, &that._storage);
+      _ops = std::exchange(that._ops, nullptr);
+    }
+  }
+
+  Storage _storage;
+  const Ops* _ops = nullptr;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// One worker's deque: a fixed ring of task slots under the worker's own lock. The owner
+/// pushes and pops at the back, and thieves take from the front, so they rarely meet.
+struct Worker {
+  explicit Worker(sizex capacity) : tasks(capacity), mask(capacity - 1) {}
+
+  template <typename Func>
+  bool tryPush(Func&& func) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (size > mask) {
+      return false;
+    }
+    tasks[(head + size) & mask].assign(std::forward<Func>(func));
+    ++size;
+    return true;
+  }
+
+  bool popBack(InlineTask& task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (size == 0) {
+      return false;
+    }
+    --size;
+    task = std::move(tasks[(head + size) & mask]);
+    return true;
+  }
+
+  bool popFront(InlineTask& task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (size == 0) {
+      return false;
+    }
+    task = std::move(tasks[head]);
+    head = (head + 1) & mask;
+    --size;
+    return true;
+  }
+
+  std::mutex mutex;
+  std::vector<InlineTask> tasks;
+  const sizex mask;
+  sizex head = 0;
+  sizex size = 0;
+  std::thread thread;
+
+  /// Keep neighbouring workers' locks off this cache line
+  char pad[kCacheLineSize];
+};
+
+}  // namespace pool_detail
+
+////////////////////////////////////////////////////////////////////////////////
+/// Tracks a batch of tasks submitted to a WorkStealingPool, so they can be waited on. It's
+/// owned by the caller, usually on the stack, so tracking the batch doesn't allocate and only
+/// the batch's own tasks touch it. The first exception thrown by a task is rethrown by
+/// `WorkStealingPool::wait()`.
+///
+/// Must outlive its tasks, ie. wait on it before destroying it.
+class TaskGroup {
+public:
+  TaskGroup() = default;
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  ~TaskGroup() { SW_ASSERT(_pending.load(std::memory_order_relaxed) == 0); }
+
+  /// @return True when every task submitted so far has finished
+  bool done() const noexcept { return _pending.load(std::memory_order_acquire) == 0; }
+
+private:
+  void add() noexcept { _pending.fetch_add(1, std::memory_order_relaxed); }
+
+  template <typename Func>
+  void run(Func& func) noexcept {
+    try {
+      func();
+    } catch (...) {
+      setError(std::current_exception());
+    }
+    finish();
+  }
+
+  void setError(std::exception_ptr error) noexcept {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_error) {
+      _error = std::move(error);
+    }
+  }
+
+  /// Done under the lock, so a waiter can't see zero and destroy the group while this
+  /// thread still needs it
+  void finish() noexcept {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      _finished.notify_all();
+    }
+  }
+
+  void waitFinished() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _finished.wait(lock, [this]() { return _pending.load(std::memory_order_acquire) == 0; });
+    if (_error) {
+      std::rethrow_exception(std::exchange(_error, nullptr));
+    }
+  }
+
+  std::atomic<sizex> _pending{0};
+  std::mutex _mutex;
+  std::condition_variable _finished;
+  std::exception_ptr _error;
+
+  friend class WorkStealingPool;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// A work-stealing thread pool. Each worker has its own bounded deque. Tasks submitted from a
+/// worker go on its own deque, and others are spread round-robin across the workers, so
+/// there's no single queue for everyone to contend on. A worker runs its own newest task
+/// first, and when it's out of work, steals the oldest from the others.
+///
+/// Submitting never allocates: tasks live inline in the deque slots (see InlineTask for the
+/// size limit). When every deque is full, the submitting thread runs the task itself rather
+/// than block or grow a queue.
+///
+/// `parallelFor(count, func)` is the bulk API, and the pool itself fits the
+/// `parallelFor(count, task)` contract of eg. `normalizeAll(paths, count, pool)`. Use
+/// `submit(group, func)` and `wait(group)` for a batch of separate tasks, and plain
+/// `submit(func)` to fire and forget. Ungrouped tasks must not throw (as with std::thread,
+/// that calls std::terminate).
+///
+/// Destroying the pool runs whatever's still queued, then joins the workers.
+class WorkStealingPool {
+public:
+  struct Config {
+    sizex threadCount = 0;       ///< 0 for std::thread::hardware_concurrency()
+    sizex queueCapacity = 1024;  ///< Task slots per worker. Rounded up to a power of two
+    bool pinThreads = false;     ///< Pin worker i to core i (mod the core count). Linux only
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  WorkStealingPool() : WorkStealingPool(Config()) {}
+
+  explicit WorkStealingPool(Config config) {
+    const sizex cores = std::max(sizex(std::thread::hardware_concurrency()), 1_z);
+    const sizex threads = config.threadCount == 0 ? cores : config.threadCount;
+    sizex capacity = 2;
+    while (capacity < config.queueCapacity) {
+      capacity <<= 1;
+    }
+
+    _workers.reserve(threads);
+    for (sizex i = 0; i < threads; ++i) {
+      _workers.push_back(std::make_unique<pool_detail::Worker>(capacity));
+    }
+    for (sizex i = 0; i < threads; ++i) {
+      _workers[i]->thread = std::thread([this, i]() { workerLoop(i); });
+      if (config.pinThreads) {
+        pinThread(_workers[i]->thread, i % cores);
+      }
+    }
+  }
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  ~WorkStealingPool() {
+    {
+      std::lock_guard<std::mutex> lock(_sleepMutex);
+      _stopping = true;
+    }
+    _wake.notify_all();
+    for (auto& worker : _workers) {
+      if (worker->thread.joinable()) {
+        worker->thread.join();
+      }
+    }
+  }
+
+  sizex threadCount() const noexcept { return _workers.size(); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Queue `func()` to run on some worker
+  template <typename Func>
+  void submit(Func&& func) {
+    if (!tryQueue(std::forward<Func>(func))) {
+      func();
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Queue `func()` as part of `group`. Wait for the group with `wait(group)`.
+  template <typename Func>
+  void submit(TaskGroup& group, Func&& func) {
+    group.add();
+    auto task = [&group, func = std::forward<Func>(func)]() mutable { group.run(func); };
+    if (!tryQueue(std::move(task))) {
+      task();
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Wait for every task in the group, running queued tasks on this thread meanwhile.
+  /// Rethrows the first exception from the group's tasks.
+  void wait(TaskGroup& group) {
+    pool_detail::InlineTask task;
+    while (!group.done() && takeTask(currentWorker(), task)) {
+      runTask(task);
+    }
+    // Nothing's queued, so the rest of the group is running on other threads
+    group.waitFinished();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Call `func(i)` for every i in [0, count), across the workers and this thread, and return
+  /// once they're all done. Indexes are handed out one at a time, so give each one a chunk
+  /// of work rather than a single item. Rethrows the first exception from `func`, after
+  /// which the remaining indexes are skipped.
+  template <typename Func>
+  void parallelFor(sizex count, const Func& func) {
+    if (count == 0) {
+      return;
+    }
+
+    std::atomic<sizex> next{0};
+    const auto runIndexes = [&]() {
+      for (sizex i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+           i = next.fetch_add(1, std::memory_order_relaxed)) {
+        try {
+          func(i);
+        } catch (...) {
+          next.store(count, std::memory_order_relaxed);
+          throw;
+        }
+      }
+    };
+
+    TaskGroup group;
+    const sizex helpers = std::min(count - 1, threadCount());
+    for (sizex h = 0; h < helpers; ++h) {
+      submit(group, [&runIndexes]() { runIndexes(); });
+    }
+    try {
+      runIndexes();
+    } catch (...) {
+      group.setError(std::current_exception());
+    }
+    wait(group);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Same as parallelFor, so the pool can be passed where a `parallelFor` callable is wanted
+  template <typename Func>
+  void operator()(sizex count, const Func& func) {
+    parallelFor(count, func);
+  }
+
+private:
+  /// Which pool and worker this thread is, if any
+  struct WorkerId {
+    const WorkStealingPool* pool = nullptr;
+    sizex index = pool_detail::kNoWorker;
+  };
+
+  static WorkerId& threadWorkerId() noexcept {
+    static thread_local WorkerId id;
+    return id;
+  }
+
+  sizex currentWorker() const noexcept {
+    const auto& id = threadWorkerId();
+    return id.pool == this ? id.index : pool_detail::kNoWorker;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Round-robin position for submits from outside the pool. Per thread, so submitting doesn't
+  /// write a shared line. Starts at a per-thread offset so submitters don't all pile onto worker 0
+  static sizex& externalCursor() noexcept {
+    static thread_local sizex cursor = std::hash<std::thread::id>()(std::this_thread::get_id());
+    return cursor;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Push onto this worker's deque, or the next one round-robin, trying the others if it's
+  /// full. Returns false if they're all full.
+  template <typename Func>
+  bool tryQueue(Func&& func) {
+    const sizex count = _workers.size();
+    const sizex self = currentWorker();
+    const sizex start = self != pool_detail::kNoWorker ? self : externalCursor()++ % count;
+    for (sizex i = 0; i < count; ++i) {
+      // tryPush only consumes func when it succeeds
+      if (_workers[(start + i) % count]->tryPush(std::forward<Func>(func))) {
+        wakeSleeper();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Our own deque's newest task, else the oldest task of another
+  bool takeTask(sizex self, pool_detail::InlineTask& task) {
+    const sizex count = _workers.size();
+    if (self != pool_detail::kNoWorker && _workers[self]->popBack(task)) {
+      return true;
+    }
+    const sizex start = self != pool_detail::kNoWorker ? self + 1 : 0;
+    for (sizex i = 0; i < count; ++i) {
+      const sizex victim = (start + i) % count;
+      if (victim != self && _workers[victim]->popFront(task)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static void runTask(pool_detail::InlineTask& task) {
+    task();
+    task.reset();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// The sleeper count is only touched by workers going to sleep, so a submit normally costs
+  /// one load here. A sleeper counts itself before its last look at the deques, and a
+  /// submitter pushes before checking the count, so one of them always sees the other.
+  void wakeSleeper() {
+    if (_sleepers.load(std::memory_order_seq_cst) != 0) {
+      {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        ++_wakeSignals;
+      }
+      _wake.notify_one();
+    }
+  }
+
+  void workerLoop(sizex index) {
+    threadWorkerId() = WorkerId{this, index};
+    pool_detail::InlineTask task;
+    while (true) {
+      if (takeTask(index, task)) {
+        runTask(task);
+        continue;
+      }
+
+      // Spin a little before sleeping, since more work often follows shortly
+      bool found = false;
+      for (int spin = 0; spin < kIdleSpins && !found; ++spin) {
+        std::this_thread::yield();
+        found = takeTask(index, task);
+      }
+      if (found) {
+        runTask(task);
+        continue;
+      }
+
+      u64 signals;
+      {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        signals = _wakeSignals;
+        _sleepers.fetch_add(1, std::memory_order_seq_cst);
+      }
+      found = takeTask(index, task);
+      if (!found) {
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _wake.wait(lock, [&]() { return _wakeSignals != signals || _stopping; });
+      }
+      _sleepers.fetch_sub(1, std::memory_order_relaxed);
+
+      if (found) {
+        runTask(task);
+      } else if (shouldExit()) {
+        return;
+      }
+    }
+  }
+
+  /// Stop once stopping and the deques are empty, so queued work still runs
+  bool shouldExit() {
+    {
+      std::lock_guard<std::mutex> lock(_sleepMutex);
+      if (!_stopping) {
+        return false;
+      }
+    }
+    pool_detail::InlineTask task;
+    for (auto& worker : _workers) {
+      if (worker->popFront(task)) {
+        runTask(task);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static void pinThread(std::thread& thread, sizex core) {
+#if SW_LINUX
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    // Best effort. eg. A restricted cpuset can refuse it
+    unused(::pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus));
+#else
+    unused(thread);
+    unused(core);
+#endif
+  }
+
+  static constexpr int kIdleSpins = 64;
+
+  std::vector<std::unique_ptr<pool_detail::Worker>> _workers;
+
+  std::atomic<sizex> _sleepers{0};
+  std::mutex _sleepMutex;
+  std::condition_variable _wake;
+  u64 _wakeSignals = 0;
+  bool _stopping = false;
+};
+
 SW_NAMESPACE_END
@@ -28,6 +28,10 @@
 #include <string>
 #include <type_traits>
 
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 SW_NAMESPACE_BEGIN namespace utils {
   template <typename SystemTraits = ::sw::system::ThisSystemTraits>
   struct UtilsStorageType;
@@ -101,6 +105,149 @@ SW_NAMESPACE_BEGIN namespace utils {
     } while (*pos++ != 0);
   }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Like splitString(), but the substrings are StringViews into the source, so nothing is
+  /// allocated. Splitters are found with memchr. The source's length is used, so embedded NULs
+  /// are just regular chars.
+  ///
+  /// Ex: split ":foo::bar:" by ':'. Results -> "", "foo", "", "bar", ""
+  ///
+  /// @param Func function that receives each substring: void func(StringView)
+  /// @return number of substrings processed
+  template <typename Func>
+  inline sizex splitStringView(const StringView& source, char splitter, const Func& func) {
+    if (source.empty()) {
+      return 0;
+    }
+
+    sizex count = 0;
+    const char* pos = source.data();
+    const char* const end = pos + source.size();
+    for (;;) {
+      const auto found = static_cast<const char*>(std::memchr(pos, splitter, sizex(end - pos)));
+      const char* const tokenEnd = found != nullptr ? found : end;
+      func(StringView(pos, sizex(tokenEnd - pos)));
+      ++count;
+      if (found == nullptr) {
+        return count;
+      }
+      pos = found + 1;
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Whether StringTokenizer hands out the empty tokens between adjacent delimiters
+  enum class EmptyTokens : u8 {
+    Keep,
+    Skip,
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Pulls StringView tokens, separated by any of a set of delimiter chars, out of a source
+  /// string. No allocation. With EmptyTokens::Keep the tokens match splitStringView().
+  ///
+  /// A single delimiter is searched for with memchr. Up to kMaxVectorDelimiters are compared 16
+  /// chars at a time with SSE2 where available; larger sets use a 256-bit lookup.
+  ///
+  /// Usage:
+  ///   auto tokenizer = StringTokenizer(line, " \t,", EmptyTokens::Skip);
+  ///   StringView token;
+  ///   while (tokenizer.next(token)) { ... }
+  ////////////////////////////////////////////////////////////////////////////////
+  class StringTokenizer {
+  public:
+    static constexpr sizex kMaxVectorDelimiters = 8;
+
+    StringTokenizer(const StringView& source, const StringView& delimiters, EmptyTokens emptyTokens = EmptyTokens::Keep)
+        : _pos(source.data()),
+          _end(source.data() + source.size()),
+          _done(source.empty()),
+          _emptyTokens(emptyTokens) {
+      for (char c : delimiters) {
+        const auto index = u8(c);
+        if ((_delimiterSet[index >> 6u] & (1_u64 << (index & 63u))) == 0) {
+          _delimiterSet[index >> 6u] |= 1_u64 << (index & 63u);
+          if (_delimiterCount < kMaxVectorDelimiters) {
+            _delimiters[_delimiterCount] = c;
+          }
+          ++_delimiterCount;
+        }
+      }
+    }
+
+    /// Get the next token. Returns false when there are no more
+    bool next(StringView& token) {
+      while (!_done) {
+        const char* const found = findDelimiter();
+        token = StringView(_pos, sizex(found - _pos));
+        if (found == _end) {
+          _done = true;
+        } else {
+          _pos = found + 1;
+        }
+        if (_emptyTokens == EmptyTokens::Keep || !token.empty()) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /// The part of the source that hasn't been tokenized yet
+    StringView rest() const { return _done ? StringView(_end, 0) : StringView(_pos, sizex(_end - _pos)); }
+
+  private:
+    bool isDelimiter(char c) const {
+      const auto index = u8(c);
+      return (_delimiterSet[index >> 6u] & (1_u64 << (index & 63u))) != 0;
+    }
+
+    const char* findDelimiter() const {
+      if (_delimiterCount == 0) {
+        return _end;
+      }
+      if (_delimiterCount == 1) {
+        const auto found = static_cast<const char*>(std::memchr(_pos, _delimiters[0], sizex(_end - _pos)));
+        return found != nullptr ? found : _end;
+      }
+
+      const char* pos = _pos;
+#if defined(__SSE2__)
+      if (_delimiterCount <= kMaxVectorDelimiters) {
+        __m128i delimiters[kMaxVectorDelimiters];
+        for (sizex i = 0; i < _delimiterCount; ++i) {
+          delimiters[i] = _mm_set1_epi8(_delimiters[i]);
+        }
+        for (; _end - pos >= 16; pos += 16) {
+          const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+          __m128i matches = _mm_cmpeq_epi8(chars, delimiters[0]);
+          for (sizex i = 1; i < _delimiterCount; ++i) {
+            matches = _mm_or_si128(matches, _mm_cmpeq_epi8(chars, delimiters[i]));
+          }
+          const int mask = _mm_movemask_epi8(matches);
+          if (mask != 0) {
+            return pos + __builtin_ctz(unsigned(mask));
+          }
+        }
+      }
+#endif
+      for (; pos != _end; ++pos) {
+        if (isDelimiter(*pos)) {
+          return pos;
+        }
+      }
+      return _end;
+    }
+
+  private:
+    const char* _pos;
+    const char* _end;
+    bool _done;
+    EmptyTokens _emptyTokens;
+    sizex _delimiterCount = 0;
+    char _delimiters[kMaxVectorDelimiters] = {};
+    u64 _delimiterSet[4] = {};
+  };
+
   ////////////////////////////////////////////////////////////////////////////////
   /// TODO: Probably just get rid of this now that I'm using lib {fmt}
   ///
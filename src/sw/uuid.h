@@ -19,18 +19,156 @@
 #pragma once
 
 #include "base64.h"
+#include "random.h"
 #include "system_traits.h"
 #include "utils.h"
 
 #include <array>
+#include <chrono>
+#include <cstring>
+#include <functional>
 #include <iostream>
 
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 SW_NAMESPACE_BEGIN
 
 template <typename SystemTraits = system::ThisSystemTraits>
 class UuidType;
 using Uuid = UuidType<>;
 
+namespace uuid_detail {
+
+////////////////////////////////////////////////////////////////////////////////
+/// 16 bytes to 32 lower case hex chars
+inline void toHex(const byte* bytes, char* hex) noexcept {
+#if defined(__SSE2__)
+  // SSE2 is baseline on x86-64. Split into nibbles, map each to '0'-'9' or 'a'-'f' with a
+  // compare, then interleave the high and low nibble chars back into byte order
+  const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+  const __m128i mask = _mm_set1_epi8(0x0f);
+  const auto toAscii = [](__m128i nibbles) {
+    const __m128i letters = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), _mm_and_si128(letters, _mm_set1_epi8('a' - '0' - 10)));
+  };
+  const __m128i hi = toAscii(_mm_and_si128(_mm_srli_epi16(in, 4), mask));
+  const __m128i lo = toAscii(_mm_and_si128(in, mask));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(hex), _mm_unpacklo_epi8(hi, lo));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(hex + 16), _mm_unpackhi_epi8(hi, lo));
+#else
+  for (sizex i = 0; i < 16; ++i) {
+    const char* hexChar = utils::toHexChar(bytes[i]);
+    hex[2 * i] = hexChar[0];
+    hex[2 * i + 1] = hexChar[1];
+  }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// 32 hex chars, either case, to 16 bytes. Returns false if any char isn't hex
+inline bool fromHex(const char* hex, byte* bytes) noexcept {
+#if defined(__SSE2__)
+  // Unsigned range checks via min: a char is a digit if (c - '0') <= 9, and a letter if
+  // ((c | 0x20) - 'a') <= 5
+  __m128i valid = _mm_set1_epi8(-1);
+  const auto toNibbles = [&valid](__m128i chars) {
+    const __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+    const __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    const __m128i letter = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    const __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+    valid = _mm_and_si128(valid, _mm_or_si128(isDigit, isLetter));
+    const __m128i nibbles = _mm_or_si128(_mm_and_si128(isDigit, digit),
+                                         _mm_and_si128(isLetter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+    // Each 16-bit lane holds [high nibble, low nibble]; combine into one byte per lane
+    return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00ff)), 4),
+                        _mm_srli_epi16(nibbles, 8));
+  };
+  const __m128i first = toNibbles(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex)));
+  const __m128i second = toNibbles(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + 16)));
+  if (_mm_movemask_epi8(valid) != 0xffff) {
+    return false;
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), _mm_packus_epi16(first, second));
+  return true;
+#else
+  const auto nibble = [](char c) -> int {
+    if (c >= '0' && c <= '9') {
+      return c - '0';
+    }
+    const char lower = char(c | 0x20);
+    return lower >= 'a' && lower <= 'f' ? lower - 'a' + 10 : -1;
+  };
+  for (sizex i = 0; i < 16; ++i) {
+    const int hi = nibble(hex[2 * i]);
+    const int lo = nibble(hex[2 * i + 1]);
+    if ((hi | lo) < 0) {
+      return false;
+    }
+    bytes[i] = byte((hi << 4) | lo);
+  }
+  return true;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// 64-bit finalizer from MurmurHash3
+inline u64 mix64(u64 x) noexcept {
+  x ^= x >> 33u;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33u;
+  x *= 0xc4ceb9fe1a85ec53ull;
+  x ^= x >> 33u;
+  return x;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Per-thread UUIDv7 timestamp + counter. Uses the 12 rand_a bits as a counter (RFC 9562 method
+/// 1), restarting at a random value with the top bit clear each new millisecond. If the counter
+/// runs out, or the clock steps back, the timestamp is advanced past the last one issued, so
+/// every ID a thread makes sorts after the one before.
+struct V7Clock {
+  u64 ms = 0;
+  u32 counter = 0;
+
+  void advance(u64 nowMs, ChaCha20Random& random) noexcept {
+    if (nowMs > ms) {
+      ms = nowMs;
+      counter = u32(random() & 0x7ffu);
+    } else if (++counter > 0xfffu) {
+      ++ms;
+      counter = u32(random() & 0x7ffu);
+    }
+  }
+
+  static V7Clock& thisThread() noexcept {
+    static thread_local V7Clock tClock;
+    return tClock;
+  }
+};
+
+inline u64 unixTimeMs() noexcept {
+  using namespace std::chrono;
+  return u64(duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// 48-bit big-endian ms timestamp, version 7, 12-bit counter, variant 0b10, 62 random bits
+inline void writeV7(u64 ms, u32 counter, u64 random, byte* out) noexcept {
+  for (sizex i = 0; i < 6; ++i) {
+    out[i] = byte(ms >> (40u - 8u * i));
+  }
+  out[6] = byte(0x70u | ((counter >> 8u) & 0x0fu));
+  out[7] = byte(counter);
+  out[8] = byte(0x80u | ((random >> 56u) & 0x3fu));
+  for (sizex i = 9; i < 16; ++i) {
+    out[i] = byte(random >> (8u * (15u - i)));
+  }
+}
+
+}  // namespace uuid_detail
+
 ////////////////////////////////////////////////////////////////////////////////
 /// Class that represents a UUID
 ////////////////////////////////////////////////////////////////////////////////
@@ -40,6 +178,32 @@ public:
   /// Creates a random UUID
   static UuidType create() noexcept;
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Creates a time ordered UUIDv7 (RFC 9562). IDs from one thread are strictly increasing; IDs
+  /// from different threads are ordered to the millisecond. Randomness comes from threadRandom(),
+  /// so there are no syscalls beyond reading the clock. The first call on a thread seeds it from
+  /// std::random_device, which can throw.
+  static UuidType createV7() {
+    auto& random = threadRandom();
+    auto& clock = uuid_detail::V7Clock::thisThread();
+    clock.advance(uuid_detail::unixTimeMs(), random);
+    UuidType result;
+    uuid_detail::writeV7(clock.ms, clock.counter, random(), result.bytes_.data());
+    return result;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Fill out with count UUIDv7s, in increasing order. Reads the clock once for the whole batch
+  static void createBatch(UuidType* out, sizex count) {
+    auto& random = threadRandom();
+    auto& clock = uuid_detail::V7Clock::thisThread();
+    const u64 nowMs = uuid_detail::unixTimeMs();
+    for (sizex i = 0; i < count; ++i) {
+      clock.advance(nowMs, random);
+      uuid_detail::writeV7(clock.ms, clock.counter, random(), out[i].bytes_.data());
+    }
+  }
+
   /// Creates an invalid UUID
   UuidType() noexcept : bytes_({{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}}) {}
 
@@ -55,25 +219,81 @@ public:
   UuidType(UuidType&& other) noexcept = default;
   UuidType& operator=(UuidType&& other) noexcept = default;
 
-  // TODO Uuid(const StringWrapper& string);
+  /// Length of the canonical 8-4-4-4-12 string form
+  static constexpr sizex kStringSize = 36;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Parse the canonical 8-4-4-4-12 form, either case. No allocation. Returns false, leaving
+  /// result untouched, if the string isn't exactly that
+  static bool fromString(const char* str, sizex len, UuidType& result) noexcept {
+    if (len != kStringSize || str[8] != '-' || str[13] != '-' || str[18] != '-' || str[23] != '-') {
+      return false;
+    }
+    char hex[32];
+    ::memcpy(hex, str, 8);
+    ::memcpy(hex + 8, str + 9, 4);
+    ::memcpy(hex + 12, str + 14, 4);
+    ::memcpy(hex + 16, str + 19, 4);
+    ::memcpy(hex + 20, str + 24, 12);
+    std::array<byte, 16> bytes;
+    if (!uuid_detail::fromHex(hex, bytes.data())) {
+      return false;
+    }
+    result.bytes_ = bytes;
+    return true;
+  }
+
+  static bool fromString(const std::string& str, UuidType& result) noexcept {
+    return fromString(str.data(), str.size(), result);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Parse the output of toBase64(). Padding is optional
+  static bool fromBase64(const char* str, sizex len, UuidType& result) noexcept {
+    return fromBase64With<::sw::detail::Base64Traits>(str, len, result);
+  }
+
+  static bool fromBase64(const std::string& str, UuidType& result) noexcept {
+    return fromBase64(str.data(), str.size(), result);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Parse the output of toBase64Url(). Padding is optional
+  static bool fromBase64Url(const char* str, sizex len, UuidType& result) noexcept {
+    return fromBase64With<::sw::detail::Base64UrlTraits>(str, len, result);
+  }
+
+  static bool fromBase64Url(const std::string& str, UuidType& result) noexcept {
+    return fromBase64Url(str.data(), str.size(), result);
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
   const byte* bytes() const { return bytes_.data(); }
   constexpr sizex size() const { return 16; }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Write the canonical string form into dest, which must have room for kStringSize chars. No
+  /// terminator is written. Returns the end of what was written
+  char* toChars(char* dest) const noexcept {
+    char hex[32];
+    uuid_detail::toHex(bytes_.data(), hex);
+    ::memcpy(dest, hex, 8);
+    dest[8] = '-';
+    ::memcpy(dest + 9, hex + 8, 4);
+    dest[13] = '-';
+    ::memcpy(dest + 14, hex + 12, 4);
+    dest[18] = '-';
+    ::memcpy(dest + 19, hex + 16, 4);
+    dest[23] = '-';
+    ::memcpy(dest + 24, hex + 20, 12);
+    return dest + kStringSize;
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
   /// Convert the UUID into a string
   std::string toString() const {
-    std::array<char, 36> buffer = {{0}};
-    for (size_t i = 0, pos = 0; i < 16; ++i) {
-      if (i == 4 || i == 6 || i == 8 || i == 10) {
-        buffer[pos++] = '-';
-      }
-      auto hexChar = utils::toHexChar(bytes_[i]);
-      buffer[pos++] = hexChar[0];
-      buffer[pos++] = hexChar[1];
-    }
-
-    std::string result(buffer.data(), 36);
+    std::string result(kStringSize, '\0');
+    toChars(&result[0]);
     return result;
   }
 
@@ -85,6 +305,10 @@ public:
   /// Convert the UUID into a filename-safe base64 string
   std::string toBase64Url() const { return base64UrlEncode(bytes_.data(), 16); }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /// The version nibble, e.g. 4 for random or 7 for time ordered
+  u8 version() const { return u8(bytes_[6] >> 4u); }
+
   ////////////////////////////////////////////////////////////////////////////////
   /// Determine if the UUID is valid or not. An invalid UUID has all bytes as 0
   bool isValid() const {
@@ -92,6 +316,16 @@ public:
     return *this != invalid;
   }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Hash of all 128 bits. Cheap, and fine for time based UUIDs where only some bits vary
+  sizex hash() const noexcept {
+    u64 a;
+    u64 b;
+    ::memcpy(&a, bytes_.data(), 8);
+    ::memcpy(&b, bytes_.data() + 8, 8);
+    return sizex(uuid_detail::mix64(a ^ uuid_detail::mix64(b)));
+  }
+
   friend bool operator==(const UuidType& a, const UuidType& b) { return a.bytes_ == b.bytes_; }
   friend bool operator!=(const UuidType& a, const UuidType& b) { return a.bytes_ != b.bytes_; }
   friend bool operator<(const UuidType& a, const UuidType& b) { return a.bytes_ < b.bytes_; }
@@ -102,12 +336,37 @@ public:
     return outs << u.toString().c_str();
   }
 
+private:
+  template <typename Base64TraitsType>
+  static bool fromBase64With(const char* str, sizex len, UuidType& result) noexcept {
+    std::array<byte, 16> bytes;
+    if (base64DecoderInto<Base64TraitsType>(str, len, bytes.data(), bytes.size()) != bytes.size()) {
+      return false;
+    }
+    result.bytes_ = bytes;
+    return true;
+  }
+
 private:
   std::array<byte, 16> bytes_ = {{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}};
 };
 
+template <typename SystemTraits>
+constexpr sizex UuidType<SystemTraits>::kStringSize;
+
 SW_NAMESPACE_END
 
+namespace std {
+
+////////////////////////////////////////////////////////////////////////////////
+/// Lets UUIDs be used directly as unordered container and LruCache keys
+template <typename SystemTraits>
+struct hash<::sw::UuidType<SystemTraits>> {
+  size_t operator()(const ::sw::UuidType<SystemTraits>& uuid) const noexcept { return uuid.hash(); }
+};
+
+}  // namespace std
+
 ////////////////////////////////////////////////////////////////////////////////
 /// Per-OS implementation.
 ///
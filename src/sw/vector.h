@@ -19,41 +19,112 @@
 #pragma once
 
 #include "assert.h"
+#include "buffers.h"
 #include "misc.h"
 #include "reallocator.h"
 #include "types.h"
 
-#if UNTIL_BUFFER
-#  include "UniqueBuffer.h"
-#endif
-
+#include <algorithm>
 #include <type_traits>
 #include <vector>
 
 SW_NAMESPACE_BEGIN
 
-template <typename T, typename Reallocator>
+////////////////////////////////////////////////////////////////////////////////
+/// Vector growth policies. `grow()` gives the capacity to grow to once `capacity` is
+/// full, which must be at least `minCapacity`.
+
+/// Double the capacity. The fewest reallocations, but up to half the memory sits unused
+struct DoublingGrowthPolicy {
+  static constexpr sizex grow(sizex capacity, sizex minCapacity, sizex /*itemSize*/) noexcept {
+    return std::max(capacity * 2, minCapacity);
+  }
+};
+
+/// Grow by half again. Wastes less, and lets the allocator reuse freed blocks for later
+/// growth, at the cost of some extra reallocations
+struct OneAndHalfGrowthPolicy {
+  static constexpr sizex grow(sizex capacity, sizex minCapacity, sizex /*itemSize*/) noexcept {
+    return std::max(capacity + capacity / 2, minCapacity);
+  }
+};
+
+/// Round another policy's capacity up to the end of its allocator size class, so the
+/// slack malloc rounds up to anyway holds items. Uses jemalloc's classes (16 byte steps to
+/// 128, then four per doubling), which also suit tcmalloc's closely enough.
+template <typename BasePolicy = OneAndHalfGrowthPolicy>
+struct SizeClassGrowthPolicy {
+  static constexpr sizex grow(sizex capacity, sizex minCapacity, sizex itemSize) noexcept {
+    return roundUpToSizeClass(BasePolicy::grow(capacity, minCapacity, itemSize) * itemSize) / itemSize;
+  }
+
+  static constexpr sizex roundUpToSizeClass(sizex bytes) noexcept {
+    if (bytes <= 8) {
+      return 8;
+    }
+    if (bytes <= 128) {
+      return (bytes + 15) & ~15_z;
+    }
+
+    sizex log2 = 0;
+    for (auto value = bytes - 1; value > 1; value >>= 1) {
+      ++log2;
+    }
+    const auto step = 1_z << (log2 - 2);
+    return (bytes + step - 1) & ~(step - 1);
+  }
+};
+
+template <typename T, typename Reallocator, typename GrowthPolicy>
 class VectorBase;
 
+template <typename T, sizex N, typename Reallocator, typename GrowthPolicy>
+class SmallVectorBase;
+
+/// The reallocator vectors use by default: malloc (and realloc) for anything trivially
+/// relocatable
+template <typename T>
+using DefaultVectorReallocator = std::conditional_t<IsTriviallyRelocatable<T>::value, MallocReallocator<T>,
+                                                    ReallocatorAdapter<T, std::allocator<T>>>;
+
 // The vector type.
-template <typename T, typename Reallocator = std::conditional_t<
-                          std::is_trivially_destructible<T>::value && std::is_trivially_copyable<T>::value,
-                          MallocReallocator<T>, ReallocatorAdapter<T, std::allocator<T>>>>
-using Vector = VectorBase<T, Reallocator>;
+template <typename T, typename Reallocator = DefaultVectorReallocator<T>, typename GrowthPolicy = DoublingGrowthPolicy>
+using Vector = VectorBase<T, Reallocator, GrowthPolicy>;
+
+// A vector keeping up to N items inline before it allocates.
+template <typename T, sizex N, typename Reallocator = DefaultVectorReallocator<T>,
+          typename GrowthPolicy = DoublingGrowthPolicy>
+using SmallVector = SmallVectorBase<T, N, Reallocator, GrowthPolicy>;
+
+namespace vector_detail {
+
+/// True for reallocators that free with std::free, so can take over a UniqueBuffer
+template <typename Reallocator>
+struct FreesWithStdFree : std::false_type {};
+template <typename T>
+struct FreesWithStdFree<MallocReallocator<T>> : std::true_type {};
+template <typename T, sizex N, typename Fallback>
+struct FreesWithStdFree<InlineReallocator<T, N, Fallback>> : FreesWithStdFree<Fallback> {};
+
+}  // namespace vector_detail
 
 ////////////////////////////////////////////////////////////////////////////////
 /// A vector with a bit more flexibility/efficiency than std::vector for POD types.
-/// - Uses a "Reallocator". For now, assumes the reallocator is stateless
+/// - Uses a "Reallocator", which may be stateful (eg. ArenaReallocator). Empty (stateless)
+///   reallocators take no space.
 /// - Supports capacity setting on construction
 /// - *Not* specialized for 'bool' space efficiency, so use std::vector for that
 /// - Can consume a std::unique_ptr<T> for no-copy semantics
 /// - Conforms to the std::vector interface where possible.
 /// - data() returns nullptr for empty vector
 ///
-/// I'm using the stateless allocator until I get a compressed-pair class in there.
+/// The reallocator goes along with the memory on moves and copy constructions, but copy
+/// assignment keeps the vector's own.
+///
+/// @tparam GrowthPolicy How much capacity push_back grows by. eg. DoublingGrowthPolicy
 ////////////////////////////////////////////////////////////////////////////////
-template <typename T, typename Reallocator>
-class VectorBase {
+template <typename T, typename Reallocator, typename GrowthPolicy>
+class VectorBase : private Reallocator {
 public:
   using value_type = T;
   using size_type = ::std::size_t;
@@ -64,6 +135,7 @@ public:
   using iterator = pointer;
   using const_iterator = const_pointer;
   using reallocator = Reallocator;
+  using growth_policy = GrowthPolicy;
   using move_copy_ops = MoveCopyOps<T>;
 
   ////////////////////////////////////////////////////////////////////////////////
@@ -75,9 +147,14 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
   VectorBase() noexcept : begin_(nullptr), end_(nullptr), capacity_(nullptr) {}
 
+  ////////////////////////////////////////////////////////////////////////////////
+  explicit VectorBase(const Reallocator& realloc) noexcept :
+      Reallocator(realloc), begin_(nullptr), end_(nullptr), capacity_(nullptr) {}
+
   ////////////////////////////////////////////////////////////////////////////////
   /// Copy a vector
   VectorBase(const VectorBase& that) :
+      Reallocator(that.get_allocator()),
       begin_(allocator().allocate(that.capacity())),
       end_(begin_ + that.size()),
       capacity_(begin_ + that.capacity()) {
@@ -87,6 +164,7 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
   /// Move a vector
   VectorBase(VectorBase&& that) noexcept :
+      Reallocator(std::move(that.allocator())),
       begin_(std::exchange(that.begin_, nullptr)),
       end_(std::exchange(that.end_, nullptr)),
       capacity_(std::exchange(that.capacity_, nullptr)) {
@@ -94,32 +172,42 @@ public:
   }
 
   ////////////////////////////////////////////////////////////////////////////////
-  explicit VectorBase(size_type count) :
-      begin_(allocator().allocate(count)), end_(begin_ + count), capacity_(end_) {
+  explicit VectorBase(size_type count, const Reallocator& realloc = Reallocator()) :
+      Reallocator(realloc), begin_(allocator().allocate(count)), end_(begin_ + count), capacity_(end_) {
     move_copy_ops::constructDefaultItems(begin_, count);
   }
 
   ////////////////////////////////////////////////////////////////////////////////
-  VectorBase(size_type count, size_type capacity) :
-      begin_(allocator().allocate(capacity)), end_(begin_ + count), capacity_(begin_ + capacity) {
+  VectorBase(size_type count, size_type capacity, const Reallocator& realloc = Reallocator()) :
+      Reallocator(realloc),
+      begin_(allocator().allocate(capacity)),
+      end_(begin_ + count),
+      capacity_(begin_ + capacity) {
     move_copy_ops::constructDefaultItems(begin_, count);
   }
 
   ////////////////////////////////////////////////////////////////////////////////
-  VectorBase(size_type count, const value_type& value) :
-      begin_(allocator().allocate(count)), end_(begin_ + count), capacity_(end_) {
+  VectorBase(size_type count, const value_type& value, const Reallocator& realloc = Reallocator()) :
+      Reallocator(realloc), begin_(allocator().allocate(count)), end_(begin_ + count), capacity_(end_) {
     move_copy_ops::constructItemsFromItem(begin_, count, value);
   }
 
   ////////////////////////////////////////////////////////////////////////////////
-  VectorBase(size_type count, size_type capacity, const value_type& value) :
-      begin_(allocator().allocate(capacity)), end_(begin_ + count), capacity_(begin_ + capacity) {
+  VectorBase(size_type count, size_type capacity, const value_type& value,
+             const Reallocator& realloc = Reallocator()) :
+      Reallocator(realloc),
+      begin_(allocator().allocate(capacity)),
+      end_(begin_ + count),
+      capacity_(begin_ + capacity) {
     move_copy_ops::constructItemsFromItem(begin_, count, value);
   }
 
   ////////////////////////////////////////////////////////////////////////////////
-  VectorBase(std::initializer_list<T> init) :
-      begin_(allocator().allocate(init.size())), end_(begin_ + init.size()), capacity_(end_) {
+  VectorBase(std::initializer_list<T> init, const Reallocator& realloc = Reallocator()) :
+      Reallocator(realloc),
+      begin_(allocator().allocate(init.size())),
+      end_(begin_ + init.size()),
+      capacity_(end_) {
     T* slot = begin_;
     for (const auto& value : init) {
       move_copy_ops::constructItemsFromItem(slot, 1, value);
@@ -127,21 +215,23 @@ public:
     }
   }
 
-#if UNTIL_BUFFER
   ////////////////////////////////////////////////////////////////////////////////
-  // Assume ownership
-  explicit VectorBase(UniqueBuffer&& buffer) {
-    auto bufferSize = buffer.size();
-    auto count = bufferSize / sizeof(T);
-    begin_ = buffer.release().release();
+  /// Assume ownership of the buffer's memory, which holds the items. Any partial item at
+  /// the end of the buffer is ignored.
+  explicit VectorBase(UniqueBuffer&& buffer) noexcept {
+    static_assert(vector_detail::FreesWithStdFree<Reallocator>::value,
+                  "Only a malloc-based vector can take over a UniqueBuffer");
+    const auto count = buffer.size() / sizeof(T);
+    begin_ = reinterpret_cast<T*>(buffer.release());
     end_ = begin_ + count;
     capacity_ = begin_ + count;
   }
-#endif
 
   ////////////////////////////////////////////////////////////////////////////////
+  /// Keeps this vector's reallocator
   VectorBase& operator=(const VectorBase& that) {
     if (this != &that) {
+      freeItems();
       begin_ = allocator().allocate(that.capacity());
       end_ = begin_ + that.size();
       capacity_ = begin_ + that.capacity();
@@ -151,8 +241,11 @@ public:
   }
 
   ////////////////////////////////////////////////////////////////////////////////
+  /// Takes the reallocator along with the memory
   VectorBase& operator=(VectorBase&& that) noexcept {
     if (this != &that) {
+      freeItems();
+      allocator() = std::move(that.allocator());
       begin_ = std::exchange(that.begin_, nullptr);
       end_ = std::exchange(that.end_, nullptr);
       capacity_ = std::exchange(that.capacity_, nullptr);
@@ -160,6 +253,9 @@ public:
     return *this;
   }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  const reallocator& get_allocator() const noexcept { return *this; }
+
   iterator begin() noexcept { return begin_; }
   const_iterator begin() const noexcept { return begin_; }
   const_iterator cbegin() const noexcept { return begin_; }
@@ -207,7 +303,7 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
   void reserve(size_type newCapacity) {
     // Per std::vector, no shrinking allowed
-    if (newCapacity < capacity()) {
+    if (newCapacity <= capacity()) {
       return;
     }
 
@@ -271,7 +367,7 @@ public:
   ////////////////////////////////////////////////////////////////////////////////
   void pop_back() {
     --end_;
-    move_copy_ops::destructItems(*end_, 1);
+    move_copy_ops::destructItems(end_, 1);
   }
 
   // TODO
@@ -285,12 +381,19 @@ public:
     size_type max_size() const noexcept;
 #endif
 
-private:
+protected:
   ////////////////////////////////////////////////////////////////////////////////
-  /// For now until we have an allocator member (via compressed pair)... this can
-  /// then change to return a reallocator&
-  reallocator allocator() { return reallocator(); }
+  reallocator& allocator() noexcept { return *this; }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Destroy the items and free the memory, leaving the vector empty
+  void freeItems() noexcept {
+    move_copy_ops::destructItems(begin_, size());
+    allocator().deallocate(begin_, capacity());
+    begin_ = end_ = capacity_ = nullptr;
+  }
+
+private:
   ////////////////////////////////////////////////////////////////////////////////
   /// Call when the size is shrinking. Will destruct items
   void shrinkTo(size_type newCount) {
@@ -305,17 +408,188 @@ private:
   T*& bufferEnd() { return capacity_; }
   T* const& bufferEnd() const { return capacity_; }
 
-  /// For now, to grow we'll just double our size. TODO: Think about this
+  /// Grow as the policy says once full. Growing from nothing has to give at least one slot.
   void autoGrow() {
     if (end_ == bufferEnd()) {
-      reserve(capacity() * 2);
+      const auto newCapacity = GrowthPolicy::grow(capacity(), size() + 1, sizeof(T));
+      SW_ASSERT(newCapacity > size());
+      reserve(newCapacity);
     }
   }
 
-private:
+protected:
   T* begin_;
   T* end_;
   T* capacity_;
 };
 
+////////////////////////////////////////////////////////////////////////////////
+/// A Vector that keeps up to N items inline, inside the object, only going to the
+/// reallocator once it outgrows them. So the many small, short-lived vectors cost no
+/// allocations at all. It has the whole Vector interface, and starts with a capacity of N.
+///
+/// Moving a vector that's still inline moves the items one by one, since the storage
+/// can't go with them. Once on the heap moves just take the memory, as with Vector.
+///
+/// The Vector base is protected, so its pointer-stealing moves can't be reached through a
+/// base reference and leave the target pointing at our inline storage.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T, sizex N, typename Reallocator, typename GrowthPolicy>
+class SmallVectorBase : protected VectorBase<T, InlineReallocator<T, N, Reallocator>, GrowthPolicy> {
+  using Base = VectorBase<T, InlineReallocator<T, N, Reallocator>, GrowthPolicy>;
+
+public:
+  using typename Base::const_iterator;
+  using typename Base::const_pointer;
+  using typename Base::const_reference;
+  using typename Base::growth_policy;
+  using typename Base::iterator;
+  using typename Base::move_copy_ops;
+  using typename Base::pointer;
+  using typename Base::reallocator;
+  using typename Base::reference;
+  using typename Base::size_type;
+  using typename Base::value_type;
+
+  using Base::assign;
+  using Base::at;
+  using Base::back;
+  using Base::begin;
+  using Base::capacity;
+  using Base::cbegin;
+  using Base::cend;
+  using Base::clear;
+  using Base::data;
+  using Base::empty;
+  using Base::end;
+  using Base::front;
+  using Base::get_allocator;
+  using Base::pop_back;
+  using Base::push_back;
+  using Base::reserve;
+  using Base::resize;
+  using Base::size;
+  using Base::operator[];
+
+  static constexpr sizex kInlineCapacity = N;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  SmallVectorBase() noexcept : SmallVectorBase(Reallocator()) {}
+
+  ////////////////////////////////////////////////////////////////////////////////
+  explicit SmallVectorBase(const Reallocator& realloc) noexcept : Base(inlineReallocator(realloc)) {
+    reserveInline();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  SmallVectorBase(const SmallVectorBase& that) : Base(that.get_allocator()) {
+    copyFrom(that);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  SmallVectorBase(SmallVectorBase&& that) noexcept(std::is_nothrow_move_constructible<T>::value) :
+      Base(that.get_allocator()) {
+    moveFrom(that);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  explicit SmallVectorBase(size_type count, const Reallocator& realloc = Reallocator()) :
+      Base(count, inlineReallocator(realloc)) {
+    reserveInline();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  SmallVectorBase(size_type count, size_type minCapacity, const Reallocator& realloc = Reallocator()) :
+      Base(count, std::max(minCapacity, N), inlineReallocator(realloc)) {}
+
+  ////////////////////////////////////////////////////////////////////////////////
+  SmallVectorBase(size_type count, const value_type& value, const Reallocator& realloc = Reallocator()) :
+      Base(count, value, inlineReallocator(realloc)) {
+    reserveInline();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  SmallVectorBase(size_type count, size_type minCapacity, const value_type& value,
+                  const Reallocator& realloc = Reallocator()) :
+      Base(count, std::max(minCapacity, N), value, inlineReallocator(realloc)) {}
+
+  ////////////////////////////////////////////////////////////////////////////////
+  SmallVectorBase(std::initializer_list<T> init, const Reallocator& realloc = Reallocator()) :
+      Base(init, inlineReallocator(realloc)) {
+    reserveInline();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Assume ownership of the buffer's memory. See Vector.
+  explicit SmallVectorBase(UniqueBuffer&& buffer) noexcept : Base(std::move(buffer)) { reserveInline(); }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Reuses the current storage when it's big enough
+  SmallVectorBase& operator=(const SmallVectorBase& that) {
+    if (this != &that) {
+      Base::clear();
+      copyFrom(that);
+    }
+    return *this;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  SmallVectorBase& operator=(SmallVectorBase&& that) noexcept(std::is_nothrow_move_constructible<T>::value) {
+    if (this != &that) {
+      Base::clear();
+      moveFrom(that);
+    }
+    return *this;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Return true while the items are still in the inline storage
+  bool isInline() const noexcept { return this->get_allocator().isInline(this->begin_); }
+
+private:
+  static InlineReallocator<T, N, Reallocator> inlineReallocator(const Reallocator& realloc) noexcept {
+    return InlineReallocator<T, N, Reallocator>(realloc);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Get the inline storage if there's no storage at all, or it's inline but short
+  void reserveInline() noexcept {
+    if (this->begin_ == nullptr || isInline()) {
+      Base::reserve(N);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Copy the items into this (empty) vector
+  void copyFrom(const SmallVectorBase& that) {
+    Base::reserve(std::max(N, that.size()));
+    move_copy_ops::copyConstructItems(this->begin_, that.begin_, that.size());
+    this->end_ = this->begin_ + that.size();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// Take the items from `that`, leaving it empty. This vector must be empty.
+  void moveFrom(SmallVectorBase& that) {
+    if (that.isInline()) {
+      // The items have to move, as the storage can't go with them
+      Base::reserve(std::max(N, that.size()));
+      move_copy_ops::moveConstructAndDeleteItems(this->begin_, that.begin_, that.size());
+      this->end_ = this->begin_ + that.size();
+      that.end_ = that.begin_;
+      return;
+    }
+
+    // Take the heap memory, along with the reallocator for freeing it
+    this->freeItems();
+    this->allocator() = that.get_allocator();
+    this->begin_ = std::exchange(that.begin_, nullptr);
+    this->end_ = std::exchange(that.end_, nullptr);
+    this->capacity_ = std::exchange(that.capacity_, nullptr);
+    that.reserveInline();
+  }
+};
+
+template <typename T, sizex N, typename Reallocator, typename GrowthPolicy>
+constexpr sizex SmallVectorBase<T, N, Reallocator, GrowthPolicy>::kInlineCapacity;
+
 SW_NAMESPACE_END
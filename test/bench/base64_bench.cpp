@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#include "bench_utils.h"
+
+#include <sw/base64.h>
+
+#include <string>
+
+SW_NAMESPACE_BEGIN
+
+namespace {
+
+std::string sourceBytes(sizex size) {
+  std::string result(size, '\0');
+  for (sizex i = 0; i < size; ++i) {
+    result[i] = char(i * 131 + 7);
+  }
+  return result;
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+/// The allocating API, with whatever kernel the CPU picks
+static void BM_Base64Encode(benchmark::State& state) {
+  const auto source = sourceBytes(sizex(state.range(0)));
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(base64Encode(source));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Base64Encode)->RangeMultiplier(16)->Range(16, 1 << 20);
+
+////////////////////////////////////////////////////////////////////////////////
+static void BM_Base64Decode(benchmark::State& state) {
+  const auto encoded = base64Encode(sourceBytes(sizex(state.range(0))));
+  std::string decoded;
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(base64Decode(encoded, decoded));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Base64Decode)->RangeMultiplier(16)->Range(16, 1 << 20);
+
+////////////////////////////////////////////////////////////////////////////////
+/// Each supported kernel, into a preallocated buffer. Arg 1 is the Base64Kernel
+static void BM_Base64EncodeKernel(benchmark::State& state) {
+  const auto kernel = Base64Kernel(state.range(1));
+  if (!base64KernelSupported(kernel)) {
+    state.SkipWithError("kernel not supported on this CPU");
+    return;
+  }
+  const auto source = sourceBytes(sizex(state.range(0)));
+  std::string dest(base64EncodedSize(source.size(), true), '\0');
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(::sw::detail::base64EncodeWith<::sw::detail::Base64Traits>(
+        kernel, reinterpret_cast<const byte*>(source.data()), source.size(), &dest[0], true));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Base64EncodeKernel)
+    ->ArgsProduct({{64, 4096, 1 << 20},
+                   {int(Base64Kernel::Scalar), int(Base64Kernel::Sse41), int(Base64Kernel::Avx2),
+                    int(Base64Kernel::Neon)}});
+
+SW_NAMESPACE_END
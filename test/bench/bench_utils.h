@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <sw/reallocator.h>
+#include <sw/types.h>
+
+#include <benchmark/benchmark.h>
+
+SW_NAMESPACE_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+/// Heap allocations made so far by the whole process. Counted by the replaced global
+/// operator new in bench_main.cpp.
+u64 allocationCount() noexcept;
+
+////////////////////////////////////////////////////////////////////////////////
+/// Add an allocation that didn't go through operator new to the count
+void countAllocation() noexcept;
+
+////////////////////////////////////////////////////////////////////////////////
+/// MallocReallocator that counts its mallocs and reallocs, so containers that grow with
+/// realloc show up in the "allocs" counter too
+template <typename T>
+class CountingMallocReallocator : public MallocReallocator<T> {
+public:
+  T* allocate(sizex count) {
+    countAllocation();
+    return MallocReallocator<T>::allocate(count);
+  }
+
+  T* reallocate(T* oldAddr, sizex existingCount, sizex oldCount, sizex newCount) {
+    countAllocation();
+    return MallocReallocator<T>::reallocate(oldAddr, existingCount, oldCount, newCount);
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Reports the allocations made during its lifetime as an "allocs" per iteration counter.
+/// Make one before the benchmark loop. With threaded benchmarks the count is process wide,
+/// so it includes every thread's allocations.
+class AllocationCounter {
+public:
+  explicit AllocationCounter(benchmark::State& state) noexcept : state_(state), start_(allocationCount()) {}
+  AllocationCounter(const AllocationCounter&) = delete;
+  AllocationCounter& operator=(const AllocationCounter&) = delete;
+
+  ~AllocationCounter() {
+    const double allocs = double(allocationCount() - start_);
+    state_.counters["allocs"] = benchmark::Counter(allocs, benchmark::Counter::kAvgIterations);
+  }
+
+private:
+  benchmark::State& state_;
+  u64 start_;
+};
+
+SW_NAMESPACE_END
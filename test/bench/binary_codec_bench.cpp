@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#include "bench_utils.h"
+
+#include <sw/binary_codec.h>
+#include <sw/paged_buffer.h>
+#include <sw/vector.h>
+
+#include <vector>
+
+SW_NAMESPACE_BEGIN
+
+namespace {
+
+constexpr ByteOrder kForeignByteOrder = kNativeByteOrder == ByteOrder::Little ? ByteOrder::Big : ByteOrder::Little;
+
+std::vector<u32> sourceWords(sizex count) {
+  std::vector<u32> result(count);
+  for (sizex i = 0; i < count; ++i) {
+    result[i] = u32(i * 2654435761u);
+  }
+  return result;
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+/// Non-native order u32 encode with each supported kernel. Arg 1 is the ByteSwapKernel
+static void BM_ByteSwapKernel(benchmark::State& state) {
+  const auto kernel = ByteSwapKernel(state.range(1));
+  if (!byteSwapKernelSupported(kernel)) {
+    state.SkipWithError("kernel not supported on this CPU");
+    return;
+  }
+  const auto source = sourceWords(sizex(state.range(0)));
+  std::vector<byte> dest(source.size() * sizeof(u32));
+  for (auto _ : state) {
+    swapBytesWith<u32>(kernel, source.data(), dest.data(), source.size());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) * i64(sizeof(u32)));
+}
+BENCHMARK(BM_ByteSwapKernel)
+    ->ArgsProduct({{64, 4096, 1 << 18},
+                   {int(ByteSwapKernel::Scalar), int(ByteSwapKernel::Ssse3), int(ByteSwapKernel::Avx2),
+                    int(ByteSwapKernel::Neon)}});
+
+////////////////////////////////////////////////////////////////////////////////
+/// The per-value loop that the bulk call replaces
+static void BM_ByteSwapPerValue(benchmark::State& state) {
+  const auto source = sourceWords(sizex(state.range(0)));
+  std::vector<byte> dest(source.size() * sizeof(u32));
+  for (auto _ : state) {
+    for (sizex i = 0; i < source.size(); ++i) {
+      utils::placeIntoBuffer(dest.data() + i * sizeof(u32), source[i], kForeignByteOrder);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) * i64(sizeof(u32)));
+}
+BENCHMARK(BM_ByteSwapPerValue)->Arg(64)->Arg(4096)->Arg(1 << 18);
+
+////////////////////////////////////////////////////////////////////////////////
+static void BM_VarintEncode(benchmark::State& state) {
+  const auto source = sourceWords(sizex(state.range(0)));
+  std::vector<byte> dest(source.size() * kMaxVarintSize);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(varintEncodeArray(source.data(), source.size(), dest.data()));
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_VarintEncode)->Arg(4096);
+
+////////////////////////////////////////////////////////////////////////////////
+static void BM_VarintDecode(benchmark::State& state) {
+  const auto source = sourceWords(sizex(state.range(0)));
+  std::vector<byte> encoded(source.size() * kMaxVarintSize);
+  const byte* end = varintEncodeArray(source.data(), source.size(), encoded.data());
+  std::vector<u32> decoded(source.size());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(varintDecodeArray(encoded.data(), end, decoded.data(), decoded.size()));
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_VarintDecode)->Arg(4096);
+
+////////////////////////////////////////////////////////////////////////////////
+/// Appending to each kind of sink, reusing its storage. Allocations should stay at zero
+static void BM_AppendArrayVector(benchmark::State& state) {
+  const auto source = sourceWords(sizex(state.range(0)));
+  auto sink = Vector<byte>{};
+  sink.reserve(source.size() * sizeof(u32));
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    sink.clear();
+    appendArray(sink, source.data(), source.size(), ByteOrder::Big);
+    benchmark::DoNotOptimize(sink.data());
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) * i64(sizeof(u32)));
+}
+BENCHMARK(BM_AppendArrayVector)->Arg(4096);
+
+static void BM_AppendArrayPaged(benchmark::State& state) {
+  const auto source = sourceWords(sizex(state.range(0)));
+  auto sink = PagedBuffer<4096>(0);
+  for (auto _ : state) {
+    sink.resize(0);
+    appendArray(sink, source.data(), source.size(), ByteOrder::Big);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) * i64(sizeof(u32)));
+}
+BENCHMARK(BM_AppendArrayPaged)->Arg(4096);
+
+SW_NAMESPACE_END
@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#include "bench_utils.h"
+
+#include <sw/logger.h>
+
+#include <memory>
+
+SW_NAMESPACE_BEGIN
+
+namespace {
+
+/// One async logger shared by every thread of a run, forwarding to a NullLogHandler so only the
+/// front end and the queue are measured
+std::shared_ptr<Logger> gLogger;
+
+void setupLogger(const benchmark::State& state) {
+  if (state.thread_index() == 0) {
+    AsyncLogHandler::Config config;
+    config.overflow = AsyncLogOverflow::DropAndCount;
+    gLogger = std::make_shared<Logger>(std::make_shared<AsyncLogHandler>(std::make_shared<NullLogHandler>(), config));
+  }
+}
+
+void teardownLogger(const benchmark::State& state) {
+  if (state.thread_index() == 0) {
+    gLogger.reset();
+  }
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+/// Formatting on the calling thread, then a copy of the message to the queue
+static void BM_AsyncLogFormatted(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  int value = 0;
+  for (auto _ : state) {
+    gLogger->infof("request {} took {}us", value++, 42);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AsyncLogFormatted)->ThreadRange(1, 8)->UseRealTime()->Setup(setupLogger)->Teardown(teardownLogger);
+
+////////////////////////////////////////////////////////////////////////////////
+/// Only the arguments are copied to the queue. The logging thread formats
+static void BM_AsyncLogDeferred(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  int value = 0;
+  for (auto _ : state) {
+    gLogger->logDeferred(LoggerCategory::Info, "request {} took {}us", value++, 42);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AsyncLogDeferred)->ThreadRange(1, 8)->UseRealTime()->Setup(setupLogger)->Teardown(teardownLogger);
+
+////////////////////////////////////////////////////////////////////////////////
+/// A disabled category should cost next to nothing
+static void BM_LogDisabled(benchmark::State& state) {
+  Logger logger(std::make_shared<NullLogHandler>());
+  logger.setCategoryMask(LoggerCategory::Error);
+  int value = 0;
+  for (auto _ : state) {
+    SW_LOG_DEBUG(logger, "request {} took {}us", value++, 42);
+  }
+}
+BENCHMARK(BM_LogDisabled);
+
+SW_NAMESPACE_END
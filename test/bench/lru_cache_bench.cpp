@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#include "bench_utils.h"
+
+#include <sw/lru_cache.h>
+#include <sw/sharded_lru_cache.h>
+
+#include <unordered_map>
+#include <vector>
+
+SW_NAMESPACE_BEGIN
+
+namespace {
+
+/// Keys spread over 2x the cache size, so about half the lookups miss
+std::vector<u64> lookupKeys(sizex cacheSize) {
+  std::vector<u64> keys(4096);
+  u64 state = 0x9e3779b97f4a7c15;
+  for (auto& key : keys) {
+    state ^= state << 13u;
+    state ^= state >> 7u;
+    state ^= state << 17u;
+    key = state % (cacheSize * 2);
+  }
+  return keys;
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+static void BM_LruCacheGet(benchmark::State& state) {
+  const auto size = sizex(state.range(0));
+  LruCache<u64, u64> cache(size);
+  for (u64 i = 0; i < size; ++i) {
+    cache.put(i, i);
+  }
+  const auto keys = lookupKeys(size);
+  AllocationCounter allocs(state);
+  sizex index = 0;
+  for (auto _ : state) {
+    u64 value = 0;
+    benchmark::DoNotOptimize(cache.get(keys[index++ & 4095], value));
+    benchmark::DoNotOptimize(value);
+  }
+}
+BENCHMARK(BM_LruCacheGet)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+
+////////////////////////////////////////////////////////////////////////////////
+static void BM_UnorderedMapFind(benchmark::State& state) {
+  const auto size = sizex(state.range(0));
+  std::unordered_map<u64, u64> map;
+  for (u64 i = 0; i < size; ++i) {
+    map.emplace(i, i);
+  }
+  const auto keys = lookupKeys(size);
+  AllocationCounter allocs(state);
+  sizex index = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(map.find(keys[index++ & 4095]));
+  }
+}
+BENCHMARK(BM_UnorderedMapFind)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+
+////////////////////////////////////////////////////////////////////////////////
+/// Every put past the size evicts
+static void BM_LruCachePutEvict(benchmark::State& state) {
+  const auto size = sizex(state.range(0));
+  LruCache<u64, u64> cache(size);
+  AllocationCounter allocs(state);
+  u64 key = 0;
+  for (auto _ : state) {
+    cache.put(key, key);
+    ++key;
+  }
+}
+BENCHMARK(BM_LruCachePutEvict)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+
+////////////////////////////////////////////////////////////////////////////////
+static void BM_ShardedLruCacheGet(benchmark::State& state) {
+  static ShardedLruCache<u64, u64> cache(1 << 16);
+  if (state.thread_index() == 0) {
+    for (u64 i = 0; i < (1 << 16); ++i) {
+      cache.put(i, i);
+    }
+  }
+  const auto keys = lookupKeys(1 << 16);
+  AllocationCounter allocs(state);
+  sizex index = sizex(state.thread_index()) * 512;
+  for (auto _ : state) {
+    u64 value = 0;
+    benchmark::DoNotOptimize(cache.get(keys[index++ & 4095], value));
+    benchmark::DoNotOptimize(value);
+  }
+}
+BENCHMARK(BM_ShardedLruCacheGet)->ThreadRange(1, 8)->UseRealTime();
+
+SW_NAMESPACE_END
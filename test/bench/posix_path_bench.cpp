@@ -0,0 +1,120 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#include "bench_utils.h"
+
+#include <sw/posix_path.h>
+
+#include <string>
+#include <vector>
+
+#if __has_include(<filesystem>)
+#  include <filesystem>
+#  define SW_BENCH_STD_FILESYSTEM 1
+#endif
+
+SW_NAMESPACE_BEGIN
+
+namespace {
+
+/// Paths with a given number of segments, some of them needing normalization
+std::vector<std::string> samplePaths(sizex segments) {
+  std::vector<std::string> result;
+  for (int i = 0; i < 64; ++i) {
+    std::string path = "/usr";
+    for (sizex s = 0; s < segments; ++s) {
+      path += (s % 5 == 3) ? "/.." : (s % 7 == 2) ? "/./dir" : "/segment" + std::to_string(s + i);
+    }
+    path += "/file" + std::to_string(i) + ".txt";
+    result.push_back(std::move(path));
+  }
+  return result;
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename Path>
+static void BM_PathNormalize(benchmark::State& state) {
+  const auto paths = samplePaths(sizex(state.range(0)));
+  AllocationCounter allocs(state);
+  sizex index = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Path(paths[index++ & 63]).lexically_normal());
+  }
+}
+BENCHMARK_TEMPLATE(BM_PathNormalize, PosixPath)->RangeMultiplier(4)->Range(2, 32);
+#if SW_BENCH_STD_FILESYSTEM
+BENCHMARK_TEMPLATE(BM_PathNormalize, std::filesystem::path)->RangeMultiplier(4)->Range(2, 32);
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// The component queries, on an already built path
+template <typename Path>
+static void BM_PathDecompose(benchmark::State& state) {
+  const auto paths = samplePaths(sizex(state.range(0)));
+  std::vector<Path> built(paths.begin(), paths.end());
+  AllocationCounter allocs(state);
+  sizex index = 0;
+  for (auto _ : state) {
+    const auto& path = built[index++ & 63];
+    benchmark::DoNotOptimize(path.filename());
+    benchmark::DoNotOptimize(path.extension());
+    benchmark::DoNotOptimize(path.parent_path());
+  }
+}
+BENCHMARK_TEMPLATE(BM_PathDecompose, PosixPath)->RangeMultiplier(4)->Range(2, 32);
+#if SW_BENCH_STD_FILESYSTEM
+BENCHMARK_TEMPLATE(BM_PathDecompose, std::filesystem::path)->RangeMultiplier(4)->Range(2, 32);
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// The non-allocating views PosixPath has on top of the std::filesystem API
+static void BM_PosixPathDecomposeViews(benchmark::State& state) {
+  const auto paths = samplePaths(sizex(state.range(0)));
+  std::vector<PosixPath> built(paths.begin(), paths.end());
+  AllocationCounter allocs(state);
+  sizex index = 0;
+  for (auto _ : state) {
+    const auto& path = built[index++ & 63];
+    benchmark::DoNotOptimize(path.filename_view());
+    benchmark::DoNotOptimize(path.extension_view());
+    benchmark::DoNotOptimize(path.parent_path_view());
+  }
+}
+BENCHMARK(BM_PosixPathDecomposeViews)->RangeMultiplier(4)->Range(2, 32);
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename Path>
+static void BM_PathAppend(benchmark::State& state) {
+  const auto count = int(state.range(0));
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    Path path("/root");
+    for (int i = 0; i < count; ++i) {
+      path /= "segment";
+    }
+    benchmark::DoNotOptimize(path);
+  }
+}
+BENCHMARK_TEMPLATE(BM_PathAppend, PosixPath)->RangeMultiplier(4)->Range(2, 32);
+#if SW_BENCH_STD_FILESYSTEM
+BENCHMARK_TEMPLATE(BM_PathAppend, std::filesystem::path)->RangeMultiplier(4)->Range(2, 32);
+#endif
+
+SW_NAMESPACE_END
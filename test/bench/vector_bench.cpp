@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#include "bench_utils.h"
+
+#include <sw/vector.h>
+
+#include <numeric>
+#include <vector>
+
+SW_NAMESPACE_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+/// Vector<int> grows with realloc, which the operator new hook doesn't see, so it's measured with
+/// the counting reallocator to compare allocations with std::vector
+template <typename VectorType>
+static void BM_PushBack(benchmark::State& state) {
+  const auto count = int(state.range(0));
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    VectorType vec;
+    for (int i = 0; i < count; ++i) {
+      vec.push_back(i);
+    }
+    benchmark::DoNotOptimize(vec.data());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK_TEMPLATE(BM_PushBack, Vector<int, CountingMallocReallocator<int>>)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_PushBack, std::vector<int>)->RangeMultiplier(16)->Range(16, 1 << 20);
+
+////////////////////////////////////////////////////////////////////////////////
+/// std::string isn't trivially relocatable, so Vector<std::string> already allocates through
+/// std::allocator and both sides are counted by the operator new hook
+template <typename VectorType>
+static void BM_PushBackStrings(benchmark::State& state) {
+  const auto count = int(state.range(0));
+  const std::string value(32, 'x');
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    VectorType vec;
+    for (int i = 0; i < count; ++i) {
+      vec.push_back(value);
+    }
+    benchmark::DoNotOptimize(vec.data());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK_TEMPLATE(BM_PushBackStrings, Vector<std::string>)->RangeMultiplier(16)->Range(16, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PushBackStrings, std::vector<std::string>)->RangeMultiplier(16)->Range(16, 1 << 16);
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename VectorType>
+static void BM_Iterate(benchmark::State& state) {
+  const auto count = int(state.range(0));
+  VectorType vec;
+  for (int i = 0; i < count; ++i) {
+    vec.push_back(i);
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(std::accumulate(vec.begin(), vec.end(), 0ll));
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK_TEMPLATE(BM_Iterate, Vector<int>)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_Iterate, std::vector<int>)->RangeMultiplier(16)->Range(16, 1 << 20);
+
+SW_NAMESPACE_END
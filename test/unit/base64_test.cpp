@@ -17,11 +17,16 @@
 /// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 ////////////////////////////////////////////////////////////////////////////////
 #include <sw/base64.h>
+#include <sw/paged_buffer.h>
 #include <sw/uuid.h>
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <random>
+#include <vector>
 
 SW_NAMESPACE_BEGIN
 
@@ -45,6 +50,216 @@ TEST(Base64Test, basic) {
   ASSERT_EQ(base64UrlEncode("<>?"), "PD4_");
 }
 
+TEST(Base64Test, decode) {
+  std::string result;
+  ASSERT_TRUE(base64Decode("RW5jb2RlIHRvIEJhc2U2NCBmb3JtYXQ=", result));
+  ASSERT_EQ(result, "Encode to Base64 format");
+  ASSERT_TRUE(base64Decode("RWFzeSB0bw==", result));
+  ASSERT_EQ(result, "Easy to");
+  ASSERT_TRUE(base64Decode("RWFzeSB0bw", result));
+  ASSERT_EQ(result, "Easy to");
+  ASSERT_TRUE(base64Decode("PD4/", result));
+  ASSERT_EQ(result, "<>?");
+  ASSERT_TRUE(base64UrlDecode("PD4_", result));
+  ASSERT_EQ(result, "<>?");
+  ASSERT_TRUE(base64Decode("", result));
+  ASSERT_TRUE(result.empty());
+
+  // Strict validation
+  ASSERT_FALSE(base64Decode("PD4_", result));
+  ASSERT_TRUE(result.empty());
+  ASSERT_FALSE(base64UrlDecode("PD4/", result));
+  ASSERT_FALSE(base64Decode("RWFzeSB0bw=", result));     // Padding doesn't complete the group
+  ASSERT_FALSE(base64Decode("RWFzeSB0b===", result));    // Too much padding
+  ASSERT_FALSE(base64Decode("RW=zeSB0bw==", result));    // Padding in the middle
+  ASSERT_FALSE(base64Decode("RWFze", result));           // Dangling 6-bits
+  ASSERT_FALSE(base64Decode("RWFzeSB0bx==", result));    // Non-zero trailing bits
+  ASSERT_FALSE(base64Decode("RWFzeSB0b3l=", result));    // Non-zero trailing bits
+  ASSERT_FALSE(base64Decode("RWFz eSB0bw==", result));   // Whitespace
+  ASSERT_FALSE(base64Decode("====", result));
+}
+
+namespace {
+
+std::vector<Base64Kernel> supportedKernels() {
+  std::vector<Base64Kernel> kernels;
+  for (auto kernel : {Base64Kernel::Scalar, Base64Kernel::Sse41, Base64Kernel::Avx2, Base64Kernel::Neon}) {
+    if (base64KernelSupported(kernel)) {
+      kernels.push_back(kernel);
+    }
+  }
+  return kernels;
+}
+
+template <typename Traits>
+void testKernels(bool pad) {
+  std::mt19937 engine(42);
+  std::uniform_int_distribution<u32> dist(0, 255);
+  for (sizex size = 0; size < 300; ++size) {
+    std::string data(size, '\0');
+    for (auto& c : data) {
+      c = char(dist(engine));
+    }
+    const auto* bytes = utils::saferAlias<const byte*>(data.data());
+    const auto expected = base64Encoder<Traits>(bytes, size, pad, Base64Kernel::Scalar);
+
+    for (auto kernel : supportedKernels()) {
+      ASSERT_EQ(base64Encoder<Traits>(bytes, size, pad, kernel), expected) << "size=" << size;
+      std::string decoded;
+      ASSERT_TRUE(base64Decoder<Traits>(expected.data(), expected.size(), decoded, kernel)) << "size=" << size;
+      ASSERT_EQ(decoded, data);
+
+      // Every bad char position must be caught, whichever kernel's block it lands in
+      if (!expected.empty()) {
+        auto corrupt = expected;
+        for (char bad : {'*', '=', '\n', char(0x80), char(0xff), '.'}) {
+          const sizex pos = dist(engine) % corrupt.size();
+          const char saved = corrupt[pos];
+          if (saved == bad || (bad == '=' && pos + 4 >= corrupt.size())) {
+            continue;  // Not a corruption, or possibly valid padding
+          }
+          corrupt[pos] = bad;
+          ASSERT_FALSE(base64Decoder<Traits>(corrupt.data(), corrupt.size(), decoded, kernel))
+              << "size=" << size << " pos=" << pos;
+          corrupt[pos] = saved;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+
+TEST(Base64Test, kernels) {
+  testKernels<::sw::detail::Base64Traits>(true);
+  testKernels<::sw::detail::Base64Traits>(false);
+  testKernels<::sw::detail::Base64UrlTraits>(true);
+  testKernels<::sw::detail::Base64UrlTraits>(false);
+
+  // Only the other alphabet's specials should differ between the two
+  for (auto kernel : supportedKernels()) {
+    std::string decoded;
+    const std::string standard(64, '/');
+    const std::string url(64, '_');
+    ASSERT_TRUE(base64Decoder<::sw::detail::Base64Traits>(standard.data(), standard.size(), decoded, kernel));
+    ASSERT_FALSE(base64Decoder<::sw::detail::Base64Traits>(url.data(), url.size(), decoded, kernel));
+    ASSERT_TRUE(base64Decoder<::sw::detail::Base64UrlTraits>(url.data(), url.size(), decoded, kernel));
+    ASSERT_FALSE(base64Decoder<::sw::detail::Base64UrlTraits>(standard.data(), standard.size(), decoded, kernel));
+  }
+}
+
+TEST(Base64Test, into) {
+  const std::string text = "Encode to Base64 format";
+  char encoded[64];
+  ASSERT_EQ(32u, base64EncodedSize(text.size(), true));
+  ASSERT_EQ(kBase64Invalid, base64EncodeInto(text, encoded, 31));
+  ASSERT_EQ(32u, base64EncodeInto(text, encoded, 32));
+  ASSERT_EQ(std::string(encoded, 32), "RW5jb2RlIHRvIEJhc2U2NCBmb3JtYXQ=");
+  ASSERT_EQ(31u, base64UrlEncodeInto(text, encoded, 31));
+
+  // Decoding needs exactly the decoded size, not the unpadded bound
+  byte decoded[64];
+  ASSERT_EQ(text.size(), base64DecodedSize("RW5jb2RlIHRvIEJhc2U2NCBmb3JtYXQ=", 32));
+  ASSERT_EQ(kBase64Invalid, base64DecodeInto("RW5jb2RlIHRvIEJhc2U2NCBmb3JtYXQ=", 32, decoded, text.size() - 1));
+  ASSERT_EQ(text.size(), base64DecodeInto("RW5jb2RlIHRvIEJhc2U2NCBmb3JtYXQ=", 32, decoded, text.size()));
+  ASSERT_EQ(0, std::memcmp(decoded, text.data(), text.size()));
+  ASSERT_EQ(text.size(), base64UrlDecodeInto(encoded, 31, decoded, text.size()));
+  ASSERT_EQ(kBase64Invalid, base64DecodeInto("RW5j*2Rl", 8, decoded, sizeof(decoded)));
+
+  // Large input to an exactly sized buffer, so the vector kernels run right up to the end
+  std::string big(1000, '\0');
+  for (sizex i = 0; i < big.size(); ++i) {
+    big[i] = char(i * 7);
+  }
+  const auto bigEncoded = base64Encode(big);
+  std::vector<byte> bigDecoded(big.size());
+  ASSERT_EQ(big.size(), base64DecodeInto(bigEncoded, bigDecoded.data(), bigDecoded.size()));
+  ASSERT_EQ(0, std::memcmp(bigDecoded.data(), big.data(), big.size()));
+}
+
+TEST(Base64Test, streaming) {
+  std::mt19937 engine(7);
+  std::string data(5000, '\0');
+  for (auto& c : data) {
+    c = char(engine());
+  }
+  const auto* bytes = utils::saferAlias<const byte*>(data.data());
+
+  for (bool pad : {true, false}) {
+    for (sizex size : {0_z, 1_z, 2_z, 3_z, 100_z, 5000_z}) {
+      const auto expected = base64Encode(bytes, size, pad);
+
+      // Random chunking must give the same output as the one-shot calls
+      Base64StreamEncoder<> encoder(pad);
+      std::string encoded;
+      for (sizex pos = 0; pos < size;) {
+        const sizex chunk = std::min<sizex>(engine() % 70, size - pos);
+        encoder.update(bytes + pos, chunk, encoded);
+        pos += chunk;
+      }
+      encoder.finish(encoded);
+      ASSERT_EQ(encoded, expected);
+
+      Base64StreamDecoder<> decoder;
+      std::string decoded;
+      for (sizex pos = 0; pos < encoded.size();) {
+        const sizex chunk = std::min<sizex>(engine() % 70, encoded.size() - pos);
+        ASSERT_TRUE(decoder.update(encoded.data() + pos, chunk, decoded));
+        pos += chunk;
+      }
+      ASSERT_TRUE(decoder.finish(decoded));
+      ASSERT_EQ(decoded, data.substr(0, size));
+    }
+  }
+
+  // Padding ends the stream, errors stick until reset
+  Base64StreamDecoder<> decoder;
+  std::string decoded;
+  ASSERT_TRUE(decoder.update("RWFzeSB0bw=", 11, decoded));
+  ASSERT_TRUE(decoder.update("=", 1, decoded));
+  ASSERT_FALSE(decoder.update("RWFz", 4, decoded));
+  ASSERT_TRUE(decoder.failed());
+  ASSERT_FALSE(decoder.finish(decoded));
+  ASSERT_FALSE(decoder.failed());
+  ASSERT_EQ(decoded, "Easy to");
+
+  decoded.clear();
+  ASSERT_TRUE(decoder.update("RWFze", 5, decoded));
+  ASSERT_FALSE(decoder.finish(decoded));
+  ASSERT_TRUE(decoder.update("RW*z", 3, decoded));
+  ASSERT_FALSE(decoder.update("z", 1, decoded));
+}
+
+TEST(Base64Test, pagedBufferPipeline) {
+  auto buffer = PagedBuffer<64>(0);
+  std::string data(1000, '\0');
+  for (sizex i = 0; i < data.size(); ++i) {
+    data[i] = char(i * 13);
+  }
+  buffer.append(utils::saferAlias<const byte*>(data.data()), data.size());
+
+  // Encode page by page, then decode the text back in odd sized pieces
+  Base64UrlStreamEncoder encoder;
+  std::string encoded;
+  for (const auto& segment : buffer.ioSegments(0, buffer.size())) {
+    encoder.update(static_cast<const byte*>(segment.data), segment.size, encoded);
+  }
+  encoder.finish(encoded);
+  ASSERT_EQ(encoded, base64UrlEncode(data));
+
+  Base64UrlStreamDecoder decoder;
+  std::vector<byte> decoded(data.size());
+  sizex decodedSize = 0;
+  for (sizex pos = 0; pos < encoded.size(); pos += 97) {
+    const sizex chunk = std::min<sizex>(97, encoded.size() - pos);
+    ASSERT_LE(decoder.maxUpdateSize(chunk), decoded.size() - decodedSize);
+    decodedSize += decoder.update(encoded.data() + pos, chunk, decoded.data() + decodedSize);
+  }
+  decodedSize += decoder.finish(decoded.data() + decodedSize);
+  ASSERT_EQ(data.size(), decodedSize);
+  ASSERT_EQ(0, std::memcmp(decoded.data(), data.data(), data.size()));
+}
+
 TEST(Base64Test, uuid) {
 #if 0
   for (sizex i = 0; i < 10; ++i) {
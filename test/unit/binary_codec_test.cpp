@@ -0,0 +1,293 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#include <sw/binary_codec.h>
+#include <sw/buffers.h>
+#include <sw/paged_buffer.h>
+#include <sw/vector.h>
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+SW_NAMESPACE_BEGIN
+
+namespace {
+
+const i32 kMinI32 = std::numeric_limits<i32>::min();
+
+std::vector<ByteSwapKernel> supportedKernels() {
+  std::vector<ByteSwapKernel> kernels;
+  for (auto kernel : {ByteSwapKernel::Scalar, ByteSwapKernel::Ssse3, ByteSwapKernel::Avx2, ByteSwapKernel::Neon}) {
+    if (byteSwapKernelSupported(kernel)) {
+      kernels.push_back(kernel);
+    }
+  }
+  return kernels;
+}
+
+template <typename T>
+void testSwapKernels() {
+  std::mt19937_64 gen(sizeof(T));
+  // Sizes on both sides of each kernel's block size, so every tail path runs
+  for (sizex count : {0, 1, 3, 7, 8, 15, 16, 31, 33, 64, 129, 1000}) {
+    std::vector<T> source(count);
+    for (auto& value : source) {
+      value = T(gen());
+    }
+    std::vector<T> expected(count);
+    for (sizex i = 0; i < count; ++i) {
+      expected[i] = T(byteSwap(codec_detail::CodecBitsType<T>(source[i])));
+    }
+    for (auto kernel : supportedKernels()) {
+      // Unaligned destination, and in place
+      std::vector<byte> dest(count * sizeof(T) + 1);
+      swapBytesWith<T>(kernel, source.data(), dest.data() + 1, count);
+      ASSERT_TRUE(count == 0 || std::memcmp(dest.data() + 1, expected.data(), count * sizeof(T)) == 0);
+      auto inPlace = source;
+      swapBytesWith<T>(kernel, inPlace.data(), inPlace.data(), count);
+      ASSERT_EQ(expected, inPlace);
+    }
+  }
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(BinaryCodecTest, byteSwap) {
+  ASSERT_EQ(0x12u, byteSwap(u8(0x12)));
+  ASSERT_EQ(0x3412u, byteSwap(u16(0x1234)));
+  ASSERT_EQ(0x78563412u, byteSwap(u32(0x12345678)));
+  ASSERT_EQ(0xefcdab9078563412u, byteSwap(u64(0x1234567890abcdef)));
+
+  testSwapKernels<u16>();
+  testSwapKernels<u32>();
+  testSwapKernels<u64>();
+  testSwapKernels<i32>();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(BinaryCodecTest, ordered) {
+  byte buffer[8];
+  utils::placeIntoBuffer(buffer, u32(0x01020304), ByteOrder::Big);
+  ASSERT_EQ(0x01, buffer[0]);
+  ASSERT_EQ(0x04, buffer[3]);
+  ASSERT_EQ(0x01020304u, utils::extractFromBuffer<u32>(buffer, ByteOrder::Big));
+  utils::placeIntoBuffer(buffer, u32(0x01020304), ByteOrder::Little);
+  ASSERT_EQ(0x04, buffer[0]);
+  ASSERT_EQ(0x01, buffer[3]);
+  ASSERT_EQ(0x01020304u, utils::extractFromBuffer<u32>(buffer, ByteOrder::Little));
+
+  utils::placeIntoBuffer(buffer, 1.5, ByteOrder::Big);
+  ASSERT_EQ(0x3f, buffer[0]);
+  ASSERT_EQ(0xf8, buffer[1]);
+  ASSERT_EQ(1.5, utils::extractFromBuffer<double>(buffer, ByteOrder::Big));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(BinaryCodecTest, arrays) {
+  std::vector<u16> shorts(37);
+  std::vector<float> floats(37);
+  for (sizex i = 0; i < shorts.size(); ++i) {
+    shorts[i] = u16(i * 0x0101 + 1);
+    floats[i] = float(i) * 0.25f;
+  }
+
+  for (auto order : {ByteOrder::Little, ByteOrder::Big}) {
+    std::vector<byte> buffer(shorts.size() * sizeof(u16) + floats.size() * sizeof(float));
+    byte* end = utils::placeArrayIntoBuffer(buffer.data(), shorts.data(), shorts.size(), order);
+    end = utils::placeArrayIntoBuffer(end, floats.data(), floats.size(), order);
+    ASSERT_EQ(buffer.data() + buffer.size(), end);
+    ASSERT_EQ(shorts[5], utils::extractFromBuffer<u16>(buffer.data() + 5 * sizeof(u16), order));
+    ASSERT_EQ(order == ByteOrder::Big ? 0x05 : 0x06, buffer[5 * sizeof(u16)]);
+
+    std::vector<u16> shortsOut(shorts.size());
+    std::vector<float> floatsOut(floats.size());
+    const byte* pos = utils::extractArrayFromBuffer(buffer.data(), shortsOut.data(), shortsOut.size(), order);
+    pos = utils::extractArrayFromBuffer(pos, floatsOut.data(), floatsOut.size(), order);
+    ASSERT_EQ(buffer.data() + buffer.size(), pos);
+    ASSERT_EQ(shorts, shortsOut);
+    ASSERT_EQ(floats, floatsOut);
+  }
+
+  // Fixed buffers go through the pointer calls
+  auto unique = makeUniqueBuffer(4 * sizeof(u32));
+  const u32 words[] = {1, 2, 3, 4};
+  utils::placeArrayIntoBuffer(unique.data(), words, 4, ByteOrder::Big);
+  ASSERT_EQ(0x04, unique.data()[15]);
+  ASSERT_EQ(3u, utils::extractFromBuffer<u32>(unique.data() + 8, ByteOrder::Big));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(BinaryCodecTest, varint) {
+  byte buffer[kMaxVarintSize];
+  ASSERT_EQ(buffer + 1, varintEncode(0, buffer));
+  ASSERT_EQ(0x00, buffer[0]);
+  ASSERT_EQ(buffer + 2, varintEncode(300, buffer));
+  ASSERT_EQ(0xac, buffer[0]);
+  ASSERT_EQ(0x02, buffer[1]);
+  ASSERT_EQ(buffer + kMaxVarintSize, varintEncode(~u64(0), buffer));
+
+  for (u64 value : {u64(0), u64(1), u64(127), u64(128), u64(16383), u64(16384), u64(1) << 63u, ~u64(0)}) {
+    byte* end = varintEncode(value, buffer);
+    ASSERT_EQ(varintSize(value), sizex(end - buffer));
+    u64 decoded = 0;
+    ASSERT_EQ(end, varintDecode(buffer, end, decoded));
+    ASSERT_EQ(value, decoded);
+    // Truncated
+    ASSERT_EQ(nullptr, varintDecode(buffer, end - 1, decoded));
+  }
+
+  // Overlong
+  byte overlong[kMaxVarintSize + 1];
+  std::memset(overlong, 0x80, sizeof(overlong));
+  u64 decoded;
+  ASSERT_EQ(nullptr, varintDecode(overlong, overlong + sizeof(overlong), decoded));
+
+  // Ten bytes, but more than 64 bits
+  byte tooBig[kMaxVarintSize];
+  std::memset(tooBig, 0xff, sizeof(tooBig));
+  tooBig[kMaxVarintSize - 1] = 0x7f;
+  ASSERT_EQ(nullptr, varintDecode(tooBig, tooBig + sizeof(tooBig), decoded));
+  tooBig[kMaxVarintSize - 1] = 0x01;
+  ASSERT_EQ(tooBig + kMaxVarintSize, varintDecode(tooBig, tooBig + sizeof(tooBig), decoded));
+  ASSERT_EQ(~u64(0), decoded);
+
+  // Values that don't fit the destination type are rejected rather than truncated
+  const u32 wide[] = {255, 300};
+  byte* end = varintEncodeArray(wide, 2, buffer);
+  u8 narrow[2];
+  ASSERT_EQ(buffer + 2, varintDecodeArray(buffer, end, narrow, 1));
+  ASSERT_EQ(255, narrow[0]);
+  ASSERT_EQ(nullptr, varintDecodeArray(buffer, end, narrow, 2));
+
+  const i32 signedWide[] = {-128, 127, -129};
+  end = varintEncodeArray(signedWide, 3, buffer);
+  i8 signedNarrow[3];
+  ASSERT_EQ(nullptr, varintDecodeArray(buffer, end, signedNarrow, 3));
+  ASSERT_NE(nullptr, varintDecodeArray(buffer, end, signedNarrow, 2));
+  ASSERT_EQ(-128, signedNarrow[0]);
+  ASSERT_EQ(127, signedNarrow[1]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(BinaryCodecTest, zigzag) {
+  ASSERT_EQ(0u, zigzagEncode(0));
+  ASSERT_EQ(1u, zigzagEncode(-1));
+  ASSERT_EQ(2u, zigzagEncode(1));
+  ASSERT_EQ(3u, zigzagEncode(-2));
+  ASSERT_EQ(~u64(0), zigzagEncode(std::numeric_limits<i64>::min()));
+  ASSERT_EQ(~u64(0) - 1, zigzagEncode(std::numeric_limits<i64>::max()));
+  for (i64 value : {i64(0), i64(-1), i64(1), i64(-64), i64(64), std::numeric_limits<i64>::min(),
+                    std::numeric_limits<i64>::max()}) {
+    ASSERT_EQ(value, zigzagDecode(zigzagEncode(value)));
+  }
+
+  // Signed arrays are zigzagged, so small negatives stay one byte
+  const i32 values[] = {-1, 1, -64, 63, -65, std::numeric_limits<i32>::min()};
+  byte buffer[6 * kMaxVarintSize];
+  byte* end = varintEncodeArray(values, 6, buffer);
+  ASSERT_EQ(buffer[0], 0x01);
+  ASSERT_EQ(buffer[1], 0x02);
+  ASSERT_EQ(sizex(1 + 1 + 1 + 1 + 2 + 5), sizex(end - buffer));
+  i32 decoded[6];
+  ASSERT_EQ(end, varintDecodeArray(buffer, end, decoded, 6));
+  ASSERT_TRUE(std::equal(values, values + 6, decoded));
+  ASSERT_EQ(nullptr, varintDecodeArray(buffer, end - 1, decoded, 6));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(BinaryCodecTest, sinks) {
+  std::vector<u64> values(300);
+  for (sizex i = 0; i < values.size(); ++i) {
+    values[i] = u64(i) << (i % 64);
+  }
+
+  // The same stream through each kind of sink
+  std::vector<byte> expected(values.size() * (sizeof(u64) + kMaxVarintSize) + sizeof(u16));
+  byte* end = utils::placeArrayIntoBuffer(expected.data(), values.data(), values.size(), ByteOrder::Big);
+  end = varintEncodeArray(values.data(), values.size(), end);
+  utils::placeIntoBuffer(end, u16(0xbeef), ByteOrder::Little);
+  expected.resize(sizex(end - expected.data()) + sizeof(u16));
+
+  auto vector = Vector<byte>{};
+  appendArray(vector, values.data(), values.size(), ByteOrder::Big);
+  appendVarints(vector, values.data(), values.size());
+  appendValue(vector, u16(0xbeef), ByteOrder::Little);
+  ASSERT_EQ(expected.size(), vector.size());
+  ASSERT_EQ(0, std::memcmp(expected.data(), vector.data(), expected.size()));
+
+  std::string str = "x";
+  appendArray(str, values.data(), values.size(), ByteOrder::Big);
+  appendVarints(str, values.data(), values.size());
+  appendValue(str, u16(0xbeef), ByteOrder::Little);
+  appendVarints(str, values.data(), 0);
+  ASSERT_EQ(expected.size() + 1, str.size());
+  ASSERT_EQ(0, std::memcmp(expected.data(), str.data() + 1, expected.size()));
+
+  // Small pages, so chunks straddle page boundaries
+  auto paged = PagedBuffer<64>(0);
+  appendArray(paged, values.data(), values.size(), ByteOrder::Big);
+  appendVarints(paged, values.data(), values.size());
+  appendValue(paged, u16(0xbeef), ByteOrder::Little);
+  ASSERT_EQ(expected.size(), paged.size());
+  std::vector<byte> copied(paged.size());
+  paged.copyFrom(0, copied.data(), copied.size());
+  ASSERT_EQ(expected, copied);
+
+  std::vector<u64> decoded(values.size());
+  const byte* pos = utils::extractArrayFromBuffer(copied.data(), decoded.data(), decoded.size(), ByteOrder::Big);
+  ASSERT_EQ(values, decoded);
+  pos = varintDecodeArray(pos, copied.data() + copied.size(), decoded.data(), decoded.size());
+  ASSERT_NE(nullptr, pos);
+  ASSERT_EQ(values, decoded);
+  ASSERT_EQ(0xbeefu, utils::extractFromBuffer<u16>(pos, ByteOrder::Little));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(BinaryCodecTest, sinkSizing) {
+  ASSERT_EQ(2u, maxVarintSize<u8>());
+  ASSERT_EQ(5u, maxVarintSize<u32>());
+  ASSERT_EQ(5u, maxVarintSize<i32>());
+  ASSERT_EQ(kMaxVarintSize, maxVarintSize<u64>());
+  byte buffer[kMaxVarintSize];
+  ASSERT_EQ(maxVarintSize<i32>(), varintEncodeArray(&kMinI32, 1, buffer) - buffer);
+
+  // A run of small ints grows the sink by just the encoded bytes, not the worst case
+  const std::vector<u32> small(10000, 5);
+  ASSERT_EQ(small.size(), varintEncodedSize(small.data(), small.size()));
+  std::vector<byte> vec;
+  appendVarints(vec, small.data(), small.size());
+  ASSERT_EQ(small.size(), vec.size());
+  ASSERT_LT(vec.capacity(), 2 * small.size());
+
+  std::string str;
+  appendVarints(str, small.data(), small.size());
+  ASSERT_EQ(small.size(), str.size());
+  ASSERT_LT(str.capacity(), 2 * small.size());
+
+  const std::vector<i32> mixed = {0, -1, 300, -300, kMinI32};
+  appendVarints(vec, mixed.data(), mixed.size());
+  ASSERT_EQ(small.size() + varintEncodedSize(mixed.data(), mixed.size()), vec.size());
+  ASSERT_EQ(1u + 1 + 2 + 2 + 5, varintEncodedSize(mixed.data(), mixed.size()));
+}
+
+SW_NAMESPACE_END
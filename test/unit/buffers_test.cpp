@@ -21,6 +21,10 @@
 #include <gtest/gtest.h>
 
 #include <array>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
 
 SW_NAMESPACE_BEGIN
 
@@ -63,4 +67,88 @@ TEST(BuffersTest, testBufferWrapperBasics) {
   }
 }
 
+TEST(BuffersTest, arenaUniqueBuffer) {
+  Arena arena;
+  auto buffer = makeUniqueBuffer(100, ArenaReallocator<byte>(arena));
+  ASSERT_EQ(&arena, &buffer.reallocator().arena());
+  buffer[99] = 1;
+
+  auto moved = std::move(buffer);
+  ASSERT_EQ(100u, moved.size());
+  ASSERT_EQ(&arena, &moved.reallocator().arena());
+
+  // Freeing the last allocation hands the space back
+  const auto data = moved.data();
+  moved.reset();
+  ASSERT_EQ(data, makeUniqueBuffer(10, ArenaReallocator<byte>(arena)).data());
+}
+
+#if SW_POSIX
+////////////////////////////////////////////////////////////////////////////////
+static std::string readFile(const std::string& path) {
+  std::ifstream fin(path);
+  std::stringstream contents;
+  contents << fin.rdbuf();
+  return contents.str();
+}
+
+TEST(BuffersTest, mappedFiles) {
+  const std::string path = "sw-buffers-test-mapped.bin";
+  {
+    std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+    fout << "hello mapped world";
+  }
+
+  // Read only
+  {
+    auto buffer = mapFile(path, FileMapMode::ReadOnly, FileMapAdvice::Sequential | FileMapAdvice::WillNeed);
+    ASSERT_EQ(18u, buffer.size());
+    ConstBufferView view(buffer);
+    ASSERT_EQ('m', view[6]);
+    ASSERT_EQ("hello mapped world", std::string(reinterpret_cast<const char*>(view.data()), view.size()));
+  }
+
+  // Copy on write leaves the file alone
+  {
+    auto buffer = mapFile(path, FileMapMode::CopyOnWrite);
+    buffer[0] = 'j';
+    ASSERT_EQ('j', buffer[0]);
+    ASSERT_EQ("hello mapped world", readFile(path));
+  }
+
+  // Read/write changes the file
+  {
+    auto buffer = mapFile(path, FileMapMode::ReadWrite, FileMapAdvice::HugePages);
+    BufferView view(buffer);
+    view[0] = 'j';
+  }
+  ASSERT_EQ("jello mapped world", readFile(path));
+
+  // Empty files give empty buffers
+  { std::ofstream fout(path, std::ios::binary | std::ios::trunc); }
+  ASSERT_TRUE(mapFile(path).empty());
+  std::remove(path.c_str());
+
+  ASSERT_THROW(mapFile(path), std::system_error);
+}
+
+TEST(BuffersTest, mmapReallocator) {
+  MmapReallocator<u32> reallocator;
+  auto values = reallocator.allocate(1000);
+  ASSERT_EQ(0u, values[999]);
+  for (u32 i = 0; i < 1000; ++i) {
+    values[i] = i;
+  }
+  values = reallocator.reallocate(values, 1000, 1000, 1000000);
+  ASSERT_EQ(999u, values[999]);
+  values[999999] = 1;
+  reallocator.deallocate(values, 1000000);
+
+  MappedBuffer buffer(MmapReallocator<byte>().allocate(5000), 5000);
+  buffer[4999] = 1;
+  buffer.reset();
+  ASSERT_TRUE(buffer.empty());
+}
+#endif
+
 SW_NAMESPACE_END
@@ -0,0 +1,238 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#include <sw/flat_lru_cache.h>
+#include <sw/lru_cache.h>
+#include <sw/sharded_lru_cache.h>
+#include <sw/strings.h>
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+SW_NAMESPACE_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(FlatLruCacheTest, putAndGet) {
+  FlatLruCache<int, std::string> lru;
+  lru.put(1, "1");
+  lru.put(2, "2");
+  lru.put(3, "3");
+  ASSERT_EQ(3u, lru.size());
+  ASSERT_EQ("1", lru[1]);
+  ASSERT_EQ("2", lru[2]);
+  ASSERT_EQ("3", lru[3]);
+  lru.put(3, "33");
+  ASSERT_EQ("33", lru[3]);
+  ASSERT_EQ("", lru[4]);
+  ASSERT_EQ(4u, lru.size());
+
+  std::string str;
+  ASSERT_FALSE(lru.get(5, str));
+  ASSERT_TRUE(lru.get(3, str));
+  ASSERT_EQ("33", str);
+
+  auto iter = lru.find(2);
+  ASSERT_NE(lru.end(), iter);
+  iter.value() = "22";
+  ASSERT_EQ("22", *lru.peek(2));
+  ASSERT_EQ(lru.cend(), lru.peek(5));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(FlatLruCacheTest, eviction) {
+  FlatLruCache<int, int> lru(3);
+  lru.put(1, 1);
+  lru.put(2, 2);
+  lru.put(3, 3);
+  lru.refresh(1);
+  lru.put(4, 4);
+  ASSERT_EQ(3u, lru.size());
+  ASSERT_FALSE(lru.contains(2));
+
+  // Ordered most recent first
+  auto iter = lru.cbegin();
+  ASSERT_EQ(4, iter.key());
+  ASSERT_EQ(1, (++iter).key());
+  ASSERT_EQ(3, (++iter).key());
+  ASSERT_EQ(lru.cend(), ++iter);
+  ASSERT_EQ(3, (--iter).key());
+
+  // Evicted slots are recycled, so the slab stays put
+  const auto capacity = lru.capacity();
+  for (int i = 0; i < 1000; ++i) {
+    lru.put(i, i);
+  }
+  ASSERT_EQ(capacity, lru.capacity());
+  ASSERT_EQ(3u, lru.size());
+  ASSERT_TRUE(lru.contains(999));
+
+  lru.setMaxSize(1);
+  ASSERT_EQ(1u, lru.size());
+  ASSERT_TRUE(lru.contains(999));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(FlatLruCacheTest, erase) {
+  FlatLruCache<int, std::string, false> lru(2);
+  for (int i = 0; i < 5; ++i) {
+    lru.put(i, std::to_string(i));
+  }
+  ASSERT_EQ(5u, lru.size());
+  ASSERT_EQ(1u, lru.erase(2));
+  ASSERT_EQ(0u, lru.erase(2));
+
+  auto next = lru.erase(lru.cfind(4));
+  ASSERT_EQ(3, next.key());
+  ASSERT_EQ(3u, lru.size());
+
+  lru.purge();
+  ASSERT_EQ(2u, lru.size());
+  ASSERT_TRUE(lru.contains(3));
+  ASSERT_TRUE(lru.contains(1));
+
+  lru.clear();
+  ASSERT_TRUE(lru.empty());
+  ASSERT_EQ(lru.end(), lru.begin());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(FlatLruCacheTest, copyAndMove) {
+  FlatLruCache<int, std::string> lru(4);
+  lru.put(1, "1");
+  lru.put(2, "2");
+  lru.put(3, "3");
+
+  auto lru2 = lru;
+  ASSERT_EQ(3u, lru2.size());
+  auto iter = lru.cbegin();
+  auto iter2 = lru2.cbegin();
+  for (; iter != lru.cend(); ++iter, ++iter2) {
+    ASSERT_EQ(iter.key(), iter2.key());
+    ASSERT_EQ(*iter, *iter2);
+  }
+
+  auto lru3 = std::move(lru);
+  ASSERT_EQ(3u, lru3.size());
+  ASSERT_TRUE(lru.empty());
+  lru.put(5, "5");
+  ASSERT_EQ("5", lru[5]);
+
+  FlatLruCache<int, std::unique_ptr<int>> ptrs(2);
+  ptrs.put(1, std::unique_ptr<int>(new int(1)));
+  ptrs.put(2, std::unique_ptr<int>(new int(2)));
+  ptrs.put(3, std::unique_ptr<int>(new int(3)));
+  ASSERT_EQ(2u, ptrs.size());
+  ASSERT_EQ(3, *ptrs[3]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Random operations should behave exactly like the node based cache
+TEST(FlatLruCacheTest, matchesLruCache) {
+  LruCache<int, int> expected(100);
+  FlatLruCache<int, int> lru(100);
+  std::mt19937 rng(1234);
+  for (int i = 0; i < 100000; ++i) {
+    const int key = static_cast<int>(rng() % 300);
+    switch (rng() % 4) {
+    case 0:
+      expected.erase(key);
+      lru.erase(key);
+      break;
+    case 1: {
+      int v1 = -1;
+      int v2 = -1;
+      ASSERT_EQ(expected.get(key, v1), lru.get(key, v2));
+      ASSERT_EQ(v1, v2);
+      break;
+    }
+    default:
+      expected.put(key, i);
+      lru.put(key, i);
+      break;
+    }
+  }
+
+  ASSERT_EQ(expected.size(), lru.size());
+  auto iter = lru.cbegin();
+  for (auto eiter = expected.cbeginOrdered(); eiter != expected.cendOrdered(); ++eiter, ++iter) {
+    ASSERT_EQ(eiter.key(), iter.key());
+    ASSERT_EQ(*eiter, *iter);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(FlatLruCacheTest, sharded) {
+  ShardedLruCacheType<FlatLruCache<int, int>, 4, LruPromotion::Deferred> lru(8);
+  for (int i = 0; i < 100; ++i) {
+    lru.put(i, i);
+  }
+  ASSERT_LE(lru.size(), 8u);
+
+  int value = 0;
+  ASSERT_TRUE(lru.get(99, value));
+  ASSERT_EQ(99, value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(FlatLruCacheTest, transparentLookup) {
+  using Cache = FlatLruCache<std::string, int, true, TransparentStringHash, TransparentStringEqual>;
+  static_assert(Cache::kTransparentLookup, "");
+  static_assert(!FlatLruCache<std::string, int>::kTransparentLookup, "");
+
+  Cache lru(2);
+  lru.put("one", 1);
+  lru.put("two", 2);
+
+  const char buffer[] = "one-two";
+  const StringView one(buffer, 3);
+  int value = 0;
+  ASSERT_TRUE(lru.contains(one));
+  ASSERT_TRUE(lru.get(one, value));
+  ASSERT_EQ(1, value);
+  ASSERT_EQ(2, lru.peek(StringWrapper("two")).value());
+  ASSERT_EQ(lru.end(), lru.find(StringView(buffer, 2)));
+
+  // The get refreshed "one", so "two" goes
+  lru.put("three", 3);
+  ASSERT_FALSE(lru.contains("two"));
+  ASSERT_EQ(1u, lru.erase(one));
+  ASSERT_EQ(1u, lru.size());
+
+  // Sharded lookups pick the same shard for any key type
+  ShardedLruCacheType<Cache, 4> sharded(100);
+  for (int i = 0; i < 50; ++i) {
+    sharded.put(std::to_string(i), i);
+  }
+  for (int i = 0; i < 50; ++i) {
+    const auto key = std::to_string(i);
+    ASSERT_EQ(sharded.shardIndex(key), sharded.shardIndex(StringView(key.data(), key.size())));
+    ASSERT_TRUE(sharded.get(StringView(key.data(), key.size()), value));
+    ASSERT_EQ(i, value);
+  }
+
+  std::vector<StringView> keys{"1", "2", "nope", "49"};
+  std::vector<int> values(keys.size(), -1);
+  ASSERT_EQ(3u, sharded.getMany(keys.data(), keys.size(), values.data()));
+  ASSERT_EQ((std::vector<int>{1, 2, -1, 49}), values);
+}
+
+SW_NAMESPACE_END
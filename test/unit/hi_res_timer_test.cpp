@@ -0,0 +1,62 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#include <sw/hi_res_timer.h>
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <type_traits>
+
+SW_NAMESPACE_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(HiResTimerTest, basic) {
+  static_assert(std::is_same<HiResTimer::Clock, std::chrono::high_resolution_clock>::value, "");
+
+  HiResTimer hrt;
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_GE(hrt.elapsedMs().count(), 10);
+  ASSERT_GE(hrt.elapsedNs(), hrt.elapsed());
+  ASSERT_GE(hrt.update().count(), 10000);
+  ASSERT_LT(hrt.elapsedMs().count(), 10);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(HiResTimerTest, tscClock) {
+  TscClock::calibrate();
+
+  // Steady, whichever backend it's using
+  auto last = TscClock::now();
+  for (int i = 0; i < 10000; ++i) {
+    const auto now = TscClock::now();
+    ASSERT_GE(now, last);
+    last = now;
+  }
+
+  // And agrees with steady_clock, within calibration error and scheduling noise
+  const auto steadyStart = std::chrono::steady_clock::now();
+  TscTimer timer;
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  const auto tscElapsed = timer.elapsedNs();
+  const auto steadyElapsed = std::chrono::steady_clock::now() - steadyStart;
+  ASSERT_GE(tscElapsed, std::chrono::milliseconds(45));
+  ASSERT_LE(tscElapsed, steadyElapsed + std::chrono::milliseconds(5));
+}
+
+SW_NAMESPACE_END
@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#include <sw/latency_histogram.h>
+#include <sw/logger.h>
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+SW_NAMESPACE_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(LatencyHistogramTest, buckets) {
+  using namespace latency_detail;
+
+  // Every value lands in a bucket that holds it, and buckets are at most ~3% wide
+  sizex lastIndex = 0;
+  for (u64 value = 0; value < 1000000; value += 1 + value / 100) {
+    const sizex index = bucketIndex(value);
+    ASSERT_GE(index, lastIndex);
+    ASSERT_LE(bucketLowest(index), value);
+    ASSERT_GE(bucketHighest(index), value);
+    ASSERT_LE(bucketHighest(index) - bucketLowest(index), bucketLowest(index) / kSubBuckets);
+    lastIndex = index;
+  }
+  ASSERT_EQ(bucketLowest(bucketIndex(0)), 0);
+  ASSERT_EQ(bucketIndex(63), 63);
+  ASSERT_EQ(bucketIndex(64), 64);
+  ASSERT_EQ(bucketIndex(kMaxValue), kBucketCount - 1);
+  ASSERT_EQ(bucketIndex(~0_u64), kBucketCount - 1);
+  ASSERT_EQ(bucketHighest(kBucketCount - 1), kMaxValue);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(LatencyHistogramTest, percentiles) {
+  LatencyHistogram histogram;
+  ASSERT_EQ(0, histogram.snapshot().p99Ns());
+
+  for (u64 i = 1; i <= 10000; ++i) {
+    histogram.record(i * 100);
+  }
+  const auto snapshot = histogram.snapshot();
+  ASSERT_EQ(10000, snapshot.count);
+  ASSERT_DOUBLE_EQ(500050.0, snapshot.meanNs());
+  ASSERT_EQ(100, snapshot.minNs());
+
+  // Within a bucket of the true value, never below it
+  auto near = [](u64 expected, u64 actual) { return actual >= expected && actual <= expected + expected / 32; };
+  ASSERT_TRUE(near(500000, snapshot.p50Ns())) << snapshot.p50Ns();
+  ASSERT_TRUE(near(990000, snapshot.p99Ns())) << snapshot.p99Ns();
+  ASSERT_TRUE(near(999000, snapshot.p999Ns())) << snapshot.p999Ns();
+  ASSERT_TRUE(near(1000000, snapshot.maxNs())) << snapshot.maxNs();
+
+  histogram.record(std::chrono::milliseconds(5));
+  ASSERT_TRUE(near(5000000, histogram.snapshot().maxNs()));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(LatencyHistogramTest, threadsAndIntervals) {
+  LatencyHistogram histogram;
+  histogram.record(10);
+  ASSERT_EQ(1, histogram.intervalSnapshot().count);
+  ASSERT_EQ(0, histogram.intervalSnapshot().count);
+
+  // Counts survive their threads exiting. The values start buckets, so min is exact
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&histogram, t]() {
+      for (u64 i = 0; i < 10000; ++i) {
+        histogram.record(u64(t + 1) * 1024);
+      }
+    });
+  }
+  auto during = histogram.snapshot();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_LE(during.count, 40001);
+
+  const auto interval = histogram.intervalSnapshot();
+  ASSERT_EQ(40000, interval.count);
+  ASSERT_EQ(1024, interval.minNs());
+  ASSERT_EQ(latency_detail::bucketHighest(latency_detail::bucketIndex(4096)), interval.maxNs());
+  ASSERT_EQ(40001, histogram.snapshot().count);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+struct LatencyTestLogHandler : LogHandler {
+  void onLog(SystemTimepoint logTime, LoggerCategory cat, const StringWrapper& msg, bool force) override {
+    unused(logTime);
+    unused(cat);
+    unused(force);
+    lines.emplace_back(msg.data(), msg.size());
+  };
+
+  std::vector<std::string> lines;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(LatencyHistogramTest, scopedTimerAndRegistry) {
+  LatencyRegistry registry;
+  auto& histogram = registry.histogram("test.sleep");
+  ASSERT_EQ(&histogram, &registry.histogram("test.sleep"));
+  registry.histogram("test.idle");
+
+  {
+    ScopedTimer timer(histogram);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  {
+    ScopedTimer timer(histogram);
+    timer.cancel();
+  }
+  const auto snapshot = histogram.snapshot();
+  ASSERT_EQ(1, snapshot.count);
+  ASSERT_GE(snapshot.maxNs(), 2000000);
+
+  // Only histograms with something new get a line
+  auto handler = std::make_shared<LatencyTestLogHandler>();
+  Logger logger(handler);
+  registry.logIntervalSnapshots(logger);
+  ASSERT_EQ(1, handler->lines.size());
+  ASSERT_EQ(0, handler->lines[0].find("latency test.sleep: count=1 mean="));
+  registry.logIntervalSnapshots(logger);
+  ASSERT_EQ(1, handler->lines.size());
+
+  for (int i = 0; i < 3; ++i) {
+    SW_SCOPED_LATENCY("test.macro");
+  }
+  ASSERT_EQ(3, latencyRegistry().histogram("test.macro").snapshot().count);
+}
+
+SW_NAMESPACE_END
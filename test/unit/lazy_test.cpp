@@ -21,6 +21,13 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
 SW_NAMESPACE_BEGIN
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -56,4 +63,84 @@ TEST(LazyTest, basic) {
 };
 // clang-format on
 
+////////////////////////////////////////////////////////////////////////////////
+TEST(LazyTest, atomicPod) {
+  AtomicLazyPodValue<int, -1> lz;
+  ASSERT_EQ(5, lz.get([]() { return 5; }));
+  ASSERT_EQ(5, lz.get([]() { return 6; }));
+
+  // Racing initializers all see the one that won
+  static int tables[8];
+  AtomicLazyPodValue<int*, nullptr> table;
+  std::atomic<int> calls{0};
+  std::vector<int*> seen(8);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t]() {
+      seen[sizex(t)] = table.get([&]() { return &tables[calls++]; });
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_GE(calls.load(), 1);
+  for (auto* ptr : seen) {
+    ASSERT_EQ(table.get([]() { return tables; }), ptr);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(LazyTest, concurrent) {
+  {
+    u32 testInc = 0;
+    auto lz1 = ConcurrentLazyValue<TestDummy>([&]() { ++testInc; return TestDummy{77}; });
+    ASSERT_FALSE(lz1.isSet());
+    ASSERT_EQ(77, lz1.get().x);
+    ASSERT_EQ(77, lz1.get().x);
+    ASSERT_EQ(1, testInc);
+    ASSERT_TRUE(lz1.isSet());
+  }
+
+  // A throwing evaluation leaves it unset, to try again
+  {
+    int attempts = 0;
+    auto lz1 = makeConcurrentLazyValue<std::string>([&]() {
+      if (++attempts == 1) {
+        throw std::runtime_error("not yet");
+      }
+      return std::string("ready");
+    });
+    ASSERT_THROW(lz1.get(), std::runtime_error);
+    ASSERT_FALSE(lz1.isSet());
+    ASSERT_EQ("ready", lz1.get());
+    ASSERT_EQ(2, attempts);
+  }
+
+  // Evaluated exactly once, however many threads race for it
+  std::atomic<int> evaluations{0};
+  const auto build = [&]() {
+    ++evaluations;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return std::vector<int>(1000, 42);
+  };
+  ConcurrentLazyLambdaValue<std::vector<int>, decltype(build)> table(build);
+  std::atomic<int> bad{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < 1000; ++i) {
+        const auto& value = table.get();
+        if (value.size() != 1000 || value[999] != 42) {
+          ++bad;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(1, evaluations.load());
+  ASSERT_EQ(0, bad.load());
+}
+
 SW_NAMESPACE_END
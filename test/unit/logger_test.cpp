@@ -20,6 +20,13 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
 SW_NAMESPACE_BEGIN
 
 struct TestLogEntry {
@@ -56,4 +63,261 @@ TEST(LoggerTest, basic) {
   ASSERT_EQ(false, handler->entries[1].force);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST(LoggerTest, asyncOrderAndDrain) {
+  auto handler = std::make_shared<TestLogHandler>();
+  AsyncLogHandler::Config config;
+  config.capacity = 64;
+  config.wakeWatermark = 16;
+  auto async = std::make_shared<AsyncLogHandler>(handler, config);
+  Logger logger(async);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&logger, t]() {
+      for (int i = 0; i < 500; ++i) {
+        logger.infof("{}:{}", t, i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  async->shutdown();
+
+  // Blocking overflow loses nothing, and each thread's messages stay in order
+  ASSERT_EQ(2000u, handler->entries.size());
+  int next[4] = {0, 0, 0, 0};
+  for (const auto& entry : handler->entries) {
+    const auto t = entry.msg[0] - '0';
+    ASSERT_EQ(fmt::format("{}:{}", t, next[t]), entry.msg);
+    ++next[t];
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Holds up the async thread in the first message until released
+struct GatedLogHandler : TestLogHandler {
+  void onLog(SystemTimepoint logTime, LoggerCategory cat, const StringWrapper& msg, bool force) override {
+    entered = true;
+    while (!released) {
+      std::this_thread::yield();
+    }
+    TestLogHandler::onLog(logTime, cat, msg, force);
+  }
+
+  std::atomic<bool> entered{false};
+  std::atomic<bool> released{false};
+};
+
+TEST(LoggerTest, asyncDropAndCount) {
+  auto handler = std::make_shared<GatedLogHandler>();
+  AsyncLogHandler::Config config;
+  config.capacity = 4;
+  config.wakeWatermark = 1;
+  config.overflow = AsyncLogOverflow::DropAndCount;
+  auto async = std::make_shared<AsyncLogHandler>(handler, config);
+  Logger logger(async);
+
+  logger.info("first");
+  while (!handler->entered) {
+    std::this_thread::yield();
+  }
+  for (int i = 0; i < 5; ++i) {
+    logger.infof("{}", i);
+  }
+  handler->released = true;
+  async->shutdown();
+
+  // The slot being forwarded isn't free yet, so 3 fit and 2 are dropped
+  ASSERT_EQ(2u, async->droppedCount());
+  ASSERT_EQ(5u, handler->entries.size());
+  ASSERT_EQ("first", handler->entries[0].msg);
+  ASSERT_EQ("0", handler->entries[1].msg);
+  ASSERT_EQ("2", handler->entries[3].msg);
+  ASSERT_EQ(LoggerCategory::Warn, handler->entries[4].cat);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(LoggerTest, deferred) {
+  // Handlers without deferred support get the formatted message
+  auto handler = std::make_shared<TestLogHandler>();
+  Logger logger(handler);
+  logger.logDeferred(LoggerCategory::Info, "{} {} {:.1f} {}", 1, "two", 3.0, std::string("four"));
+  ASSERT_EQ(1u, handler->entries.size());
+  ASSERT_EQ("1 two 3.0 four", handler->entries[0].msg);
+
+  // Async formats on its thread, from copies of the arguments
+  auto asyncTarget = std::make_shared<TestLogHandler>();
+  auto async = std::make_shared<AsyncLogHandler>(asyncTarget);
+  Logger asyncLogger(async);
+  for (int i = 0; i < 100; ++i) {
+    std::string str = fmt::format("str{}", i);
+    const char buffer[] = "view-extra";
+    asyncLogger.logDeferred(LoggerCategory::Debug, "{}:{}:{}:{}", i, str, StringView(buffer, 4), 'c');
+    str.assign("clobbered");
+  }
+  asyncLogger.logDeferred(LoggerCategory::Warn, "no args");
+  // Too few arguments only shows up when the thread formats it
+  asyncLogger.logDeferred(LoggerCategory::Error, "{} and {}", 1);
+  asyncLogger.logDeferred(LoggerCategory::Info, "after");
+  async->shutdown();
+
+  ASSERT_EQ(103u, asyncTarget->entries.size());
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_EQ(fmt::format("{}:str{}:view:c", i, i), asyncTarget->entries[i].msg);
+    ASSERT_EQ(LoggerCategory::Debug, asyncTarget->entries[i].cat);
+  }
+  ASSERT_EQ("no args", asyncTarget->entries[100].msg);
+  ASSERT_EQ(LoggerCategory::Error, asyncTarget->entries[101].cat);
+  ASSERT_NE(std::string::npos, asyncTarget->entries[101].msg.find("{} and {}"));
+  ASSERT_EQ("after", asyncTarget->entries[102].msg);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static std::string readFile(const std::string& path) {
+  std::ifstream fin(path);
+  std::stringstream contents;
+  contents << fin.rdbuf();
+  return contents.str();
+}
+
+TEST(LoggerTest, bufferedFile) {
+  const std::string path = "sw-logger-test-buffered.log";
+  std::remove(path.c_str());
+  {
+    ConsoleFileLogHandler::Config config;
+    config.logFile = path;
+    config.fileTimeStyle = LoggerTimeStyle::None;
+    config.console_destination = LoggerConsoleDestination::None;
+    config.fileBufferSize = 1 << 20;
+    config.fileFlushInterval = std::chrono::hours(1);
+    auto handler = std::make_shared<ConsoleFileLogHandler>(config);
+    Logger logger(handler);
+
+    logger.info("one");
+    logger.warn("two");
+    ASSERT_EQ("", readFile(path));
+
+    // Errors flush right away
+    logger.error("three");
+    const auto nl = std::string(system::ThisSystemTraits::newline());
+    ASSERT_EQ("info: one" + nl + "warn: two" + nl + "erro: three" + nl, readFile(path));
+
+    // Batches, and the rest goes on destruction
+    const LogRecord records[] = {{SystemClock::now(), LoggerCategory::Info, "four", false},
+                                 {SystemClock::now(), LoggerCategory::Debug, "five", false}};
+    handler->onLogBatch(records, 2);
+    handler->flush();
+    ASSERT_EQ("info: one" + nl + "warn: two" + nl + "erro: three" + nl + "info: four" + nl + "dbug: five" + nl,
+              readFile(path));
+    logger.info("six");
+  }
+  ASSERT_NE(std::string::npos, readFile(path).find("info: six"));
+  std::remove(path.c_str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(LoggerTest, absoluteTimeFormat) {
+  const std::string path = "sw-logger-test-abstime.log";
+  std::remove(path.c_str());
+  const auto base = SystemClock::from_time_t(SystemClock::to_time_t(SystemClock::now()));
+  const auto times = {base + std::chrono::milliseconds(250), base + std::chrono::milliseconds(500),
+                      base + std::chrono::milliseconds(1001)};
+  {
+    ConsoleFileLogHandler::Config config;
+    config.logFile = path;
+    config.console_destination = LoggerConsoleDestination::None;
+    Logger logger(std::make_shared<ConsoleFileLogHandler>(config));
+    for (const auto& time : times) {
+      logger.log(time, LoggerCategory::Info, "msg");
+    }
+  }
+
+  // Same format as before the cached time, and the text changes with the second
+  std::string expected;
+  for (const auto& time : times) {
+    const auto absTime = log_detail::getAbsTime(time);
+    expected += fmt::format("{}.{:.3f}:info: msg", absTime.timeString, absTime.msFraction);
+    expected += system::ThisSystemTraits::newline();
+  }
+  ASSERT_EQ(expected, readFile(path));
+  std::remove(path.c_str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+struct BatchCountingLogHandler : TestLogHandler {
+  void onLogBatch(const LogRecord* records, sizex count) override {
+    while (!released) {
+      std::this_thread::yield();
+    }
+    ++batches;
+    LogHandler::onLogBatch(records, count);
+  }
+  void flush() override { ++flushes; }
+
+  std::atomic<bool> released{false};
+  int batches = 0;
+  int flushes = 0;
+};
+
+TEST(LoggerTest, asyncBatches) {
+  auto handler = std::make_shared<BatchCountingLogHandler>();
+  auto async = std::make_shared<AsyncLogHandler>(handler);
+  Logger logger(async);
+  for (int i = 0; i < 1000; ++i) {
+    logger.infof("{}", i);
+  }
+  handler->released = true;
+  async->shutdown();
+
+  // Held up by the first batch, the rest queue up and come through a few batches
+  ASSERT_EQ(1000u, handler->entries.size());
+  ASSERT_EQ("999", handler->entries.back().msg);
+  ASSERT_LE(handler->batches, 5);
+  ASSERT_GE(handler->flushes, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(LoggerTest, categoryMasks) {
+  auto handler = std::make_shared<TestLogHandler>();
+  Logger logger(handler);
+  ASSERT_EQ(LoggerCategory::All, logger.categoryMask());
+
+  logger.setCategoryMask(LoggerCategory::Error | LoggerCategory::Warn);
+  ASSERT_FALSE(logger.isEnabled(LoggerCategory::Info));
+  logger.info("no");
+  logger.debugf("no {}", std::string("copy"));
+  logger.logDeferred(LoggerCategory::Debug, "no");
+  logger.logForcef(LoggerCategory::Info, "forced {}", 1);
+  logger.warnf("yes {}", 2);
+  ASSERT_EQ(2u, handler->entries.size());
+  ASSERT_EQ("forced 1", handler->entries[0].msg);
+  ASSERT_EQ("yes 2", handler->entries[1].msg);
+
+  // Macros skip evaluating the arguments when disabled
+  int evaluated = 0;
+  const auto& arg = [&]() { return ++evaluated; };
+  SW_LOG_DEBUG(logger, "{}", arg());
+  SW_LOG_ERROR(logger, "{}", arg());
+  ASSERT_EQ(1, evaluated);
+  ASSERT_EQ("1", handler->entries.back().msg);
+
+  // Compiled out categories are gone even when forced
+  using ReleaseLogger = LoggerType<system::ThisSystemTraits, LoggerCategory::Error | LoggerCategory::Warn>;
+  static_assert(!ReleaseLogger::isCompiledIn(LoggerCategory::Debug), "");
+  static_assert(ReleaseLogger::isCompiledIn(LoggerCategory::Error), "");
+  ReleaseLogger release(handler);
+  handler->entries.clear();
+  release.debugf("{}", 1);
+  release.logForcef(LoggerCategory::Debug, "{}", 2);
+  SW_LOG_VERBOSE(release, "{}", arg());
+  release.error("error");
+  ASSERT_EQ(1u, handler->entries.size());
+  ASSERT_EQ(1, evaluated);
+
+  Logger moved(std::move(logger));
+  ASSERT_EQ(LoggerCategory::Error | LoggerCategory::Warn, moved.categoryMask());
+}
+
 SW_NAMESPACE_END
@@ -56,6 +56,216 @@ TEST(LruCacheTest, lruPutAndGet) {
   ASSERT_EQ("33", str);
 }
 
+TEST(LruCacheTest, peekAndRefresh) {
+  LruCache<int, std::string> lru(2);
+  lru.put(1, "1");
+  lru.put(2, "2");
+
+  // Peeking doesn't change the order, so 1 is still the oldest
+  auto iter = lru.peek(1);
+  ASSERT_NE(lru.cend(), iter);
+  ASSERT_EQ("1", *iter);
+  ASSERT_EQ(lru.cend(), lru.peek(3));
+  ASSERT_EQ(2, lru.cbeginOrdered().key());
+
+  lru.refresh(iter);
+  ASSERT_EQ(1, lru.cbeginOrdered().key());
+  lru.put(3, "3");
+  ASSERT_TRUE(lru.contains(1));
+  ASSERT_FALSE(lru.contains(2));
+}
+
+struct StringCost {
+  sizex operator()(int, const std::string& value) const { return value.size(); }
+};
+
+TEST(LruCacheTest, costWeighted) {
+  using Cache = LruCache<int, std::string, true, StringCost>;
+  Cache lru(Cache::kUnlimitedCost, 10);
+  ASSERT_EQ(10u, lru.maxCost());
+  lru.put(1, "aaaa");
+  lru.put(2, "bbbb");
+  ASSERT_EQ(8u, lru.totalCost());
+
+  // Needs 2 more, so the oldest goes
+  lru.put(3, "cccc");
+  ASSERT_EQ(2u, lru.size());
+  ASSERT_FALSE(lru.contains(1));
+  ASSERT_EQ(8u, lru.totalCost());
+
+  // Growing a value re-costs it
+  lru.put(3, "cccccccc");
+  ASSERT_EQ(1u, lru.size());
+  ASSERT_EQ(8u, lru.totalCost());
+
+  // Explicit cost, and an item that can never fit
+  lru.put(4, "d", 2);
+  ASSERT_EQ(10u, lru.totalCost());
+  lru.put(5, "eeeeeeeeeeee");
+  ASSERT_FALSE(lru.contains(5));
+  ASSERT_EQ(10u, lru.totalCost());
+
+  lru.setMaxCost(3);
+  ASSERT_EQ(1u, lru.size());
+  ASSERT_TRUE(lru.contains(4));
+  ASSERT_EQ(1u, lru.erase(4));
+  ASSERT_EQ(0u, lru.totalCost());
+
+  // Copies keep the costs
+  lru.put(6, "ff");
+  auto lru2 = lru;
+  ASSERT_EQ(2u, lru2.totalCost());
+  lru2.clear();
+  ASSERT_EQ(0u, lru2.totalCost());
+
+  // The count bound still applies
+  Cache lru3(2, 100);
+  lru3.put(1, "1");
+  lru3.put(2, "2");
+  lru3.put(3, "3");
+  ASSERT_EQ(2u, lru3.size());
+  ASSERT_EQ(2u, lru3.totalCost());
+}
+
+TEST(LruCacheTest, stats) {
+  using Cache = LruCache<int, std::string, true, StringCost, LruPolicy, true>;
+  Cache lru(10, 10);
+  lru.put(1, "aaaa");
+  lru.put(2, "bbbb");
+  lru.put(2, "bb");
+  std::string value;
+  ASSERT_TRUE(lru.get(1, value));
+  ASSERT_FALSE(lru.get(3, value));
+  ASSERT_NE(lru.peek(2), lru.cend());
+  lru[4] = "";
+
+  // 2 then 1 go to make room, and 12 chars can never fit
+  lru.put(5, "eeeeeeee");
+  lru.put(6, "ffffffffffff");
+
+  auto stats = lru.stats();
+  ASSERT_EQ(2u, stats.hits);
+  ASSERT_EQ(2u, stats.misses);
+  ASSERT_EQ(4u, stats.inserts);
+  ASSERT_EQ(2u, stats.evictions);
+  ASSERT_EQ(6u, stats.evictedCost);
+  ASSERT_EQ(1u, stats.rejections);
+  ASSERT_DOUBLE_EQ(0.5, stats.hitRatio());
+
+  // Copies carry the counts
+  auto lru2 = lru;
+  ASSERT_EQ(2u, lru2.stats().hits);
+  lru.resetStats();
+  ASSERT_EQ(0u, lru.stats().hits);
+  ASSERT_EQ(0.0, lru.stats().hitRatio());
+
+  // Disabled statistics take no space
+  static_assert(sizeof(LruCache<int, int>) == sizeof(LruCache<int, int, true, LruUnitCost, LruPolicy, false>), "");
+}
+
+TEST(LruCacheTest, segmentedScanResistance) {
+  LruCache<int, int> lru(10);
+  LruCache<int, int, true, LruUnitCost, SlruPolicy<>> slru(10);
+  for (int i = 0; i < 5; ++i) {
+    lru.put(i, i);
+    slru.put(i, i);
+  }
+  for (int i = 0; i < 5; ++i) {
+    lru.refresh(i);
+    slru.refresh(i);
+  }
+
+  // A scan flushes plain LRU but only churns the probation segment of SLRU
+  for (int i = 100; i < 200; ++i) {
+    lru.put(i, i);
+    slru.put(i, i);
+  }
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_FALSE(lru.contains(i));
+    ASSERT_TRUE(slru.contains(i));
+  }
+  ASSERT_EQ(10u, slru.size());
+  ASSERT_TRUE(slru.contains(199));
+
+  // Order is protected first, then probation
+  ASSERT_EQ(4, slru.cbeginOrdered().key());
+  ASSERT_EQ(199, (++++++++++slru.cbeginOrdered()).key());
+
+  auto slru2 = slru;
+  ASSERT_EQ(10u, slru2.size());
+  slru2.put(300, 300);
+  ASSERT_TRUE(slru2.contains(0));
+}
+
+TEST(LruCacheTest, tinyLfuAdmission) {
+  LruCache<int, int, true, LruUnitCost, TinyLfuPolicy<LruPolicy>> lru(5);
+  for (int i = 0; i < 5; ++i) {
+    lru.put(i, i);
+    for (int j = 0; j < 8; ++j) {
+      lru.refresh(i);
+    }
+  }
+
+  // One-off keys are seen less than the hot victim, so they're rejected
+  for (int i = 100; i < 200; ++i) {
+    lru.put(i, i);
+  }
+  ASSERT_EQ(5u, lru.size());
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_TRUE(lru.contains(i));
+  }
+
+  // A key that keeps getting asked for will get in
+  int value = 0;
+  for (int j = 0; j < 15; ++j) {
+    ASSERT_FALSE(lru.get(500, value));
+  }
+  lru.put(500, 500);
+  ASSERT_TRUE(lru.contains(500));
+
+  // operator[] always admits
+  lru[600] = 600;
+  ASSERT_TRUE(lru.contains(600));
+}
+
+TEST(LruCacheTest, policyStress) {
+  LruCache<int, int, true, LruUnitCost, TinyLfuPolicy<>> lru(50);
+  LruCache<int, int, false, LruUnitCost, SlruPolicy<50>> slru(50);
+  u32 seed = 17;
+  for (int i = 0; i < 50000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    const int key = static_cast<int>((seed >> 8) % 200);
+    int value = 0;
+    switch ((seed >> 4) % 5) {
+    case 0:
+      lru.erase(key);
+      slru.erase(key);
+      break;
+    case 1:
+      lru.get(key, value);
+      slru.get(key, value);
+      break;
+    case 2:
+      lru[key] = i;
+      slru[key] = i;
+      break;
+    default:
+      lru.put(key, i);
+      slru.put(key, i);
+      if (i % 1000 == 0)
+        slru.purge();
+      break;
+    }
+    ASSERT_LE(lru.size(), 50u);
+  }
+
+  auto moved = std::move(slru);
+  slru.put(1, 1);
+  ASSERT_EQ(1u, slru.size());
+  moved.purge();
+  ASSERT_EQ(50u, moved.size());
+}
+
 TEST(LruCacheTest, keyErase) {
   LruCache<int, std::string> lru;
   lru[1] = "1";
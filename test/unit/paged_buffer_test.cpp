@@ -22,7 +22,14 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <array>
+#include <thread>
+#include <vector>
+
+#if SW_POSIX
+#  include <unistd.h>
+#endif
 
 SW_NAMESPACE_BEGIN
 
@@ -54,4 +61,242 @@ TEST(PagedBufferTest, basicTest) {
   ASSERT_EQ(destBuffer[11], 5);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST(PagedBufferTest, pagePool) {
+  using Pool = PagePool<16>;
+  using Buffer = PagedBuffer<16, true, Pool::Allocator>;
+  Pool::Config config;
+  config.threadCachePages = 4;
+  config.maxPooledPages = 8;
+  auto pool = std::make_shared<Pool>(config);
+
+  const std::array<byte, 64> source = {{1, 2, 3, 4, 5, 6, 7, 8}};
+  byte* firstPage = nullptr;
+  {
+    Buffer buffer(0, pool->allocator());
+    buffer.append(source.data(), source.size());
+    ASSERT_EQ(64u, buffer.capacity());
+    firstPage = &buffer[0];
+
+    // Moves keep the pages
+    Buffer moved(std::move(buffer));
+    ASSERT_EQ(0u, buffer.size());
+    ASSERT_EQ(64u, moved.size());
+    ASSERT_EQ(source[7], moved[7]);
+  }
+
+  // The pages get recycled through this thread's cache, and are zeroed again
+  {
+    Buffer buffer(64, pool->allocator());
+    ASSERT_EQ(0, buffer[0]);
+    bool reused = false;
+    for (sizex i = 0; i < 4; ++i) {
+      reused = reused || &buffer[i * 16] == firstPage;
+    }
+    ASSERT_TRUE(reused);
+  }
+
+  // Overfilling the thread cache spills to the shared list, which is capped
+  {
+    Buffer buffer(16 * 32, pool->allocator());
+  }
+  ASSERT_GT(pool->pooledPageCount(), 0u);
+  ASSERT_LE(pool->pooledPageCount(), 8u);
+  pool->trim();
+  ASSERT_EQ(0u, pool->pooledPageCount());
+
+  // Pages freed on other threads, including after the pool is gone
+  std::vector<Buffer> buffers;
+  for (int i = 0; i < 8; ++i) {
+    buffers.emplace_back(64, pool->allocator());
+  }
+  std::thread thread([&]() {
+    buffers.erase(buffers.begin() + 4, buffers.end());
+    pool.reset();
+    buffers.clear();
+  });
+  thread.join();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(PagedBufferTest, ioSegments) {
+  auto buffer = PagedBuffer<16>(0);
+  std::array<byte, 100> source;
+  for (sizex i = 0; i < source.size(); ++i) {
+    source[i] = byte(i);
+  }
+  buffer.append(source.data(), source.size());
+
+  // Ranges get split on page boundaries
+  ASSERT_EQ(0u, buffer.ioSegmentCount(5, 0));
+  ASSERT_EQ(1u, buffer.ioSegmentCount(0, 16));
+  ASSERT_EQ(2u, buffer.ioSegmentCount(15, 2));
+  auto segments = buffer.ioSegments(10, 40);
+  ASSERT_EQ(4u, segments.size());
+  ASSERT_EQ(&buffer[10], segments[0].data);
+  ASSERT_EQ(6u, segments[0].size);
+  ASSERT_EQ(&buffer[16], segments[1].data);
+  ASSERT_EQ(16u, segments[1].size);
+  ASSERT_EQ(2u, segments[3].size);
+
+  // A short segment array covers part of the range
+  IoSegment twoSegments[2];
+  ASSERT_EQ(22u, buffer.ioSegments(10, 40, twoSegments, 2));
+
+#if SW_POSIX
+  int fds[2];
+  ASSERT_EQ(0, ::pipe(fds));
+  ASSERT_EQ(90, buffer.writeTo(fds[1], 10, 90));
+  ::close(fds[1]);
+
+  auto readBuffer = PagedBuffer<16>(0);
+  sizex total = 0;
+  ptrdiffx result = 0;
+  while ((result = readBuffer.appendFrom(fds[0], 33)) > 0) {
+    total += sizex(result);
+    ASSERT_EQ(total, readBuffer.size());
+  }
+  ::close(fds[0]);
+  ASSERT_EQ(0, result);
+  ASSERT_EQ(90u, readBuffer.size());
+  for (sizex i = 0; i < readBuffer.size(); ++i) {
+    ASSERT_EQ(source[i + 10], readBuffer[i]);
+  }
+
+  // A huge count only grows as far as one readv() can fill
+  ASSERT_EQ(0, ::pipe(fds));
+  ASSERT_EQ(1, ::write(fds[1], "x", 1));
+  ::close(fds[1]);
+  auto hugeRead = PagedBuffer<16>(0);
+  hugeRead.append(source.data(), 3);
+  ASSERT_EQ(1, hugeRead.appendFrom(fds[0], sizex(1) << 30u));
+  ::close(fds[0]);
+  ASSERT_EQ(4u, hugeRead.size());
+  ASSERT_EQ(64u * 16, hugeRead.capacity());
+
+  ASSERT_EQ(-1, readBuffer.writeTo(-1));
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(PagedBufferTest, slices) {
+  using Buffer = PagedBuffer<16>;
+  std::array<byte, 100> source;
+  for (sizex i = 0; i < source.size(); ++i) {
+    source[i] = byte(i);
+  }
+
+  Buffer::Slice whole;
+  Buffer::Slice middle;
+  {
+    Buffer buffer(0);
+    buffer.append(source.data(), source.size());
+
+    // Slices share the pages
+    middle = buffer.slice(10, 40);
+    ASSERT_EQ(40u, middle.size());
+    ASSERT_EQ(4u, middle.segmentCount());
+    const auto& constBuffer = buffer;
+    ASSERT_EQ(&constBuffer[10], &middle[0]);
+    whole = buffer.slice();
+
+    // Writing to the buffer copies the shared page, leaving the slices alone
+    const byte changed = 200;
+    buffer.copyInto(20, &changed, 1);
+    ASSERT_EQ(changed, buffer[20]);
+    ASSERT_EQ(source[20], middle[10]);
+    ASSERT_EQ(source[20], whole[20]);
+    buffer[0] = changed;
+    ASSERT_EQ(source[0], whole[0]);
+  }
+
+  // Slices outlive the buffer, and sub-slices merge back into contiguous segments
+  auto sub = middle.slice(5, 30);
+  ASSERT_EQ(30u, sub.size());
+  Buffer::Slice chained;
+  chained.append(whole.slice(0, 8));
+  chained.append(whole.slice(8, 8));
+  ASSERT_EQ(1u, chained.segmentCount());
+  chained.append(sub);
+  ASSERT_EQ(46u, chained.size());
+
+  std::array<byte, 46> copied;
+  chained.copyFrom(0, copied.data(), copied.size());
+  for (sizex i = 0; i < 16; ++i) {
+    ASSERT_EQ(source[i], copied[i]);
+  }
+  for (sizex i = 0; i < 30; ++i) {
+    ASSERT_EQ(source[i + 15], copied[i + 16]);
+  }
+
+  // Appending adopts whole pages when they line up, and copies otherwise
+  Buffer target(64);
+  target.append(whole.slice(0, 40));
+  const auto& constTarget = target;
+  ASSERT_EQ(&whole[16], &constTarget[16]);
+  ASSERT_EQ(&whole[32], &constTarget[32]);
+  target.append(sub);
+  ASSERT_EQ(70u, target.size());
+  ASSERT_EQ(source[15], target[40]);
+  ASSERT_EQ(source[39], target[64]);
+  ASSERT_NE(&whole[32], &constTarget[32]);  // Copy on write for the shared tail page
+
+  // Copies and moves
+  auto copy = chained;
+  auto moved = std::move(chained);
+  ASSERT_EQ(0u, chained.size());
+  ASSERT_EQ(copy.size(), moved.size());
+  copy = moved;
+  ASSERT_EQ(moved[45], copy[45]);
+
+#if SW_POSIX
+  int fds[2];
+  ASSERT_EQ(0, ::pipe(fds));
+  ASSERT_EQ(46, copy.writeTo(fds[1]));
+  ::close(fds[1]);
+  std::array<byte, 64> readBack;
+  ASSERT_EQ(46, ::read(fds[0], readBack.data(), readBack.size()));
+  ::close(fds[0]);
+  ASSERT_TRUE(std::equal(copied.begin(), copied.end(), readBack.begin()));
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(PagedBufferTest, pooledSlices) {
+  using Pool = PagePool<16>;
+  using Buffer = PagedBuffer<16, false, Pool::Allocator>;
+  auto pool = std::make_shared<Pool>();
+  const std::array<byte, 40> source = {{1, 2, 3}};
+
+  std::vector<Buffer::Slice> slices;
+  {
+    Buffer buffer(0, pool->allocator());
+    buffer.append(source.data(), source.size());
+    for (int i = 0; i < 8; ++i) {
+      slices.push_back(buffer.slice(0, 20));
+    }
+  }
+  pool.reset();
+
+  // Released on other threads, after the buffer and pool are gone
+  std::thread thread([&]() { slices.erase(slices.begin(), slices.begin() + 4); });
+  thread.join();
+  ASSERT_EQ(source[2], slices.back()[2]);
+  slices.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(PagedBufferTest, arenaPages) {
+  using Allocator = ReallocatorPageAllocator<16, ArenaReallocator<byte>>;
+  Arena arena;
+  const std::array<byte, 40> source = {{1, 2, 3}};
+  {
+    PagedBuffer<16, true, Allocator> buffer(0, Allocator(ArenaReallocator<byte>(arena)));
+    buffer.append(source.data(), source.size());
+    ASSERT_EQ(source[2], buffer[2]);
+    ASSERT_EQ(0, buffer[39]);
+  }
+  ASSERT_EQ(1u, arena.blockCount());
+}
+
 SW_NAMESPACE_END
@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#include <sw/path_pool.h>
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <unordered_set>
+
+SW_NAMESPACE_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(PathPoolTest, roundTrip) {
+  PathPool pool;
+  for (const char* str : {"", "/", "foo", "foo/", "/foo/bar/baz.txt", "a/b/c", "./x/../y", "../../..", "//c:",
+                          "//c:/", "//c:/foo/bar", "//net.name.lan/foo/bar", "/foo/bar/"}) {
+    const auto p = pool.intern(str);
+    ASSERT_EQ(std::string(str), p.str()) << str;
+    ASSERT_EQ(PosixPath(str), p.path()) << str;
+    ASSERT_EQ(std::strlen(str), p.size()) << str;
+    ASSERT_EQ(p, pool.intern(PosixPath(str))) << str;
+  }
+
+  // Repeated separators are dropped
+  ASSERT_EQ(pool.intern("foo/bar"), pool.intern("foo//bar"));
+  ASSERT_TRUE(pool.intern("").empty());
+  ASSERT_EQ(InternedPath(), pool.intern(""));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(PathPoolTest, sharing) {
+  PathPool pool;
+  const auto a = pool.intern("/home/user/src/project/main.cpp");
+  ASSERT_EQ(6u, a.depth());
+  ASSERT_EQ(6u, pool.nodeCount());
+
+  const auto b = pool.intern("/home/user/src/project/util.cpp");
+  ASSERT_NE(a, b);
+  ASSERT_EQ(7u, pool.nodeCount());
+  ASSERT_EQ(a.parent_path(), b.parent_path());
+
+  // Same names under a different parent share the name but not the node
+  const auto c = pool.intern("/home/other/src/project/main.cpp");
+  ASSERT_EQ(11u, pool.nodeCount());
+  ASSERT_EQ(8u, pool.nameCount());
+  ASSERT_EQ(a.segment().data(), c.segment().data());
+  ASSERT_NE(a, c);
+
+  ASSERT_EQ(a, pool.intern(PosixPath("/home/user/src/project/main.cpp")));
+  ASSERT_EQ(11u, pool.nodeCount());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(PathPoolTest, navigation) {
+  PathPool pool;
+  const auto root = pool.intern("/usr");
+  const auto lib = pool.child(root, "lib");
+  ASSERT_EQ("/usr/lib", lib.str());
+  ASSERT_EQ(lib, pool.intern("/usr/lib"));
+  ASSERT_EQ(root, lib.parent_path());
+  ASSERT_EQ(pool.intern("/"), root.parent_path());
+  ASSERT_TRUE(pool.intern("/").parent_path().empty());
+  ASSERT_EQ("lib", lib.segment());
+  ASSERT_EQ("/", root.parent_path().segment());
+
+  // A final separator goes away when appending, and its parent is the named path
+  const auto withSep = pool.intern("/usr/lib/");
+  ASSERT_EQ(lib, withSep.parent_path());
+  ASSERT_EQ(pool.intern("/usr/lib/x"), pool.child(withSep, "x"));
+
+  ASSERT_EQ(pool.intern("/usr/lib/a/b"), pool.join(lib, "a/b"));
+  ASSERT_EQ(pool.intern("/etc"), pool.join(lib, "/etc"));
+  ASSERT_EQ(pool.intern("//c:/bar"), pool.join(pool.intern("//c:/foo"), "/bar"));
+  ASSERT_EQ((PosixPath("/usr/lib") / "a/b"), pool.join(lib, "a/b").path());
+  ASSERT_EQ(pool.intern("/usr/lib/.."), pool.child(lib, ".."));
+
+  ASSERT_TRUE(pool.intern("/usr/lib/a/b").isWithin(lib));
+  ASSERT_TRUE(lib.isWithin(lib));
+  ASSERT_TRUE(lib.isWithin(InternedPath()));
+  ASSERT_FALSE(root.isWithin(lib));
+  ASSERT_FALSE(pool.intern("/usr/libs").isWithin(lib));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(PathPoolTest, manyPaths) {
+  PathPool pool;
+  std::vector<InternedPath> paths;
+  std::unordered_set<InternedPath> unique;
+  for (int dir = 0; dir < 100; ++dir) {
+    for (int file = 0; file < 100; ++file) {
+      const auto str = "/data/dir" + std::to_string(dir) + "/file" + std::to_string(file) + ".dat";
+      paths.push_back(pool.intern(str));
+      unique.insert(paths.back());
+    }
+  }
+  ASSERT_EQ(10000u, unique.size());
+  ASSERT_EQ(2u + 100u + 10000u, pool.nodeCount());
+  ASSERT_EQ(2u + 100u + 100u, pool.nameCount());
+
+  // Handles survive the tables growing
+  for (int dir = 0; dir < 100; dir += 7) {
+    for (int file = 0; file < 100; file += 13) {
+      const auto str = "/data/dir" + std::to_string(dir) + "/file" + std::to_string(file) + ".dat";
+      ASSERT_EQ(paths[dir * 100 + file], pool.intern(str));
+      ASSERT_EQ(str, paths[dir * 100 + file].str());
+    }
+  }
+}
+
+SW_NAMESPACE_END
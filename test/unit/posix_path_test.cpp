@@ -17,11 +17,14 @@
 /// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 ////////////////////////////////////////////////////////////////////////////////
 #include <sw/posix_path.h>
+#include <sw/threading_utils.h>
 
 #include <gtest/gtest.h>
 
 #include <iostream>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 SW_NAMESPACE_BEGIN
 
@@ -318,6 +321,15 @@ TEST(PosixPathTest, pathSegmentIterator) {
     ASSERT_EQ((pd::PathSegment{StringView{"/"}, pd::PathSection::FinalSep}), iter.next());
     ASSERT_EQ(iter.end(), iter.next());
   }
+  {
+    // Single character names
+    pd::PathSegmentIterator iter("a/b/cd/");
+    ASSERT_EQ((pd::PathSegment{StringView{"a"}, pd::PathSection::Filename}), iter.begin());
+    ASSERT_EQ((pd::PathSegment{StringView{"b"}, pd::PathSection::Filename}), iter.next());
+    ASSERT_EQ((pd::PathSegment{StringView{"cd"}, pd::PathSection::Filename}), iter.next());
+    ASSERT_EQ((pd::PathSegment{StringView{"/"}, pd::PathSection::FinalSep}), iter.next());
+    ASSERT_EQ(iter.end(), iter.next());
+  }
   {
     pd::PathSegmentIterator iter("../../..");
     ASSERT_EQ((pd::PathSegment{StringView{".."}, pd::PathSection::DotDot}), iter.begin());
@@ -375,6 +387,99 @@ TEST(PosixPathTest, lexicallyNormal) {
   ASSERT_EQ("/foo/bar/foo", PosixPath("/foo/bar/../bar/../bar/foo").lexically_full_normal());
   ASSERT_EQ("//C:/bar/foo", PosixPath("//C:/bar/foo/").lexically_full_normal());
   ASSERT_EQ("//hello/bar/foo", PosixPath("//hello/bar/foo/").lexically_full_normal());
+
+  // Dot-dots take out the segment before them, or go away right after a root dir
+  ASSERT_EQ(".", PosixPath("a/..").lexically_normal());
+  ASSERT_EQ("/", PosixPath("/a/..").lexically_normal());
+  ASSERT_EQ("/", PosixPath("/..").lexically_normal());
+  ASSERT_EQ("/a", PosixPath("/../a").lexically_normal());
+  ASSERT_EQ("a/", PosixPath("a/b/..").lexically_normal());
+  ASSERT_EQ("..", PosixPath("../").lexically_normal());
+  ASSERT_EQ("../..", PosixPath("../a/../..").lexically_normal());
+  ASSERT_EQ("..", PosixPath("foo/bar/../../..").lexically_normal());
+  ASSERT_EQ("c/", PosixPath("a/b/../../c/.").lexically_normal());
+  ASSERT_EQ("//c:/b/", PosixPath("//c:/a/../b/").lexically_normal());
+  ASSERT_EQ("//host/", PosixPath("//host/x/../..").lexically_normal());
+  ASSERT_EQ("//c:", PosixPath("//c:").lexically_normal());
+  ASSERT_EQ("", PosixPath("a/..").lexically_full_normal());
+  ASSERT_EQ("a", PosixPath("a/b/..").lexically_full_normal());
+  ASSERT_EQ("../..", PosixPath("../a/../../").lexically_full_normal());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(PosixPathTest, normalizeInPlace) {
+  PosixPath p("/foo/./bar//baz/../qux.txt");
+  const auto data = p.c_str();
+  p.normalize();
+  ASSERT_EQ("/foo/bar/qux.txt", p);
+  ASSERT_EQ(data, p.c_str());  // Reused the string
+  ASSERT_TRUE(p.is_normalized());
+  ASSERT_EQ("qux.txt", p.filename_view());
+
+  // Already normalized paths are left alone, even if they don't look it
+  PosixPath forced("a/./b");
+  forced.forceNormalized().normalize();
+  ASSERT_EQ("a/./b", forced);
+
+  // Only the flavor that matches normalize() counts as normalized, so normalize() still finishes
+  // the job on the other one
+  auto normal = PosixPath("a/").lexically_normal();
+  auto fullNormal = PosixPath("a/").lexically_full_normal();
+  ASSERT_EQ("a/", normal);
+  ASSERT_EQ("a", fullNormal);
+  ASSERT_EQ(!kPosixPathUseFullNormalization, normal.is_normalized());
+  ASSERT_EQ(kPosixPathUseFullNormalization, fullNormal.is_normalized());
+  ASSERT_EQ(kPosixPathUseFullNormalization ? "a" : "a/", normal.normalize());
+  ASSERT_EQ("a", fullNormal.normalize());
+
+  PosixPath rel("bar/../baz/");
+  rel.absonormize(PosixPath("/home/user"));
+  ASSERT_EQ(kPosixPathUseFullNormalization ? "/home/user/baz" : "/home/user/baz/", rel);
+  ASSERT_TRUE(rel.is_absonorm());
+  ASSERT_EQ(PosixPath("/home/user/"), PosixPath("").absolutize(PosixPath("/home/user")));
+  ASSERT_EQ(PosixPath("/x"), PosixPath("x").absolutize(PosixPath("/")));
+  ASSERT_EQ(PosixPath("/abs"), PosixPath("/abs").absolutize(PosixPath("/home")));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(PosixPathTest, normalizeAll) {
+  std::vector<PosixPath> paths;
+  for (int i = 0; i < 5000; ++i) {
+    paths.emplace_back("dir" + std::to_string(i % 10) + "/./sub/../file" + std::to_string(i));
+  }
+  auto serial = paths;
+  absonormizeAll(serial.data(), serial.size(), PosixPath("/root"));
+  ASSERT_EQ(PosixPath("/root/dir3/file123"), serial[123]);
+
+  // Run the chunks on a few threads, each taking every nth chunk
+  const auto threadedFor = [](sizex count, const auto& task) {
+    std::vector<std::thread> threads;
+    for (sizex t = 0; t < 4; ++t) {
+      threads.emplace_back([&, t] {
+        for (sizex i = t; i < count; i += 4) {
+          task(i);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  };
+  auto parallel = paths;
+  absonormizeAll(parallel.data(), parallel.size(), PosixPath("/root"), threadedFor, 100);
+  ASSERT_EQ(serial, parallel);
+
+  auto normed = paths;
+  normalizeAll(normed.data(), normed.size(), threadedFor);
+  for (sizex i = 0; i < paths.size(); ++i) {
+    ASSERT_EQ(paths[i].lexically_normal(), normed[i]);
+  }
+
+  // The pool fits the parallelFor contract as is
+  WorkStealingPool pool(WorkStealingPool::Config{4});
+  auto pooled = paths;
+  absonormizeAll(pooled.data(), pooled.size(), PosixPath("/root"), pool, 100);
+  ASSERT_EQ(serial, pooled);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -429,4 +534,101 @@ TEST(PosixPathTest, osConvert) {
 #endif
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST(PosixPathTest, hash) {
+  const PosixPath p("/foo/bar/baz.txt");
+  ASSERT_EQ(hash_value(p), std::hash<PosixPath>()(p));
+  ASSERT_EQ(hash_value(p), TransparentStringHash()(p.u8()));
+  ASSERT_NE(hash_value(p), hash_value(PosixPath("/foo/bar/baz.tx")));
+
+  std::unordered_map<PosixPath, int> map;
+  map[p] = 1;
+  map[PosixPath("/foo")] = 2;
+  ASSERT_EQ(1, map[PosixPath("/foo/bar/baz.txt")]);
+  ASSERT_EQ(2, map[PosixPath("/foo")]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Compare the components of `p` against a fresh path, which can't have stale offsets
+static void expectSameComponents(const PosixPath& p) {
+  const PosixPath fresh(p.u8());
+  EXPECT_EQ(fresh.filename_view(), p.filename_view()) << p;
+  EXPECT_EQ(fresh.parent_path_view(), p.parent_path_view()) << p;
+  EXPECT_EQ(fresh.extension_view(), p.extension_view()) << p;
+  EXPECT_EQ(fresh.root_directory_view(), p.root_directory_view()) << p;
+  EXPECT_EQ(fresh.is_absolute(), p.is_absolute()) << p;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(PosixPathTest, offsetCache) {
+  namespace pd = path_detail;
+  {
+    pd::PathOffsetCache<> cache;
+    const std::string str = "/foo/bar.txt";
+    ASSERT_FALSE(cache.cached());
+    const auto offsets = cache.get(str.data(), str.size());
+    ASSERT_TRUE(cache.cached());
+    ASSERT_EQ(5u, offsets.filenamePos);
+    ASSERT_EQ(0u, offsets.rootSepPos);
+    ASSERT_EQ(0u, offsets.rootDirPos);
+    ASSERT_EQ(8u, offsets.extensionPos);
+
+    // Cached values come back even for a different string
+    ASSERT_EQ(8u, cache.get("foo", 3).extensionPos);
+    const auto copy = cache;
+    ASSERT_TRUE(copy.cached());
+    cache.reset();
+    ASSERT_FALSE(cache.cached());
+    ASSERT_EQ(pd::kNoPos, cache.get("foo", 3).extensionPos);
+    ASSERT_EQ(pd::kNoPos, cache.get("foo", 3).rootDirPos);
+  }
+
+  // Every mutation must drop the cached offsets
+  PosixPath p("/foo/bar.txt");
+  expectSameComponents(p);
+  p += ".gz";
+  expectSameComponents(p);
+  p.replace_extension(".bz2");
+  expectSameComponents(p);
+  p.remove_filename();
+  expectSameComponents(p);
+  p /= "baz";
+  expectSameComponents(p);
+  p /= PosixPath();
+  expectSameComponents(p);
+  p.concat(std::string("qux.c"));
+  expectSameComponents(p);
+  p.shorten(2);
+  expectSameComponents(p);
+  p.replace_filename("other.h");
+  expectSameComponents(p);
+  p /= "/abs/path.cpp";
+  expectSameComponents(p);
+
+  PosixPath q("relative.dat");
+  expectSameComponents(q);
+  p.swap(q);
+  expectSameComponents(p);
+  expectSameComponents(q);
+  q = std::move(p);
+  expectSameComponents(p);
+  expectSameComponents(q);
+  q.clear();
+  expectSameComponents(q);
+  q = PosixPath("//c:/dir/file.x");
+  expectSameComponents(q);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(PosixPathTest, iteratorCopiesShareSegments) {
+  const PosixPath p("/foo/bar/baz");
+  auto iter = const_cast<PosixPath&>(p).begin();
+  ASSERT_EQ("/", *iter);
+  auto copy = iter;
+  ASSERT_EQ(&*iter, &*copy);
+  ++copy;
+  ASSERT_EQ("foo", *copy);
+  ASSERT_EQ("/", *iter);
+}
+
 SW_NAMESPACE_END
@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#include <sw/random.h>
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <thread>
+
+#if SW_POSIX
+#  include <sys/wait.h>
+#  include <unistd.h>
+#endif
+
+SW_NAMESPACE_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(RandomTest, chacha20Block) {
+  // RFC 7539 section 2.3.2
+  const u32 input[16] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574, 0x03020100, 0x07060504,
+                         0x0b0a0908, 0x0f0e0d0c, 0x13121110, 0x17161514, 0x1b1a1918, 0x1f1e1d1c,
+                         0x00000001, 0x09000000, 0x4a000000, 0x00000000};
+  const u32 expected[16] = {0xe4e7f110, 0x15593bd1, 0x1fdd0f50, 0xc47120a3, 0xc7f4d1c7, 0x0368c033,
+                            0x9aaa2204, 0x4e6cd4c3, 0x466482d2, 0x09aa9f07, 0x05d7c214, 0xa2028bd9,
+                            0xd19c12b5, 0xb94e16de, 0xe883d0cb, 0x4e3c50a2};
+  u32 output[16];
+  random_detail::chacha20Block(input, output);
+  for (sizex i = 0; i < 16; ++i) {
+    ASSERT_EQ(expected[i], output[i]) << "word " << i;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(RandomTest, streams) {
+  const std::array<u32, 8> key = {{1, 2, 3, 4, 5, 6, 7, 8}};
+  ChaCha20Random a(key, 0);
+  ChaCha20Random b(key, 0);
+  ChaCha20Random c(key, 1);
+  std::set<u64> values;
+  for (sizex i = 0; i < 100; ++i) {
+    const auto value = a();
+    ASSERT_EQ(value, b());
+    ASSERT_NE(value, c());
+    values.insert(value);
+  }
+  ASSERT_EQ(100u, values.size());
+
+  // fill() takes whole words from the same stream, including for the odd tail
+  ChaCha20Random d(key, 0);
+  ChaCha20Random e(key, 0);
+  byte bytes[13];
+  d.fill(bytes, sizeof(bytes));
+  const u64 first = e();
+  const u64 second = e();
+  ASSERT_EQ(0, std::memcmp(bytes, &first, 8));
+  ASSERT_EQ(0, std::memcmp(bytes + 8, &second, 5));
+
+  std::uniform_int_distribution<int> dist(1, 6);
+  for (sizex i = 0; i < 100; ++i) {
+    const int roll = dist(a);
+    ASSERT_TRUE(roll >= 1 && roll <= 6);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(RandomTest, threadRandom) {
+  ASSERT_EQ(&threadRandom(), &threadRandom());
+  const u64 mine = threadRandom()();
+  u64 theirs = 0;
+  ChaCha20Random* theirRandom = nullptr;
+  std::thread([&] {
+    theirRandom = &threadRandom();
+    theirs = threadRandom()();
+  }).join();
+  ASSERT_NE(&threadRandom(), theirRandom);
+  ASSERT_NE(mine, theirs);
+
+#if SW_POSIX
+  // The child must not replay the parent's next values
+  int fds[2];
+  ASSERT_EQ(0, ::pipe(fds));
+  const pid_t pid = ::fork();
+  ASSERT_NE(-1, pid);
+  if (pid == 0) {
+    const u64 value = threadRandom()();
+    const auto written = ::write(fds[1], &value, sizeof(value));
+    ::_exit(written == sizeof(value) ? 0 : 1);
+  }
+  const u64 parentValue = threadRandom()();
+  u64 childValue = 0;
+  ASSERT_EQ(ssize_t(sizeof(childValue)), ::read(fds[0], &childValue, sizeof(childValue)));
+  int status = 0;
+  ::waitpid(pid, &status, 0);
+  ::close(fds[0]);
+  ::close(fds[1]);
+  ASSERT_NE(parentValue, childValue);
+#endif
+}
+
+SW_NAMESPACE_END
@@ -0,0 +1,257 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright 2019 Steven C. Wilson
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+/// and associated documentation files (the "Software"), to deal in the Software without
+/// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+/// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+/// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+/// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+/// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+////////////////////////////////////////////////////////////////////////////////
+#include <sw/sharded_lru_cache.h>
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+SW_NAMESPACE_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ShardedLruCacheTest, putAndGet) {
+  ShardedLruCache<int, std::string, 4> lru(100);
+  ASSERT_TRUE(lru.empty());
+  lru.put(1, "1");
+  lru.put(2, "2");
+  lru.put(3, "3");
+  ASSERT_EQ(3u, lru.size());
+  ASSERT_TRUE(lru.contains(2));
+
+  lru.put(3, "33");
+  std::string str;
+  ASSERT_FALSE(lru.get(4, str));
+  ASSERT_TRUE(lru.get(3, str));
+  ASSERT_EQ("33", str);
+
+  ASSERT_TRUE(lru.visit(1, [](std::string& value) { value += "1"; }));
+  ASSERT_TRUE(lru.get(1, str));
+  ASSERT_EQ("11", str);
+  ASSERT_FALSE(lru.visit(4, [](std::string&) {}));
+
+  ASSERT_EQ(1u, lru.erase(1));
+  ASSERT_EQ(0u, lru.erase(1));
+  ASSERT_EQ(2u, lru.size());
+  lru.clear();
+  ASSERT_TRUE(lru.empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ShardedLruCacheTest, shardLimits) {
+  ShardedLruCache<int, int, 8> lru(16);
+  ASSERT_EQ(16u, lru.maxSize());
+  for (int i = 0; i < 1000; ++i) {
+    lru.put(i, i);
+  }
+  // Each shard holds at most 2 items
+  ASSERT_LE(lru.size(), 16u);
+  ASSERT_GE(lru.size(), 8u);
+
+  // Keys should spread across shards
+  std::vector<int> counts(8, 0);
+  for (int i = 0; i < 1000; ++i) {
+    ++counts[lru.shardIndex(i)];
+  }
+  for (auto count : counts) {
+    ASSERT_GT(count, 50);
+  }
+
+  lru.setMaxSize(8);
+  ASSERT_LE(lru.size(), 8u);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+struct ShardedStringCost {
+  sizex operator()(int, const std::string& value) const { return value.size(); }
+};
+
+TEST(ShardedLruCacheTest, costWeighted) {
+  using Cache = ShardedLruCache<int, std::string, 4, true, ShardedStringCost>;
+  Cache lru(1000, 400);
+  ASSERT_EQ(400u, lru.maxCost());
+  for (int i = 0; i < 100; ++i) {
+    lru.put(i, std::string(10, 'x'));
+  }
+  ASSERT_LE(lru.totalCost(), 400u);
+  ASSERT_GE(lru.totalCost(), 200u);
+
+  lru.put(1000, "y", 50);
+  lru.setMaxCost(40);
+  ASSERT_LE(lru.totalCost(), 40u + 50u);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ShardedLruCacheTest, stats) {
+  using Cache = ShardedLruCacheType<LruCache<int, int, true, LruUnitCost, LruPolicy, true>, 4>;
+  Cache lru(8);
+  for (int i = 0; i < 100; ++i) {
+    lru.put(i, i);
+  }
+  int value = 0;
+  for (int i = 0; i < 100; ++i) {
+    lru.get(i, value);
+  }
+
+  auto stats = lru.stats();
+  ASSERT_EQ(100u, stats.inserts);
+  ASSERT_EQ(100u, stats.hits + stats.misses);
+  ASSERT_EQ(100u - lru.size(), stats.evictions);
+  ASSERT_EQ(lru.size(), stats.hits);
+  lru.resetStats();
+  ASSERT_EQ(0u, lru.stats().inserts);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename Cache>
+void checkBatches(Cache& lru) {
+  std::vector<int> keys;
+  std::vector<int> values;
+  for (int i = 0; i < 64; ++i) {
+    keys.push_back(i);
+    values.push_back(i * 10);
+  }
+  lru.putMany(keys.data(), values.data(), keys.size());
+  ASSERT_EQ(64u, lru.size());
+
+  keys.push_back(1000);
+  std::vector<int> found(keys.size(), -1);
+  std::unique_ptr<bool[]> flags(new bool[keys.size()]);
+  ASSERT_EQ(64u, lru.getMany(keys.data(), keys.size(), found.data(), flags.get()));
+  for (sizex i = 0; i < 64; ++i) {
+    ASSERT_TRUE(flags[i]);
+    ASSERT_EQ(values[i], found[i]);
+  }
+  ASSERT_FALSE(flags[64]);
+  ASSERT_EQ(-1, found[64]);
+}
+
+TEST(ShardedLruCacheTest, batches) {
+  ShardedLruCache<int, int, 4> lru(100);
+  checkBatches(lru);
+
+  ReadMostlyLruCache<int, int, 4> readMostly(100);
+  checkBatches(readMostly);
+
+  // Duplicates in a put batch keep the last value
+  const int keys[] = {7, 7};
+  const int values[] = {1, 2};
+  lru.putMany(keys, values, 2);
+  int value = 0;
+  ASSERT_TRUE(lru.get(7, value));
+  ASSERT_EQ(2, value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ShardedLruCacheTest, noAutoPurge) {
+  ShardedLruCache<int, int, 2, false> lru(2);
+  for (int i = 0; i < 10; ++i) {
+    lru.put(i, i);
+  }
+  ASSERT_EQ(10u, lru.size());
+  lru.purge();
+  ASSERT_LE(lru.size(), 2u);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ShardedLruCacheTest, deferredPromotion) {
+  ReadMostlyLruCache<int, std::string, 1> lru(3);
+  lru.put(1, "1");
+  lru.put(2, "2");
+  lru.put(3, "3");
+
+  // The hit is only recorded. It gets applied before the next put, so 2 is the oldest
+  std::string str;
+  ASSERT_TRUE(lru.get(1, str));
+  ASSERT_EQ("1", str);
+  lru.put(4, "4");
+  ASSERT_TRUE(lru.contains(1));
+  ASSERT_FALSE(lru.contains(2));
+
+  // Overflow the read buffer, which must stay harmless
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_TRUE(lru.get(3, str));
+  }
+  lru.purge();
+  lru.put(5, "5");
+  ASSERT_TRUE(lru.contains(3));
+  ASSERT_FALSE(lru.contains(1));
+  ASSERT_EQ(3u, lru.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ShardedLruCacheTest, threaded) {
+  constexpr int kThreads = 4;
+  constexpr int kKeys = 2000;
+  using Cache = ShardedLruCache<int, int>;
+  Cache lru(kKeys / 2);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&lru, t]() {
+      for (int i = 0; i < kKeys; ++i) {
+        const int key = (i * 7 + t) % kKeys;
+        lru.put(key, key * 2);
+        int value = 0;
+        if (lru.get((key + 1) % kKeys, value)) {
+          ASSERT_EQ(((key + 1) % kKeys) * 2, value);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_LE(lru.size(), lru.maxSize() + Cache::kShardCount);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ShardedLruCacheTest, threadedDeferred) {
+  constexpr int kThreads = 4;
+  constexpr int kKeys = 500;
+  using Cache = ReadMostlyLruCache<int, int, 4>;
+  Cache lru(kKeys / 2);
+  for (int i = 0; i < kKeys; ++i) {
+    lru.put(i, i);
+  }
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&lru, t]() {
+      for (int i = 0; i < 20 * kKeys; ++i) {
+        const int key = (i * 13 + t) % kKeys;
+        int value = -1;
+        if (lru.get(key, value)) {
+          ASSERT_EQ(key, value);
+        }
+        if (i % 50 == t) {
+          lru.put(key, key);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_LE(lru.size(), lru.maxSize() + Cache::kShardCount);
+}
+
+SW_NAMESPACE_END
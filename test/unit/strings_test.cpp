@@ -20,6 +20,9 @@
 
 #include <gtest/gtest.h>
 
+#include <unordered_map>
+#include <unordered_set>
+
 SW_NAMESPACE_BEGIN
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -102,4 +105,113 @@ TEST(StringsTest, startsWith) {
   ASSERT_FALSE(sw::startsWith(sv, "foobar.exef"));
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST(StringsTest, transparentHash) {
+  const std::string str = "foobar";
+  const char buffer[] = "foobar-baz";
+  const StringView sv(buffer, 6);
+  const StringWrapper sw(str);
+
+  TransparentStringHash hash;
+  ASSERT_EQ(hash(str), hash(sv));
+  ASSERT_EQ(hash(str), hash(sw));
+  ASSERT_EQ(hash(str), hash("foobar"));
+  ASSERT_NE(hash(str), hash(StringView(buffer, 7)));
+
+  TransparentStringEqual equal;
+  ASSERT_TRUE(equal(str, sv));
+  ASSERT_TRUE(equal(sw, "foobar"));
+  ASSERT_FALSE(equal(str, StringView(buffer, 7)));
+  ASSERT_FALSE(equal("foo", sv));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(StringsTest, bytesEqual) {
+  // Cover each of the short, vector and memcmp paths with a difference at every position
+  for (sizex size = 0; size <= 100; ++size) {
+    std::string a(size, 'x');
+    std::string b(size, 'x');
+    for (sizex i = 0; i < size; ++i) {
+      a[i] = char('a' + i % 26);
+      b[i] = a[i];
+    }
+    ASSERT_TRUE(strings_detail::bytesEqual(a.data(), b.data(), size)) << size;
+    for (sizex i = 0; i < size; ++i) {
+      b[i] = '#';
+      ASSERT_FALSE(strings_detail::bytesEqual(a.data(), b.data(), size)) << size << " " << i;
+      b[i] = a[i];
+    }
+  }
+
+  const std::string longStr(200, 'q');
+  ASSERT_TRUE(endsWith(longStr, std::string(100, 'q')));
+  ASSERT_FALSE(endsWith(longStr, std::string(99, 'q') + "r"));
+  ASSERT_TRUE(startsWith(StringView(longStr), StringView(longStr.data(), 64)));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(StringsTest, hashBytes) {
+  // Equal strings hash the same no matter which type holds them
+  const std::string str = "some/longer/path/that/takes/the/long/loop.txt";
+  ASSERT_EQ(hashBytes(str.data(), str.size()), std::hash<StringView>()(StringView(str)));
+  ASSERT_EQ(hashBytes(str.data(), str.size()), std::hash<StringWrapper>()(StringWrapper(str)));
+  ASSERT_EQ(TransparentStringHash()(str), std::hash<StringView>()(StringView(str)));
+  ASSERT_NE(hashBytes(str.data(), str.size()), hashBytes(str.data(), str.size(), 1));
+
+  // Pinned values, which every platform must match. Covers each input length path
+  if (sizeof(sizex) == 8) {
+    std::string alphabet;
+    for (int i = 0; i < 100; ++i) {
+      alphabet.push_back(char('a' + i % 26));
+    }
+    ASSERT_EQ(sizex(0x93228a4de0eec5a2_u64), hashBytes(alphabet.data(), 0));
+    ASSERT_EQ(sizex(0x989b4a209c1011c9_u64), hashBytes(alphabet.data(), 3));
+    ASSERT_EQ(sizex(0xb9a4994f5b68615c_u64), hashBytes(alphabet.data(), 8));
+    ASSERT_EQ(sizex(0x03a21907281306e8_u64), hashBytes(alphabet.data(), 20));
+    ASSERT_EQ(sizex(0xaae7edd1c324f48b_u64), hashBytes(alphabet.data(), 100));
+  }
+
+  // Every prefix of one buffer should hash differently, which exercises all the length paths
+  std::string buffer(300, '\0');
+  for (sizex i = 0; i < buffer.size(); ++i) {
+    buffer[i] = char(i * 7);
+  }
+  std::unordered_set<sizex> hashes;
+  for (sizex size = 0; size <= buffer.size(); ++size) {
+    hashes.insert(hashBytes(buffer.data(), size));
+  }
+  ASSERT_EQ(buffer.size() + 1, hashes.size());
+
+  // Single bit flips should change the hash, and roughly half the output bits
+  for (sizex size : {1_z, 3_z, 8_z, 16_z, 17_z, 47_z, 48_z, 100_z}) {
+    const sizex base = hashBytes(buffer.data(), size);
+    sizex flippedBits = 0;
+    for (sizex bit = 0; bit < size * 8; ++bit) {
+      std::string copy = buffer.substr(0, size);
+      copy[bit / 8] = char(copy[bit / 8] ^ (1 << (bit % 8)));
+      const sizex h = hashBytes(copy.data(), size);
+      ASSERT_NE(base, h) << size << " " << bit;
+      flippedBits += sizex(__builtin_popcountll(base ^ h));
+    }
+    const double average = double(flippedBits) / double(size * 8);
+    ASSERT_GT(average, 20.0) << size;
+    ASSERT_LT(average, 44.0) << size;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(StringsTest, stdHashKeys) {
+  const char buffer[] = "alpha beta gamma";
+  std::unordered_map<StringView, int> map;
+  map[StringView(buffer, 5)] = 1;
+  map[StringView(buffer + 6, 4)] = 2;
+  map[StringView(buffer + 11, 5)] = 3;
+
+  const std::string beta = "beta";
+  ASSERT_EQ(3u, map.size());
+  ASSERT_EQ(2, map[beta]);
+  ASSERT_EQ(1, map.at("alpha"));
+  ASSERT_EQ(0u, map.count("delta"));
+}
+
 SW_NAMESPACE_END
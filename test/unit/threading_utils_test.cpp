@@ -20,7 +20,14 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
 #include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 SW_NAMESPACE_BEGIN
 
@@ -85,6 +92,92 @@ TEST(VersionedValueCacheTest, basic) {
   ASSERT_EQ(2, stringValueCache.copyCount());
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST(VersionedValueCacheTest, staleCheckin) {
+  std::mutex testMutex;
+  VersionedValueCache<std::string, std::mutex, std::lock_guard<std::mutex>> stringValueCache(testMutex);
+  stringValueCache.setValue("v1");
+
+  // Copies outstanding across a version change are just dropped, explicitly or not
+  {
+    auto valueCopy = stringValueCache.checkout();
+    auto valueCopy2 = stringValueCache.checkout();
+    stringValueCache.setValue("v2");
+    stringValueCache.checkin(std::move(valueCopy));
+    ASSERT_EQ("v1", valueCopy2.value());
+  }
+  ASSERT_EQ(0, stringValueCache.copyCount());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(VersionedValueCacheTest, perThread) {
+  using Cache = VersionedValueCache<std::string, std::mutex, std::lock_guard<std::mutex>>;
+  std::mutex testMutex;
+  Cache stringValueCache(testMutex, Cache::VersionedCopies::PerThread);
+  stringValueCache.setValue("Hello World", 1);
+  ASSERT_EQ(1, stringValueCache.copyCount());
+
+  // The first checkin lands in this thread's slot, and after that the shared list isn't used
+  {
+    auto valueCopy = stringValueCache.checkout();
+    ASSERT_EQ(0, stringValueCache.copyCount());
+    ASSERT_EQ("Hello World", valueCopy.value());
+  }
+  ASSERT_EQ(0, stringValueCache.copyCount());
+  for (int i = 0; i < 3; ++i) {
+    auto valueCopy = stringValueCache.checkout();
+    ASSERT_EQ("Hello World", valueCopy.value());
+    ASSERT_EQ(0, stringValueCache.copyCount());
+  }
+
+  // A nested checkout makes a copy, which goes to the shared list since the slot is full again
+  {
+    auto valueCopy = stringValueCache.checkout();
+    {
+      auto valueCopy2 = stringValueCache.checkout();
+      ASSERT_EQ("Hello World", valueCopy2.value());
+    }
+    ASSERT_EQ(0, stringValueCache.copyCount());
+  }
+  ASSERT_EQ(1, stringValueCache.copyCount());
+
+  // A new version makes the thread's copy stale
+  stringValueCache.setValue("Hello World v2");
+  {
+    auto valueCopy = stringValueCache.checkout();
+    ASSERT_EQ("Hello World v2", valueCopy.value());
+  }
+  {
+    auto valueCopy = stringValueCache.checkout();
+    ASSERT_EQ("Hello World v2", valueCopy.value());
+    stringValueCache.setValue("Hello World v3");
+  }
+  ASSERT_EQ(0, stringValueCache.copyCount());
+  ASSERT_EQ("Hello World v3", stringValueCache.checkout().value());
+
+  // Each thread gets its own copy, and sees new versions
+  std::vector<std::thread> threads;
+  std::atomic<bool> failed{false};
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < 1000; ++i) {
+        auto valueCopy = stringValueCache.checkout();
+        if (valueCopy.value().compare(0, 11, "Hello World") != 0) {
+          failed = true;
+        }
+      }
+    });
+  }
+  for (int i = 0; i < 10; ++i) {
+    stringValueCache.setValue("Hello World v" + std::to_string(i + 4));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_FALSE(failed);
+  ASSERT_EQ("Hello World v13", stringValueCache.checkout().value());
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST(VersionedValueCacheTest, atomicSharedValue) {
   std::mutex testMutex;
@@ -113,4 +206,283 @@ TEST(VersionedValueCacheTest, atomicSharedValue) {
   ASSERT_NE(*getV1, *getV3);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST(BoundedMpscQueueTest, basic) {
+  BoundedMpscQueue<std::string> queue(3);
+  ASSERT_EQ(4u, queue.capacity());
+  ASSERT_TRUE(queue.empty());
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(queue.tryPush([&](std::string& value) { value = std::to_string(i); }));
+  }
+  ASSERT_FALSE(queue.tryPush([](std::string&) { FAIL(); }));
+  ASSERT_EQ(4u, queue.size());
+
+  std::string value;
+  ASSERT_TRUE(queue.tryPop([&](std::string& cell) { value = cell; }));
+  ASSERT_EQ("0", value);
+  ASSERT_TRUE(queue.tryPush([](std::string& cell) { cell = "4"; }));
+  for (int i = 1; i < 5; ++i) {
+    ASSERT_TRUE(queue.tryPop([&](std::string& cell) { value = cell; }));
+    ASSERT_EQ(std::to_string(i), value);
+  }
+  ASSERT_FALSE(queue.tryPop([](std::string&) { FAIL(); }));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(BoundedMpscQueueTest, threaded) {
+  constexpr int kThreads = 4;
+  constexpr int kCount = 10000;
+  BoundedMpscQueue<int> queue(64);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&queue, t]() {
+      for (int i = 0; i < kCount; ++i) {
+        while (!queue.tryPush([&](int& cell) { cell = t * kCount + i; })) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // Each producer's values come out in order
+  std::vector<int> next(kThreads, 0);
+  for (int popped = 0; popped < kThreads * kCount;) {
+    queue.tryPop([&](int value) {
+      const auto t = value / kCount;
+      ASSERT_EQ(next[t], value % kCount);
+      ++next[t];
+      ++popped;
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_TRUE(queue.empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ThreadLocalValueTest, basic) {
+  auto value = std::make_unique<ThreadLocalValue<int>>();
+  ThreadLocalValue<int> other;
+  value->get() = 1;
+  other.get() = 2;
+  ASSERT_EQ(1, value->get());
+  ASSERT_EQ(2, other.get());
+
+  std::thread thread([&]() {
+    // find() never creates one
+    ASSERT_EQ(nullptr, value->find());
+    ASSERT_EQ(nullptr, value->find());
+    ASSERT_EQ(0, value->get());
+    ASSERT_EQ(&value->get(), value->find());
+    ASSERT_EQ(7, other.get([]() { return std::make_unique<int>(7); }));
+  });
+  thread.join();
+  ASSERT_EQ(1, value->get());
+
+  // A new owner never sees a dead owner's value, even at the same address
+  value.reset();
+  value = std::make_unique<ThreadLocalValue<int>>();
+  ASSERT_EQ(0, value->get());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ReadMostlySharedValueTest, basic) {
+  ReadMostlySharedValue<std::string> value;
+  ASSERT_FALSE(value.read());
+  ASSERT_EQ(nullptr, value.snapshot());
+
+  value.set(std::make_unique<std::string>("first"));
+  {
+    const auto guard = value.read();
+    ASSERT_EQ("first", *guard);
+    ASSERT_EQ(5u, guard->size());
+
+    // Nested reads see the same value
+    const auto nested = value.read();
+    ASSERT_EQ(guard.get(), nested.get());
+  }
+
+  // A snapshot outlives the value being replaced
+  const auto snapshot = value.snapshot();
+  value.set(std::make_unique<std::string>("second"));
+  ASSERT_EQ("first", *snapshot);
+  ASSERT_EQ("second", *value.read());
+
+  // Another thread's guard keeps the old value alive until it's released
+  std::atomic<int> stage{0};
+  std::thread reader([&]() {
+    const auto guard = value.read();
+    stage = 1;
+    while (stage != 2) {
+      std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_EQ("second", *guard);
+    stage = 3;
+  });
+  while (stage != 1) {
+    std::this_thread::yield();
+  }
+  stage = 2;
+  value.set(std::make_unique<std::string>("third"));
+  ASSERT_EQ(3, stage.load());
+  reader.join();
+  ASSERT_EQ("third", *value.read());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ReadMostlySharedValueTest, threaded) {
+  // Each value is a run of the same number. A reader seeing a mixed run would mean it read
+  // a value that was being freed or written.
+  const auto makeValue = [](int n) { return std::make_unique<std::vector<int>>(64, n); };
+  ReadMostlySharedValue<std::vector<int>> value(makeValue(0));
+
+  std::atomic<bool> done{false};
+  std::atomic<int> badReads{0};
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&]() {
+      int last = 0;
+      while (!done) {
+        const auto guard = value.read();
+        const auto first = guard->front();
+        for (const auto n : *guard) {
+          if (n != first) {
+            ++badReads;
+          }
+        }
+        if (first < last) {
+          ++badReads;
+        }
+        last = first;
+      }
+    });
+  }
+  for (int i = 1; i <= 2000; ++i) {
+    value.set(makeValue(i));
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  ASSERT_EQ(0, badReads.load());
+  ASSERT_EQ(2000, value.read()->front());
+
+  // Threads that have exited give their slots back for new threads
+  for (int i = 0; i < 8; ++i) {
+    std::thread([&]() { ASSERT_EQ(2000, value.read()->back()); }).join();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(WorkStealingPoolTest, inlineTask) {
+  auto counter = std::make_shared<int>(0);
+  {
+    pool_detail::InlineTask task;
+    ASSERT_FALSE(task);
+    task.assign([counter]() { ++*counter; });
+    ASSERT_EQ(2, counter.use_count());
+
+    pool_detail::InlineTask moved(std::move(task));
+    ASSERT_FALSE(task);
+    ASSERT_TRUE(moved);
+    moved();
+    ASSERT_EQ(1, *counter);
+
+    task = std::move(moved);
+    task();
+    ASSERT_EQ(2, *counter);
+    ASSERT_EQ(2, counter.use_count());
+  }
+  ASSERT_EQ(1, counter.use_count());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(WorkStealingPoolTest, parallelFor) {
+  WorkStealingPool pool(WorkStealingPool::Config{4});
+  ASSERT_EQ(4, pool.threadCount());
+  pool.parallelFor(0, [](sizex) { FAIL(); });
+
+  // Every index exactly once
+  std::vector<std::atomic<int>> hits(10000);
+  pool.parallelFor(hits.size(), [&](sizex i) { ++hits[i]; });
+  for (const auto& hit : hits) {
+    ASSERT_EQ(1, hit.load());
+  }
+
+  // Nested, from inside the workers
+  std::atomic<sizex> total{0};
+  pool.parallelFor(16, [&](sizex) {
+    pool.parallelFor(100, [&](sizex i) { total += i; });
+  });
+  ASSERT_EQ(16 * 4950, total.load());
+
+  // The first exception comes back to the caller
+  ASSERT_THROW(pool.parallelFor(1000,
+                                [](sizex i) {
+                                  if (i == 500) {
+                                    throw std::runtime_error("500");
+                                  }
+                                }),
+               std::runtime_error);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(WorkStealingPoolTest, groups) {
+  // Tiny deques, so most submits overflow to the caller
+  WorkStealingPool::Config config;
+  config.threadCount = 2;
+  config.queueCapacity = 2;
+  config.pinThreads = true;
+  WorkStealingPool pool(config);
+
+  std::atomic<int> ran{0};
+  TaskGroup group;
+  for (int i = 0; i < 1000; ++i) {
+    pool.submit(group, [&]() {
+      ++ran;
+      std::this_thread::yield();
+    });
+  }
+  pool.wait(group);
+  ASSERT_TRUE(group.done());
+  ASSERT_EQ(1000, ran.load());
+
+  // Tasks adding more tasks to their group
+  ran = 0;
+  for (int i = 0; i < 10; ++i) {
+    pool.submit(group, [&]() {
+      for (int j = 0; j < 10; ++j) {
+        pool.submit(group, [&]() { ++ran; });
+      }
+    });
+  }
+  pool.wait(group);
+  ASSERT_EQ(100, ran.load());
+
+  pool.submit(group, []() { throw std::runtime_error("failed"); });
+  ASSERT_THROW(pool.wait(group), std::runtime_error);
+  pool.wait(group);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(WorkStealingPoolTest, fireAndForget) {
+  std::atomic<int> ran{0};
+  {
+    WorkStealingPool pool(WorkStealingPool::Config{3});
+    for (int i = 0; i < 5000; ++i) {
+      pool.submit([&]() { ++ran; });
+    }
+    // Let the workers go idle, then wake them again
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    for (int i = 0; i < 5000; ++i) {
+      pool.submit([&]() { ++ran; });
+    }
+  }
+  // Destruction runs what's left
+  ASSERT_EQ(10000, ran.load());
+}
+
 SW_NAMESPACE_END
@@ -21,6 +21,8 @@
 #include <gtest/gtest.h>
 
 #include <array>
+#include <random>
+#include <vector>
 
 SW_NAMESPACE_BEGIN
 
@@ -48,6 +50,98 @@ TEST(UtilsTest, testSplitString) {
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST(UtilsTest, testSplitStringView) {
+  auto subs = std::vector<std::string>{};
+  const auto collect = [&](StringView s) { subs.emplace_back(toString(s)); };
+  ASSERT_EQ(0u, utils::splitStringView("", ':', collect));
+  ASSERT_EQ(6u, utils::splitStringView(":foo::bar:foobar:", ':', collect));
+  ASSERT_EQ(subs, (std::vector<std::string>{"", "foo", "", "bar", "foobar", ""}));
+
+  // Views point into the source, and embedded NULs are regular chars
+  const std::string source("ab\0c:d", 6);
+  std::vector<StringView> views;
+  utils::splitStringView(source, ':', [&](StringView s) { views.push_back(s); });
+  ASSERT_EQ(2u, views.size());
+  ASSERT_EQ(source.data(), views[0].data());
+  ASSERT_EQ(4u, views[0].size());
+  ASSERT_EQ("d", views[1]);
+
+  // Same results as splitString for NUL free input
+  std::mt19937 engine(3);
+  for (sizex i = 0; i < 200; ++i) {
+    std::string str(engine() % 40, 'x');
+    for (auto& c : str) {
+      c = "ab:"[engine() % 3];
+    }
+    std::vector<std::string> expected;
+    utils::splitString(str, ':', [&](std::string&& s) { expected.emplace_back(std::move(s)); });
+    subs.clear();
+    utils::splitStringView(str, ':', collect);
+    ASSERT_EQ(expected, subs) << str;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(UtilsTest, testStringTokenizer) {
+  const auto tokenize = [](const StringView& source, const StringView& delimiters, utils::EmptyTokens mode) {
+    std::vector<std::string> tokens;
+    auto tokenizer = utils::StringTokenizer(source, delimiters, mode);
+    StringView token;
+    while (tokenizer.next(token)) {
+      tokens.emplace_back(toString(token));
+    }
+    return tokens;
+  };
+  using Tokens = std::vector<std::string>;
+  using utils::EmptyTokens;
+
+  ASSERT_EQ(tokenize("a,b;;c", ",;", EmptyTokens::Keep), (Tokens{"a", "b", "", "c"}));
+  ASSERT_EQ(tokenize(";a,b;;c,", ",;", EmptyTokens::Skip), (Tokens{"a", "b", "c"}));
+  ASSERT_EQ(tokenize("a b", "", EmptyTokens::Keep), (Tokens{"a b"}));
+  ASSERT_EQ(tokenize("", ",", EmptyTokens::Keep), Tokens{});
+  ASSERT_EQ(tokenize(",,,", ",", EmptyTokens::Skip), Tokens{});
+
+  // rest() is what's left after the last token handed out
+  auto tokenizer = utils::StringTokenizer("key=value=more", "=");
+  StringView token;
+  ASSERT_TRUE(tokenizer.next(token));
+  ASSERT_EQ("key", token);
+  ASSERT_EQ("value=more", tokenizer.rest());
+
+  // Every path (memchr, vector, lookup table) against a simple reference, with delimiters landing
+  // on both sides of 16-char blocks
+  std::mt19937 engine(5);
+  for (const StringView delimiters : {StringView(","), StringView(",;"), StringView(" \t,;|:\xff"),
+                                      StringView("0123456789,;")}) {
+    for (sizex i = 0; i < 300; ++i) {
+      std::string str(engine() % 80, 'x');
+      for (auto& c : str) {
+        const auto r = engine() % 20;
+        c = r < delimiters.size() ? delimiters[r] : char('a' + r);
+      }
+      for (auto mode : {EmptyTokens::Keep, EmptyTokens::Skip}) {
+        Tokens expected;
+        std::string current;
+        for (char c : str) {
+          if (std::find(delimiters.begin(), delimiters.end(), c) != delimiters.end()) {
+            if (mode == EmptyTokens::Keep || !current.empty()) {
+              expected.push_back(current);
+            }
+            current.clear();
+          } else {
+            current.push_back(c);
+          }
+        }
+        if (!str.empty() && (mode == EmptyTokens::Keep || !current.empty())) {
+          expected.push_back(current);
+        }
+        ASSERT_EQ(expected, tokenize(str, delimiters, mode)) << str;
+      }
+    }
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST(UtilsTest, testFormatInto) {
   constexpr sizex kBufSize = 20;
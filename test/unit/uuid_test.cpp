@@ -16,13 +16,17 @@
 /// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 /// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 ////////////////////////////////////////////////////////////////////////////////
+#include <sw/lru_cache.h>
 #include <sw/strings.h>
 #include <sw/uuid.h>
 
 #include <gtest/gtest.h>
 
+#include <chrono>
 #include <iostream>
 #include <sstream>
+#include <unordered_set>
+#include <vector>
 
 SW_NAMESPACE_BEGIN
 
@@ -65,4 +69,134 @@ TEST(UuidTest, testCreate) {
   std::cout << "real uuid=" << u0 << std::endl;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST(UuidTest, testFromString) {
+  std::array<u8, 16> u1data = {{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 255}};
+  const auto u1 = Uuid(u1data);
+
+  Uuid parsed;
+  ASSERT_TRUE(Uuid::fromString("01020304-0506-0708-090a-0b0c0d0e0fff", parsed));
+  ASSERT_EQ(u1, parsed);
+  parsed = Uuid();
+  ASSERT_TRUE(Uuid::fromString(std::string("01020304-0506-0708-090A-0B0C0D0E0FFF"), parsed));
+  ASSERT_EQ(u1, parsed);
+
+  char chars[Uuid::kStringSize];
+  ASSERT_EQ(chars + Uuid::kStringSize, u1.toChars(chars));
+  ASSERT_EQ(std::string(chars, Uuid::kStringSize), "01020304-0506-0708-090a-0b0c0d0e0fff");
+
+  // Malformed strings leave the result alone
+  parsed = Uuid();
+  ASSERT_FALSE(Uuid::fromString("01020304-0506-0708-090a-0b0c0d0e0ff", parsed));
+  ASSERT_FALSE(Uuid::fromString("01020304-0506-0708-090a-0b0c0d0e0fff0", parsed));
+  ASSERT_FALSE(Uuid::fromString("010203040-506-0708-090a-0b0c0d0e0fff", parsed));
+  ASSERT_FALSE(Uuid::fromString("0102030405060708090a0b0c0d0e0fff", parsed));
+  ASSERT_FALSE(parsed.isValid());
+
+  // Every hex position must reject the chars bordering the hex ranges
+  const std::string good = u1.toString();
+  for (sizex i = 0; i < good.size(); ++i) {
+    if (good[i] == '-') {
+      continue;
+    }
+    for (char bad : {'/', ':', '@', 'G', '`', 'g', ' ', '\0', char(0xc1)}) {
+      auto corrupt = good;
+      corrupt[i] = bad;
+      ASSERT_FALSE(Uuid::fromString(corrupt, parsed)) << corrupt;
+    }
+  }
+
+  for (sizex i = 0; i < 100; ++i) {
+    const auto u = Uuid::create();
+    ASSERT_TRUE(Uuid::fromString(u.toString(), parsed));
+    ASSERT_EQ(u, parsed);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(UuidTest, testFromBase64) {
+  for (sizex i = 0; i < 100; ++i) {
+    const auto u = Uuid::create();
+    Uuid parsed;
+    ASSERT_TRUE(Uuid::fromBase64(u.toBase64(), parsed));
+    ASSERT_EQ(u, parsed);
+    ASSERT_TRUE(Uuid::fromBase64(u.toBase64().substr(0, 22), parsed));
+    ASSERT_EQ(u, parsed);
+    parsed = Uuid();
+    ASSERT_TRUE(Uuid::fromBase64Url(u.toBase64Url(), parsed));
+    ASSERT_EQ(u, parsed);
+  }
+
+  Uuid parsed;
+  ASSERT_FALSE(Uuid::fromBase64("AQIDBAUGBwgJCgsMDQ4P", parsed));  // Too short
+  ASSERT_FALSE(Uuid::fromBase64("AQIDBAUGBwgJCgsMDQ4P_w", parsed));  // Wrong alphabet
+  ASSERT_TRUE(Uuid::fromBase64("AQIDBAUGBwgJCgsMDQ4P/w==", parsed));
+  ASSERT_EQ(parsed.toString(), "01020304-0506-0708-090a-0b0c0d0e0fff");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(UuidTest, testHash) {
+  // Nearby uuids, differing in just a few bits, still spread across the low bits buckets use
+  std::unordered_set<Uuid> uuids;
+  std::unordered_set<sizex> lowBits;
+  std::array<u8, 16> data = {};
+  for (u32 i = 0; i < 1024; ++i) {
+    data[15] = u8(i);
+    data[6] = u8(i >> 8u);
+    const auto u = Uuid(data);
+    ASSERT_EQ(std::hash<Uuid>()(u), u.hash());
+    uuids.insert(u);
+    lowBits.insert(u.hash() & 0xfff);
+  }
+  ASSERT_EQ(1024u, uuids.size());
+  ASSERT_GT(lowBits.size(), 800u);
+
+  LruCache<Uuid, int> lru(4);
+  const auto key = Uuid::create();
+  lru.put(key, 7);
+  ASSERT_TRUE(lru.contains(key));
+  ASSERT_EQ(7, *lru.peek(key));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(UuidTest, testCreateV7) {
+  using namespace std::chrono;
+  const auto before = u64(duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count());
+  const auto u = Uuid::createV7();
+  ASSERT_EQ(7u, u.version());
+  ASSERT_EQ(0x80u, u.bytes()[8] & 0xc0u);  // RFC variant
+
+  u64 ms = 0;
+  for (sizex i = 0; i < 6; ++i) {
+    ms = (ms << 8u) | u.bytes()[i];
+  }
+  ASSERT_GE(ms, before);
+  ASSERT_LE(ms, before + 1000);
+
+  // Strictly increasing within a thread, even well past 4096 per millisecond
+  auto last = u;
+  for (sizex i = 0; i < 20000; ++i) {
+    const auto next = Uuid::createV7();
+    ASSERT_LT(last, next);
+    last = next;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(UuidTest, testCreateBatch) {
+  std::vector<Uuid> uuids(50000);
+  Uuid::createBatch(uuids.data(), uuids.size());
+  const auto after = Uuid::createV7();
+  std::unordered_set<Uuid> unique;
+  for (sizex i = 0; i < uuids.size(); ++i) {
+    ASSERT_EQ(7u, uuids[i].version());
+    if (i > 0) {
+      ASSERT_LT(uuids[i - 1], uuids[i]);
+    }
+    unique.insert(uuids[i]);
+  }
+  ASSERT_EQ(uuids.size(), unique.size());
+  ASSERT_LT(uuids.back(), after);
+}
+
 SW_NAMESPACE_END
@@ -22,6 +22,7 @@
 #include <gtest/gtest.h>
 
 #include <iostream>
+#include <memory>
 #include <random>
 #include <string>
 #include <vector>
@@ -321,4 +322,233 @@ TEST(VectorTest, nonTrivialVecPerf) {
 }
 #endif
 
+TEST(VectorTest, arenaReallocator) {
+  alignas(std::max_align_t) byte scratch[1024];
+  Arena arena(scratch, sizeof(scratch), 4096);
+
+  // The most recent allocation grows in place
+  using ArenaVector = Vector<u32, ArenaReallocator<u32>>;
+  ArenaVector values{ArenaReallocator<u32>(arena)};
+  values.reserve(4);
+  values.push_back(1);
+  const auto first = values.data();
+  ASSERT_EQ(reinterpret_cast<u32*>(scratch), first);
+  values.reserve(200);
+  ASSERT_EQ(first, values.data());
+  ASSERT_EQ(0u, arena.capacity() - sizeof(scratch));
+
+  // Outgrowing the initial buffer moves to a heap block
+  values.reserve(1000);
+  ASSERT_NE(first, values.data());
+  ASSERT_EQ(1u, values[0]);
+  ASSERT_EQ(2u, arena.blockCount());
+
+  // Copies and moves keep the arena
+  auto copy = values;
+  ASSERT_EQ(&arena, &copy.get_allocator().arena());
+  auto moved = std::move(copy);
+  ASSERT_EQ(1u, moved[0]);
+  copy = std::move(moved);
+
+  // Non-trivial types move when they can't grow in place
+  Vector<std::string, ArenaReallocator<std::string>> strings{ArenaReallocator<std::string>(arena)};
+  strings.reserve(1);
+  strings.push_back("a fairly long string to dodge the small string buffer");
+  auto wedge = arena.allocate(8);
+  ASSERT_NE(nullptr, wedge);
+  strings.reserve(2);
+  strings.push_back("b");
+  ASSERT_EQ("a fairly long string to dodge the small string buffer", strings[0]);
+  strings.clear();
+
+  // After a reset the blocks are reused, with no new mallocs once warmed up
+  arena.reset();
+  { ArenaVector warmup(2000_z, ArenaReallocator<u32>(arena)); }
+  const auto blocks = arena.blockCount();
+  for (int i = 0; i < 3; ++i) {
+    arena.reset();
+    ArenaVector scratchValues(2000_z, ArenaReallocator<u32>(arena));
+    ASSERT_EQ(blocks, arena.blockCount());
+  }
+  arena.release();
+  ASSERT_EQ(1u, arena.blockCount());
+}
+
+TEST(VectorTest, largeReallocator) {
+  using Reallocator = LargeReallocator<u64, 64 * 1024, true>;
+  ASSERT_FALSE(Reallocator::isMapped(8191));
+  ASSERT_TRUE(Reallocator::isMapped(8192));
+
+  // Grows from malloc, across the threshold, and on through remapping
+  Vector<u64, Reallocator> values;
+  values.reserve(16);
+  for (u64 i = 0; i < 1000000; ++i) {
+    values.push_back(i);
+  }
+  ASSERT_GE(values.capacity(), 1000000u);
+  for (u64 i = 0; i < values.size(); i += 997) {
+    ASSERT_EQ(i, values[i]);
+  }
+
+  // Back down below the threshold
+  Reallocator reallocator;
+  auto data = reallocator.allocate(10000);
+  data[9999] = 7;
+  data[99] = 3;
+  data = reallocator.reallocate(data, 100, 10000, 100);
+  ASSERT_EQ(3u, data[99]);
+  reallocator.deallocate(data, 100);
+}
+
+TEST(VectorTest, smallVector) {
+  // No Vector& to it, so nothing can slice off a pointer-stealing move
+  using InlineVector = Vector<int, InlineReallocator<int, 4, DefaultVectorReallocator<int>>>;
+  static_assert(!std::is_convertible<SmallVector<int, 4>&, InlineVector&>::value, "Vector base is reachable");
+
+  SmallVector<int, 4> values;
+  ASSERT_EQ(4u, values.capacity());
+  ASSERT_TRUE(values.isInline());
+  const auto inlineData = values.data();
+  for (int i = 0; i < 4; ++i) {
+    values.push_back(i);
+  }
+  ASSERT_EQ(inlineData, values.data());
+
+  // Inline moves and copies move the items
+  auto copy = values;
+  ASSERT_TRUE(copy.isInline());
+  ASSERT_NE(values.data(), copy.data());
+  auto moved = std::move(copy);
+  ASSERT_TRUE(moved.isInline());
+  ASSERT_EQ(0u, copy.size());
+  ASSERT_EQ(3, moved[3]);
+
+  // Overflow goes to the heap, and moves take the memory
+  values.push_back(4);
+  ASSERT_FALSE(values.isInline());
+  const auto heapData = values.data();
+  SmallVector<int, 4> taken(std::move(values));
+  ASSERT_EQ(heapData, taken.data());
+  ASSERT_EQ(5u, taken.size());
+  ASSERT_TRUE(values.isInline());
+  values.push_back(9);
+  ASSERT_EQ(9, values[0]);
+
+  moved = std::move(taken);
+  ASSERT_EQ(heapData, moved.data());
+  taken = moved;
+  ASSERT_EQ(4, taken.back());
+  taken.pop_back();
+  ASSERT_EQ(4u, taken.size());
+
+  // Non-trivial items
+  TrackedItem::sItems = 0;
+  {
+    SmallVector<TrackedItem, 2> items(2);
+    ASSERT_EQ(2, TrackedItem::sItems);
+    auto itemsCopy = items;
+    SmallVector<TrackedItem, 2> itemsMoved(std::move(items));
+    itemsMoved.push_back(TrackedItem());
+    ASSERT_FALSE(itemsMoved.isInline());
+    ASSERT_EQ(5, TrackedItem::sItems);
+  }
+  ASSERT_EQ(0, TrackedItem::sItems);
+
+  SmallVector<std::string, 2> strings = {"one", "two", "three"};
+  ASSERT_FALSE(strings.isInline());
+  ASSERT_EQ("three", strings[2]);
+}
+
+TEST(VectorTest, uniqueBufferCtor) {
+  auto buffer = makeUniqueBuffer(4 * sizeof(u32) + 1);
+  for (u32 i = 0; i < 4; ++i) {
+    reinterpret_cast<u32*>(buffer.data())[i] = i;
+  }
+  const auto data = buffer.data();
+
+  Vector<u32> values(std::move(buffer));
+  ASSERT_TRUE(buffer.empty());
+  ASSERT_EQ(4u, values.size());
+  ASSERT_EQ(reinterpret_cast<u32*>(data), values.data());
+  ASSERT_EQ(3u, values[3]);
+  values.push_back(4);
+
+  SmallVector<u32, 8> small(makeUniqueBuffer(2 * sizeof(u32)));
+  ASSERT_EQ(2u, small.size());
+  ASSERT_FALSE(small.isInline());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// A handle with real moves, which is still fine to relocate with memcpy
+struct Handle {
+  explicit Handle(int valueIn) : value(new int(valueIn)) {}
+  Handle(Handle&& that) noexcept : value(std::exchange(that.value, nullptr)) { ++sMoves; }
+  ~Handle() { delete value; }
+
+  int* value;
+  static int sMoves;
+};
+int Handle::sMoves = 0;
+SW_DECLARE_TRIVIALLY_RELOCATABLE(Handle);
+
+TEST(VectorTest, triviallyRelocatable) {
+  static_assert(std::is_same<MallocReallocator<Handle>, Vector<Handle>::reallocator>::value, "realloc for handles");
+  static_assert(std::is_same<MallocReallocator<std::unique_ptr<int>>, Vector<std::unique_ptr<int>>::reallocator>::value,
+                "realloc for unique_ptr");
+  static_assert(!IsTriviallyRelocatable<std::string>::value, "strings may point into themselves");
+
+  // Growing never moves the handles one by one
+  Handle::sMoves = 0;
+  {
+    Vector<Handle> handles;
+    for (int i = 0; i < 100; ++i) {
+      handles.push_back(Handle(i));
+    }
+    ASSERT_EQ(100, Handle::sMoves);  // Just the push_backs
+    ASSERT_EQ(42, *handles[42].value);
+
+    // Nor do the fallbacks
+    Vector<Handle, StdReallocator<Handle>> adapted;
+    adapted.push_back(Handle(1));
+    adapted.reserve(100);
+    ASSERT_EQ(101, Handle::sMoves);
+    ASSERT_EQ(1, *adapted[0].value);
+  }
+
+  Vector<std::unique_ptr<int>> pointers;
+  for (int i = 0; i < 50; ++i) {
+    pointers.push_back(std::make_unique<int>(i));
+  }
+  ASSERT_EQ(49, *pointers.back());
+}
+
+TEST(VectorTest, growthPolicies) {
+  // Growing from nothing
+  Vector<int> empty;
+  empty.push_back(1);
+  ASSERT_EQ(1u, empty.capacity());
+  empty.push_back(2);
+  ASSERT_EQ(2u, empty.capacity());
+
+  Vector<int, MallocReallocator<int>, OneAndHalfGrowthPolicy> halfAgain;
+  for (int i = 0; i < 5; ++i) {
+    halfAgain.push_back(i);
+  }
+  ASSERT_EQ(6u, halfAgain.capacity());  // 1, 2, 3, 4, 6
+
+  using SizeClasses = SizeClassGrowthPolicy<>;
+  ASSERT_EQ(8u, SizeClasses::roundUpToSizeClass(1));
+  ASSERT_EQ(48u, SizeClasses::roundUpToSizeClass(33));
+  ASSERT_EQ(160u, SizeClasses::roundUpToSizeClass(129));
+  ASSERT_EQ(320u, SizeClasses::roundUpToSizeClass(257));
+  ASSERT_EQ(1280u, SizeClasses::roundUpToSizeClass(1025));
+
+  Vector<u64, MallocReallocator<u64>, SizeClasses> classed;
+  for (u64 i = 0; i < 17; ++i) {
+    classed.push_back(i);
+  }
+  ASSERT_EQ(24u, classed.capacity());  // 16 grows by half again to 24, 192 bytes
+  ASSERT_EQ(16u, classed[16]);
+}
+
 SW_NAMESPACE_END